@@ -0,0 +1,436 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <algorithm>
+
+#include <common/allocationtracker.hpp>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <malloc.h>
+#endif
+
+// Call stacks need glibc's backtrace, they're only recorded in debug builds
+#if defined(TRACK_ALLOCATIONS) && !defined(NDEBUG) && defined(__GLIBC__)
+#define ALLOCATION_CALL_SITES
+#include <execinfo.h>
+#include <cxxabi.h>
+#endif
+
+#ifdef TRACK_ALLOCATIONS
+const bool AllocationTracker::enabled = true;
+#else
+const bool AllocationTracker::enabled = false;
+#endif
+AllocationStrictness AllocationTracker::strict = AllocationStrictness::Off;
+unsigned int AllocationTracker::warmupFrames = 60;
+
+namespace
+{
+    // All threads
+    std::atomic<uint64_t> totalAllocations(0), totalFrees(0), totalBytes(0);
+
+    // Calling thread, these are plain data so they need no construction
+    thread_local uint64_t threadAllocations = 0, threadFrees = 0, threadBytes = 0;
+    thread_local bool renderThread = false;
+
+    // Frames, only touched by the render thread
+    uint64_t frameIndex = 0;
+    AllocationStats frameStart, frameStartAll, lastFrame, lastFrameAll;
+    AllocationStats steadyTotal, steadyTotalAll;
+    uint64_t steadyFrames = 0, allocatingFrames = 0;
+
+    AllocationStats difference(const AllocationStats& a, const AllocationStats& b)
+    {
+        AllocationStats stats;
+        stats.allocations = a.allocations - b.allocations;
+        stats.frees = a.frees - b.frees;
+        stats.bytes = a.bytes - b.bytes;
+        return stats;
+    }
+
+    void add(AllocationStats& total, const AllocationStats& stats)
+    {
+        total.allocations += stats.allocations;
+        total.frees += stats.frees;
+        total.bytes += stats.bytes;
+    }
+
+#ifdef ALLOCATION_CALL_SITES
+    // Distinct call stacks of the allocations of one frame
+    const int siteDepth = 8;
+    const unsigned int siteCapacity = 128;
+
+    struct CallSite
+    {
+        void* frames[siteDepth];
+        int depth;
+        uint64_t count, bytes;
+    };
+
+    CallSite sites[siteCapacity];
+    unsigned int siteCount = 0;
+    bool recordSites = false;
+    thread_local bool inRecord = false;
+
+    void recordSite(std::size_t size, void* caller)
+    {
+        // Start the stack at the caller of operator new
+        void* frames[siteDepth + 8];
+        int depth = backtrace(frames, siteDepth + 8);
+        int first = 0;
+        while (first < depth && frames[first] != caller)
+            first++;
+        if (first == depth)
+            first = 0;
+        depth = std::min(depth - first, siteDepth);
+
+        unsigned int i = 0;
+        for (; i < siteCount; i++)
+            if (sites[i].depth == depth && memcmp(sites[i].frames, frames + first, depth * sizeof(void*)) == 0)
+                break;
+
+        if (i == siteCount)
+        {
+            // Allocations past a full table go to its last entry
+            if (siteCount == siteCapacity)
+                i = siteCapacity - 1;
+            else
+            {
+                memcpy(sites[i].frames, frames + first, depth * sizeof(void*));
+                sites[i].depth = depth;
+                sites[i].count = 0;
+                sites[i].bytes = 0;
+                siteCount++;
+            }
+        }
+        sites[i].count++;
+        sites[i].bytes += size;
+    }
+
+    // Print a frame of a call stack with its demangled name when it has one
+    void printFrame(const char* symbol)
+    {
+        const char* open = strchr(symbol, '(');
+        const char* plus = open != NULL ? strchr(open, '+') : NULL;
+        if (open != NULL && plus != NULL && plus > open + 1)
+        {
+            char mangled[512];
+            size_t length = std::min(static_cast<size_t>(plus - open - 1), sizeof(mangled) - 1);
+            memcpy(mangled, open + 1, length);
+            mangled[length] = '\0';
+
+            int status = 0;
+            char* name = abi::__cxa_demangle(mangled, NULL, NULL, &status);
+            if (status == 0 && name != NULL)
+            {
+                printf("        %s\n", name);
+                free(name);
+                return;
+            }
+            free(name);
+        }
+        printf("        %s\n", symbol);
+    }
+
+    void printSites()
+    {
+        std::sort(sites, sites + siteCount, [](const CallSite& a, const CallSite& b) { return a.count > b.count; });
+        for (unsigned int i = 0; i < std::min(siteCount, 8u); i++)
+        {
+            printf("    %llu allocations, %llu bytes from\n", static_cast<unsigned long long>(sites[i].count),
+                   static_cast<unsigned long long>(sites[i].bytes));
+            char** symbols = backtrace_symbols(sites[i].frames, sites[i].depth);
+            if (symbols == NULL)
+                continue;
+            for (int j = 0; j < sites[i].depth; j++)
+                printFrame(symbols[j]);
+            free(symbols);
+        }
+    }
+#endif
+
+    void countAllocation(std::size_t size, void* caller)
+    {
+        threadAllocations++;
+        threadBytes += size;
+        totalAllocations.fetch_add(1, std::memory_order_relaxed);
+        totalBytes.fetch_add(size, std::memory_order_relaxed);
+
+#ifdef ALLOCATION_CALL_SITES
+        if (renderThread && recordSites && !inRecord)
+        {
+            inRecord = true;
+            recordSite(size, caller);
+            inRecord = false;
+        }
+#endif
+    }
+
+    void countFree()
+    {
+        threadFrees++;
+        totalFrees.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void AllocationTracker::beginFrame()
+{
+    renderThread = true;
+    frameStart = thread();
+    frameStartAll = total();
+
+#ifdef ALLOCATION_CALL_SITES
+    siteCount = 0;
+    recordSites = strict != AllocationStrictness::Off && frameIndex >= warmupFrames;
+#endif
+}
+
+void AllocationTracker::endFrame()
+{
+#ifdef ALLOCATION_CALL_SITES
+    recordSites = false;
+#endif
+    lastFrame = difference(thread(), frameStart);
+    lastFrameAll = difference(total(), frameStartAll);
+
+    if (frameIndex >= warmupFrames)
+    {
+        steadyFrames++;
+        add(steadyTotal, lastFrame);
+        add(steadyTotalAll, lastFrameAll);
+
+        if (lastFrame.allocations > 0)
+        {
+            allocatingFrames++;
+            if (strict != AllocationStrictness::Off)
+            {
+                printf("Frame %llu allocated %llu times, %llu bytes on the render thread\n",
+                       static_cast<unsigned long long>(frameIndex), static_cast<unsigned long long>(lastFrame.allocations),
+                       static_cast<unsigned long long>(lastFrame.bytes));
+#ifdef ALLOCATION_CALL_SITES
+                printSites();
+#endif
+                if (strict == AllocationStrictness::Abort)
+                {
+                    fflush(stdout);
+                    abort();
+                }
+            }
+        }
+    }
+    frameIndex++;
+}
+
+AllocationStats AllocationTracker::frame()
+{
+    return lastFrame;
+}
+
+AllocationStats AllocationTracker::frameAllThreads()
+{
+    return lastFrameAll;
+}
+
+AllocationStats AllocationTracker::thread()
+{
+    AllocationStats stats;
+    stats.allocations = threadAllocations;
+    stats.frees = threadFrees;
+    stats.bytes = threadBytes;
+    return stats;
+}
+
+AllocationStats AllocationTracker::total()
+{
+    AllocationStats stats;
+    stats.allocations = totalAllocations.load(std::memory_order_relaxed);
+    stats.frees = totalFrees.load(std::memory_order_relaxed);
+    stats.bytes = totalBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AllocationTracker::printSummary()
+{
+    if (!enabled || steadyFrames == 0)
+        return;
+
+    printf("Allocations per frame after %u warm up frames: %.2f (%.0f bytes) on the render thread, %.2f (%.0f bytes) "
+           "on all threads, %llu of %llu frames allocated\n", warmupFrames,
+           static_cast<double>(steadyTotal.allocations) / steadyFrames, static_cast<double>(steadyTotal.bytes) / steadyFrames,
+           static_cast<double>(steadyTotalAll.allocations) / steadyFrames, static_cast<double>(steadyTotalAll.bytes) / steadyFrames,
+           static_cast<unsigned long long>(allocatingFrames), static_cast<unsigned long long>(steadyFrames));
+}
+
+#ifdef TRACK_ALLOCATIONS
+// Replacements of the global allocation functions, the caller of operator new
+// is where the recorded call stacks start
+namespace
+{
+    void* allocate(std::size_t size, void* caller)
+    {
+        void* pointer = malloc(size > 0 ? size : 1);
+        if (pointer != nullptr)
+            countAllocation(size, caller);
+        return pointer;
+    }
+
+    void release(void* pointer)
+    {
+        if (pointer == nullptr)
+            return;
+        countFree();
+        free(pointer);
+    }
+
+#ifdef __cpp_aligned_new
+    void* allocateAligned(std::size_t size, std::size_t alignment, void* caller)
+    {
+#ifdef _WIN32
+        void* pointer = _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+        void* pointer = nullptr;
+        if (posix_memalign(&pointer, std::max(alignment, sizeof(void*)), size > 0 ? size : 1) != 0)
+            pointer = nullptr;
+#endif
+        if (pointer != nullptr)
+            countAllocation(size, caller);
+        return pointer;
+    }
+
+    void releaseAligned(void* pointer)
+    {
+        if (pointer == nullptr)
+            return;
+        countFree();
+#ifdef _WIN32
+        _aligned_free(pointer);
+#else
+        free(pointer);
+#endif
+    }
+#endif
+}
+
+#ifdef _MSC_VER
+#define ALLOCATION_CALLER _ReturnAddress()
+#else
+#define ALLOCATION_CALLER __builtin_return_address(0)
+#endif
+
+void* operator new(std::size_t size)
+{
+    void* pointer = allocate(size, ALLOCATION_CALLER);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* pointer = allocate(size, ALLOCATION_CALLER);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, ALLOCATION_CALLER);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, ALLOCATION_CALLER);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    release(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    release(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    release(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    release(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    release(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    release(pointer);
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    void* pointer = allocateAligned(size, static_cast<std::size_t>(alignment), ALLOCATION_CALLER);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    void* pointer = allocateAligned(size, static_cast<std::size_t>(alignment), ALLOCATION_CALLER);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<std::size_t>(alignment), ALLOCATION_CALLER);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<std::size_t>(alignment), ALLOCATION_CALLER);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    releaseAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    releaseAligned(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    releaseAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    releaseAligned(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    releaseAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    releaseAligned(pointer);
+}
+#endif
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations made through operator new
+struct AllocationStats
+{
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;         // bytes allocated
+};
+
+// What a steady state frame that allocates does
+enum class AllocationStrictness { Off, Log, Abort };
+
+// Counts heap allocations with replacements of the global operator new and
+// delete, compiled in with the TRACK_ALLOCATIONS build option. Frames are
+// counted on the thread that brackets them, normally the render thread, and
+// over all threads. In strict mode a frame past the warm up that allocates on
+// the render thread is logged or aborts the program, debug builds on glibc
+// also report the call stacks of its allocations.
+class AllocationTracker
+{
+public:
+    // True when the operator new hooks are compiled in
+    static const bool enabled;
+
+    // Strict mode, frames before the loop counts as steady state
+    static AllocationStrictness strict;
+    static unsigned int warmupFrames;
+
+    // Frame boundaries, called on the render thread
+    static void beginFrame();
+    static void endFrame();
+
+    // Allocations of the last frame on the render thread and on all threads
+    static AllocationStats frame();
+    static AllocationStats frameAllThreads();
+
+    // Allocations of the calling thread and of all threads since the start
+    static AllocationStats thread();
+    static AllocationStats total();
+
+    // Averages per steady state frame
+    static void printSummary();
+};
@@ -0,0 +1,319 @@
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include <common/benchmark.hpp>
+#ifdef NULL_GL
+#include <common/nullgl.hpp>
+#endif
+
+GPUFrameTimer::GPUFrameTimer()
+{
+    glGenQueries(queryCount, queries);
+    for (unsigned int i = 0; i < queryCount; i++)
+        queryFrames[i] = -1;
+}
+
+GPUFrameTimer::~GPUFrameTimer()
+{
+    glDeleteQueries(queryCount, queries);
+}
+
+void GPUFrameTimer::begin(unsigned int frame)
+{
+    // Reuse the oldest query once its result has been read
+    unsigned int slot = next++ % queryCount;
+    if (queryFrames[slot] >= 0)
+        read(slot);
+    glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+    queryFrames[slot] = static_cast<int>(frame);
+}
+
+void GPUFrameTimer::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void GPUFrameTimer::flush()
+{
+    // Oldest first so the results stay in frame order
+    for (unsigned int i = 0; i < queryCount; i++)
+    {
+        unsigned int slot = (next + i) % queryCount;
+        if (queryFrames[slot] >= 0)
+            read(slot);
+    }
+}
+
+void GPUFrameTimer::reset()
+{
+    flush();
+    frames.clear();
+    times.clear();
+}
+
+void GPUFrameTimer::read(unsigned int slot)
+{
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+    frames.push_back(static_cast<unsigned int>(queryFrames[slot]));
+    times.push_back(static_cast<float>(elapsed * 1e-6));
+    queryFrames[slot] = -1;
+}
+
+void Benchmark::generate(const Scene& base, unsigned int blocks, Scene& scene)
+{
+    scene.clear();
+    scene.meshes = base.meshes;
+    scene.materials = base.materials;
+    scene.reserve(blocks + 1);
+
+    // Every object of the template except the ground is copied
+    int ground = base.findMesh("plane");
+    std::vector<unsigned int> parts;
+    AABB house;
+    for (unsigned int i = 0; i < base.objectCount; i++)
+    {
+        if (static_cast<int>(base.meshIDs[i]) == ground)
+            continue;
+
+        parts.push_back(i);
+        house.expand(base.positions[i]);
+    }
+    if (parts.empty())
+        return;
+
+    std::mt19937 generator(seed);
+    if (layout != BenchmarkLayout::Blocks)
+    {
+        // Copies on a grid spaced by whole blocks, the positions in each copy
+        // are turned by a random multiple of 90 degrees about the centre of
+        // the template so the blocks stay on the block grid
+        unsigned int copies = (blocks + static_cast<unsigned int>(parts.size()) - 1) / static_cast<unsigned int>(parts.size());
+        unsigned int side = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(copies))));
+        glm::vec3 size = house.max - house.min;
+        glm::vec3 centre = 2.0f * glm::floor(0.5f * house.centre());
+        float spacing = 2.0f * std::ceil(0.5f * std::max(size.x, size.z)) + 4.0f;
+        for (unsigned int c = 0; c < copies; c++)
+        {
+            glm::vec3 offset(spacing * (c % side), 0.0f, spacing * (c / side));
+            unsigned int turns = random(generator, 4);
+            for (unsigned int j = 0; j < parts.size(); j++)
+            {
+                unsigned int i = parts[j];
+                glm::vec3 p = base.positions[i] - centre;
+                for (unsigned int t = 0; t < turns; t++)
+                    p = glm::vec3(-p.z, p.y, p.x);
+
+                scene.addObject(base.meshIDs[i], base.materialIDs[i], centre + offset + p, base.scales[i],
+                                base.axes[i], base.angles[i]);
+            }
+        }
+    }
+    else
+    {
+        // Random field filling about a quarter of a cube of blocks, one in 64
+        // is turned so it's drawn as an object rather than a block
+        unsigned int side = static_cast<unsigned int>(std::ceil(std::cbrt(4.0f * blocks)));
+        for (unsigned int b = 0; b < blocks; b++)
+        {
+            unsigned int i = parts[random(generator, static_cast<unsigned int>(parts.size()))];
+            glm::ivec3 cell(random(generator, side), random(generator, side), random(generator, side));
+            float angle = random(generator, 64) == 0 ? Maths::radians(static_cast<float>(random(generator, 90))) : 0.0f;
+            scene.addObject(base.meshIDs[i], base.materialIDs[i], 2.0f * glm::vec3(cell), glm::vec3(1.0f),
+                            glm::vec3(0.0f, 1.0f, 0.0f), angle);
+        }
+    }
+
+    // Ground under the whole scene with the material of the template's ground
+    for (unsigned int i = 0; i < base.objectCount; i++)
+    {
+        if (static_cast<int>(base.meshIDs[i]) != ground)
+            continue;
+
+        const AABB& mesh = scene.meshes[ground].bounds;
+        glm::vec3 size = scene.bounds.max - scene.bounds.min;
+        glm::vec3 centre = scene.bounds.centre();
+        glm::vec3 scale(1.1f * size.x / (mesh.max.x - mesh.min.x), 1.0f, 1.1f * size.z / (mesh.max.z - mesh.min.z));
+        scene.addObject(ground, base.materialIDs[i], glm::vec3(centre.x, scene.bounds.min.y, centre.z), scale);
+        break;
+    }
+
+    current = BenchmarkResult();
+    current.requested = blocks;
+}
+
+void Benchmark::beginRun(const AABB& bounds, unsigned int blocks, unsigned int objects, float setupTime,
+                         unsigned int lights, bool deferred)
+{
+    path = CameraPath::orbit(bounds, warmupFrames + frames);
+    current.blocks = blocks;
+    current.objects = objects;
+    current.setupTime = setupTime;
+    current.lights = lights;
+    current.deferred = deferred;
+    frame = 0;
+    cpuTimes.clear();
+    gpuTimer.reset();
+    drawCallSum = 0.0;
+    triangleSum = 0.0;
+    glCallSums.clear();
+}
+
+void Benchmark::beginFrame(Camera& camera)
+{
+    // One orbit around the scene over the whole run
+    path.apply(camera, static_cast<float>(frame));
+#ifdef NULL_GL
+    NullGL::snapshot(glCallsFrame);
+#endif
+    gpuTimer.begin(frame);
+}
+
+void Benchmark::endFrame(float cpuTime, const RenderStats& stats)
+{
+    gpuTimer.end();
+
+    if (frame >= warmupFrames)
+    {
+        cpuTimes.push_back(cpuTime);
+        drawCallSum += stats.drawCalls;
+        triangleSum += static_cast<double>(stats.triangles);
+#ifdef NULL_GL
+        glCallSums.resize(NullGLEntryCount, 0.0);
+        for (unsigned int i = 0; i < NullGLEntryCount; i++)
+            glCallSums[i] += static_cast<double>(NullGL::calls[i] - glCallsFrame[i]);
+#endif
+    }
+    frame++;
+}
+
+void Benchmark::endRun()
+{
+    gpuTimer.flush();
+
+    for (unsigned int i = 0; i < cpuTimes.size(); i++)
+    {
+        current.cpuTime += cpuTimes[i] / cpuTimes.size();
+        current.cpuMax = std::max(current.cpuMax, cpuTimes[i]);
+    }
+    unsigned int gpuFrames = 0;
+    for (unsigned int i = 0; i < gpuTimer.times.size(); i++)
+    {
+        if (gpuTimer.frames[i] < warmupFrames)
+            continue;
+
+        current.gpuTime += gpuTimer.times[i];
+        current.gpuMax = std::max(current.gpuMax, gpuTimer.times[i]);
+        gpuFrames++;
+    }
+    if (gpuFrames > 0)
+        current.gpuTime /= gpuFrames;
+    if (!cpuTimes.empty())
+    {
+        current.drawCalls = static_cast<float>(drawCallSum / cpuTimes.size());
+        current.triangles = static_cast<float>(triangleSum / cpuTimes.size());
+    }
+    results.push_back(current);
+
+    if (layout == BenchmarkLayout::Lights)
+        printf("Benchmark %u lights %s: cpu %.3f ms, gpu %.3f ms, %.0f draw calls\n", current.lights,
+               current.deferred ? "deferred" : "forward", current.cpuTime, current.gpuTime, current.drawCalls);
+    else
+        printf("Benchmark %u blocks: %u in the world, %u objects, cpu %.3f ms, gpu %.3f ms, %.0f draw calls, %.0f triangles\n",
+               current.requested, current.blocks, current.objects, current.cpuTime, current.gpuTime,
+               current.drawCalls, current.triangles);
+
+#ifdef NULL_GL
+    // Calls per frame by entry point over the measured frames, busiest first
+    if (!glCallSums.empty())
+    {
+        std::vector<float>& calls = results.back().glCalls;
+        calls.resize(NullGLEntryCount);
+        std::vector<unsigned int> order;
+        float total = 0.0f;
+        for (unsigned int i = 0; i < NullGLEntryCount; i++)
+        {
+            calls[i] = static_cast<float>(glCallSums[i] / cpuTimes.size());
+            total += calls[i];
+            if (calls[i] > 0.0f)
+                order.push_back(i);
+        }
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return calls[a] > calls[b]; });
+
+        printf("  %.1f GL calls per frame:", total);
+        for (unsigned int i = 0; i < std::min(static_cast<unsigned int>(order.size()), 8u); i++)
+            printf(" %s %.1f", NullGL::name(order[i]), calls[order[i]]);
+        printf("\n");
+    }
+#endif
+}
+
+const char* Benchmark::layoutName() const
+{
+    return layout == BenchmarkLayout::Houses ? "houses" : layout == BenchmarkLayout::Blocks ? "blocks" : "lights";
+}
+
+bool Benchmark::writeCSV(const char* path) const
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("Impossible to write the benchmark results to %s.\n", path);
+        return false;
+    }
+
+    fprintf(file, "layout,requested,blocks,objects,setup_ms,cpu_ms,cpu_max_ms,gpu_ms,gpu_max_ms,draw_calls,triangles,"
+                  "lights,lighting\n");
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& r = results[i];
+        fprintf(file, "%s,%u,%u,%u,%.3f,%.4f,%.4f,%.4f,%.4f,%.1f,%.0f,%u,%s\n", layoutName(), r.requested, r.blocks,
+                r.objects, r.setupTime, r.cpuTime, r.cpuMax, r.gpuTime, r.gpuMax, r.drawCalls, r.triangles, r.lights,
+                r.lights == 0 ? "none" : r.deferred ? "deferred" : "forward");
+    }
+    fclose(file);
+
+#ifdef NULL_GL
+    // Calls per frame by entry point, one row per entry that was called
+    bool counted = false;
+    for (unsigned int i = 0; i < results.size(); i++)
+        counted = counted || !results[i].glCalls.empty();
+    if (!counted)
+        return true;
+
+    std::string callsPath = path;
+    size_t extension = callsPath.rfind('.');
+    if (extension != std::string::npos && callsPath.find_first_of("/\\", extension) == std::string::npos)
+        callsPath.erase(extension);
+    callsPath += "_calls.csv";
+
+    file = fopen(callsPath.c_str(), "w");
+    if (file == NULL)
+    {
+        printf("Impossible to write the GL call counts to %s.\n", callsPath.c_str());
+        return false;
+    }
+
+    fprintf(file, "layout,requested,lights,lighting,entry,calls_per_frame\n");
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& r = results[i];
+        for (unsigned int j = 0; j < r.glCalls.size(); j++)
+        {
+            if (r.glCalls[j] > 0.0f)
+                fprintf(file, "%s,%u,%u,%s,%s,%.2f\n", layoutName(), r.requested, r.lights,
+                        r.lights == 0 ? "none" : r.deferred ? "deferred" : "forward", NullGL::name(j), r.glCalls[j]);
+        }
+    }
+    fclose(file);
+#endif
+
+    return true;
+}
+
+unsigned int Benchmark::random(std::mt19937& generator, unsigned int range)
+{
+    // The raw output of mt19937 is the same everywhere, the distributions aren't
+    return static_cast<unsigned int>(generator() % range);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+#include <common/camera.hpp>
+#include <common/camerapath.hpp>
+#include <common/scene.hpp>
+
+// Per frame rendering counters
+struct RenderStats
+{
+    unsigned int drawCalls = 0;
+    unsigned long long triangles = 0;
+    unsigned int stateChanges = 0;      // binds and state changes passed on to GL
+    unsigned int stateSkips = 0;        // redundant ones filtered by GLState
+
+    void reset() { drawCalls = 0; triangles = 0; stateChanges = 0; stateSkips = 0; }
+};
+
+// Times whole frames on the GPU with GL_TIME_ELAPSED queries. Results are
+// read back a few frames late so they never stall the CPU.
+class GPUFrameTimer
+{
+public:
+    // Frames and times in milliseconds read back so far
+    std::vector<unsigned int> frames;
+    std::vector<float> times;
+
+    // Constructor and destructor, a GL context must be current
+    GPUFrameTimer();
+    ~GPUFrameTimer();
+
+    // Bracket the GL commands of a frame
+    void begin(unsigned int frame);
+    void end();
+
+    // Read back the outstanding queries
+    void flush();
+
+    // Forget the results and the queries in flight
+    void reset();
+
+private:
+    static const unsigned int queryCount = 8;
+
+    unsigned int queries[queryCount];
+    int queryFrames[queryCount];
+    unsigned int next = 0;
+
+    void read(unsigned int slot);
+};
+
+// Result of one benchmark run, times are in milliseconds and the counters
+// are averages per frame
+struct BenchmarkResult
+{
+    unsigned int requested = 0;     // blocks asked for
+    unsigned int blocks = 0;        // blocks in the voxel world
+    unsigned int objects = 0;       // objects drawn on their own
+    float setupTime = 0.0f;
+    float cpuTime = 0.0f, cpuMax = 0.0f;
+    float gpuTime = 0.0f, gpuMax = 0.0f;
+    float drawCalls = 0.0f;
+    float triangles = 0.0f;
+    unsigned int lights = 0;        // lights of the lit runs
+    bool deferred = false;          // lit with the deferred path rather than forward
+    std::vector<float> glCalls;     // calls per frame by entry point, null GL builds only
+};
+
+// Layout of the generated scenes, Lights draws the houses of the first size
+// lit by each light count, forward then deferred
+enum class BenchmarkLayout { Houses, Blocks, Lights };
+
+// Scaling benchmark. Generates scenes of increasing size from the meshes,
+// materials and objects of a template scene, flies the camera along a fixed
+// orbit around each one and records the CPU and GPU frame times.
+class Benchmark
+{
+public:
+    BenchmarkLayout layout = BenchmarkLayout::Houses;
+    std::vector<unsigned int> sizes = { 1000, 10000, 100000, 1000000 };
+    std::vector<unsigned int> lightCounts = { 16, 64, 256, 1024 };
+    unsigned int seed = 12345;
+    unsigned int warmupFrames = 30;
+    unsigned int frames = 300;
+    std::vector<BenchmarkResult> results;
+
+    // Generate a scene with roughly the given number of blocks
+    void generate(const Scene& base, unsigned int blocks, Scene& scene);
+
+    // Start a run once the generated scene has been set up, the light count
+    // and path are those of the Lights layout
+    void beginRun(const AABB& bounds, unsigned int blocks, unsigned int objects, float setupTime,
+                  unsigned int lights = 0, bool deferred = false);
+    bool running() const { return frame < warmupFrames + frames; }
+
+    // Move the camera along the path and time the frame
+    void beginFrame(Camera& camera);
+    void endFrame(float cpuTime, const RenderStats& stats);
+
+    // Collect the outstanding timers and store the result
+    void endRun();
+
+    // Write the results as comma separated values, null GL builds also write
+    // the calls per frame by entry point next to them
+    bool writeCSV(const char* path) const;
+    const char* layoutName() const;
+
+private:
+    GPUFrameTimer gpuTimer;
+    unsigned int frame = 0;
+    CameraPath path;
+    BenchmarkResult current;
+    std::vector<float> cpuTimes;
+    double drawCallSum = 0.0, triangleSum = 0.0;
+    std::vector<uint64_t> glCallsFrame;
+    std::vector<double> glCallSums;
+
+    static unsigned int random(std::mt19937& generator, unsigned int range);
+};
@@ -0,0 +1,142 @@
+#include <cmath>
+#include <algorithm>
+
+#include <common/bounds.hpp>
+
+float AABB::surfaceArea() const
+{
+    if (!isValid())
+        return 0.0f;
+
+    glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+void AABB::expand(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::expand(const AABB& box)
+{
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+}
+
+bool AABB::contains(const AABB& box) const
+{
+    return min.x <= box.min.x && min.y <= box.min.y && min.z <= box.min.z &&
+           max.x >= box.max.x && max.y >= box.max.y && max.z >= box.max.z;
+}
+
+AABB AABB::transformed(const glm::mat4& matrix) const
+{
+    // Transform the centre and project the extents onto the new axes
+    glm::vec3 c = glm::vec3(matrix * glm::vec4(centre(), 1.0f));
+    glm::vec3 e = extent();
+    glm::vec3 r;
+    for (int i = 0; i < 3; i++)
+        r[i] = std::abs(matrix[0][i]) * e.x + std::abs(matrix[1][i]) * e.y + std::abs(matrix[2][i]) * e.z;
+
+    return AABB(c - r, c + r);
+}
+
+AABB AABB::merge(const AABB& a, const AABB& b)
+{
+    return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+Ray::Ray(const glm::vec3& Origin, const glm::vec3& Direction)
+{
+    origin = Origin;
+    direction = glm::normalize(Direction);
+    invDirection = 1.0f / direction;
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& m)
+{
+    // Extract the planes from the rows of the view-projection matrix
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; i++)
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+
+    return frustum;
+}
+
+bool Bounds::intersects(const AABB& a, const AABB& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+bool Bounds::intersects(const Sphere& sphere, const AABB& box)
+{
+    glm::vec3 closest = glm::clamp(sphere.centre, box.min, box.max);
+    glm::vec3 d = closest - sphere.centre;
+    return glm::dot(d, d) <= sphere.radius * sphere.radius;
+}
+
+bool Bounds::intersects(const Ray& ray, const AABB& box, float maxDistance, float& distance)
+{
+    // Slab test
+    glm::vec3 t0 = (box.min - ray.origin) * ray.invDirection;
+    glm::vec3 t1 = (box.max - ray.origin) * ray.invDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float tMin = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float tMax = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+
+    distance = tMin;
+    return tMin <= tMax;
+}
+
+Containment Bounds::classify(const Frustum& frustum, const AABB& box)
+{
+    glm::vec3 c = box.centre();
+    glm::vec3 e = box.extent();
+    Containment result = Containment::Inside;
+    for (int i = 0; i < 6; i++)
+    {
+        // Signed distance of the centre and projected radius of the box
+        const glm::vec4& p = frustum.planes[i];
+        float d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+        float r = std::abs(p.x) * e.x + std::abs(p.y) * e.y + std::abs(p.z) * e.z;
+        if (d < -r)
+            return Containment::Outside;
+        if (d < r)
+            result = Containment::Intersecting;
+    }
+
+    return result;
+}
+
+bool Bounds::intersects(const Frustum& frustum, const AABB& box)
+{
+    return classify(frustum, box) != Containment::Outside;
+}
+
+bool Bounds::intersects(const Frustum& frustum, const Sphere& sphere)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        const glm::vec4& p = frustum.planes[i];
+        if (glm::dot(glm::vec3(p), sphere.centre) + p.w < -sphere.radius)
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cfloat>
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box
+struct AABB
+{
+    glm::vec3 min = glm::vec3( FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    AABB() {}
+    AABB(const glm::vec3& Min, const glm::vec3& Max) : min(Min), max(Max) {}
+
+    // Methods
+    glm::vec3 centre() const { return 0.5f * (min + max); }
+    glm::vec3 extent() const { return 0.5f * (max - min); }
+    bool isValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    float surfaceArea() const;
+    void expand(const glm::vec3& point);
+    void expand(const AABB& box);
+    bool contains(const AABB& box) const;
+    AABB transformed(const glm::mat4& matrix) const;
+
+    static AABB merge(const AABB& a, const AABB& b);
+};
+
+// Bounding sphere
+struct Sphere
+{
+    glm::vec3 centre;
+    float radius;
+};
+
+// Ray with precomputed reciprocal direction for slab tests
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 invDirection;
+
+    Ray(const glm::vec3& Origin, const glm::vec3& Direction);
+};
+
+// Result of classifying a volume against a frustum
+enum class Containment { Outside, Intersecting, Inside };
+
+// View frustum stored as six inward facing planes (left, right, bottom, top,
+// near, far) with normalised normals
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+};
+
+// Intersection tests
+namespace Bounds
+{
+    bool intersects(const AABB& a, const AABB& b);
+    bool intersects(const Sphere& sphere, const AABB& box);
+    bool intersects(const Ray& ray, const AABB& box, float maxDistance, float& distance);
+    Containment classify(const Frustum& frustum, const AABB& box);
+    bool intersects(const Frustum& frustum, const AABB& box);
+    bool intersects(const Frustum& frustum, const Sphere& sphere);
+}
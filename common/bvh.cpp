@@ -0,0 +1,651 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+
+#include <common/bvh.hpp>
+
+// Number of bins used when evaluating the surface area heuristic
+static const int sahBins = 16;
+
+std::vector<int> BVH::build(const std::vector<AABB>& boxes)
+{
+    clear();
+    nodes.reserve(2 * boxes.size());
+
+    // Create a leaf for each object
+    std::vector<int> proxies(boxes.size());
+    std::vector<int> leaves(boxes.size());
+    std::vector<glm::vec3> centroids(boxes.size());
+    for (unsigned int i = 0; i < boxes.size(); i++)
+    {
+        int leaf = allocateNode();
+        nodes[leaf].box = boxes[i];
+        nodes[leaf].object = i;
+        nodes[leaf].height = 0;
+        proxies[i] = leaf;
+        leaves[i] = leaf;
+        centroids[i] = boxes[i].centre();
+    }
+    leafCount = static_cast<unsigned int>(boxes.size());
+
+    // Build the hierarchy top-down
+    if (!leaves.empty())
+        root = buildRecursive(leaves, centroids, 0, static_cast<int>(leaves.size()), -1);
+
+    return proxies;
+}
+
+int BVH::buildRecursive(std::vector<int>& leaves, std::vector<glm::vec3>& centroids,
+                        int begin, int end, int parent)
+{
+    int count = end - begin;
+    if (count == 1)
+    {
+        nodes[leaves[begin]].parent = parent;
+        return leaves[begin];
+    }
+
+    // Bounds of the centroids
+    AABB centroidBox;
+    for (int i = begin; i < end; i++)
+        centroidBox.expand(centroids[i]);
+
+    // Find the cheapest split over the bins of each axis
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float lo = centroidBox.min[axis];
+        float width = centroidBox.max[axis] - lo;
+        if (width <= 0.0f)
+            continue;
+
+        // Bin the objects
+        AABB binBox[sahBins];
+        int binCount[sahBins] = { 0 };
+        float scale = sahBins / width;
+        for (int i = begin; i < end; i++)
+        {
+            int b = std::min(sahBins - 1, static_cast<int>((centroids[i][axis] - lo) * scale));
+            binCount[b]++;
+            binBox[b].expand(nodes[leaves[i]].box);
+        }
+
+        // Sweep from the right to accumulate the right hand areas
+        float rightArea[sahBins];
+        int rightCount[sahBins];
+        AABB box;
+        int n = 0;
+        for (int b = sahBins - 1; b > 0; b--)
+        {
+            box.expand(binBox[b]);
+            n += binCount[b];
+            rightArea[b] = box.surfaceArea();
+            rightCount[b] = n;
+        }
+
+        // Sweep from the left and evaluate the cost of each split
+        box = AABB();
+        n = 0;
+        for (int b = 0; b < sahBins - 1; b++)
+        {
+            box.expand(binBox[b]);
+            n += binCount[b];
+            if (n == 0 || rightCount[b + 1] == 0)
+                continue;
+
+            float cost = n * box.surfaceArea() + rightCount[b + 1] * rightArea[b + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    // Partition the objects
+    int mid;
+    if (bestAxis == -1)
+    {
+        // All centroids coincide so split down the middle
+        mid = begin + count / 2;
+    }
+    else
+    {
+        float lo = centroidBox.min[bestAxis];
+        float scale = sahBins / (centroidBox.max[bestAxis] - lo);
+        mid = begin;
+        for (int i = begin; i < end; i++)
+        {
+            int b = std::min(sahBins - 1, static_cast<int>((centroids[i][bestAxis] - lo) * scale));
+            if (b <= bestSplit)
+            {
+                std::swap(leaves[i], leaves[mid]);
+                std::swap(centroids[i], centroids[mid]);
+                mid++;
+            }
+        }
+    }
+
+    // Create the internal node and its children
+    int node = allocateNode();
+    nodes[node].parent = parent;
+    int left = buildRecursive(leaves, centroids, begin, mid, node);
+    int right = buildRecursive(leaves, centroids, mid, end, node);
+    nodes[node].left = left;
+    nodes[node].right = right;
+    nodes[node].box = AABB::merge(nodes[left].box, nodes[right].box);
+    nodes[node].height = 1 + std::max(nodes[left].height, nodes[right].height);
+
+    return node;
+}
+
+int BVH::insert(const AABB& box, unsigned int object)
+{
+    // Fatten the box so the object can move a little before it is reinserted
+    int leaf = allocateNode();
+    nodes[leaf].box = AABB(box.min - glm::vec3(margin), box.max + glm::vec3(margin));
+    nodes[leaf].object = object;
+    nodes[leaf].height = 0;
+    insertLeaf(leaf);
+    leafCount++;
+
+    return leaf;
+}
+
+void BVH::remove(int proxy)
+{
+    removeLeaf(proxy);
+    freeNode(proxy);
+    leafCount--;
+}
+
+bool BVH::update(int proxy, const AABB& box)
+{
+    // Nothing to do while the object stays inside its fat box
+    if (nodes[proxy].box.contains(box))
+        return false;
+
+    removeLeaf(proxy);
+    nodes[proxy].box = AABB(box.min - glm::vec3(margin), box.max + glm::vec3(margin));
+    insertLeaf(proxy);
+
+    return true;
+}
+
+void BVH::setBounds(int proxy, const AABB& box)
+{
+    nodes[proxy].box = box;
+}
+
+void BVH::refit()
+{
+    if (root == -1)
+        return;
+
+    // Post-order traversal so children are refitted before their parents
+    stack.clear();
+    int node = root, last = -1;
+    while (!stack.empty() || node != -1)
+    {
+        if (node != -1)
+        {
+            stack.push_back(node);
+            node = nodes[node].left;
+            continue;
+        }
+
+        int top = stack.back();
+        if (!nodes[top].isLeaf() && last != nodes[top].right)
+        {
+            node = nodes[top].right;
+            continue;
+        }
+
+        if (!nodes[top].isLeaf())
+            nodes[top].box = AABB::merge(nodes[nodes[top].left].box, nodes[nodes[top].right].box);
+        last = top;
+        stack.pop_back();
+    }
+}
+
+void BVH::clear()
+{
+    nodes.clear();
+    root = -1;
+    freeList = -1;
+    leafCount = 0;
+}
+
+bool BVH::validate(bool balanced) const
+{
+    if (root == -1)
+        return leafCount == 0;
+    if (nodes[root].parent != -1)
+        return false;
+
+    unsigned int leaves = 0;
+    std::vector<int> pending(1, root);
+    while (!pending.empty())
+    {
+        int index = pending.back();
+        pending.pop_back();
+
+        const BVHNode& node = nodes[index];
+        if (node.isLeaf())
+        {
+            if (node.right != -1 || node.height != 0)
+                return false;
+            leaves++;
+            continue;
+        }
+
+        const BVHNode& left = nodes[node.left];
+        const BVHNode& right = nodes[node.right];
+        if (left.parent != index || right.parent != index)
+            return false;
+        if (node.height != 1 + std::max(left.height, right.height))
+            return false;
+        if (balanced && std::abs(left.height - right.height) > 1)
+            return false;
+        if (!node.box.contains(left.box) || !node.box.contains(right.box))
+            return false;
+
+        pending.push_back(node.left);
+        pending.push_back(node.right);
+    }
+
+    return leaves == leafCount;
+}
+
+int BVH::allocateNode()
+{
+    if (freeList == -1)
+    {
+        nodes.push_back(BVHNode());
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    int node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = BVHNode();
+    return node;
+}
+
+void BVH::freeNode(int node)
+{
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+void BVH::insertLeaf(int leaf)
+{
+    if (root == -1)
+    {
+        root = leaf;
+        nodes[root].parent = -1;
+        return;
+    }
+
+    // Descend to the sibling that gives the smallest increase in surface area
+    AABB leafBox = nodes[leaf].box;
+    int index = root;
+    while (!nodes[index].isLeaf())
+    {
+        int left = nodes[index].left;
+        int right = nodes[index].right;
+
+        float area = nodes[index].box.surfaceArea();
+        float combinedArea = AABB::merge(nodes[index].box, leafBox).surfaceArea();
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        // Cost of descending into each child
+        float costLeft = AABB::merge(leafBox, nodes[left].box).surfaceArea() + inheritanceCost;
+        if (!nodes[left].isLeaf())
+            costLeft -= nodes[left].box.surfaceArea();
+        float costRight = AABB::merge(leafBox, nodes[right].box).surfaceArea() + inheritanceCost;
+        if (!nodes[right].isLeaf())
+            costRight -= nodes[right].box.surfaceArea();
+
+        if (cost < costLeft && cost < costRight)
+            break;
+
+        index = costLeft < costRight ? left : right;
+    }
+
+    // Create a new parent for the sibling and the leaf
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = AABB::merge(leafBox, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == -1)
+        root = newParent;
+    else if (nodes[oldParent].left == sibling)
+        nodes[oldParent].left = newParent;
+    else
+        nodes[oldParent].right = newParent;
+
+    // Refit and rebalance the ancestors
+    fixUpwards(nodes[leaf].parent);
+}
+
+void BVH::removeLeaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = -1;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    // Replace the parent with the sibling
+    if (grandParent == -1)
+    {
+        root = sibling;
+        nodes[sibling].parent = -1;
+        freeNode(parent);
+        return;
+    }
+
+    if (nodes[grandParent].left == parent)
+        nodes[grandParent].left = sibling;
+    else
+        nodes[grandParent].right = sibling;
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    fixUpwards(grandParent);
+}
+
+void BVH::fixUpwards(int index)
+{
+    while (index != -1)
+    {
+        index = balance(index);
+
+        int left = nodes[index].left;
+        int right = nodes[index].right;
+        nodes[index].height = 1 + std::max(nodes[left].height, nodes[right].height);
+        nodes[index].box = AABB::merge(nodes[left].box, nodes[right].box);
+
+        index = nodes[index].parent;
+    }
+}
+
+int BVH::balance(int a)
+{
+    if (nodes[a].isLeaf() || nodes[a].height < 2)
+        return a;
+
+    int b = nodes[a].left;
+    int c = nodes[a].right;
+    int difference = nodes[c].height - nodes[b].height;
+
+    // Rotate the taller child up
+    if (difference > 1 || difference < -1)
+    {
+        int up = difference > 0 ? c : b;
+        int down = difference > 0 ? b : c;
+        int f = nodes[up].left;
+        int g = nodes[up].right;
+
+        // Swap node a and the taller child
+        nodes[up].left = a;
+        nodes[up].parent = nodes[a].parent;
+        nodes[a].parent = up;
+
+        if (nodes[up].parent == -1)
+            root = up;
+        else if (nodes[nodes[up].parent].left == a)
+            nodes[nodes[up].parent].left = up;
+        else
+            nodes[nodes[up].parent].right = up;
+
+        // Keep the taller grandchild under the new root
+        int keep = nodes[f].height > nodes[g].height ? f : g;
+        int move = keep == f ? g : f;
+        nodes[up].right = keep;
+        if (difference > 0)
+            nodes[a].right = move;
+        else
+            nodes[a].left = move;
+        nodes[move].parent = a;
+
+        nodes[a].box = AABB::merge(nodes[down].box, nodes[move].box);
+        nodes[a].height = 1 + std::max(nodes[down].height, nodes[move].height);
+
+        // A leaf inserted next to a tall sibling leaves node a more than one
+        // level out, so keep rotating on the way down
+        int lower = balance(a);
+        nodes[up].box = AABB::merge(nodes[lower].box, nodes[keep].box);
+        nodes[up].height = 1 + std::max(nodes[lower].height, nodes[keep].height);
+
+        return up;
+    }
+
+    return a;
+}
+
+void BVH::collect(int node, std::vector<unsigned int>& objects) const
+{
+    size_t base = stack.size();
+    stack.push_back(node);
+    while (stack.size() > base)
+    {
+        int index = stack.back();
+        stack.pop_back();
+        nodesVisited++;
+
+        if (nodes[index].isLeaf())
+        {
+            objects.push_back(nodes[index].object);
+            continue;
+        }
+        stack.push_back(nodes[index].left);
+        stack.push_back(nodes[index].right);
+    }
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& objects) const
+{
+    nodesVisited = 0;
+    if (root == -1)
+        return;
+
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+        nodesVisited++;
+
+        Containment containment = Bounds::classify(frustum, nodes[index].box);
+        if (containment == Containment::Outside)
+            continue;
+
+        // Everything below a node inside the frustum is visible
+        if (containment == Containment::Inside || nodes[index].isLeaf())
+        {
+            collect(index, objects);
+            continue;
+        }
+        stack.push_back(nodes[index].left);
+        stack.push_back(nodes[index].right);
+    }
+}
+
+void BVH::querySphere(const Sphere& sphere, std::vector<unsigned int>& objects) const
+{
+    nodesVisited = 0;
+    if (root == -1)
+        return;
+
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+        nodesVisited++;
+
+        if (!Bounds::intersects(sphere, nodes[index].box))
+            continue;
+
+        if (nodes[index].isLeaf())
+        {
+            objects.push_back(nodes[index].object);
+            continue;
+        }
+        stack.push_back(nodes[index].left);
+        stack.push_back(nodes[index].right);
+    }
+}
+
+void BVH::queryAABB(const AABB& box, std::vector<unsigned int>& objects) const
+{
+    nodesVisited = 0;
+    if (root == -1)
+        return;
+
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+        nodesVisited++;
+
+        if (!Bounds::intersects(box, nodes[index].box))
+            continue;
+
+        if (nodes[index].isLeaf())
+        {
+            objects.push_back(nodes[index].object);
+            continue;
+        }
+        stack.push_back(nodes[index].left);
+        stack.push_back(nodes[index].right);
+    }
+}
+
+void BVH::queryRay(const Ray& ray, float maxDistance, std::vector<unsigned int>& objects) const
+{
+    nodesVisited = 0;
+    if (root == -1)
+        return;
+
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+        nodesVisited++;
+
+        float distance;
+        if (!Bounds::intersects(ray, nodes[index].box, maxDistance, distance))
+            continue;
+
+        if (nodes[index].isLeaf())
+        {
+            objects.push_back(nodes[index].object);
+            continue;
+        }
+        stack.push_back(nodes[index].left);
+        stack.push_back(nodes[index].right);
+    }
+}
+
+int BVH::raycast(const Ray& ray, float maxDistance, float& distance) const
+{
+    nodesVisited = 0;
+    int hit = -1;
+    if (root == -1)
+        return hit;
+
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+        nodesVisited++;
+
+        // Skip nodes further away than the nearest hit so far
+        float t;
+        if (!Bounds::intersects(ray, nodes[index].box, maxDistance, t))
+            continue;
+
+        if (nodes[index].isLeaf())
+        {
+            maxDistance = t;
+            distance = t;
+            hit = static_cast<int>(nodes[index].object);
+            continue;
+        }
+
+        // Visit the nearer child first
+        int left = nodes[index].left;
+        int right = nodes[index].right;
+        float tLeft, tRight;
+        bool hitLeft = Bounds::intersects(ray, nodes[left].box, maxDistance, tLeft);
+        bool hitRight = Bounds::intersects(ray, nodes[right].box, maxDistance, tRight);
+        if (hitLeft && hitRight && tLeft < tRight)
+        {
+            stack.push_back(right);
+            stack.push_back(left);
+        }
+        else
+        {
+            if (hitLeft)
+                stack.push_back(left);
+            if (hitRight)
+                stack.push_back(right);
+        }
+    }
+
+    return hit;
+}
+
+bool BVH::occluded(const Ray& ray, float maxDistance, std::vector<int>& stack) const
+{
+    if (root == -1)
+        return false;
+
+    // Any hit will do, so there is no need to sort the children
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        stack.pop_back();
+
+        float t;
+        if (!Bounds::intersects(ray, nodes[index].box, maxDistance, t))
+            continue;
+        if (nodes[index].isLeaf())
+            return true;
+
+        stack.push_back(nodes[index].left);
+        stack.push_back(nodes[index].right);
+    }
+    return false;
+}
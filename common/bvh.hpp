@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+
+// Node of the bounding volume hierarchy. Leaves hold a single object, free
+// nodes reuse the parent index as the next link of the free list
+struct BVHNode
+{
+    AABB box;
+    int parent = -1;
+    int left = -1;
+    int right = -1;
+    int height = 0;
+    unsigned int object = 0;
+
+    bool isLeaf() const { return left == -1; }
+};
+
+// Dynamic bounding volume hierarchy over scene objects. Static content is
+// built top-down with the surface area heuristic (SAH), moving objects are
+// inserted and removed incrementally with AVL style rotations keeping the
+// tree balanced.
+class BVH
+{
+public:
+    // Margin added to the boxes of moving objects so that small movements
+    // don't restructure the tree
+    float margin = 0.1f;
+
+    // Number of nodes visited by the last query
+    mutable unsigned int nodesVisited = 0;
+
+    // Build the tree from static content, the object index of each box is its
+    // position in the array. Returns the proxy of each object.
+    std::vector<int> build(const std::vector<AABB>& boxes);
+
+    // Incremental updates for moving objects
+    int insert(const AABB& box, unsigned int object);
+    void remove(int proxy);
+    bool update(int proxy, const AABB& box);
+
+    // Refit without restructuring, call refit() after changing leaf bounds
+    void setBounds(int proxy, const AABB& box);
+    void refit();
+
+    // Queries, the objects found are appended to the output array
+    void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& objects) const;
+    void querySphere(const Sphere& sphere, std::vector<unsigned int>& objects) const;
+    void queryAABB(const AABB& box, std::vector<unsigned int>& objects) const;
+    void queryRay(const Ray& ray, float maxDistance, std::vector<unsigned int>& objects) const;
+
+    // Nearest object hit by a ray, returns -1 if nothing is hit
+    int raycast(const Ray& ray, float maxDistance, float& distance) const;
+
+    // Whether any object is hit closer than maxDistance. The traversal stack
+    // is the caller's, so several threads can trace the tree at once.
+    bool occluded(const Ray& ray, float maxDistance, std::vector<int>& stack) const;
+
+    // Cleanup
+    void clear();
+
+    // Check the parent links, heights and leaf count of the tree and that
+    // every box encloses its children. A tree built incrementally also has to
+    // be balanced, the children heights differing by at most one.
+    bool validate(bool balanced) const;
+
+    // Tree properties
+    unsigned int size() const { return leafCount; }
+    int height() const { return root == -1 ? 0 : nodes[root].height; }
+    const AABB& bounds(int proxy) const { return nodes[proxy].box; }
+    unsigned int object(int proxy) const { return nodes[proxy].object; }
+
+private:
+    std::vector<BVHNode> nodes;
+    int root = -1;
+    int freeList = -1;
+    unsigned int leafCount = 0;
+    mutable std::vector<int> stack;
+
+    // Node allocation
+    int allocateNode();
+    void freeNode(int node);
+
+    // Tree maintenance
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void fixUpwards(int node);
+
+    // SAH build
+    int buildRecursive(std::vector<int>& leaves, std::vector<glm::vec3>& centroids,
+                       int begin, int end, int parent);
+
+    // Append every object below a node
+    void collect(int node, std::vector<unsigned int>& objects) const;
+};
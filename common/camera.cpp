@@ -1,5 +1,6 @@
 
 #include <common/camera.hpp>
+#include <common/profiler.hpp>
 
 Camera::Camera(const glm::vec3 Eye, const glm::vec3 Target)
 {
@@ -9,19 +10,55 @@ Camera::Camera(const glm::vec3 Eye, const glm::vec3 Target)
 
 void Camera::calculateMatrices()
 {
+    PROFILE_SCOPE("calculateMatrices");
+
     // Calculate camera vectors
     calculateCameraVectors();
 
     // Calculate the view matrix
-    view = glm::lookAt(eye, target, worldUp);
+    bool viewChanged = !valid || eye != viewEye || target != viewTarget || worldUp != viewUp;
+    if (viewChanged)
+    {
+        view = glm::lookAt(eye, target, worldUp);
+        inverseView = glm::inverse(view);
+        viewEye = eye, viewTarget = target, viewUp = worldUp;
+        viewVersion++;
+    }
 
     // Calculate the projection matrix
-    projection = glm::perspective(fov, aspect, near, far);
+    bool projectionChanged = !valid || fov != projectionFov || aspect != projectionAspect ||
+                             near != projectionNear || far != projectionFar;
+    if (projectionChanged)
+    {
+        projection = glm::perspective(fov, aspect, near, far);
+        projectionFov = fov, projectionAspect = aspect, projectionNear = near, projectionFar = far;
+        projectionVersion++;
+    }
+    valid = true;
+
+    if (!viewChanged && !projectionChanged)
+        return;
+
+    // Combined matrices and the view volume
+    viewProjection = projection * view;
+    inverseViewProjection = glm::inverse(viewProjection);
+    frustum = Frustum::fromMatrix(viewProjection);
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec4 corner = inverseViewProjection * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f,
+                                                             i & 4 ? 1.0f : -1.0f, 1.0f);
+        corners[i] = glm::vec3(corner) / corner.w;
+    }
 }
 
 void Camera::calculateCameraVectors()
 {
+    // Only when the angles moved since the last call
+    if (valid && yaw == vectorYaw && pitch == vectorPitch && worldUp == vectorUp)
+        return;
+
     front = glm::vec3(cos(yaw) * cos(pitch), sin(pitch), sin(yaw) * cos(pitch));
     right = glm::normalize(glm::cross(front, worldUp));
     up = glm::cross(right, front);
+    vectorYaw = yaw, vectorPitch = pitch, vectorUp = worldUp;
 }
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <glm/gtc/matrix_transform.hpp>
 #include <common/maths.hpp>
+#include <common/bounds.hpp>
 
 class Camera
 {
@@ -29,12 +30,35 @@ public:
 
     // Transformation matrices
     glm::mat4 view;
+    glm::mat4 inverseView;
     glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::mat4 inverseViewProjection;
+
+    // World space view volume, the planes are normalised and the corners are
+    // the near plane then the far plane, each (-1,-1) (1,-1) (-1,1) (1,1)
+    Frustum frustum;
+    glm::vec3 corners[8];
+
+    // Change counters, bumped by calculateMatrices when the view or the
+    // projection is rebuilt. Caches that keep the version they were built
+    // with can skip their work while the camera is still.
+    uint64_t viewVersion = 0;
+    uint64_t projectionVersion = 0;
+    uint64_t version() const { return viewVersion + projectionVersion; }
 
     // Constructor
     Camera(const glm::vec3 eye, const glm::vec3 target);
 
-    // Methods
+    // Methods, both only recompute what changed since the last call
     void calculateMatrices();
     void calculateCameraVectors();
+
+private:
+    // Inputs the cached results were built from
+    bool valid = false;
+    float vectorYaw = 0.0f, vectorPitch = 0.0f;
+    glm::vec3 vectorUp;
+    glm::vec3 viewEye, viewTarget, viewUp;
+    float projectionFov = 0.0f, projectionAspect = 0.0f, projectionNear = 0.0f, projectionFar = 0.0f;
 };
@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include <common/camerapath.hpp>
+
+bool CameraPath::load(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        printf("Impossible to open the camera path %s.\n", path);
+        return false;
+    }
+
+    keys.clear();
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        CameraKey key;
+        if (sscanf(line, " key %f %f %f %f %f %f %f", &key.frame, &key.eye.x, &key.eye.y, &key.eye.z,
+                   &key.target.x, &key.target.y, &key.target.z) == 7)
+            keys.push_back(key);
+    }
+    fclose(file);
+
+    // Keys are kept in frame order
+    std::sort(keys.begin(), keys.end(), [](const CameraKey& a, const CameraKey& b) { return a.frame < b.frame; });
+    if (keys.empty())
+    {
+        printf("Camera path %s has no keys.\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+CameraPath CameraPath::orbit(const AABB& bounds, unsigned int frames)
+{
+    // Keys around a circle above the box looking at its centre, one extra key
+    // at each end keeps the spline smooth where the orbit closes
+    CameraPath path;
+    glm::vec3 centre = bounds.centre();
+    glm::vec3 size = bounds.max - bounds.min;
+    float radius = 0.5f * std::max(size.x, size.z) + 20.0f;
+    float height = 0.5f * size.y + 0.3f * radius;
+    const int segments = 32;
+    for (int i = -1; i <= segments + 1; i++)
+    {
+        float angle = 6.2831853f * i / segments;
+        CameraKey key;
+        key.frame = static_cast<float>(i) * frames / segments;
+        key.eye = centre + glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle));
+        key.target = centre;
+        path.keys.push_back(key);
+    }
+    path.far = std::max(100.0f, 2.5f * radius + size.y);
+
+    return path;
+}
+
+void CameraPath::apply(Camera& camera, float frame) const
+{
+    if (keys.empty())
+        return;
+
+    // Find the segment containing the frame
+    unsigned int i = 0;
+    while (i + 1 < keys.size() && keys[i + 1].frame <= frame)
+        i++;
+
+    glm::vec3 eye = keys[i].eye, target = keys[i].target;
+    if (i + 1 < keys.size() && frame > keys[i].frame)
+    {
+        const CameraKey& k0 = keys[i > 0 ? i - 1 : i];
+        const CameraKey& k1 = keys[i];
+        const CameraKey& k2 = keys[i + 1];
+        const CameraKey& k3 = keys[std::min(i + 2, static_cast<unsigned int>(keys.size()) - 1)];
+        float t = (frame - k1.frame) / (k2.frame - k1.frame);
+        float t2 = t * t, t3 = t2 * t;
+
+        // Catmull-Rom spline through the four keys
+        auto spline = [&](const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3)
+        {
+            return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                           (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+        };
+        eye = spline(k0.eye, k1.eye, k2.eye, k3.eye);
+        target = spline(k0.target, k1.target, k2.target, k3.target);
+    }
+
+    // Point the camera at the target
+    glm::vec3 direction = glm::normalize(target - eye);
+    camera.eye = eye;
+    camera.yaw = std::atan2(direction.z, direction.x);
+    camera.pitch = std::asin(direction.y);
+    if (far > 0.0f)
+        camera.far = far;
+    camera.calculateCameraVectors();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+#include <common/camera.hpp>
+
+// Camera position and look at point at a given frame
+struct CameraKey
+{
+    float frame;
+    glm::vec3 eye;
+    glm::vec3 target;
+};
+
+// Scripted camera path through keyframes, interpolated with Catmull-Rom
+// splines. Path files have one key per line:
+//
+//     key <frame> <eye x y z> <target x y z>
+class CameraPath
+{
+public:
+    std::vector<CameraKey> keys;
+    float far = 0.0f;       // far plane distance, zero keeps the camera's
+
+    // Load a path file
+    bool load(const char* path);
+
+    // One orbit around a box over the given number of frames
+    static CameraPath orbit(const AABB& bounds, unsigned int frames);
+
+    // Move the camera to its position at a frame
+    void apply(Camera& camera, float frame) const;
+};
@@ -0,0 +1,108 @@
+#include <algorithm>
+
+#include <common/chunkmesher.hpp>
+#include <common/profiler.hpp>
+
+ChunkMesher::ChunkMesher(VoxelWorld& World, ThreadPool& Pool) : world(World), pool(Pool)
+{
+    running = 0;
+    busyMicroseconds = 0;
+    windowStart = Clock::now();
+}
+
+ChunkMesher::~ChunkMesher()
+{
+    finish();
+}
+
+void ChunkMesher::update()
+{
+    for (unsigned int i = 0; i < world.dirtyChunks.size(); i++)
+    {
+        glm::ivec3 coord = world.dirtyChunks[i];
+        Chunk* chunk = world.getChunk(coord);
+        if (chunk == nullptr)
+            continue;
+        chunk->dirty = false;
+
+        // Copy the blocks so the job doesn't touch the world
+        Job* job = new Job();
+        world.gatherChunk(coord, job->padded);
+        job->generation = ++generations[VoxelWorld::chunkKey(coord)];
+        job->scheduled = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running++;
+        }
+
+        pool.submit([this, job]
+        {
+            PROFILE_SCOPE("greedyMesh");
+            Clock::time_point start = Clock::now();
+            world.greedyMesh(job->padded, job->mesh);
+            Clock::time_point end = Clock::now();
+            job->meshTime = std::chrono::duration<float, std::milli>(end - start).count();
+            busyMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+            // Notify with the lock held, finish() can't return and the
+            // mesher can't be destroyed until the lock is released, after
+            // which the job doesn't touch the mesher again
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back(std::unique_ptr<Job>(job));
+            if (--running == 0)
+                done.notify_all();
+        });
+    }
+    world.dirtyChunks.clear();
+    stats.pending = running;
+}
+
+unsigned int ChunkMesher::swap(VoxelRenderer& renderer)
+{
+    std::vector<std::unique_ptr<Job>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.swap(finished);
+    }
+
+    // Upload the meshes that are still the latest for their chunk
+    Clock::time_point now = Clock::now();
+    unsigned int swapped = 0;
+    for (unsigned int i = 0; i < jobs.size(); i++)
+    {
+        const Job& job = *jobs[i];
+        if (job.generation != generations[VoxelWorld::chunkKey(job.padded.coord)])
+        {
+            stats.discarded++;
+            continue;
+        }
+
+        renderer.upload(world, job.padded.coord, job.mesh);
+        swapped++;
+
+        float latency = std::chrono::duration<float, std::milli>(now - job.scheduled).count();
+        stats.completed++;
+        stats.lastLatency = latency;
+        stats.maxLatency = std::max(stats.maxLatency, latency);
+        latencySum += latency;
+        stats.averageLatency = static_cast<float>(latencySum / stats.completed);
+    }
+
+    // Utilization of the workers over windows of half a second
+    double window = std::chrono::duration<double, std::micro>(now - windowStart).count();
+    if (window > 5e5)
+    {
+        double capacity = window * std::max(1u, pool.size());
+        stats.utilization = static_cast<float>(busyMicroseconds.exchange(0) / capacity);
+        windowStart = now;
+    }
+    stats.pending = running;
+
+    return swapped;
+}
+
+void ChunkMesher::finish()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return running == 0; });
+}
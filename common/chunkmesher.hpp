@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+
+#include <common/voxel.hpp>
+#include <common/voxelrenderer.hpp>
+#include <common/threadpool.hpp>
+
+// Remeshing metrics, times are in milliseconds
+struct MesherStats
+{
+    unsigned int pending = 0;       // jobs queued or running
+    unsigned int completed = 0;     // meshes swapped in since the start
+    unsigned int discarded = 0;     // stale meshes replaced by a newer edit
+    float lastLatency = 0.0f;       // from scheduling to swap of the last mesh
+    float averageLatency = 0.0f;
+    float maxLatency = 0.0f;
+    float utilization = 0.0f;       // fraction of worker time spent meshing
+};
+
+// Remeshes dirty chunks on the worker threads. The blocks of each dirty
+// chunk and its border are copied on the main thread, meshed in the
+// background and the finished meshes are swapped into the renderer on the
+// render thread, so editing a block never waits for the mesher.
+class ChunkMesher
+{
+public:
+    MesherStats stats;
+
+    // Constructor
+    ChunkMesher(VoxelWorld& world, ThreadPool& pool);
+    ~ChunkMesher();
+
+    // Schedule jobs for the chunks marked dirty since the last call
+    void update();
+
+    // Upload the finished meshes, returns the number of chunks swapped in
+    unsigned int swap(VoxelRenderer& renderer);
+
+    // Wait for all scheduled jobs to finish
+    void finish();
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct Job
+    {
+        PaddedChunk padded;
+        ChunkMesh mesh;
+        unsigned int generation;
+        Clock::time_point scheduled;
+        float meshTime;
+    };
+
+    VoxelWorld& world;
+    ThreadPool& pool;
+
+    // Latest generation scheduled for each chunk, older results are dropped
+    std::unordered_map<unsigned long long, unsigned int> generations;
+
+    // Finished jobs waiting to be swapped in, running is only changed with
+    // the mutex held and done is signalled when it reaches zero
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<std::unique_ptr<Job>> finished;
+    std::atomic<unsigned int> running;
+
+    // Worker utilization over the current measurement window
+    std::atomic<long long> busyMicroseconds;
+    Clock::time_point windowStart;
+    double latencySum = 0.0;
+};
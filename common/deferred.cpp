@@ -0,0 +1,217 @@
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+#include <common/deferred.hpp>
+#include <common/glstate.hpp>
+#include <common/profiler.hpp>
+
+// Icosahedron scaled so its faces enclose the unit sphere
+static std::vector<glm::vec3> lightVolume()
+{
+    const float phi = 0.5f * (1.0f + std::sqrt(5.0f));
+    const glm::vec3 corners[12] = {
+        glm::vec3(-1,  phi, 0), glm::vec3( 1,  phi, 0), glm::vec3(-1, -phi, 0), glm::vec3( 1, -phi, 0),
+        glm::vec3(0, -1,  phi), glm::vec3(0,  1,  phi), glm::vec3(0, -1, -phi), glm::vec3(0,  1, -phi),
+        glm::vec3( phi, 0, -1), glm::vec3( phi, 0,  1), glm::vec3(-phi, 0, -1), glm::vec3(-phi, 0,  1)
+    };
+    const int faces[20][3] = {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+        { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+        { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+    };
+
+    // The distance from the centre to a face is the inradius
+    glm::vec3 centre = (corners[faces[0][0]] + corners[faces[0][1]] + corners[faces[0][2]]) / 3.0f;
+    float scale = 1.0f / glm::length(centre);
+
+    std::vector<glm::vec3> vertices;
+    for (int i = 0; i < 20; i++)
+    {
+        glm::vec3 a = corners[faces[i][0]], b = corners[faces[i][1]], c = corners[faces[i][2]];
+
+        // Counter-clockwise seen from outside
+        if (glm::dot(glm::cross(b - a, c - a), a + b + c) < 0.0f)
+            std::swap(b, c);
+        vertices.push_back(a * scale);
+        vertices.push_back(b * scale);
+        vertices.push_back(c * scale);
+    }
+    return vertices;
+}
+
+bool DeferredRenderer::create(unsigned int GeometryProgram, unsigned int LightingProgram, int Width, int Height)
+{
+    width = Width;
+    height = Height;
+    geometry.adopt(GeometryProgram, "G-buffer shader");
+    lighting.adopt(LightingProgram, "Deferred lighting shader");
+
+    FBO.create("G-buffer");
+    GLState::bindFramebuffer(FBO);
+
+    // The targets are read with texelFetch, one texel per pixel
+    struct Target
+    {
+        GLTexture* texture;
+        const char* label;
+        GLenum internalFormat, format, type;
+        GLenum attachment;
+        int bytes;
+    };
+    const Target targets[] = {
+        { &albedo, "G-buffer albedo", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0, 4 },
+        { &normal, "G-buffer normal", GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, GL_COLOR_ATTACHMENT1, 4 },
+        { &material, "G-buffer material", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT2, 4 },
+        { &output, "Deferred output", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT3, 4 },
+        { &depth, "G-buffer depth", GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_DEPTH_ATTACHMENT, 4 },
+    };
+    for (const Target& target : targets)
+    {
+        target.texture->create(target.label);
+        GLState::bindTexture(GL_TEXTURE_2D, *target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, target.internalFormat, width, height, 0, target.format, target.type, nullptr);
+        target.texture->setBytes(GLResourceTracker::textureBytes(width, height, 1, target.bytes, false));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, target.attachment, GL_TEXTURE_2D, *target.texture, 0);
+    }
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete)
+        printf("G-buffer is incomplete.\n");
+
+    // The lights are added with a copy of the depth, the depth texture is
+    // sampled so it can't be attached while they are drawn
+    lightFBO.create("Deferred lighting target");
+    GLState::bindFramebuffer(lightFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output, 0);
+    lightDepth.create("Deferred lighting depth");
+    glBindRenderbuffer(GL_RENDERBUFFER, lightDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    lightDepth.setBytes(GLResourceTracker::textureBytes(width, height, 1, 4, false));
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, lightDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("Deferred lighting target is incomplete.\n");
+        complete = false;
+    }
+    GLState::bindFramebuffer(0);
+
+    // Light volume shared by every bounded light, the vertex shader places
+    // and scales it
+    std::vector<glm::vec3> vertices = lightVolume();
+    volumeVertices = static_cast<unsigned int>(vertices.size());
+    volumeVAO.create("Light volume");
+    GLState::bindVertexArray(volumeVAO);
+    volumeBuffer.create("Light volume vertices");
+    GLState::bindBuffer(GL_ARRAY_BUFFER, volumeBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+    volumeBuffer.setBytes(vertices.size() * sizeof(glm::vec3));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    // Point the lighting program at the G-buffer and the light buffer
+    GLState::useProgram(lighting);
+    LightManager::setupProgram(lighting);
+    GLState::uniform1i(glGetUniformLocation(lighting, "albedoMap"), albedoUnit);
+    GLState::uniform1i(glGetUniformLocation(lighting, "normalMap"), normalUnit);
+    GLState::uniform1i(glGetUniformLocation(lighting, "materialMap"), materialUnit);
+    GLState::uniform1i(glGetUniformLocation(lighting, "depthMap"), depthUnit);
+    return complete;
+}
+
+void DeferredRenderer::beginGeometry()
+{
+    GLState::bindFramebuffer(FBO);
+    const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+    glDrawBuffers(4, buffers);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Only the G-buffer targets are written by the objects
+    glDrawBuffers(3, buffers);
+    GLState::useProgram(geometry);
+}
+
+void DeferredRenderer::light(const LightManager& lights, const Camera& camera)
+{
+    PROFILE_SCOPE("Deferred lighting");
+    stats = DeferredStats();
+
+    // Copy the depth for the volumes and the forward objects, then add
+    // every light into the output target
+    GLState::bindReadFramebuffer(FBO);
+    GLState::bindDrawFramebuffer(lightFBO);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    GLState::bindFramebuffer(lightFBO);
+    GLState::useProgram(lighting);
+    lights.bind(lighting);
+    GLState::bindTexture(albedoUnit, GL_TEXTURE_2D, albedo);
+    GLState::bindTexture(normalUnit, GL_TEXTURE_2D, normal);
+    GLState::bindTexture(materialUnit, GL_TEXTURE_2D, material);
+    GLState::bindTexture(depthUnit, GL_TEXTURE_2D, depth);
+    GLState::uniformMatrix4fv(glGetUniformLocation(lighting, "viewProjection"), &camera.viewProjection[0][0]);
+    GLState::uniformMatrix4fv(glGetUniformLocation(lighting, "inverseViewProjection"), &camera.inverseViewProjection[0][0]);
+    GLState::uniformMatrix4fv(glGetUniformLocation(lighting, "inverseView"), &camera.inverseView[0][0]);
+    GLState::enable(GL_BLEND);
+    GLState::blendFunc(GL_ONE, GL_ONE);
+    GLState::depthMask(false);
+    GLState::bindVertexArray(volumeVAO);
+
+    // Directional lights reach every pixel
+    GLState::disable(GL_DEPTH_TEST);
+    GLState::uniform1i(glGetUniformLocation(lighting, "volumes"), 0);
+    for (unsigned int i = 0; i < lights.count(); i++)
+    {
+        if (lights.bounded(i))
+            continue;
+        GLState::uniform1i(glGetUniformLocation(lighting, "lightIndex"), static_cast<int>(i));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        stats.fullscreen++;
+    }
+
+    // The back faces of a volume pass where the scene is in front of them
+    stats.volumes = lights.count() - stats.fullscreen;
+    if (stats.volumes > 0)
+    {
+        GLState::enable(GL_DEPTH_TEST);
+        GLState::depthFunc(GL_GEQUAL);
+        GLState::enable(GL_CULL_FACE);
+        GLState::cullFace(GL_FRONT);
+        GLState::uniform1i(glGetUniformLocation(lighting, "volumes"), 1);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, volumeVertices, lights.count());
+        GLState::cullFace(GL_BACK);
+        GLState::disable(GL_CULL_FACE);
+        GLState::depthFunc(GL_LESS);
+    }
+
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::depthMask(true);
+    GLState::disable(GL_BLEND);
+}
+
+void DeferredRenderer::resolve(unsigned int framebuffer)
+{
+    PROFILE_SCOPE("Deferred resolve");
+    GLState::bindDrawFramebuffer(framebuffer);
+    GLState::bindReadFramebuffer(lightFBO);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+void DeferredRenderer::deleteBuffers()
+{
+    albedo.release();
+    normal.release();
+    material.release();
+    depth.release();
+    output.release();
+    lightDepth.release();
+    FBO.release();
+    lightFBO.release();
+    volumeBuffer.release();
+    volumeVAO.release();
+    geometry.release();
+    lighting.release();
+}
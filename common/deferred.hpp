@@ -0,0 +1,75 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/glresource.hpp>
+#include <common/camera.hpp>
+#include <common/light.hpp>
+
+// Statistics of the last lighting pass
+struct DeferredStats
+{
+    unsigned int volumes = 0;       // bounded lights drawn as volumes
+    unsigned int fullscreen = 0;    // directional lights drawn over the whole screen
+
+    unsigned int drawCalls() const { return fullscreen + (volumes > 0 ? 1 : 0); }
+};
+
+// Deferred lighting path. The opaque objects write their albedo, normal and
+// material terms into a G-buffer, then every light adds its contribution to
+// an output target in a second pass. Directional lights cover the screen,
+// the others are drawn as one instanced batch of bounding volumes whose back
+// faces are depth tested against a copy of the scene depth, so only the
+// pixels in front of a light's far side are shaded. Objects that can't go
+// through the G-buffer, like glass, are drawn forward into the output target
+// afterwards, which is then copied to the destination framebuffer.
+//
+// Bytes per pixel: albedo and ka RGBA8, normal RGB10_A2, kd, ks and Ns RGBA8,
+// depth 24 bits and its copy, and the RGBA8 output, 24 in all.
+class DeferredRenderer
+{
+public:
+    // Texture units of the G-buffer, after the light buffers
+    static const unsigned int albedoUnit = 11;
+    static const unsigned int normalUnit = 12;
+    static const unsigned int materialUnit = 13;
+    static const unsigned int depthUnit = 14;
+
+    // Statistics of the last lighting pass
+    DeferredStats stats;
+
+    // Create the G-buffer, takes ownership of the programs. The geometry
+    // program draws the opaque objects, the lighting program the lights.
+    // Returns false if the G-buffer is incomplete.
+    bool create(unsigned int geometryProgram, unsigned int lightingProgram, int width, int height);
+
+    // Program the opaque objects are drawn with between beginGeometry and light
+    unsigned int geometryProgram() const { return geometry; }
+
+    // Program the lights are added with
+    unsigned int lightingProgram() const { return lighting; }
+
+    // Bind and clear the G-buffer for the opaque objects
+    void beginGeometry();
+
+    // Add the lights into the output target, which stays bound with the
+    // copy of the G-buffer depth for the objects drawn forward
+    void light(const LightManager& lights, const Camera& camera);
+
+    // Copy the output target to a framebuffer, zero is the window
+    void resolve(unsigned int framebuffer);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    GLProgram geometry, lighting;
+    GLFramebuffer FBO, lightFBO;
+    GLTexture albedo, normal, material, depth, output;
+    GLRenderbuffer lightDepth;
+    GLVertexArray volumeVAO;
+    GLBuffer volumeBuffer;
+    unsigned int volumeVertices = 0;
+    int width = 0, height = 0;
+};
@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <vector>
+
+#include <common/framebuffer.hpp>
+#include <common/glstate.hpp>
+
+bool Framebuffer::create(int Width, int Height)
+{
+    width = Width;
+    height = Height;
+
+    FBO.create("Offscreen target");
+    GLState::bindFramebuffer(FBO);
+
+    colourBuffer.create("Offscreen colour");
+    glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    colourBuffer.setBytes(GLResourceTracker::textureBytes(width, height, 1, 4, false));
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+
+    depthBuffer.create("Offscreen depth");
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    depthBuffer.setBytes(GLResourceTracker::textureBytes(width, height, 1, 4, false));
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete)
+        printf("Framebuffer is incomplete.\n");
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    GLState::bindFramebuffer(0);
+    return complete;
+}
+
+void Framebuffer::bind() const
+{
+    GLState::bindFramebuffer(FBO);
+    glViewport(0, 0, width, height);
+}
+
+void Framebuffer::unbind()
+{
+    GLState::bindFramebuffer(0);
+}
+
+bool Framebuffer::saveImage(const char* path, int width, int height)
+{
+    std::vector<unsigned char> pixels(width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("Impossible to write the image %s.\n", path);
+        return false;
+    }
+
+    // OpenGL rows start at the bottom, PPM rows at the top
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--)
+        fwrite(&pixels[y * width * 3], 1, width * 3, file);
+    fclose(file);
+
+    return true;
+}
+
+void Framebuffer::deleteBuffers()
+{
+    colourBuffer.release();
+    depthBuffer.release();
+    FBO.release();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <common/glresource.hpp>
+
+// Offscreen render target with a colour and a depth renderbuffer
+class Framebuffer
+{
+public:
+    GLFramebuffer FBO;
+    GLRenderbuffer colourBuffer;
+    GLRenderbuffer depthBuffer;
+    int width = 0, height = 0;
+
+    // Create the render target, returns false if it is incomplete
+    bool create(int width, int height);
+
+    // Draw into the render target or back into the window
+    void bind() const;
+    static void unbind();
+
+    // Write the pixels of the bound framebuffer to a binary PPM image
+    static bool saveImage(const char* path, int width, int height);
+
+    // Cleanup
+    void deleteBuffers();
+};
@@ -0,0 +1,736 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <common/glcapture.hpp>
+
+const char GLCapture::magic[8] = { 'C', 'G', 'G', 'L', 'T', 'R', 'C', '\0' };
+
+#ifdef GL_CAPTURE
+const bool GLCapture::coreCalls = true;
+#else
+const bool GLCapture::coreCalls = false;
+#endif
+
+namespace
+{
+    const char* callNames[] =
+    {
+#define GL_CAPTURE_NAME(name) "gl" #name,
+        GL_ENTRY_POINTS(GL_CAPTURE_NAME)
+#undef GL_CAPTURE_NAME
+    };
+
+    struct State
+    {
+        FILE* file = nullptr;
+        std::string path;
+        unsigned int frames = 0, frameLimit = 0;
+        uint64_t calls = 0;
+        GLint unpackAlignment = 4;
+    };
+
+    State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    // Arguments are written with their own size, pointers are widened to 64 bits
+    void write(const void* data, size_t bytes)
+    {
+        fwrite(data, 1, bytes, state().file);
+    }
+
+    void arguments()
+    {
+    }
+
+    template <typename T, typename... Rest>
+    void arguments(const T& value, const Rest&... rest)
+    {
+        write(&value, sizeof(T));
+        arguments(rest...);
+    }
+
+    // Write a call and its arguments, nothing is written when not capturing
+    template <typename... Args>
+    bool record(GLCall call, const Args&... args)
+    {
+        State& s = state();
+        if (s.file == nullptr)
+            return false;
+
+        uint16_t id = call;
+        write(&id, sizeof(id));
+        arguments(args...);
+        s.calls++;
+        return true;
+    }
+
+    // Memory passed with a call, a null pointer is stored as no bytes
+    void payload(const void* data, size_t bytes)
+    {
+        uint32_t size = data == nullptr ? 0 : static_cast<uint32_t>(bytes);
+        write(&size, sizeof(size));
+        if (size > 0)
+            write(data, size);
+    }
+
+    // Object names read or written by the Gen and Delete calls
+    void names(GLCall call, GLsizei n, const GLuint* ids)
+    {
+        if (record(call, n))
+            write(ids, n * sizeof(GLuint));
+    }
+
+    uint64_t offset(const void* pointer)
+    {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer));
+    }
+
+    // Originals of the swapped GLEW function pointers
+#define GL_CAPTURE_REAL(name) decltype(__glew##name) real##name = nullptr;
+    GL_POINTER_ENTRY_POINTS(GL_CAPTURE_REAL)
+#undef GL_CAPTURE_REAL
+
+    void GLAPIENTRY captureActiveTexture(GLenum texture)
+    {
+        record(GLCall_ActiveTexture, texture);
+        realActiveTexture(texture);
+    }
+
+    void GLAPIENTRY captureAttachShader(GLuint program, GLuint shader)
+    {
+        record(GLCall_AttachShader, program, shader);
+        realAttachShader(program, shader);
+    }
+
+    void GLAPIENTRY captureBeginQuery(GLenum target, GLuint id)
+    {
+        record(GLCall_BeginQuery, target, id);
+        realBeginQuery(target, id);
+    }
+
+    void GLAPIENTRY captureBindBuffer(GLenum target, GLuint buffer)
+    {
+        record(GLCall_BindBuffer, target, buffer);
+        realBindBuffer(target, buffer);
+    }
+
+    void GLAPIENTRY captureBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        record(GLCall_BindBufferBase, target, index, buffer);
+        realBindBufferBase(target, index, buffer);
+    }
+
+    void GLAPIENTRY captureBindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        record(GLCall_BindFramebuffer, target, framebuffer);
+        realBindFramebuffer(target, framebuffer);
+    }
+
+    void GLAPIENTRY captureBindRenderbuffer(GLenum target, GLuint renderbuffer)
+    {
+        record(GLCall_BindRenderbuffer, target, renderbuffer);
+        realBindRenderbuffer(target, renderbuffer);
+    }
+
+    void GLAPIENTRY captureBindVertexArray(GLuint array)
+    {
+        record(GLCall_BindVertexArray, array);
+        realBindVertexArray(array);
+    }
+
+    void GLAPIENTRY captureBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0,
+                                           GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
+    {
+        record(GLCall_BlitFramebuffer, srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+        realBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    }
+
+    void GLAPIENTRY captureBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        if (record(GLCall_BufferData, target, static_cast<int64_t>(size), usage))
+            payload(data, size);
+        realBufferData(target, size, data, usage);
+    }
+
+    void GLAPIENTRY captureBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        if (record(GLCall_BufferSubData, target, static_cast<int64_t>(offset), static_cast<int64_t>(size)))
+            payload(data, size);
+        realBufferSubData(target, offset, size, data);
+    }
+
+    GLenum GLAPIENTRY captureCheckFramebufferStatus(GLenum target)
+    {
+        record(GLCall_CheckFramebufferStatus, target);
+        return realCheckFramebufferStatus(target);
+    }
+
+    void GLAPIENTRY captureCompileShader(GLuint shader)
+    {
+        record(GLCall_CompileShader, shader);
+        realCompileShader(shader);
+    }
+
+    GLuint GLAPIENTRY captureCreateProgram()
+    {
+        GLuint program = realCreateProgram();
+        record(GLCall_CreateProgram, program);
+        return program;
+    }
+
+    GLuint GLAPIENTRY captureCreateShader(GLenum type)
+    {
+        GLuint shader = realCreateShader(type);
+        record(GLCall_CreateShader, type, shader);
+        return shader;
+    }
+
+    void GLAPIENTRY captureDeleteBuffers(GLsizei n, const GLuint* buffers)
+    {
+        names(GLCall_DeleteBuffers, n, buffers);
+        realDeleteBuffers(n, buffers);
+    }
+
+    void GLAPIENTRY captureDeleteFramebuffers(GLsizei n, const GLuint* framebuffers)
+    {
+        names(GLCall_DeleteFramebuffers, n, framebuffers);
+        realDeleteFramebuffers(n, framebuffers);
+    }
+
+    void GLAPIENTRY captureDeleteProgram(GLuint program)
+    {
+        record(GLCall_DeleteProgram, program);
+        realDeleteProgram(program);
+    }
+
+    void GLAPIENTRY captureDeleteQueries(GLsizei n, const GLuint* ids)
+    {
+        names(GLCall_DeleteQueries, n, ids);
+        realDeleteQueries(n, ids);
+    }
+
+    void GLAPIENTRY captureDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers)
+    {
+        names(GLCall_DeleteRenderbuffers, n, renderbuffers);
+        realDeleteRenderbuffers(n, renderbuffers);
+    }
+
+    void GLAPIENTRY captureDeleteShader(GLuint shader)
+    {
+        record(GLCall_DeleteShader, shader);
+        realDeleteShader(shader);
+    }
+
+    void GLAPIENTRY captureDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+    {
+        names(GLCall_DeleteVertexArrays, n, arrays);
+        realDeleteVertexArrays(n, arrays);
+    }
+
+    void GLAPIENTRY captureDetachShader(GLuint program, GLuint shader)
+    {
+        record(GLCall_DetachShader, program, shader);
+        realDetachShader(program, shader);
+    }
+
+    void GLAPIENTRY captureDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        record(GLCall_DrawArraysInstanced, mode, first, count, instancecount);
+        realDrawArraysInstanced(mode, first, count, instancecount);
+    }
+
+    void GLAPIENTRY captureDrawBuffers(GLsizei n, const GLenum* bufs)
+    {
+        if (record(GLCall_DrawBuffers, n))
+            payload(bufs, n * sizeof(GLenum));
+        realDrawBuffers(n, bufs);
+    }
+
+    void GLAPIENTRY captureEnableVertexAttribArray(GLuint index)
+    {
+        record(GLCall_EnableVertexAttribArray, index);
+        realEnableVertexAttribArray(index);
+    }
+
+    void GLAPIENTRY captureEndQuery(GLenum target)
+    {
+        record(GLCall_EndQuery, target);
+        realEndQuery(target);
+    }
+
+    void GLAPIENTRY captureFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer)
+    {
+        record(GLCall_FramebufferRenderbuffer, target, attachment, renderbuffertarget, renderbuffer);
+        realFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer);
+    }
+
+    void GLAPIENTRY captureFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
+    {
+        record(GLCall_FramebufferTexture2D, target, attachment, textarget, texture, level);
+        realFramebufferTexture2D(target, attachment, textarget, texture, level);
+    }
+
+    void GLAPIENTRY captureGenBuffers(GLsizei n, GLuint* buffers)
+    {
+        realGenBuffers(n, buffers);
+        names(GLCall_GenBuffers, n, buffers);
+    }
+
+    void GLAPIENTRY captureGenFramebuffers(GLsizei n, GLuint* framebuffers)
+    {
+        realGenFramebuffers(n, framebuffers);
+        names(GLCall_GenFramebuffers, n, framebuffers);
+    }
+
+    void GLAPIENTRY captureGenQueries(GLsizei n, GLuint* ids)
+    {
+        realGenQueries(n, ids);
+        names(GLCall_GenQueries, n, ids);
+    }
+
+    void GLAPIENTRY captureGenRenderbuffers(GLsizei n, GLuint* renderbuffers)
+    {
+        realGenRenderbuffers(n, renderbuffers);
+        names(GLCall_GenRenderbuffers, n, renderbuffers);
+    }
+
+    void GLAPIENTRY captureGenVertexArrays(GLsizei n, GLuint* arrays)
+    {
+        realGenVertexArrays(n, arrays);
+        names(GLCall_GenVertexArrays, n, arrays);
+    }
+
+    void GLAPIENTRY captureGenerateMipmap(GLenum target)
+    {
+        record(GLCall_GenerateMipmap, target);
+        realGenerateMipmap(target);
+    }
+
+    void GLAPIENTRY captureGetInteger64v(GLenum pname, GLint64* params)
+    {
+        record(GLCall_GetInteger64v, pname);
+        realGetInteger64v(pname, params);
+    }
+
+    void GLAPIENTRY captureGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+    {
+        record(GLCall_GetProgramInfoLog, program, bufSize);
+        realGetProgramInfoLog(program, bufSize, length, infoLog);
+    }
+
+    void GLAPIENTRY captureGetProgramiv(GLuint program, GLenum pname, GLint* param)
+    {
+        record(GLCall_GetProgramiv, program, pname);
+        realGetProgramiv(program, pname, param);
+    }
+
+    void GLAPIENTRY captureGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params)
+    {
+        record(GLCall_GetQueryObjectui64v, id, pname);
+        realGetQueryObjectui64v(id, pname, params);
+    }
+
+    void GLAPIENTRY captureGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+    {
+        record(GLCall_GetShaderInfoLog, shader, bufSize);
+        realGetShaderInfoLog(shader, bufSize, length, infoLog);
+    }
+
+    void GLAPIENTRY captureGetShaderiv(GLuint shader, GLenum pname, GLint* param)
+    {
+        record(GLCall_GetShaderiv, shader, pname);
+        realGetShaderiv(shader, pname, param);
+    }
+
+    // The index is stored like the uniform locations
+    GLuint GLAPIENTRY captureGetUniformBlockIndex(GLuint program, const GLchar* uniformBlockName)
+    {
+        GLuint index = realGetUniformBlockIndex(program, uniformBlockName);
+        if (record(GLCall_GetUniformBlockIndex, program, index))
+            payload(uniformBlockName, strlen(uniformBlockName));
+        return index;
+    }
+
+    // The location is stored so the replay can map the captured one onto its own
+    GLint GLAPIENTRY captureGetUniformLocation(GLuint program, const GLchar* name)
+    {
+        GLint location = realGetUniformLocation(program, name);
+        if (record(GLCall_GetUniformLocation, program, location))
+            payload(name, strlen(name));
+        return location;
+    }
+
+    void GLAPIENTRY captureLinkProgram(GLuint program)
+    {
+        record(GLCall_LinkProgram, program);
+        realLinkProgram(program);
+    }
+
+    void GLAPIENTRY captureQueryCounter(GLuint id, GLenum target)
+    {
+        record(GLCall_QueryCounter, id, target);
+        realQueryCounter(id, target);
+    }
+
+    void GLAPIENTRY captureRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+    {
+        record(GLCall_RenderbufferStorage, target, internalformat, width, height);
+        realRenderbufferStorage(target, internalformat, width, height);
+    }
+
+    // The strings are joined into one source
+    void GLAPIENTRY captureShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length)
+    {
+        if (record(GLCall_ShaderSource, shader))
+        {
+            std::string source;
+            for (GLsizei i = 0; i < count; i++)
+            {
+                if (length != NULL && length[i] >= 0)
+                    source.append(string[i], length[i]);
+                else
+                    source.append(string[i]);
+            }
+            payload(source.data(), source.size());
+        }
+        realShaderSource(shader, count, string, length);
+    }
+
+    void GLAPIENTRY captureTexBuffer(GLenum target, GLenum internalFormat, GLuint buffer)
+    {
+        record(GLCall_TexBuffer, target, internalFormat, buffer);
+        realTexBuffer(target, internalFormat, buffer);
+    }
+
+    void GLAPIENTRY captureTexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                                      GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        if (record(GLCall_TexImage3D, target, level, internalFormat, width, height, depth, border, format, type))
+            payload(pixels, GLCapture::imageBytes(width, height, depth, format, type, state().unpackAlignment));
+        realTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+    }
+
+    void GLAPIENTRY captureTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                                         GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+    {
+        if (record(GLCall_TexSubImage3D, target, level, xoffset, yoffset, zoffset, width, height, depth, format, type))
+            payload(pixels, GLCapture::imageBytes(width, height, depth, format, type, state().unpackAlignment));
+        realTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+    }
+
+    void GLAPIENTRY captureUniform1f(GLint location, GLfloat v0)
+    {
+        record(GLCall_Uniform1f, location, v0);
+        realUniform1f(location, v0);
+    }
+
+    void GLAPIENTRY captureUniform1i(GLint location, GLint v0)
+    {
+        record(GLCall_Uniform1i, location, v0);
+        realUniform1i(location, v0);
+    }
+
+    void GLAPIENTRY captureUniformBlockBinding(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding)
+    {
+        record(GLCall_UniformBlockBinding, program, uniformBlockIndex, uniformBlockBinding);
+        realUniformBlockBinding(program, uniformBlockIndex, uniformBlockBinding);
+    }
+
+    void GLAPIENTRY captureUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        if (record(GLCall_UniformMatrix4fv, location, count, transpose))
+            payload(value, count * 16 * sizeof(GLfloat));
+        realUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    void GLAPIENTRY captureUseProgram(GLuint program)
+    {
+        record(GLCall_UseProgram, program);
+        realUseProgram(program);
+    }
+
+    void GLAPIENTRY captureVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride,
+                                               const void* pointer)
+    {
+        record(GLCall_VertexAttribPointer, index, size, type, normalized, stride, offset(pointer));
+        realVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    }
+}
+
+#ifdef GL_CAPTURE
+// The calls into the GL library are redirected here by the linker
+// (-Wl,--wrap=glX), __real_glX is the library function
+extern "C"
+{
+#define GL_CAPTURE_DECLARE(name) decltype(gl##name) __real_gl##name;
+    GL_CORE_ENTRY_POINTS(GL_CAPTURE_DECLARE)
+#undef GL_CAPTURE_DECLARE
+
+    void GLAPIENTRY __wrap_glBindTexture(GLenum target, GLuint texture)
+    {
+        record(GLCall_BindTexture, target, texture);
+        __real_glBindTexture(target, texture);
+    }
+
+    void GLAPIENTRY __wrap_glBlendFunc(GLenum sfactor, GLenum dfactor)
+    {
+        record(GLCall_BlendFunc, sfactor, dfactor);
+        __real_glBlendFunc(sfactor, dfactor);
+    }
+
+    void GLAPIENTRY __wrap_glClear(GLbitfield mask)
+    {
+        record(GLCall_Clear, mask);
+        __real_glClear(mask);
+    }
+
+    void GLAPIENTRY __wrap_glClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)
+    {
+        record(GLCall_ClearColor, red, green, blue, alpha);
+        __real_glClearColor(red, green, blue, alpha);
+    }
+
+    void GLAPIENTRY __wrap_glColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+    {
+        record(GLCall_ColorMask, red, green, blue, alpha);
+        __real_glColorMask(red, green, blue, alpha);
+    }
+
+    void GLAPIENTRY __wrap_glCullFace(GLenum mode)
+    {
+        record(GLCall_CullFace, mode);
+        __real_glCullFace(mode);
+    }
+
+    void GLAPIENTRY __wrap_glDeleteTextures(GLsizei n, const GLuint* textures)
+    {
+        names(GLCall_DeleteTextures, n, textures);
+        __real_glDeleteTextures(n, textures);
+    }
+
+    void GLAPIENTRY __wrap_glDepthFunc(GLenum func)
+    {
+        record(GLCall_DepthFunc, func);
+        __real_glDepthFunc(func);
+    }
+
+    void GLAPIENTRY __wrap_glDepthMask(GLboolean flag)
+    {
+        record(GLCall_DepthMask, flag);
+        __real_glDepthMask(flag);
+    }
+
+    void GLAPIENTRY __wrap_glDisable(GLenum cap)
+    {
+        record(GLCall_Disable, cap);
+        __real_glDisable(cap);
+    }
+
+    void GLAPIENTRY __wrap_glDrawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        record(GLCall_DrawArrays, mode, first, count);
+        __real_glDrawArrays(mode, first, count);
+    }
+
+    void GLAPIENTRY __wrap_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        record(GLCall_DrawElements, mode, count, type, offset(indices));
+        __real_glDrawElements(mode, count, type, indices);
+    }
+
+    void GLAPIENTRY __wrap_glEnable(GLenum cap)
+    {
+        record(GLCall_Enable, cap);
+        __real_glEnable(cap);
+    }
+
+    void GLAPIENTRY __wrap_glFinish()
+    {
+        record(GLCall_Finish);
+        __real_glFinish();
+    }
+
+    void GLAPIENTRY __wrap_glFlush()
+    {
+        record(GLCall_Flush);
+        __real_glFlush();
+    }
+
+    void GLAPIENTRY __wrap_glGenTextures(GLsizei n, GLuint* textures)
+    {
+        __real_glGenTextures(n, textures);
+        names(GLCall_GenTextures, n, textures);
+    }
+
+    GLenum GLAPIENTRY __wrap_glGetError()
+    {
+        record(GLCall_GetError);
+        return __real_glGetError();
+    }
+
+    void GLAPIENTRY __wrap_glGetIntegerv(GLenum pname, GLint* params)
+    {
+        record(GLCall_GetIntegerv, pname);
+        __real_glGetIntegerv(pname, params);
+    }
+
+    const GLubyte* GLAPIENTRY __wrap_glGetString(GLenum name)
+    {
+        record(GLCall_GetString, name);
+        return __real_glGetString(name);
+    }
+
+    void GLAPIENTRY __wrap_glPixelStorei(GLenum pname, GLint param)
+    {
+        record(GLCall_PixelStorei, pname, param);
+        if (pname == GL_UNPACK_ALIGNMENT)
+            state().unpackAlignment = param;
+        __real_glPixelStorei(pname, param);
+    }
+
+    void GLAPIENTRY __wrap_glReadBuffer(GLenum mode)
+    {
+        record(GLCall_ReadBuffer, mode);
+        __real_glReadBuffer(mode);
+    }
+
+    void GLAPIENTRY __wrap_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels)
+    {
+        record(GLCall_ReadPixels, x, y, width, height, format, type);
+        __real_glReadPixels(x, y, width, height, format, type, pixels);
+    }
+
+    void GLAPIENTRY __wrap_glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        record(GLCall_Scissor, x, y, width, height);
+        __real_glScissor(x, y, width, height);
+    }
+
+    void GLAPIENTRY __wrap_glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                                        GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        if (record(GLCall_TexImage2D, target, level, internalformat, width, height, border, format, type))
+            payload(pixels, GLCapture::imageBytes(width, height, 1, format, type, state().unpackAlignment));
+        __real_glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+    }
+
+    void GLAPIENTRY __wrap_glTexParameteri(GLenum target, GLenum pname, GLint param)
+    {
+        record(GLCall_TexParameteri, target, pname, param);
+        __real_glTexParameteri(target, pname, param);
+    }
+
+    void GLAPIENTRY __wrap_glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                                           GLenum format, GLenum type, const void* pixels)
+    {
+        if (record(GLCall_TexSubImage2D, target, level, xoffset, yoffset, width, height, format, type))
+            payload(pixels, GLCapture::imageBytes(width, height, 1, format, type, state().unpackAlignment));
+        __real_glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+    }
+
+    void GLAPIENTRY __wrap_glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        record(GLCall_Viewport, x, y, width, height);
+        __real_glViewport(x, y, width, height);
+    }
+}
+#endif
+
+bool GLCapture::begin(const char* path, unsigned int frames)
+{
+    State& s = state();
+    if (s.file != nullptr)
+        return false;
+
+    s.file = fopen(path, "wb");
+    if (s.file == nullptr)
+    {
+        printf("Impossible to open %s for the GL capture\n", path);
+        return false;
+    }
+    setvbuf(s.file, nullptr, _IOFBF, 1 << 20);
+
+    GLTraceHeader header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.coreCalls = coreCalls ? 1 : 0;
+    write(&header, sizeof(header));
+
+    s.path = path;
+    s.frames = 0;
+    s.frameLimit = frames;
+    s.calls = 0;
+
+    // Record through the GLEW pointers from now on
+#define GL_CAPTURE_SWAP(name) real##name = __glew##name; __glew##name = capture##name;
+    GL_POINTER_ENTRY_POINTS(GL_CAPTURE_SWAP)
+#undef GL_CAPTURE_SWAP
+
+    if (!coreCalls)
+        printf("GL capture: the build doesn't wrap the GL library calls, the trace can't be replayed\n");
+    return true;
+}
+
+void GLCapture::beginFrame()
+{
+    State& s = state();
+    if (s.file == nullptr)
+        return;
+
+    if (s.frameLimit > 0 && s.frames == s.frameLimit)
+    {
+        end();
+        return;
+    }
+
+    uint16_t id = GLCallFrame;
+    write(&id, sizeof(id));
+    s.frames++;
+}
+
+void GLCapture::end()
+{
+    State& s = state();
+    if (s.file == nullptr)
+        return;
+
+#define GL_CAPTURE_RESTORE(name) __glew##name = real##name;
+    GL_POINTER_ENTRY_POINTS(GL_CAPTURE_RESTORE)
+#undef GL_CAPTURE_RESTORE
+
+    long bytes = ftell(s.file);
+    fclose(s.file);
+    s.file = nullptr;
+    printf("GL capture: %u frames, %llu calls, %.2f MB written to %s\n", s.frames,
+           static_cast<unsigned long long>(s.calls), bytes / (1024.0 * 1024.0), s.path.c_str());
+}
+
+bool GLCapture::capturing()
+{
+    return state().file != nullptr;
+}
+
+const char* GLCapture::name(unsigned int call)
+{
+    if (call == GLCallFrame)
+        return "frame";
+    return call < GLCallCount ? callNames[call] : "";
+}
+
+size_t GLCapture::imageBytes(int width, int height, int depth, GLenum format, GLenum type, int alignment)
+{
+    size_t components = format == GL_RGBA || format == GL_BGRA ? 4 :
+                        format == GL_RGB || format == GL_BGR ? 3 :
+                        format == GL_RG ? 2 : 1;
+    size_t size = type == GL_FLOAT || type == GL_UNSIGNED_INT || type == GL_INT ? 4 :
+                  type == GL_HALF_FLOAT || type == GL_UNSIGNED_SHORT || type == GL_SHORT ? 2 : 1;
+
+    // Rows are padded to the alignment
+    size_t align = static_cast<size_t>(alignment > 0 ? alignment : 1);
+    size_t row = (width * components * size + align - 1) / align * align;
+    return row * height * depth;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include <common/glentrypoints.hpp>
+
+// Calls stored in a trace, in the order of GL_ENTRY_POINTS
+enum GLCall : uint16_t
+{
+#define GL_CAPTURE_ENUM(name) GLCall_##name,
+    GL_ENTRY_POINTS(GL_CAPTURE_ENUM)
+#undef GL_CAPTURE_ENUM
+    GLCallCount,
+    GLCallFrame = 0xffff        // start of a frame
+};
+
+// File header of a trace. The header is followed by records of a 16 bit
+// call, its arguments and, for calls that pass memory, a 32 bit byte count
+// and the bytes. Object names and uniform locations are stored as the
+// capture saw them, the replay maps them onto its own.
+struct GLTraceHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t coreCalls;         // calls into the GL library were captured too
+};
+
+// Records the GL calls of the renderer into a binary trace that the replay
+// tool plays back without the scene logic. The GLEW function pointers are
+// swapped for recording ones while a capture runs. The calls into the GL
+// library itself are wrapped by the linker with the GL_CAPTURE build option,
+// without it the trace only has the GLEW calls and can't be replayed.
+class GLCapture
+{
+public:
+    static const char magic[8];
+    static const uint32_t version = 3;
+
+    // True when the linker wraps the GL library calls
+    static const bool coreCalls;
+
+    // Start recording after glewInit, zero frames runs until end()
+    static bool begin(const char* path, unsigned int frames = 0);
+
+    // Mark the start of a frame, ends the capture after the requested frames
+    static void beginFrame();
+
+    // Stop recording and restore the GLEW function pointers
+    static void end();
+
+    static bool capturing();
+
+    // Name of a call, e.g. "glDrawArrays"
+    static const char* name(unsigned int call);
+
+    // Bytes of an image passed to or read from GL with the given row alignment
+    static size_t imageBytes(int width, int height, int depth, GLenum format, GLenum type, int alignment);
+};
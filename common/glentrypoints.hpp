@@ -0,0 +1,29 @@
+#pragma once
+
+// GL entry points the renderer calls, without the gl prefix. The core ones
+// are exported by the GL library itself, the others are function pointers
+// loaded by GLEW. A new call has to be added here, the null backend and the
+// capture layer implement every entry.
+#define GL_CORE_ENTRY_POINTS(X) \
+    X(BindTexture) X(BlendFunc) X(Clear) X(ClearColor) X(ColorMask) \
+    X(CullFace) X(DeleteTextures) X(DepthFunc) X(DepthMask) X(Disable) \
+    X(DrawArrays) X(DrawElements) X(Enable) X(Finish) X(Flush) \
+    X(GenTextures) X(GetError) X(GetIntegerv) X(GetString) X(PixelStorei) \
+    X(ReadBuffer) X(ReadPixels) X(Scissor) X(TexImage2D) X(TexParameteri) \
+    X(TexSubImage2D) X(Viewport)
+
+#define GL_POINTER_ENTRY_POINTS(X) \
+    X(ActiveTexture) X(AttachShader) X(BeginQuery) X(BindBuffer) X(BindBufferBase) \
+    X(BindFramebuffer) X(BindRenderbuffer) X(BindVertexArray) X(BlitFramebuffer) X(BufferData) \
+    X(BufferSubData) X(CheckFramebufferStatus) X(CompileShader) X(CreateProgram) X(CreateShader) \
+    X(DeleteBuffers) X(DeleteFramebuffers) X(DeleteProgram) X(DeleteQueries) X(DeleteRenderbuffers) \
+    X(DeleteShader) X(DeleteVertexArrays) X(DetachShader) X(DrawArraysInstanced) X(DrawBuffers) \
+    X(EnableVertexAttribArray) X(EndQuery) X(FramebufferRenderbuffer) X(FramebufferTexture2D) X(GenBuffers) \
+    X(GenFramebuffers) X(GenQueries) X(GenRenderbuffers) X(GenVertexArrays) X(GenerateMipmap) \
+    X(GetInteger64v) X(GetProgramInfoLog) X(GetProgramiv) X(GetQueryObjectui64v) X(GetShaderInfoLog) \
+    X(GetShaderiv) X(GetUniformBlockIndex) X(GetUniformLocation) X(LinkProgram) X(QueryCounter) \
+    X(RenderbufferStorage) X(ShaderSource) X(TexBuffer) X(TexImage3D) X(TexSubImage3D) \
+    X(Uniform1f) X(Uniform1i) X(UniformBlockBinding) X(UniformMatrix4fv) X(UseProgram) \
+    X(VertexAttribPointer)
+
+#define GL_ENTRY_POINTS(X) GL_CORE_ENTRY_POINTS(X) GL_POINTER_ENTRY_POINTS(X)
@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <unordered_map>
+
+#include <common/glresource.hpp>
+#include <common/glstate.hpp>
+
+namespace
+{
+    const unsigned int typeCount = static_cast<unsigned int>(GLResourceType::Count);
+
+    struct Resource
+    {
+        std::string label;
+        uint64_t bytes = 0;
+    };
+
+    struct State
+    {
+        // Objects keyed by kind and name
+        std::unordered_map<uint64_t, Resource> resources;
+        uint64_t bytes[typeCount] = {};
+        unsigned int count[typeCount] = {};
+    };
+
+    State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    uint64_t key(GLResourceType type, unsigned int id)
+    {
+        return (static_cast<uint64_t>(type) << 32) | id;
+    }
+}
+
+void GLResourceTracker::add(GLResourceType type, unsigned int id, const std::string& label)
+{
+    // A name can only be reused once it was deleted
+    remove(type, id);
+
+    State& s = state();
+    Resource& resource = s.resources[key(type, id)];
+    resource.label = label.empty() ? "unnamed" : label;
+    s.count[static_cast<unsigned int>(type)]++;
+}
+
+void GLResourceTracker::setBytes(GLResourceType type, unsigned int id, uint64_t bytes)
+{
+    State& s = state();
+    auto it = s.resources.find(key(type, id));
+    if (it == s.resources.end())
+        return;
+
+    s.bytes[static_cast<unsigned int>(type)] += bytes - it->second.bytes;
+    it->second.bytes = bytes;
+}
+
+void GLResourceTracker::remove(GLResourceType type, unsigned int id)
+{
+    State& s = state();
+    auto it = s.resources.find(key(type, id));
+    if (it == s.resources.end())
+        return;
+
+    s.bytes[static_cast<unsigned int>(type)] -= it->second.bytes;
+    s.count[static_cast<unsigned int>(type)]--;
+    s.resources.erase(it);
+}
+
+uint64_t GLResourceTracker::bytes()
+{
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < typeCount; i++)
+        total += state().bytes[i];
+
+    return total;
+}
+
+uint64_t GLResourceTracker::bytes(GLResourceType type)
+{
+    return state().bytes[static_cast<unsigned int>(type)];
+}
+
+unsigned int GLResourceTracker::count(GLResourceType type)
+{
+    return state().count[static_cast<unsigned int>(type)];
+}
+
+uint64_t GLResourceTracker::textureBytes(int width, int height, int layers, int texelBytes, bool mipmaps)
+{
+    uint64_t total = 0;
+    while (true)
+    {
+        total += static_cast<uint64_t>(width) * height * layers * texelBytes;
+        if (!mipmaps || (width == 1 && height == 1))
+            return total;
+
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
+
+void GLResourceTracker::printSummary()
+{
+    State& s = state();
+    printf("GPU resources %.2f MB\n", bytes() / (1024.0 * 1024.0));
+    for (unsigned int i = 0; i < typeCount; i++)
+        if (s.count[i] > 0)
+            printf("    %-14s %6u  %10.2f MB\n", name(static_cast<GLResourceType>(i)), s.count[i],
+                   s.bytes[i] / (1024.0 * 1024.0));
+}
+
+unsigned int GLResourceTracker::reportLeaks()
+{
+    State& s = state();
+    unsigned int leaked = static_cast<unsigned int>(s.resources.size());
+    if (leaked == 0)
+        return 0;
+
+    printf("%u GL objects were not deleted, %.2f MB:\n", leaked, bytes() / (1024.0 * 1024.0));
+    for (auto it = s.resources.begin(); it != s.resources.end(); ++it)
+        printf("    %s %u (%s), %llu bytes\n", name(static_cast<GLResourceType>(it->first >> 32)),
+               static_cast<unsigned int>(it->first & 0xffffffff), it->second.label.c_str(),
+               static_cast<unsigned long long>(it->second.bytes));
+
+    return leaked;
+}
+
+const char* GLResourceTracker::name(GLResourceType type)
+{
+    switch (type)
+    {
+    case GLResourceType::Buffer:        return "Buffer";
+    case GLResourceType::VertexArray:   return "Vertex array";
+    case GLResourceType::Texture:       return "Texture";
+    case GLResourceType::Renderbuffer:  return "Renderbuffer";
+    case GLResourceType::Framebuffer:   return "Framebuffer";
+    case GLResourceType::Program:       return "Program";
+    default:                            return "Unknown";
+    }
+}
+
+template <GLResourceType Type>
+void GLHandle<Type>::create(const std::string& label)
+{
+    unsigned int name = 0;
+    switch (Type)
+    {
+    case GLResourceType::Buffer:        glGenBuffers(1, &name); break;
+    case GLResourceType::VertexArray:   glGenVertexArrays(1, &name); break;
+    case GLResourceType::Texture:       glGenTextures(1, &name); break;
+    case GLResourceType::Renderbuffer:  glGenRenderbuffers(1, &name); break;
+    case GLResourceType::Framebuffer:   glGenFramebuffers(1, &name); break;
+    case GLResourceType::Program:       name = glCreateProgram(); break;
+    default:                            break;
+    }
+    adopt(name, label);
+}
+
+template <GLResourceType Type>
+void GLHandle<Type>::release()
+{
+    if (id == 0)
+        return;
+
+    switch (Type)
+    {
+    case GLResourceType::Buffer:        glDeleteBuffers(1, &id); break;
+    case GLResourceType::VertexArray:   glDeleteVertexArrays(1, &id); break;
+    case GLResourceType::Texture:       glDeleteTextures(1, &id); break;
+    case GLResourceType::Renderbuffer:  glDeleteRenderbuffers(1, &id); break;
+    case GLResourceType::Framebuffer:   glDeleteFramebuffers(1, &id); break;
+    case GLResourceType::Program:       glDeleteProgram(id); break;
+    default:                            break;
+    }
+    GLState::released(Type, id);
+    GLResourceTracker::remove(Type, id);
+    id = 0;
+}
+
+template class GLHandle<GLResourceType::Buffer>;
+template class GLHandle<GLResourceType::VertexArray>;
+template class GLHandle<GLResourceType::Texture>;
+template class GLHandle<GLResourceType::Renderbuffer>;
+template class GLHandle<GLResourceType::Framebuffer>;
+template class GLHandle<GLResourceType::Program>;
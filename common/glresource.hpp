@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+// Kinds of GL object the tracker accounts for
+enum class GLResourceType { Buffer, VertexArray, Texture, Renderbuffer, Framebuffer, Program, Count };
+
+// Live GL objects with a label and the bytes of their storage. Everything is
+// called on the thread that owns the context, the handles below register
+// themselves so the totals always match what has been created and deleted.
+class GLResourceTracker
+{
+public:
+    // Register, resize and unregister an object
+    static void add(GLResourceType type, unsigned int id, const std::string& label);
+    static void setBytes(GLResourceType type, unsigned int id, uint64_t bytes);
+    static void remove(GLResourceType type, unsigned int id);
+
+    // Totals over all objects and over one kind
+    static uint64_t bytes();
+    static uint64_t bytes(GLResourceType type);
+    static unsigned int count(GLResourceType type);
+
+    // Storage of a texture with a full mipmap chain when mipmapped
+    static uint64_t textureBytes(int width, int height, int layers, int texelBytes, bool mipmaps);
+
+    // Objects and bytes per kind
+    static void printSummary();
+
+    // Print the objects still alive, called before the context is destroyed.
+    // Returns the number of leaked objects.
+    static unsigned int reportLeaks();
+
+    static const char* name(GLResourceType type);
+};
+
+// Owns one GL object and deletes it when destroyed or released. Handles can
+// be moved but not copied, and convert to the object name so they can be
+// passed straight to GL calls. The context must still be current when a
+// live handle is destroyed.
+template <GLResourceType Type>
+class GLHandle
+{
+public:
+    unsigned int id = 0;
+
+    GLHandle() = default;
+    ~GLHandle() { release(); }
+
+    GLHandle(GLHandle&& other) noexcept : id(other.id) { other.id = 0; }
+    GLHandle& operator=(GLHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    operator unsigned int() const { return id; }
+
+    // Generate a new object, programs are created with adopt() instead
+    void create(const std::string& label);
+
+    // Take ownership of an object created elsewhere
+    void adopt(unsigned int name, const std::string& label)
+    {
+        release();
+        id = name;
+        if (id != 0)
+            GLResourceTracker::add(Type, id, label);
+    }
+
+    // Bytes of storage, call after glBufferData and friends
+    void setBytes(uint64_t bytes) const { GLResourceTracker::setBytes(Type, id, bytes); }
+
+    // Delete the object
+    void release();
+};
+
+typedef GLHandle<GLResourceType::Buffer> GLBuffer;
+typedef GLHandle<GLResourceType::VertexArray> GLVertexArray;
+typedef GLHandle<GLResourceType::Texture> GLTexture;
+typedef GLHandle<GLResourceType::Renderbuffer> GLRenderbuffer;
+typedef GLHandle<GLResourceType::Framebuffer> GLFramebuffer;
+typedef GLHandle<GLResourceType::Program> GLProgram;
+
+// Defined for each kind in glresource.cpp
+extern template class GLHandle<GLResourceType::Buffer>;
+extern template class GLHandle<GLResourceType::VertexArray>;
+extern template class GLHandle<GLResourceType::Texture>;
+extern template class GLHandle<GLResourceType::Renderbuffer>;
+extern template class GLHandle<GLResourceType::Framebuffer>;
+extern template class GLHandle<GLResourceType::Program>;
@@ -0,0 +1,352 @@
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+#include <common/glstate.hpp>
+
+uint64_t GLState::hits = 0;
+uint64_t GLState::misses = 0;
+
+namespace
+{
+    // Value of a binding or setting that hasn't been seen yet
+    const unsigned int unknown = ~0u;
+
+    // Last upload of a uniform, integers are stored by their bits
+    struct UniformValue
+    {
+        float values[16];
+    };
+
+    struct State
+    {
+        unsigned int program, vertexArray, arrayBuffer;
+        unsigned int readFramebuffer, drawFramebuffer;
+        unsigned int elementBuffer;     // part of the vertex array state
+        unsigned int activeUnit;
+        unsigned int texture2D[GLState::textureUnits];
+        unsigned int texture2DArray[GLState::textureUnits];
+        unsigned int textureBuffer[GLState::textureUnits];
+        unsigned int uniformBuffers[GLState::uniformBufferBindings];
+        unsigned int depthTest, blend, cull, depthWrite;
+        unsigned int blendSource, blendDestination, depthFunction, cullMode;
+
+        // Uniforms keyed by program and location
+        std::unordered_map<uint64_t, UniformValue> uniforms;
+
+        State() { reset(); }
+
+        void reset()
+        {
+            program = vertexArray = arrayBuffer = elementBuffer = activeUnit = unknown;
+            readFramebuffer = drawFramebuffer = unknown;
+            for (unsigned int i = 0; i < GLState::textureUnits; i++)
+                texture2D[i] = texture2DArray[i] = textureBuffer[i] = unknown;
+            for (unsigned int i = 0; i < GLState::uniformBufferBindings; i++)
+                uniformBuffers[i] = unknown;
+            depthTest = blend = cull = depthWrite = unknown;
+            blendSource = blendDestination = depthFunction = cullMode = unknown;
+            uniforms.clear();
+        }
+    };
+
+    State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    // Store a new value, returns false and counts a hit when it is unchanged
+    bool change(unsigned int& cached, unsigned int value)
+    {
+        if (cached == value)
+        {
+            GLState::hits++;
+            return false;
+        }
+
+        cached = value;
+        GLState::misses++;
+        return true;
+    }
+
+    // Cached flag of a capability, nullptr for the ones that aren't tracked
+    unsigned int* capability(GLenum cap)
+    {
+        State& s = state();
+        switch (cap)
+        {
+        case GL_DEPTH_TEST: return &s.depthTest;
+        case GL_BLEND:      return &s.blend;
+        case GL_CULL_FACE:  return &s.cull;
+        default:            return nullptr;
+        }
+    }
+
+    // Cached binding of a texture target on a unit, nullptr if not tracked
+    unsigned int* textureBinding(unsigned int unit, GLenum target)
+    {
+        State& s = state();
+        if (unit >= GLState::textureUnits)
+            return nullptr;
+
+        if (target == GL_TEXTURE_2D)
+            return &s.texture2D[unit];
+        if (target == GL_TEXTURE_2D_ARRAY)
+            return &s.texture2DArray[unit];
+        if (target == GL_TEXTURE_BUFFER)
+            return &s.textureBuffer[unit];
+        return nullptr;
+    }
+
+    // Store a uniform value, returns false and counts a hit when it is unchanged
+    bool changeUniform(int location, const void* value, size_t bytes)
+    {
+        State& s = state();
+        if (s.program == unknown)
+        {
+            GLState::misses++;
+            return true;
+        }
+
+        uint64_t key = (static_cast<uint64_t>(s.program) << 32) | static_cast<uint32_t>(location);
+        auto it = s.uniforms.find(key);
+        if (it != s.uniforms.end() && memcmp(it->second.values, value, bytes) == 0)
+        {
+            GLState::hits++;
+            return false;
+        }
+
+        if (it == s.uniforms.end())
+            it = s.uniforms.insert(std::make_pair(key, UniformValue())).first;
+        memcpy(it->second.values, value, bytes);
+        GLState::misses++;
+        return true;
+    }
+}
+
+void GLState::useProgram(unsigned int program)
+{
+    if (change(state().program, program))
+        glUseProgram(program);
+}
+
+void GLState::bindVertexArray(unsigned int vertexArray)
+{
+    State& s = state();
+    if (change(s.vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        s.elementBuffer = unknown;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, unsigned int buffer)
+{
+    State& s = state();
+    unsigned int* cached = target == GL_ARRAY_BUFFER ? &s.arrayBuffer :
+                           target == GL_ELEMENT_ARRAY_BUFFER ? &s.elementBuffer : nullptr;
+    if (cached == nullptr)
+        misses++;
+    if (cached == nullptr || change(*cached, buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+{
+    State& s = state();
+    unsigned int* cached = target == GL_UNIFORM_BUFFER && index < uniformBufferBindings ? &s.uniformBuffers[index] : nullptr;
+    if (cached == nullptr)
+        misses++;
+    if (cached == nullptr || change(*cached, buffer))
+        glBindBufferBase(target, index, buffer);
+}
+
+void GLState::bindFramebuffer(unsigned int framebuffer)
+{
+    // GL_FRAMEBUFFER binds both targets
+    State& s = state();
+    if (s.readFramebuffer == framebuffer && s.drawFramebuffer == framebuffer)
+    {
+        hits++;
+        return;
+    }
+
+    s.readFramebuffer = s.drawFramebuffer = framebuffer;
+    misses++;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GLState::bindReadFramebuffer(unsigned int framebuffer)
+{
+    if (change(state().readFramebuffer, framebuffer))
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+}
+
+void GLState::bindDrawFramebuffer(unsigned int framebuffer)
+{
+    if (change(state().drawFramebuffer, framebuffer))
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+}
+
+void GLState::activeTexture(unsigned int unit)
+{
+    if (change(state().activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::bindTexture(GLenum target, unsigned int texture)
+{
+    State& s = state();
+    unsigned int* cached = s.activeUnit == unknown ? nullptr : textureBinding(s.activeUnit, target);
+    if (cached == nullptr)
+        misses++;
+    if (cached == nullptr || change(*cached, texture))
+        glBindTexture(target, texture);
+}
+
+void GLState::bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+    // Only switch units when the binding changes
+    unsigned int* cached = textureBinding(unit, target);
+    if (cached != nullptr && *cached == texture)
+    {
+        hits++;
+        return;
+    }
+
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void GLState::enable(GLenum cap)
+{
+    unsigned int* cached = capability(cap);
+    if (cached == nullptr)
+        misses++;
+    if (cached == nullptr || change(*cached, 1))
+        glEnable(cap);
+}
+
+void GLState::disable(GLenum cap)
+{
+    unsigned int* cached = capability(cap);
+    if (cached == nullptr)
+        misses++;
+    if (cached == nullptr || change(*cached, 0))
+        glDisable(cap);
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+    State& s = state();
+    if (s.blendSource == source && s.blendDestination == destination)
+    {
+        hits++;
+        return;
+    }
+
+    s.blendSource = source;
+    s.blendDestination = destination;
+    misses++;
+    glBlendFunc(source, destination);
+}
+
+void GLState::depthFunc(GLenum function)
+{
+    if (change(state().depthFunction, function))
+        glDepthFunc(function);
+}
+
+void GLState::depthMask(bool write)
+{
+    if (change(state().depthWrite, write ? 1 : 0))
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::cullFace(GLenum face)
+{
+    if (change(state().cullMode, face))
+        glCullFace(face);
+}
+
+void GLState::uniform1i(int location, int value)
+{
+    if (location < 0)
+        return;
+
+    if (changeUniform(location, &value, sizeof(value)))
+        glUniform1i(location, value);
+}
+
+void GLState::uniform1f(int location, float value)
+{
+    if (location < 0)
+        return;
+
+    if (changeUniform(location, &value, sizeof(value)))
+        glUniform1f(location, value);
+}
+
+void GLState::uniformMatrix4fv(int location, const float* value)
+{
+    if (location < 0)
+        return;
+
+    if (changeUniform(location, value, 16 * sizeof(float)))
+        glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+void GLState::released(GLResourceType type, unsigned int id)
+{
+    State& s = state();
+    switch (type)
+    {
+    case GLResourceType::Program:
+    {
+        // A new program can reuse the name, drop the uniforms of this one
+        if (s.program == id)
+            s.program = unknown;
+        for (auto it = s.uniforms.begin(); it != s.uniforms.end();)
+            it = (it->first >> 32) == id ? s.uniforms.erase(it) : std::next(it);
+        break;
+    }
+    case GLResourceType::VertexArray:
+        if (s.vertexArray == id)
+            s.vertexArray = s.elementBuffer = unknown;
+        break;
+    case GLResourceType::Buffer:
+        if (s.arrayBuffer == id)
+            s.arrayBuffer = unknown;
+        if (s.elementBuffer == id)
+            s.elementBuffer = unknown;
+        for (unsigned int i = 0; i < uniformBufferBindings; i++)
+            if (s.uniformBuffers[i] == id)
+                s.uniformBuffers[i] = unknown;
+        break;
+    case GLResourceType::Texture:
+        for (unsigned int i = 0; i < textureUnits; i++)
+        {
+            if (s.texture2D[i] == id)
+                s.texture2D[i] = unknown;
+            if (s.texture2DArray[i] == id)
+                s.texture2DArray[i] = unknown;
+            if (s.textureBuffer[i] == id)
+                s.textureBuffer[i] = unknown;
+        }
+        break;
+    case GLResourceType::Framebuffer:
+        if (s.readFramebuffer == id)
+            s.readFramebuffer = unknown;
+        if (s.drawFramebuffer == id)
+            s.drawFramebuffer = unknown;
+        break;
+    default:
+        break;
+    }
+}
+
+void GLState::invalidate()
+{
+    state().reset();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include <GL/glew.h>
+
+#include <common/glresource.hpp>
+
+// Shadow copy of the GL bindings and fixed function state. Calls that would
+// leave the state unchanged are skipped and counted as hits, the others are
+// passed on to GL and counted as misses. All binds and state changes of the
+// renderer go through here so the shadow copy stays correct, anything
+// unknown (at start up or after invalidate()) is always passed on.
+class GLState
+{
+public:
+    static const unsigned int textureUnits = 16;
+    static const unsigned int uniformBufferBindings = 16;
+
+    // Calls skipped and calls passed on
+    static uint64_t hits;
+    static uint64_t misses;
+
+    // Bindings
+    static void useProgram(unsigned int program);
+    static void bindVertexArray(unsigned int vertexArray);
+    static void bindBuffer(GLenum target, unsigned int buffer);
+    static void bindFramebuffer(unsigned int framebuffer);
+
+    // One target of a blit, bindFramebuffer sets both
+    static void bindReadFramebuffer(unsigned int framebuffer);
+    static void bindDrawFramebuffer(unsigned int framebuffer);
+
+    // Indexed binding of a uniform buffer, this also binds the generic
+    // GL_UNIFORM_BUFFER target
+    static void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+
+    // Texture units, bindTexture binds to the active unit
+    static void activeTexture(unsigned int unit);
+    static void bindTexture(GLenum target, unsigned int texture);
+    static void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+    // Depth test, blending and face culling
+    static void enable(GLenum capability);
+    static void disable(GLenum capability);
+    static void blendFunc(GLenum source, GLenum destination);
+    static void depthFunc(GLenum function);
+    static void depthMask(bool write);
+    static void cullFace(GLenum face);
+
+    // Uniforms of the current program, values equal to the last upload of
+    // the same location are skipped
+    static void uniform1i(int location, int value);
+    static void uniform1f(int location, float value);
+    static void uniformMatrix4fv(int location, const float* value);
+
+    // An object was deleted, GL drops its bindings and the name can be reused
+    static void released(GLResourceType type, unsigned int id);
+
+    // Forget the shadow copy after GL was used directly
+    static void invalidate();
+};
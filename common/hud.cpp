@@ -0,0 +1,226 @@
+#include <cstdio>
+#include <cstddef>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/hud.hpp>
+#include <common/glstate.hpp>
+
+namespace
+{
+    // 3x5 pixel glyphs of ASCII 32 to 95, one bit per pixel from the top
+    // left. Characters without a glyph are drawn as a question mark.
+    const uint16_t glyphs[64] =
+    {
+        0x0000, 0x2482, 0x7282, 0x7282, 0x7282, 0x52a5, 0x7282, 0x7282,
+        0x2922, 0x224a, 0x7282, 0x05d0, 0x0014, 0x01c0, 0x0002, 0x12a4,
+        0x7b6f, 0x2c97, 0x73e7, 0x72cf, 0x5bc9, 0x79cf, 0x79ef, 0x7292,
+        0x7bef, 0x7bcf, 0x0410, 0x7282, 0x1511, 0x0e38, 0x4454, 0x7282,
+        0x7282, 0x2bed, 0x6bae, 0x3923, 0x6b6e, 0x79a7, 0x79a4, 0x396b,
+        0x5bed, 0x7497, 0x126a, 0x5bad, 0x4927, 0x5fed, 0x6b6d, 0x2b6a,
+        0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492, 0x5b6f, 0x5b6a, 0x5bfd,
+        0x5aad, 0x5a92, 0x72a7, 0x6926, 0x7282, 0x324b, 0x7282, 0x0007,
+    };
+
+    // The atlas has 16 x 5 cells of 4 x 6 texels, the glyphs fill the top
+    // left 3 x 5 of the first 64 and the last is solid
+    const int cellWidth = 4, cellHeight = 6;
+    const int atlasColumns = 16;
+    const int atlasWidth = atlasColumns * cellWidth, atlasHeight = 5 * cellHeight;
+    const int solidCell = 64;
+
+    // Graphs show up to two 30 fps frames
+    const float graphTime = 33.3f;
+    const float graphHeight = 40.0f;
+
+    uint32_t rgba(unsigned int r, unsigned int g, unsigned int b, unsigned int a)
+    {
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+}
+
+// Storage for the constant, std::min takes it by reference
+const unsigned int HUD::historyFrames;
+
+void HUD::create(unsigned int Program, int Width, int Height)
+{
+    width = Width;
+    height = Height;
+    program.adopt(Program, "HUD shader");
+
+    // Bake the font into the atlas
+    std::vector<unsigned char> texels(atlasWidth * atlasHeight, 0);
+    for (int cell = 0; cell <= solidCell; cell++)
+    {
+        int x0 = (cell % atlasColumns) * cellWidth;
+        int y0 = (cell / atlasColumns) * cellHeight;
+        for (int y = 0; y < cellHeight; y++)
+        {
+            for (int x = 0; x < cellWidth; x++)
+            {
+                bool set = cell == solidCell ||
+                           (x < 3 && y < 5 && (glyphs[cell] >> (14 - (y * 3 + x))) & 1);
+                texels[(y0 + y) * atlasWidth + x0 + x] = set ? 255 : 0;
+            }
+        }
+    }
+
+    atlas.create("HUD font");
+    GLState::bindTexture(GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, &texels[0]);
+    atlas.setBytes(GLResourceTracker::textureBytes(atlasWidth, atlasHeight, 1, 1, false));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // One buffer large enough for any frame, it is refilled every frame
+    VAO.create("HUD");
+    GLState::bindVertexArray(VAO);
+    vertexBuffer.create("HUD vertices");
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(HUDVertex), NULL, GL_STREAM_DRAW);
+    vertexBuffer.setBytes(maxVertices * sizeof(HUDVertex));
+
+    GLsizei stride = sizeof(HUDVertex);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(HUDVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(HUDVertex, uv));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(HUDVertex, colour));
+    GLState::bindVertexArray(0);
+
+    // The uniforms never change
+    glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f);
+    GLState::useProgram(program);
+    GLState::uniformMatrix4fv(glGetUniformLocation(program, "projection"), &projection[0][0]);
+    GLState::uniform1i(glGetUniformLocation(program, "atlas"), 0);
+
+    vertices.reserve(maxVertices);
+}
+
+void HUD::update(const HUDStats& stats, float deltaTime)
+{
+    unsigned int slot = historyCount++ % historyFrames;
+    cpuTimes[slot] = stats.cpuTime;
+    gpuTimes[slot] = stats.gpuTime;
+    averageDelta = averageDelta == 0.0f ? deltaTime : 0.95f * averageDelta + 0.05f * deltaTime;
+
+    uint32_t white = rgba(255, 255, 255, 255);
+    vertices.clear();
+    rectangle(8.0f, 8.0f, 304.0f, 216.0f, rgba(0, 0, 0, 176), solidCell);
+
+    char line[96];
+    snprintf(line, sizeof(line), "FPS %.1f  CPU %.2f MS  GPU %.2f MS",
+             averageDelta > 0.0f ? 1.0f / averageDelta : 0.0f, stats.cpuTime, stats.gpuTime);
+    text(16.0f, 16.0f, line, white);
+    snprintf(line, sizeof(line), "DRAWS %u  TRIS %.1fK", stats.drawCalls, stats.triangles / 1000.0);
+    text(16.0f, 30.0f, line, white);
+    snprintf(line, sizeof(line), "STATES %u  SKIPPED %u", stats.stateChanges, stats.stateSkips);
+    text(16.0f, 44.0f, line, white);
+    snprintf(line, sizeof(line), "TEXTURES %.2f MB  MESHES %.2f MB", stats.textureBytes / (1024.0 * 1024.0),
+             stats.meshBytes / (1024.0 * 1024.0));
+    text(16.0f, 58.0f, line, white);
+    snprintf(line, sizeof(line), "SHADOWS %u  %.2f MS  CACHED %.0f%%", stats.shadowMaps, stats.shadowTime,
+             100.0f * stats.shadowHitRate);
+    text(16.0f, 72.0f, line, white);
+
+    graph(16.0f, 92.0f, "CPU", cpuTimes, rgba(96, 200, 255, 255));
+    graph(16.0f, 158.0f, "GPU", gpuTimes, rgba(255, 160, 64, 255));
+}
+
+void HUD::draw()
+{
+    if (vertices.empty())
+        return;
+
+    GLState::disable(GL_DEPTH_TEST);
+    GLState::enable(GL_BLEND);
+    GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    GLState::useProgram(program);
+    GLState::bindTexture(0, GL_TEXTURE_2D, atlas);
+    GLState::bindVertexArray(VAO);
+
+    // Orphan the previous contents so the upload doesn't wait for the GPU
+    GLsizeiptr size = vertices.size() * sizeof(HUDVertex);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(HUDVertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, &vertices[0]);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+
+    GLState::disable(GL_BLEND);
+    GLState::enable(GL_DEPTH_TEST);
+}
+
+void HUD::deleteBuffers()
+{
+    vertexBuffer.release();
+    VAO.release();
+    atlas.release();
+    program.release();
+}
+
+void HUD::rectangle(float x, float y, float w, float h, uint32_t colour, int cell)
+{
+    if (vertices.size() + 6 > maxVertices)
+        return;
+
+    // Texture coordinates of the glyph part of the cell
+    float u0 = static_cast<float>((cell % atlasColumns) * cellWidth) / atlasWidth;
+    float v0 = static_cast<float>((cell / atlasColumns) * cellHeight) / atlasHeight;
+    float u1 = u0 + 3.0f / atlasWidth;
+    float v1 = v0 + 5.0f / atlasHeight;
+
+    HUDVertex corners[4] =
+    {
+        { glm::vec2(x, y), glm::vec2(u0, v0), colour },
+        { glm::vec2(x + w, y), glm::vec2(u1, v0), colour },
+        { glm::vec2(x + w, y + h), glm::vec2(u1, v1), colour },
+        { glm::vec2(x, y + h), glm::vec2(u0, v1), colour }
+    };
+    vertices.push_back(corners[0]);
+    vertices.push_back(corners[1]);
+    vertices.push_back(corners[2]);
+    vertices.push_back(corners[0]);
+    vertices.push_back(corners[2]);
+    vertices.push_back(corners[3]);
+}
+
+void HUD::text(float x, float y, const char* string, uint32_t colour)
+{
+    for (; *string != '\0'; string++, x += (cellWidth * scale))
+    {
+        int c = *string;
+        if (c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        if (c == ' ')
+            continue;
+
+        int cell = c >= 32 && c < 96 ? c - 32 : '?' - 32;
+        rectangle(x, y, 3.0f * scale, 5.0f * scale, colour, cell);
+    }
+}
+
+void HUD::graph(float x, float y, const char* label, const float* times, uint32_t colour)
+{
+    text(x, y, label, rgba(255, 255, 255, 255));
+    y += 14.0f;
+
+    // Backdrop with a line at 60 fps
+    float w = 2.0f * historyFrames;
+    rectangle(x, y, w, graphHeight, rgba(255, 255, 255, 24), solidCell);
+    rectangle(x, y + graphHeight * (1.0f - 16.7f / graphTime), w, 1.0f, rgba(255, 255, 255, 96), solidCell);
+
+    // One bar per frame, the oldest on the left
+    unsigned int count = std::min(historyCount, historyFrames);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        float time = times[(historyCount - count + i) % historyFrames];
+        float h = std::max(1.0f, graphHeight * std::min(time / graphTime, 1.0f));
+        uint32_t barColour = time > graphTime ? rgba(255, 64, 64, 255) : colour;
+        rectangle(x + 2.0f * (historyFrames - count + i), y + graphHeight - h, 2.0f, h, barColour, solidCell);
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/glresource.hpp>
+
+// Statistics of a frame shown by the HUD
+struct HUDStats
+{
+    float cpuTime = 0.0f;           // milliseconds
+    float gpuTime = 0.0f;
+    unsigned int drawCalls = 0;
+    unsigned long long triangles = 0;
+    unsigned int stateChanges = 0;
+    unsigned int stateSkips = 0;
+    uint64_t textureBytes = 0;      // resident bytes
+    uint64_t meshBytes = 0;
+    unsigned int shadowMaps = 0;    // in use, zero without shadows
+    float shadowTime = 0.0f;        // milliseconds
+    float shadowHitRate = 0.0f;     // fraction of the maps that were cached
+};
+
+// Performance overlay drawn over the frame. The text uses a baked 3x5 pixel
+// font stored in a small atlas texture, and the quads of the text, the
+// background and the frame time graphs are written into one dynamic vertex
+// buffer and drawn with a single call. Nothing is allocated per frame.
+class HUD
+{
+public:
+    static const unsigned int historyFrames = 120;
+
+    // Create the atlas and the buffers, takes ownership of the program
+    void create(unsigned int program, int width, int height);
+
+    // Add a frame to the graphs and rebuild the quads
+    void update(const HUDStats& stats, float deltaTime);
+
+    // Draw the quads over the bound framebuffer
+    void draw();
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    struct HUDVertex
+    {
+        glm::vec2 position;     // pixels from the top left
+        glm::vec2 uv;
+        uint32_t colour;        // RGBA8
+    };
+
+    static const unsigned int maxVertices = 8192;
+    static const int scale = 2;     // screen pixels per font pixel
+
+    GLProgram program;
+    GLVertexArray VAO;
+    GLBuffer vertexBuffer;
+    GLTexture atlas;
+    int width = 0, height = 0;
+
+    std::vector<HUDVertex> vertices;
+    float cpuTimes[historyFrames] = {};
+    float gpuTimes[historyFrames] = {};
+    unsigned int historyCount = 0;
+    float averageDelta = 0.0f;
+
+    void rectangle(float x, float y, float w, float h, uint32_t colour, int cell);
+    void text(float x, float y, const char* string, uint32_t colour);
+    void graph(float x, float y, const char* label, const float* times, uint32_t colour);
+};
@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <cstring>
+
+#include <common/input.hpp>
+
+// File identification
+static const char inputMagic[8] = { 'C', 'G', 'I', 'N', 'P', 'U', 'T', '\0' };
+static const uint32_t inputVersion = 1;
+
+struct InputHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t frameCount;
+    float timestep;
+};
+
+InputFrame InputLog::poll(GLFWwindow* window, int centreX, int centreY)
+{
+    static const struct { int key; InputButton button; } keys[] =
+    {
+        { GLFW_KEY_W, InputKeyW }, { GLFW_KEY_S, InputKeyS }, { GLFW_KEY_A, InputKeyA }, { GLFW_KEY_D, InputKeyD },
+        { GLFW_KEY_LEFT_SHIFT, InputKeyShift }, { GLFW_KEY_SPACE, InputKeySpace },
+        { GLFW_KEY_ESCAPE, InputKeyEscape }, { GLFW_KEY_F2, InputKeyF2 }, { GLFW_KEY_F3, InputKeyF3 }
+    };
+    static const struct { int mouseButton; InputButton button; } mouseButtons[] =
+    {
+        { GLFW_MOUSE_BUTTON_LEFT, InputMouseLeft }, { GLFW_MOUSE_BUTTON_RIGHT, InputMouseRight },
+        { GLFW_MOUSE_BUTTON_MIDDLE, InputMouseMiddle }
+    };
+
+    InputFrame frame;
+    for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+        if (glfwGetKey(window, keys[i].key) == GLFW_PRESS)
+            frame.buttons |= keys[i].button;
+    for (unsigned int i = 0; i < sizeof(mouseButtons) / sizeof(mouseButtons[0]); i++)
+        if (glfwGetMouseButton(window, mouseButtons[i].mouseButton) == GLFW_PRESS)
+            frame.buttons |= mouseButtons[i].button;
+
+    // Get mouse cursor position and reset to centre
+    double xPos, yPos;
+    glfwGetCursorPos(window, &xPos, &yPos);
+    glfwSetCursorPos(window, centreX, centreY);
+    frame.mouseX = static_cast<float>(xPos - centreX);
+    frame.mouseY = static_cast<float>(yPos - centreY);
+
+    return frame;
+}
+
+bool InputLog::save(const char* path) const
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("Impossible to write the input log %s.\n", path);
+        return false;
+    }
+
+    InputHeader header;
+    memcpy(header.magic, inputMagic, sizeof(inputMagic));
+    header.version = inputVersion;
+    header.frameCount = static_cast<uint32_t>(frames.size());
+    header.timestep = timestep;
+    fwrite(&header, sizeof(header), 1, file);
+    for (unsigned int i = 0; i < frames.size(); i++)
+    {
+        fwrite(&frames[i].buttons, sizeof(uint32_t), 1, file);
+        fwrite(&frames[i].mouseX, sizeof(float), 1, file);
+        fwrite(&frames[i].mouseY, sizeof(float), 1, file);
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+bool InputLog::load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("Impossible to open the input log %s.\n", path);
+        return false;
+    }
+
+    InputHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, inputMagic, sizeof(inputMagic)) != 0 ||
+        header.version != inputVersion)
+    {
+        printf("%s is not an input log.\n", path);
+        fclose(file);
+        return false;
+    }
+
+    timestep = header.timestep;
+    frames.resize(header.frameCount);
+    bool ok = true;
+    for (unsigned int i = 0; i < frames.size() && ok; i++)
+    {
+        ok = fread(&frames[i].buttons, sizeof(uint32_t), 1, file) == 1 &&
+             fread(&frames[i].mouseX, sizeof(float), 1, file) == 1 &&
+             fread(&frames[i].mouseY, sizeof(float), 1, file) == 1;
+    }
+    fclose(file);
+
+    if (!ok)
+        printf("Input log %s is truncated.\n", path);
+    return ok;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <GLFW/glfw3.h>
+
+// Keys and mouse buttons tracked in an input frame
+enum InputButton : uint32_t
+{
+    InputKeyW = 1u << 0,
+    InputKeyS = 1u << 1,
+    InputKeyA = 1u << 2,
+    InputKeyD = 1u << 3,
+    InputKeyShift = 1u << 4,
+    InputKeySpace = 1u << 5,
+    InputKeyEscape = 1u << 6,
+    InputKeyF2 = 1u << 7,
+    InputMouseLeft = 1u << 8,
+    InputMouseRight = 1u << 9,
+    InputMouseMiddle = 1u << 10,
+    InputKeyF3 = 1u << 11
+};
+
+// State of the keys and the mouse movement over one frame
+struct InputFrame
+{
+    uint32_t buttons = 0;
+    float mouseX = 0.0f;        // cursor movement in pixels
+    float mouseY = 0.0f;
+
+    bool down(InputButton button) const { return (buttons & button) != 0; }
+};
+
+// Sequence of input frames that can be recorded and replayed. The binary
+// file is a small header followed by the frames, 12 bytes each.
+class InputLog
+{
+public:
+    float timestep = 1.0f / 60.0f;  // fixed frame time used when replaying
+    std::vector<InputFrame> frames;
+
+    // Read the live input and move the cursor back to the centre of the window
+    static InputFrame poll(GLFWwindow* window, int centreX, int centreY);
+
+    // Binary files
+    bool save(const char* path) const;
+    bool load(const char* path);
+};
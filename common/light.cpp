@@ -1 +1,183 @@
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
 
+#include <common/light.hpp>
+#include <common/glstate.hpp>
+#include <common/profiler.hpp>
+
+Light Light::point(const glm::vec3& position, const glm::vec3& colour, float constant, float linear, float quadratic)
+{
+    Light light;
+    light.position = position;
+    light.colour = colour;
+    light.constant = constant;
+    light.linear = linear;
+    light.quadratic = quadratic;
+    light.type = LightPoint;
+    return light;
+}
+
+Light Light::spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& colour, float phi,
+                  float constant, float linear, float quadratic)
+{
+    Light light = point(position, colour, constant, linear, quadratic);
+    light.direction = glm::normalize(direction);
+    light.cosPhi = std::cos(phi);
+    light.type = LightSpot;
+    return light;
+}
+
+Light Light::directional(const glm::vec3& direction, const glm::vec3& colour)
+{
+    Light light;
+    light.direction = glm::normalize(direction);
+    light.colour = colour;
+    light.type = LightDirectional;
+    return light;
+}
+
+unsigned int LightManager::add(const Light& light)
+{
+    lights.push_back(light);
+    lights.back().range = range(light);
+    markDirty(count() - 1);
+    version++;
+    return count() - 1;
+}
+
+void LightManager::set(unsigned int i, const Light& light)
+{
+    lights[i] = light;
+    lights[i].range = range(light);
+    markDirty(i);
+    version++;
+}
+
+void LightManager::setShadow(unsigned int i, int32_t shadow)
+{
+    if (lights[i].shadow == shadow)
+        return;
+
+    lights[i].shadow = shadow;
+    markDirty(i);
+}
+
+void LightManager::clear()
+{
+    lights.clear();
+    dirtyBegin = dirtyEnd = 0;
+    version++;
+}
+
+void LightManager::markDirty(unsigned int i)
+{
+    // One range covering every edit since the last upload
+    if (dirtyBegin == dirtyEnd)
+    {
+        dirtyBegin = i;
+        dirtyEnd = i + 1;
+    }
+    else
+    {
+        dirtyBegin = std::min(dirtyBegin, i);
+        dirtyEnd = std::max(dirtyEnd, i + 1);
+    }
+}
+
+float LightManager::range(const Light& light)
+{
+    if (light.type == LightDirectional)
+        return FLT_MAX;
+
+    // Solve constant + linear d + quadratic d^2 = brightness / cutoff
+    float brightness = std::max(light.colour.r, std::max(light.colour.g, light.colour.b));
+    float c = light.constant - brightness / cutoff;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic > 0.0f)
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) /
+               (2.0f * light.quadratic);
+    if (light.linear > 0.0f)
+        return -c / light.linear;
+    return FLT_MAX;
+}
+
+Sphere LightManager::sphere(unsigned int i) const
+{
+    return Sphere{ lights[i].position, lights[i].range };
+}
+
+AABB LightManager::bounds(unsigned int i) const
+{
+    if (!bounded(i))
+        return AABB(glm::vec3(-FLT_MAX), glm::vec3(FLT_MAX));
+
+    return AABB(lights[i].position - glm::vec3(lights[i].range), lights[i].position + glm::vec3(lights[i].range));
+}
+
+void LightManager::create()
+{
+    buffer.create("Lights");
+    texture.create("Light buffer texture");
+    capacity = 0;
+    uploadedBytes = 0;
+    uploads = 0;
+    dirtyBegin = 0;
+    dirtyEnd = count();
+    upload();
+
+    // The texture reads the buffer as four RGBA32F texels per light
+    GLState::bindTexture(textureUnit, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+}
+
+void LightManager::release()
+{
+    texture.release();
+    buffer.release();
+    capacity = 0;
+}
+
+bool LightManager::upload()
+{
+    PROFILE_SCOPE("LightManager::upload");
+
+    // Grow the buffer, it always holds the whole uniform block
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (count() > capacity || capacity == 0)
+    {
+        capacity = maxUniformLights;
+        while (capacity < count())
+            capacity *= 2;
+        glBufferData(GL_UNIFORM_BUFFER, capacity * sizeof(Light), nullptr, GL_DYNAMIC_DRAW);
+        buffer.setBytes(capacity * sizeof(Light));
+        dirtyBegin = 0;
+        dirtyEnd = count();
+    }
+
+    if (dirtyBegin == dirtyEnd)
+        return false;
+
+    size_t bytes = (dirtyEnd - dirtyBegin) * sizeof(Light);
+    glBufferSubData(GL_UNIFORM_BUFFER, dirtyBegin * sizeof(Light), bytes, &lights[dirtyBegin]);
+    uploadedBytes += bytes;
+    uploads++;
+    dirtyBegin = dirtyEnd = 0;
+    return true;
+}
+
+void LightManager::setupProgram(unsigned int program)
+{
+    unsigned int block = glGetUniformBlockIndex(program, "Lights");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, uniformBinding);
+    GLState::uniform1i(glGetUniformLocation(program, "lightBuffer"), textureUnit);
+}
+
+void LightManager::bind(unsigned int program) const
+{
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, uniformBinding, buffer);
+    GLState::bindTexture(textureUnit, GL_TEXTURE_BUFFER, texture);
+    GLState::uniform1i(glGetUniformLocation(program, "lightCount"), static_cast<int>(count()));
+}
@@ -1 +1,104 @@
+#pragma once
 
+#include <vector>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+#include <common/glresource.hpp>
+
+// Light types, the values of the type field in the shaders
+enum LightType : int32_t { LightPoint = 1, LightSpot = 2, LightDirectional = 3 };
+
+// Light in the std140 layout of the Light struct of the shaders. Each light
+// is 64 bytes, which is also four RGBA32F texels of the light buffer texture.
+struct Light
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    float constant = 1.0f;
+    glm::vec3 colour = glm::vec3(1.0f);
+    float linear = 0.1f;
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    float quadratic = 0.02f;
+    float cosPhi = 0.0f;            // cosine of the spotlight cone angle
+    int32_t type = LightPoint;
+    float range = 0.0f;             // distance where the light fades out, set by LightManager
+    int32_t shadow = -1;            // first shadow map of the light, set by ShadowMaps, -1 without a shadow
+
+    // Constructors of each type, phi in radians
+    static Light point(const glm::vec3& position, const glm::vec3& colour,
+                       float constant, float linear, float quadratic);
+    static Light spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& colour, float phi,
+                      float constant, float linear, float quadratic);
+    static Light directional(const glm::vec3& direction, const glm::vec3& colour);
+};
+
+static_assert(sizeof(Light) == 64, "Light must match the std140 layout of the shaders");
+
+// Lights of the scene and their copy on the GPU. The lights are stored in one
+// buffer that is both the Lights uniform block, which holds the first
+// maxUniformLights, and a buffer texture that holds all of them, so the count
+// isn't limited by the size of a uniform block. Edits are collected into one
+// dirty range and upload() sends only that range.
+class LightManager
+{
+public:
+    // 64 byte lights in the 16 KB uniform block every GL 3.3 driver supports
+    static const unsigned int maxUniformLights = 256;
+
+    // Uniform block binding and texture unit of the light buffer
+    static const unsigned int uniformBinding = 0;
+    static const unsigned int textureUnit = 8;
+
+    // Fraction of its brightest channel where a light's range ends
+    static constexpr float cutoff = 1.0f / 256.0f;
+
+    // Change counter, bumped by add, set and clear. Shadow assignments don't
+    // move a light and leave it alone.
+    uint64_t version = 0;
+
+    // Upload statistics since create()
+    uint64_t uploadedBytes = 0;
+    unsigned int uploads = 0;
+
+    // Lights, add and set mark the light for the next upload
+    unsigned int add(const Light& light);
+    void set(unsigned int i, const Light& light);
+    const Light& get(unsigned int i) const { return lights[i]; }
+    void setShadow(unsigned int i, int32_t shadow);
+    unsigned int count() const { return static_cast<unsigned int>(lights.size()); }
+    void clear();
+
+    // Bounds for culling, directional lights are unbounded
+    bool bounded(unsigned int i) const { return lights[i].type != LightDirectional; }
+    Sphere sphere(unsigned int i) const;
+    AABB bounds(unsigned int i) const;
+
+    // Distance where the attenuated light drops below the cutoff
+    static float range(const Light& light);
+
+    // GL buffers, the context must be current
+    void create();
+    void release();
+
+    // Send the dirty range, returns false when there was nothing to send
+    bool upload();
+
+    // Point a program at the Lights block and the light buffer texture, once
+    // after linking with the program in use
+    static void setupProgram(unsigned int program);
+
+    // Bind the buffers and set the light count of the program in use
+    void bind(unsigned int program) const;
+
+private:
+    std::vector<Light> lights;
+    unsigned int dirtyBegin = 0, dirtyEnd = 0;
+    unsigned int capacity = 0;      // lights the buffer has room for
+    GLBuffer buffer;
+    GLTexture texture;
+
+    void markDirty(unsigned int i);
+};
@@ -0,0 +1,382 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <common/lightclusters.hpp>
+#include <common/glstate.hpp>
+#include <common/profiler.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define CLUSTERS_SSE
+#include <emmintrin.h>
+#endif
+
+// Entries the light list buffer starts with, it doubles from there
+static const size_t initialListCapacity = 4096;
+
+// Light references a slice reserves room for, past this its list grows
+static const size_t maxSliceReferences = 16384;
+
+LightClusters::LightClusters(ThreadPool& Pool, int Width, int Height) : pool(Pool), width(Width), height(Height)
+{
+    boxes.resize(clusterCount);
+    sliceLists.resize(slices);
+    grid.assign(clusterCount * 2, 0);
+}
+
+void LightClusters::buildBoxes(const Camera& camera)
+{
+    near = camera.near;
+    far = camera.far;
+
+    // Slices are spaced exponentially so clusters stay roughly cubic
+    for (unsigned int z = 0; z <= slices; z++)
+        sliceNear[z] = near * std::pow(far / near, static_cast<float>(z) / slices);
+
+    // The view space extent of an NDC coordinate grows linearly with the
+    // distance, so each box is bounded by its tile at the two slice depths
+    float scaleX = 1.0f / camera.projection[0][0];
+    float scaleY = 1.0f / camera.projection[1][1];
+    for (unsigned int z = 0; z < slices; z++)
+    {
+        float d0 = sliceNear[z], d1 = sliceNear[z + 1];
+        for (unsigned int y = 0; y < tilesY; y++)
+        {
+            float ndcY0 = 2.0f * y / tilesY - 1.0f, ndcY1 = 2.0f * (y + 1) / tilesY - 1.0f;
+            for (unsigned int x = 0; x < tilesX; x++)
+            {
+                float ndcX0 = 2.0f * x / tilesX - 1.0f, ndcX1 = 2.0f * (x + 1) / tilesX - 1.0f;
+                AABB& box = boxes[cluster(x, y, z)];
+                box.min.x = std::min(ndcX0 * d0, ndcX0 * d1) * scaleX;
+                box.max.x = std::max(ndcX1 * d0, ndcX1 * d1) * scaleX;
+                box.min.y = std::min(ndcY0 * d0, ndcY0 * d1) * scaleY;
+                box.max.y = std::max(ndcY1 * d0, ndcY1 * d1) * scaleY;
+                box.min.z = -d1;
+                box.max.z = -d0;
+            }
+        }
+    }
+}
+
+bool LightClusters::build(const Camera& camera, const LightManager& lights)
+{
+    if (built && camera.version() == cameraVersion && lights.version == lightsVersion)
+        return false;
+
+    PROFILE_SCOPE("LightClusters::build");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (!built || camera.projectionVersion != projectionVersion)
+        buildBoxes(camera);
+    built = true;
+    uploaded = false;
+    cameraVersion = camera.version();
+    projectionVersion = camera.projectionVersion;
+    lightsVersion = lights.version;
+
+    // View space spheres of the bounded lights, the others reach every cluster
+    lightX.clear();
+    lightY.clear();
+    lightZ.clear();
+    lightRadius.clear();
+    lightIDs.clear();
+    globals.clear();
+    for (unsigned int i = 0; i < lights.count(); i++)
+    {
+        if (!lights.bounded(i))
+        {
+            globals.push_back(i);
+            continue;
+        }
+
+        Sphere sphere = lights.sphere(i);
+        if (sphere.radius <= 0.0f)
+            continue;
+        glm::vec4 centre = camera.view * glm::vec4(sphere.centre, 1.0f);
+        lightX.push_back(centre.x);
+        lightY.push_back(centre.y);
+        lightZ.push_back(centre.z);
+        lightRadius.push_back(sphere.radius);
+        lightIDs.push_back(i);
+    }
+
+    // Room for every light in each slice, so the binning only allocates when
+    // the number of lights changes and not when the camera moves
+    if (lightIDs.size() != reservedLights)
+    {
+        reservedLights = lightIDs.size();
+        size_t padded = (reservedLights + 3) & ~static_cast<size_t>(3);
+        size_t references = std::min(tilesX * tilesY * padded, maxSliceReferences);
+        for (Slice& slice : sliceLists)
+        {
+            for (std::vector<float>* values : { &slice.x, &slice.y, &slice.z, &slice.radius2,
+                                                &slice.rowX, &slice.rowY, &slice.rowZ, &slice.rowRadius2 })
+                values->reserve(padded);
+            slice.candidates.reserve(padded);
+            slice.rowCandidates.reserve(padded);
+            slice.lights.reserve(references);
+        }
+        lists.reserve(lights.count() + slices * references);
+    }
+
+    // Bin each slice on its own, the lists are joined afterwards
+    if (parallel)
+        pool.parallelFor(slices, [this](unsigned int z) { binSlice(z); });
+    else
+        for (unsigned int z = 0; z < slices; z++)
+            binSlice(z);
+
+    lists.assign(globals.begin(), globals.end());
+    stats.lights = static_cast<unsigned int>(lightIDs.size());
+    stats.references = 0;
+    stats.maxLights = 0;
+    for (unsigned int z = 0; z < slices; z++)
+    {
+        const Slice& slice = sliceLists[z];
+        uint32_t base = static_cast<uint32_t>(lists.size());
+        for (unsigned int tile = 0; tile < tilesX * tilesY; tile++)
+        {
+            unsigned int c = z * tilesX * tilesY + tile;
+            grid[2 * c] = base + slice.offsets[tile];
+            grid[2 * c + 1] = slice.counts[tile];
+            stats.maxLights = std::max(stats.maxLights, slice.counts[tile]);
+        }
+        lists.insert(lists.end(), slice.lights.begin(), slice.lights.end());
+        stats.references += static_cast<unsigned int>(slice.lights.size());
+    }
+    stats.builds++;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.binTime = std::chrono::duration<float, std::milli>(end - start).count();
+    return true;
+}
+
+void LightClusters::binSlice(unsigned int z)
+{
+    Slice& slice = sliceLists[z];
+    slice.lights.clear();
+
+    // Lights that reach the depth range of the slice, padded to a multiple of
+    // four with spheres that can't touch a box
+    float z0 = -sliceNear[z + 1], z1 = -sliceNear[z];
+    slice.x.clear();
+    slice.y.clear();
+    slice.z.clear();
+    slice.radius2.clear();
+    slice.candidates.clear();
+    for (size_t i = 0; i < lightIDs.size(); i++)
+    {
+        float r = lightRadius[i];
+        if (lightZ[i] - r > z1 || lightZ[i] + r < z0)
+            continue;
+        slice.x.push_back(lightX[i]);
+        slice.y.push_back(lightY[i]);
+        slice.z.push_back(lightZ[i]);
+        slice.radius2.push_back(r * r);
+        slice.candidates.push_back(lightIDs[i]);
+    }
+    while (slice.x.size() % 4 != 0)
+    {
+        slice.x.push_back(0.0f);
+        slice.y.push_back(0.0f);
+        slice.z.push_back(0.0f);
+        slice.radius2.push_back(-1.0f);
+        slice.candidates.push_back(0);
+    }
+
+    for (unsigned int row = 0; row < tilesY; row++)
+    {
+        // The boxes of a row share their y and z extents, so the lights that
+        // reach the row are found once and gathered into padded arrays
+        const AABB& rowBox = boxes[cluster(0, row, z)];
+        std::vector<float>& x = slice.rowX;
+        std::vector<float>& y = slice.rowY;
+        std::vector<float>& zs = slice.rowZ;
+        std::vector<float>& r2 = slice.rowRadius2;
+        std::vector<uint32_t>& ids = slice.rowCandidates;
+        x.clear();
+        y.clear();
+        zs.clear();
+        r2.clear();
+        ids.clear();
+        auto gather = [&](size_t i)
+        {
+            x.push_back(slice.x[i]);
+            y.push_back(slice.y[i]);
+            zs.push_back(slice.z[i]);
+            r2.push_back(slice.radius2[i]);
+            ids.push_back(slice.candidates[i]);
+        };
+#ifdef CLUSTERS_SSE
+        if (simd)
+        {
+            __m128 minY = _mm_set1_ps(rowBox.min.y), maxY = _mm_set1_ps(rowBox.max.y);
+            __m128 minZ = _mm_set1_ps(rowBox.min.z), maxZ = _mm_set1_ps(rowBox.max.z);
+            __m128 zero = _mm_setzero_ps();
+            for (size_t i = 0; i < slice.candidates.size(); i += 4)
+            {
+                __m128 cy = _mm_loadu_ps(&slice.y[i]), cz = _mm_loadu_ps(&slice.z[i]);
+                __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, cy), _mm_sub_ps(cy, maxY)), zero);
+                __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, cz), _mm_sub_ps(cz, maxZ)), zero);
+                __m128 d2 = _mm_add_ps(_mm_mul_ps(dy, dy), _mm_mul_ps(dz, dz));
+                int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&slice.radius2[i])));
+                if (mask == 0)
+                    continue;
+                for (int lane = 0; lane < 4; lane++)
+                    if (mask & (1 << lane))
+                        gather(i + lane);
+            }
+        }
+        else
+#endif
+        {
+            for (size_t i = 0; i < slice.candidates.size(); i++)
+            {
+                float dy = std::max(std::max(rowBox.min.y - slice.y[i], slice.y[i] - rowBox.max.y), 0.0f);
+                float dz = std::max(std::max(rowBox.min.z - slice.z[i], slice.z[i] - rowBox.max.z), 0.0f);
+                if (dy * dy + dz * dz <= slice.radius2[i])
+                    gather(i);
+            }
+        }
+        while (x.size() % 4 != 0)
+        {
+            x.push_back(0.0f);
+            y.push_back(0.0f);
+            zs.push_back(0.0f);
+            r2.push_back(-1.0f);
+            ids.push_back(0);
+        }
+
+        for (unsigned int column = 0; column < tilesX; column++)
+        {
+            unsigned int tile = row * tilesX + column;
+            const AABB& box = boxes[z * tilesX * tilesY + tile];
+            slice.offsets[tile] = static_cast<uint32_t>(slice.lights.size());
+
+            // Squared distance from each centre to the box against the radius
+            // squared, four lights at a time
+            size_t count = x.size();
+#ifdef CLUSTERS_SSE
+            if (simd)
+            {
+                __m128 minX = _mm_set1_ps(box.min.x), maxX = _mm_set1_ps(box.max.x);
+                __m128 minY = _mm_set1_ps(box.min.y), maxY = _mm_set1_ps(box.max.y);
+                __m128 minZ = _mm_set1_ps(box.min.z), maxZ = _mm_set1_ps(box.max.z);
+                __m128 zero = _mm_setzero_ps();
+                for (size_t i = 0; i < count; i += 4)
+                {
+                    __m128 cx = _mm_loadu_ps(&x[i]), cy = _mm_loadu_ps(&y[i]), cz = _mm_loadu_ps(&zs[i]);
+                    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, cx), _mm_sub_ps(cx, maxX)), zero);
+                    __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, cy), _mm_sub_ps(cy, maxY)), zero);
+                    __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, cz), _mm_sub_ps(cz, maxZ)), zero);
+                    __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                    int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&r2[i])));
+                    if (mask == 0)
+                        continue;
+                    for (int lane = 0; lane < 4; lane++)
+                        if (mask & (1 << lane))
+                            slice.lights.push_back(ids[i + lane]);
+                }
+            }
+            else
+#endif
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    float dx = std::max(std::max(box.min.x - x[i], x[i] - box.max.x), 0.0f);
+                    float dy = std::max(std::max(box.min.y - y[i], y[i] - box.max.y), 0.0f);
+                    float dz = std::max(std::max(box.min.z - zs[i], zs[i] - box.max.z), 0.0f);
+                    if (dx * dx + dy * dy + dz * dz <= r2[i])
+                        slice.lights.push_back(ids[i]);
+                }
+            }
+
+            slice.counts[tile] = static_cast<uint32_t>(slice.lights.size()) - slice.offsets[tile];
+        }
+    }
+}
+
+const uint32_t* LightClusters::clusterLights(unsigned int c, unsigned int& count) const
+{
+    count = grid[2 * c + 1];
+    return lists.data() + grid[2 * c];
+}
+
+void LightClusters::create()
+{
+    gridBuffer.create("Light cluster grid");
+    listBuffer.create("Light cluster lists");
+    gridTexture.create("Light cluster grid texture");
+    listTexture.create("Light cluster lists texture");
+    stats = LightClusterStats();
+    built = false;
+    uploaded = true;
+
+    // Each cluster is an (offset, count) pair, the grid never changes size
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(uint32_t), grid.data(), GL_DYNAMIC_DRAW);
+    gridBuffer.setBytes(grid.size() * sizeof(uint32_t));
+    GLState::bindTexture(gridUnit, GL_TEXTURE_BUFFER, gridTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridBuffer);
+
+    listCapacity = initialListCapacity;
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, listBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, listCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    listBuffer.setBytes(listCapacity * sizeof(uint32_t));
+    GLState::bindTexture(listUnit, GL_TEXTURE_BUFFER, listTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, listBuffer);
+}
+
+void LightClusters::release()
+{
+    listTexture.release();
+    gridTexture.release();
+    listBuffer.release();
+    gridBuffer.release();
+    listCapacity = 0;
+}
+
+void LightClusters::upload()
+{
+    if (uploaded)
+        return;
+
+    PROFILE_SCOPE("LightClusters::upload");
+    uploaded = true;
+
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, grid.size() * sizeof(uint32_t), grid.data());
+
+    // Grow the list buffer, the texture keeps pointing at the same buffer
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, listBuffer);
+    if (lists.size() > listCapacity)
+    {
+        while (listCapacity < lists.size())
+            listCapacity *= 2;
+        glBufferData(GL_TEXTURE_BUFFER, listCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+        listBuffer.setBytes(listCapacity * sizeof(uint32_t));
+    }
+    if (!lists.empty())
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, lists.size() * sizeof(uint32_t), lists.data());
+}
+
+void LightClusters::setupProgram(unsigned int program)
+{
+    GLState::uniform1i(glGetUniformLocation(program, "clusterGrid"), gridUnit);
+    GLState::uniform1i(glGetUniformLocation(program, "clusterLights"), listUnit);
+}
+
+void LightClusters::bind(unsigned int program) const
+{
+    GLState::bindTexture(gridUnit, GL_TEXTURE_BUFFER, gridTexture);
+    GLState::bindTexture(listUnit, GL_TEXTURE_BUFFER, listTexture);
+    GLState::uniform1i(glGetUniformLocation(program, "clustered"), 1);
+    GLState::uniform1i(glGetUniformLocation(program, "clusterTilesX"), tilesX);
+    GLState::uniform1i(glGetUniformLocation(program, "clusterTilesY"), tilesY);
+    GLState::uniform1i(glGetUniformLocation(program, "clusterSlices"), slices);
+    GLState::uniform1f(glGetUniformLocation(program, "clusterTileWidth"), static_cast<float>(width) / tilesX);
+    GLState::uniform1f(glGetUniformLocation(program, "clusterTileHeight"), static_cast<float>(height) / tilesY);
+    GLState::uniform1f(glGetUniformLocation(program, "clusterNear"), near);
+    GLState::uniform1f(glGetUniformLocation(program, "clusterFar"), far);
+    GLState::uniform1i(glGetUniformLocation(program, "clusterGlobalCount"), static_cast<int>(globals.size()));
+}
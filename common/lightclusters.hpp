@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+#include <common/camera.hpp>
+#include <common/light.hpp>
+#include <common/threadpool.hpp>
+#include <common/glresource.hpp>
+
+// Statistics of the last build, times are in milliseconds
+struct LightClusterStats
+{
+    unsigned int lights = 0;        // bounded lights binned
+    unsigned int references = 0;    // light references over all clusters
+    unsigned int maxLights = 0;     // most lights in one cluster
+    unsigned int builds = 0;        // builds since create, skipped ones aren't counted
+    float binTime = 0.0f;
+
+    float averageLights(unsigned int clusters) const { return clusters > 0 ? static_cast<float>(references) / clusters : 0.0f; }
+};
+
+// Light lists for clustered forward shading. The view frustum is split into
+// screen tiles and depth slices spaced exponentially between the near and
+// far planes, and the bounding sphere of each light is tested against the
+// view space box of every cluster in the depth slices it reaches. Slices are
+// binned in parallel, four lights at a time with SSE. The grid of (offset,
+// count) pairs and the concatenated light lists go to the GPU as buffer
+// textures, directional lights reach every cluster and are stored once at
+// the start of the lists.
+class LightClusters
+{
+public:
+    static const unsigned int tilesX = 16;
+    static const unsigned int tilesY = 12;
+    static const unsigned int slices = 24;
+    static const unsigned int clusterCount = tilesX * tilesY * slices;
+
+    // Texture units of the grid and the light lists
+    static const unsigned int gridUnit = 9;
+    static const unsigned int listUnit = 10;
+
+    // Statistics of the last build
+    LightClusterStats stats;
+
+    // Binning options, both on by default
+    bool parallel = true;
+    bool simd = true;
+
+    // Constructor, the size is the viewport in pixels
+    LightClusters(ThreadPool& pool, int width = 1024, int height = 768);
+
+    // Bin the lights into the clusters of the camera, nothing is done when
+    // neither has changed since the last build. Returns whether it rebuilt.
+    bool build(const Camera& camera, const LightManager& lights);
+
+    // GL buffers, the context must be current
+    void create();
+    void release();
+
+    // Send the lists of the last build, once per build
+    void upload();
+
+    // Point a program at the buffer textures, once after linking with the
+    // program in use. Also needed when the lights aren't clustered so the
+    // samplers don't share a unit with the textures.
+    static void setupProgram(unsigned int program);
+
+    // Bind the buffer textures and set the cluster uniforms of the program in use
+    void bind(unsigned int program) const;
+
+    // Cluster index of a tile and slice, and the lights of a cluster
+    static unsigned int cluster(unsigned int x, unsigned int y, unsigned int z) { return (z * tilesY + y) * tilesX + x; }
+    const uint32_t* clusterLights(unsigned int cluster, unsigned int& count) const;
+    unsigned int globalLights() const { return static_cast<unsigned int>(globals.size()); }
+
+private:
+    ThreadPool& pool;
+    int width, height;
+
+    // Versions of the inputs of the last build
+    uint64_t cameraVersion = 0, projectionVersion = 0, lightsVersion = 0;
+    bool built = false, uploaded = true;
+    float near = 0.0f, far = 0.0f;
+
+    // View space boxes of the clusters, rebuilt with the projection
+    std::vector<AABB> boxes;
+    float sliceNear[slices + 1];
+
+    // View space bounding spheres of the bounded lights
+    std::vector<float> lightX, lightY, lightZ, lightRadius;
+    std::vector<uint32_t> lightIDs;
+    std::vector<uint32_t> globals;
+    size_t reservedLights = ~static_cast<size_t>(0);     // bounded lights the slices have room for
+
+    // Per slice lists and the candidates of the slice and of the tile row
+    // being binned, written by one job each
+    struct Slice
+    {
+        std::vector<float> x, y, z, radius2;
+        std::vector<uint32_t> candidates;
+        std::vector<float> rowX, rowY, rowZ, rowRadius2;
+        std::vector<uint32_t> rowCandidates;
+        std::vector<uint32_t> lights;
+        uint32_t offsets[tilesX * tilesY];
+        uint32_t counts[tilesX * tilesY];
+    };
+    std::vector<Slice> sliceLists;
+
+    // Grid of (offset, count) pairs and the concatenated lists
+    std::vector<uint32_t> grid;
+    std::vector<uint32_t> lists;
+
+    GLBuffer gridBuffer, listBuffer;
+    GLTexture gridTexture, listTexture;
+    size_t listCapacity = 0;
+
+    void buildBoxes(const Camera& camera);
+    void binSlice(unsigned int z);
+};
@@ -0,0 +1,490 @@
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+#include <common/lightmap.hpp>
+#include <common/maths.hpp>
+#include <common/glstate.hpp>
+#include <common/profiler.hpp>
+
+static const char lightmapMagic[8] = { 'C', 'G', 'L', 'M', 'A', 'P', '\0', '\0' };
+static const uint32_t lightmapVersion = 1;
+
+struct LightmapHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t chunkCount;
+    uint64_t sceneHash;
+};
+
+// Distance the rays start off the faces, world units
+static const float rayOffset = 0.01f;
+
+// FNV-1a, the cache keys only need to tell inputs apart
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+static const uint64_t hashSeed = 14695981039346656037ull;
+
+// Bit reversed index, the second coordinate of the Hammersley points
+static float radicalInverse(uint32_t bits)
+{
+    bits = (bits << 16) | (bits >> 16);
+    bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+    bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+    bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+    bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+    return static_cast<float>(bits) * 2.3283064365386963e-10f;
+}
+
+// Integer hash spreading the texel index over the rotations of the points
+static uint32_t hashTexel(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t packTexel(const glm::vec3& colour, float alpha)
+{
+    glm::vec3 c = glm::clamp(colour, 0.0f, 1.0f) * 255.0f + 0.5f;
+    uint32_t a = static_cast<uint32_t>(glm::clamp(alpha, 0.0f, 1.0f) * 255.0f + 0.5f);
+    return static_cast<uint32_t>(c.r) | (static_cast<uint32_t>(c.g) << 8) | (static_cast<uint32_t>(c.b) << 16) | (a << 24);
+}
+
+LightmapBaker::LightmapBaker(ThreadPool& Pool) : pool(Pool)
+{
+}
+
+void LightmapBaker::setLights(const std::vector<Light>& Lights)
+{
+    lights = Lights;
+    for (Light& light : lights)
+        light.range = LightManager::range(light);
+    cache.clear();
+}
+
+const ChunkLightmap* LightmapBaker::find(unsigned long long key) const
+{
+    auto it = cache.find(key);
+    return it != cache.end() ? &it->second : nullptr;
+}
+
+bool LightmapBaker::affected(const AABB& chunk, const AABB& box) const
+{
+    // The ambient rays of the chunk reach the box
+    AABB reach(chunk.min - glm::vec3(aoDistance), chunk.max + glm::vec3(aoDistance));
+    if (Bounds::intersects(reach, box))
+        return true;
+
+    for (const Light& light : lights)
+    {
+        if (light.type == LightDirectional)
+        {
+            // The chunk swept towards the light hits the box when a ray from
+            // the origin hits the box grown by the chunk
+            AABB grown(box.min - chunk.max, box.max - chunk.min);
+            float distance;
+            if (Bounds::intersects(Ray(glm::vec3(0.0f), -light.direction), grown, shadowDistance, distance))
+                return true;
+        }
+        else if (Bounds::intersects(Sphere{ light.position, light.range }, chunk))
+        {
+            // The shadow rays stay in the box around the chunk and the light
+            AABB swept = chunk;
+            swept.expand(light.position);
+            if (Bounds::intersects(swept, box))
+                return true;
+        }
+    }
+    return false;
+}
+
+void LightmapBaker::invalidate(const AABB& box)
+{
+    if (!box.isValid())
+        return;
+
+    for (auto it = cache.begin(); it != cache.end();)
+    {
+        if (affected(it->second.bounds, box))
+            it = cache.erase(it);
+        else
+            ++it;
+    }
+}
+
+uint64_t LightmapBaker::layoutHash(const std::vector<LightmapFace>& faces)
+{
+    return faces.empty() ? hashSeed : hashBytes(hashSeed, &faces[0], faces.size() * sizeof(LightmapFace));
+}
+
+uint64_t LightmapBaker::sceneHash(const VoxelWorld& world) const
+{
+    // Chunks in key order so the hash doesn't depend on the map
+    std::vector<unsigned long long> keys;
+    for (auto it = world.chunks.begin(); it != world.chunks.end(); ++it)
+        keys.push_back(it->first);
+    std::sort(keys.begin(), keys.end());
+
+    uint64_t hash = hashSeed;
+    for (unsigned long long key : keys)
+    {
+        const Chunk& chunk = world.chunks.at(key);
+        hash = hashBytes(hash, &key, sizeof(key));
+        hash = hashBytes(hash, chunk.blocks, sizeof(chunk.blocks));
+    }
+    for (const BlockType& type : world.blockTypes)
+        hash = hashBytes(hash, &type.opaque, sizeof(type.opaque));
+    if (!lights.empty())
+        hash = hashBytes(hash, &lights[0], lights.size() * sizeof(Light));
+    hash = hashBytes(hash, &aoRays, sizeof(aoRays));
+    hash = hashBytes(hash, &aoDistance, sizeof(aoDistance));
+    hash = hashBytes(hash, &ambient, sizeof(ambient));
+    hash = hashBytes(hash, &world.blockSize, sizeof(world.blockSize));
+    const int texels = VoxelWorld::lightmapTexels;
+    return hashBytes(hash, &texels, sizeof(texels));
+}
+
+void LightmapBaker::buildBVH(const VoxelWorld& world)
+{
+    // Only the opaque blocks next to a block light can pass through can be hit
+    static const glm::ivec3 neighbours[6] = {
+        glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 1, 0),
+        glm::ivec3(0, -1, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+    };
+    std::vector<AABB> boxes;
+    AABB bounds;
+    glm::vec3 half(0.5f * world.blockSize);
+    for (auto it = world.chunks.begin(); it != world.chunks.end(); ++it)
+    {
+        const Chunk& chunk = it->second;
+        glm::ivec3 base = chunk.coord * Chunk::size;
+        for (int z = 0; z < Chunk::size; z++)
+            for (int y = 0; y < Chunk::size; y++)
+                for (int x = 0; x < Chunk::size; x++)
+                {
+                    BlockID id = chunk.get(x, y, z);
+                    if (id == 0 || !world.blockTypes[id].opaque)
+                        continue;
+
+                    glm::ivec3 block = base + glm::ivec3(x, y, z);
+                    bool surface = false;
+                    for (int n = 0; n < 6 && !surface; n++)
+                    {
+                        BlockID neighbour = world.getBlock(block + neighbours[n]);
+                        surface = neighbour == 0 || !world.blockTypes[neighbour].opaque;
+                    }
+                    if (!surface)
+                        continue;
+
+                    glm::vec3 centre = glm::vec3(block) * world.blockSize;
+                    boxes.push_back(AABB(centre - half, centre + half));
+                    bounds.expand(boxes.back());
+                }
+    }
+
+    bvh.clear();
+    bvh.build(boxes);
+    stats.blocks = static_cast<unsigned int>(boxes.size());
+    shadowDistance = bounds.isValid() ? 2.0f * glm::length(bounds.extent()) + world.blockSize : 0.0f;
+}
+
+void LightmapBaker::bakeFace(const LightmapTarget& target, const std::vector<unsigned int>& faceLights,
+                             const LightmapFace& face, std::vector<uint32_t>& texels, std::vector<int>& stack,
+                             uint64_t& rays) const
+{
+    const int width = VoxelWorld::lightmapWidth;
+    glm::vec3 tangent = glm::normalize(face.u), bitangent = glm::normalize(face.v);
+    uint32_t seed = hashTexel(static_cast<uint32_t>(target.key) ^ static_cast<uint32_t>(face.y * width + face.x));
+
+    for (int j = 0; j < face.height; j++)
+    {
+        for (int i = 0; i < face.width; i++)
+        {
+            glm::vec3 position = face.origin + (i + 0.5f) * face.u + (j + 0.5f) * face.v;
+            glm::vec3 origin = position + rayOffset * face.normal;
+
+            // Ambient occlusion, Hammersley points rotated per texel mapped
+            // to cosine weighted directions
+            uint32_t rotation = hashTexel(seed + static_cast<uint32_t>(j * face.width + i));
+            float rotateU = static_cast<float>(rotation & 0xFFFF) / 65536.0f;
+            float rotateV = static_cast<float>(rotation >> 16) / 65536.0f;
+            unsigned int hits = 0;
+            for (unsigned int k = 0; k < aoRays; k++)
+            {
+                float u = std::fmod((k + 0.5f) / aoRays + rotateU, 1.0f);
+                float v = std::fmod(radicalInverse(k) + rotateV, 1.0f);
+                float r = std::sqrt(u), phi = 2.0f * Maths::pi * v;
+                glm::vec3 direction = r * std::cos(phi) * tangent + r * std::sin(phi) * bitangent +
+                                      std::sqrt(std::max(1.0f - u, 0.0f)) * face.normal;
+                if (bvh.occluded(Ray(origin, direction), aoDistance, stack))
+                    hits++;
+            }
+            float occlusion = 1.0f - static_cast<float>(hits) / std::max(aoRays, 1u);
+            rays += aoRays;
+
+            // Direct light, shaded like the diffuse term of the lit shader
+            glm::vec3 irradiance = ambient * occlusion;
+            for (unsigned int l : faceLights)
+            {
+                const Light& light = lights[l];
+                glm::vec3 toLight;
+                float distance, attenuation = 1.0f;
+                if (light.type == LightDirectional)
+                {
+                    toLight = -light.direction;
+                    distance = shadowDistance;
+                }
+                else
+                {
+                    toLight = light.position - position;
+                    distance = glm::length(toLight);
+                    if (distance > light.range || distance <= 0.0f)
+                        continue;
+                    toLight /= distance;
+                    attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+                    if (light.type == LightSpot)
+                        attenuation *= glm::clamp((glm::dot(-toLight, light.direction) - light.cosPhi) / Maths::radians(2.0f),
+                                                  0.0f, 1.0f);
+                }
+
+                float cosTheta = glm::dot(face.normal, toLight);
+                if (cosTheta <= 0.0f || attenuation <= 0.0f)
+                    continue;
+                rays++;
+                if (!bvh.occluded(Ray(origin, toLight), distance - rayOffset, stack))
+                    irradiance += light.colour * cosTheta * attenuation;
+            }
+
+            texels[(face.y + 1 + j) * width + face.x + 1 + i] = packTexel(irradiance * scale, occlusion);
+        }
+    }
+
+    // Copy the edges into the border so filtering doesn't blend in other faces
+    for (int j = 0; j < face.height; j++)
+    {
+        uint32_t* row = &texels[(face.y + 1 + j) * width + face.x];
+        row[0] = row[1];
+        row[face.width + 1] = row[face.width];
+    }
+    uint32_t* first = &texels[face.y * width + face.x];
+    uint32_t* last = &texels[(face.y + face.height + 1) * width + face.x];
+    std::copy(first + width, first + width + face.width + 2, first);
+    std::copy(last - width, last - width + face.width + 2, last);
+}
+
+void LightmapBaker::bake(const VoxelWorld& world, const std::vector<LightmapTarget>& targets)
+{
+    PROFILE_SCOPE("LightmapBaker::bake");
+    auto start = std::chrono::high_resolution_clock::now();
+    stats.chunks = static_cast<unsigned int>(targets.size());
+    stats.texels = 0;
+    stats.rays = 0;
+    if (targets.empty())
+    {
+        stats.bakeTime = 0.0f;
+        return;
+    }
+
+    // The blocks may have changed since the last bake
+    buildBVH(world);
+
+    // Lights reaching each chunk and one job per face
+    jobs.clear();
+    targetLights.resize(targets.size());
+    for (unsigned int t = 0; t < targets.size(); t++)
+    {
+        const LightmapTarget& target = targets[t];
+        targetLights[t].clear();
+        for (unsigned int l = 0; l < lights.size(); l++)
+        {
+            if (lights[l].type == LightDirectional || Bounds::intersects(Sphere{ lights[l].position, lights[l].range }, target.bounds))
+                targetLights[t].push_back(l);
+        }
+
+        ChunkLightmap& lightmap = cache[target.key];
+        lightmap.bounds = target.bounds;
+        lightmap.layout = layoutHash(*target.faces);
+        lightmap.height = target.height;
+        lightmap.texels.assign(static_cast<size_t>(VoxelWorld::lightmapWidth) * target.height, 0u);
+        for (unsigned int f = 0; f < target.faces->size(); f++)
+        {
+            jobs.push_back(FaceJob{ t, f });
+            stats.texels += (*target.faces)[f].width * (*target.faces)[f].height;
+        }
+    }
+
+    // The faces write to separate rectangles of the lightmaps
+    std::atomic<uint64_t> rays(0);
+    auto bakeJob = [&](unsigned int i)
+    {
+        const FaceJob& job = jobs[i];
+        const LightmapTarget& target = targets[job.target];
+        std::vector<int> stack;
+        stack.reserve(64);
+        uint64_t faceRays = 0;
+        bakeFace(target, targetLights[job.target], (*target.faces)[job.face], cache.find(target.key)->second.texels,
+                 stack, faceRays);
+        rays += faceRays;
+    };
+    if (parallel)
+        pool.parallelFor(static_cast<unsigned int>(jobs.size()), bakeJob);
+    else
+        for (unsigned int i = 0; i < jobs.size(); i++)
+            bakeJob(i);
+    stats.rays = rays.load();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.bakeTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+unsigned int LightmapBaker::update(const VoxelWorld& world, VoxelRenderer& renderer)
+{
+    // Chunks with a new mesh, or whose lightmap was dropped by an edit. A
+    // cached lightmap baked for the same faces is used as it is.
+    stats.cached = 0;
+    pending.clear();
+    for (auto it = renderer.chunks.begin(); it != renderer.chunks.end(); ++it)
+    {
+        ChunkBuffers& chunk = it->second;
+        if (chunk.lightmapFaces.empty())
+            continue;
+
+        auto cached = cache.find(it->first);
+        if (cached != cache.end() && chunk.lightmapped)
+            continue;
+        if (cached != cache.end() && cached->second.layout == layoutHash(chunk.lightmapFaces))
+            stats.cached++;
+        else
+            pending.push_back(LightmapTarget{ it->first, chunk.bounds, &chunk.lightmapFaces, chunk.lightmapHeight });
+        chunk.lightmapped = false;
+    }
+    if (!pending.empty())
+        bake(world, pending);
+    else
+        stats.chunks = 0;
+
+    // Upload every lightmap that isn't drawn yet
+    for (auto it = renderer.chunks.begin(); it != renderer.chunks.end(); ++it)
+    {
+        ChunkBuffers& chunk = it->second;
+        if (chunk.lightmapped || chunk.lightmapFaces.empty())
+            continue;
+
+        const ChunkLightmap& lightmap = cache[it->first];
+        if (chunk.lightmap == 0)
+            chunk.lightmap.create("Chunk lightmap");
+        GLState::bindTexture(textureUnit, GL_TEXTURE_2D, chunk.lightmap);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, VoxelWorld::lightmapWidth, lightmap.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     &lightmap.texels[0]);
+        chunk.lightmap.setBytes(GLResourceTracker::textureBytes(VoxelWorld::lightmapWidth, lightmap.height, 1, 4, false));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        chunk.lightmapped = true;
+    }
+    return static_cast<unsigned int>(pending.size());
+}
+
+bool LightmapBaker::save(const char* path, const VoxelWorld& world) const
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("Impossible to write the lightmap cache %s.\n", path);
+        return false;
+    }
+
+    LightmapHeader header;
+    memcpy(header.magic, lightmapMagic, sizeof(lightmapMagic));
+    header.version = lightmapVersion;
+    header.chunkCount = static_cast<uint32_t>(cache.size());
+    header.sceneHash = sceneHash(world);
+    fwrite(&header, sizeof(header), 1, file);
+    for (auto it = cache.begin(); it != cache.end(); ++it)
+    {
+        const ChunkLightmap& lightmap = it->second;
+        int32_t height = lightmap.height;
+        fwrite(&it->first, sizeof(it->first), 1, file);
+        fwrite(&lightmap.bounds, sizeof(lightmap.bounds), 1, file);
+        fwrite(&lightmap.layout, sizeof(lightmap.layout), 1, file);
+        fwrite(&height, sizeof(height), 1, file);
+        fwrite(lightmap.texels.data(), sizeof(uint32_t), lightmap.texels.size(), file);
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+bool LightmapBaker::load(const char* path, const VoxelWorld& world)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    LightmapHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, lightmapMagic, sizeof(lightmapMagic)) != 0 ||
+        header.version != lightmapVersion)
+    {
+        printf("%s is not a lightmap cache.\n", path);
+        fclose(file);
+        return false;
+    }
+    if (header.sceneHash != sceneHash(world))
+    {
+        printf("Lightmap cache %s was baked from other blocks or lights.\n", path);
+        fclose(file);
+        return false;
+    }
+
+    // Size of the file, a chunk can't have more rows than the bytes left
+    // hold so a corrupt height isn't allocated
+    long start = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, start, SEEK_SET);
+    const long rowSize = static_cast<long>(VoxelWorld::lightmapWidth * sizeof(uint32_t));
+
+    cache.clear();
+    bool ok = true;
+    for (uint32_t i = 0; i < header.chunkCount && ok; i++)
+    {
+        unsigned long long key;
+        int32_t height;
+        ChunkLightmap lightmap;
+        ok = fread(&key, sizeof(key), 1, file) == 1 && fread(&lightmap.bounds, sizeof(lightmap.bounds), 1, file) == 1 &&
+             fread(&lightmap.layout, sizeof(lightmap.layout), 1, file) == 1 && fread(&height, sizeof(height), 1, file) == 1 &&
+             height >= 0 && height <= (size - ftell(file)) / rowSize;
+        if (!ok)
+            break;
+
+        lightmap.height = height;
+        lightmap.texels.resize(static_cast<size_t>(VoxelWorld::lightmapWidth) * height);
+        ok = lightmap.texels.empty() ||
+             fread(lightmap.texels.data(), sizeof(uint32_t), lightmap.texels.size(), file) == lightmap.texels.size();
+        if (ok)
+            cache[key] = std::move(lightmap);
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        printf("Lightmap cache %s is truncated.\n", path);
+        cache.clear();
+    }
+    return ok;
+}
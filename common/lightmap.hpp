@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+#include <common/bvh.hpp>
+#include <common/light.hpp>
+#include <common/voxel.hpp>
+#include <common/voxelrenderer.hpp>
+#include <common/threadpool.hpp>
+
+// Statistics of the last bake, times are in milliseconds
+struct LightmapStats
+{
+    unsigned int chunks = 0;        // chunks traced
+    unsigned int cached = 0;        // chunks taken from the cache
+    unsigned int blocks = 0;        // surface blocks in the BVH
+    uint64_t texels = 0;
+    uint64_t rays = 0;
+    float bakeTime = 0.0f;
+};
+
+// Chunk to bake, the faces of its mesh
+struct LightmapTarget
+{
+    unsigned long long key;
+    AABB bounds;
+    const std::vector<LightmapFace>* faces;
+    int height;
+};
+
+// Baked lightmap of a chunk, RGBA8 texels of VoxelWorld::lightmapWidth by
+// height. The colour is the irradiance divided by LightmapBaker::scale, the
+// alpha the ambient occlusion.
+struct ChunkLightmap
+{
+    AABB bounds;
+    uint64_t layout = 0;            // hash of the faces it was baked for
+    int height = 0;
+    std::vector<uint32_t> texels;
+};
+
+// Bakes the lighting of the static blocks into one lightmap per chunk. The
+// faces are traced on the worker threads against a BVH over the boxes of the
+// opaque blocks on the surface, a box standing in for the twelve triangles
+// of its cube. Each light in range is tested with a shadow ray and the
+// ambient light is occluded by cosine weighted rays over the hemisphere.
+// Lightmaps are cached by chunk, an edit drops the ones it can reach, and the
+// cache can be saved to skip the bake while the blocks and lights are the same.
+class LightmapBaker
+{
+public:
+    // Lightmap value of an irradiance of one
+    static constexpr float scale = 0.5f;
+
+    // Texture unit of the lightmap in the voxel shader
+    static const unsigned int textureUnit = 1;
+
+    // Bake settings
+    unsigned int aoRays = 32;
+    float aoDistance = 4.0f;            // world units
+    glm::vec3 ambient = glm::vec3(0.3f);
+    bool parallel = true;
+
+    // Statistics of the last bake
+    LightmapStats stats;
+
+    // Constructor
+    LightmapBaker(ThreadPool& pool);
+
+    // Static lights of the bake, setting them drops the cache
+    void setLights(const std::vector<Light>& lights);
+
+    // Blocks in a box changed, drops the lightmaps the change can reach
+    void invalidate(const AABB& box);
+
+    // Bake the chunks without a lightmap and upload them, returns the number
+    // of chunks traced
+    unsigned int update(const VoxelWorld& world, VoxelRenderer& renderer);
+
+    // Trace the chunks into the cache, doesn't need a GL context
+    void bake(const VoxelWorld& world, const std::vector<LightmapTarget>& targets);
+    const ChunkLightmap* find(unsigned long long key) const;
+
+    // Cache file, load fails when it was baked from other blocks or lights
+    bool load(const char* path, const VoxelWorld& world);
+    bool save(const char* path, const VoxelWorld& world) const;
+
+private:
+    ThreadPool& pool;
+    std::vector<Light> lights;
+    std::unordered_map<unsigned long long, ChunkLightmap> cache;
+
+    // Surface blocks of the last bake
+    BVH bvh;
+    float shadowDistance = 0.0f;
+
+    // Work of a bake, one item per face
+    struct FaceJob
+    {
+        unsigned int target;
+        unsigned int face;
+    };
+    std::vector<FaceJob> jobs;
+    std::vector<std::vector<unsigned int>> targetLights;
+    std::vector<LightmapTarget> pending;
+
+    void buildBVH(const VoxelWorld& world);
+    void bakeFace(const LightmapTarget& target, const std::vector<unsigned int>& faceLights, const LightmapFace& face,
+                  std::vector<uint32_t>& texels, std::vector<int>& stack, uint64_t& rays) const;
+    bool affected(const AABB& chunk, const AABB& box) const;
+    uint64_t sceneHash(const VoxelWorld& world) const;
+    static uint64_t layoutHash(const std::vector<LightmapFace>& faces);
+};
@@ -1,6 +1,3 @@
-
-#pragma once
-
 #include <iostream>
 #include <cmath>
 #include <glm/glm.hpp>
@@ -22,11 +19,6 @@ glm::mat4 Maths::scale(const glm::vec3& v)
     return scale;
 }
 
-float Maths::radians(float angle)
-{
-    return angle * 3.1416f / 180.0f;
-}
-
 glm::mat4 Maths::rotate(const float& angle, glm::vec3 v)
 {
     v = glm::normalize(v);
@@ -48,4 +40,22 @@ glm::mat4 Maths::rotate(const float& angle, glm::vec3 v)
     rotate[2][2] = (1 - c) * z2 + c;
 
     return rotate;
-}
\ No newline at end of file
+}
+
+glm::mat4 Maths::trs(const glm::vec3& position, glm::vec3 axis, float angle, const glm::vec3& s)
+{
+    // Columns of the rotation scaled by the scale, then the translation
+    axis = glm::normalize(axis);
+    float c = cos(angle);
+    float sn = sin(angle);
+    float t = 1.0f - c;
+    float xy = axis.x * axis.y, xz = axis.x * axis.z, yz = axis.y * axis.z;
+    float xs = axis.x * sn, ys = axis.y * sn, zs = axis.z * sn;
+
+    glm::mat4 m;
+    m[0] = glm::vec4((t * axis.x * axis.x + c) * s.x, (t * xy + zs) * s.x, (t * xz - ys) * s.x, 0.0f);
+    m[1] = glm::vec4((t * xy - zs) * s.y, (t * axis.y * axis.y + c) * s.y, (t * yz + xs) * s.y, 0.0f);
+    m[2] = glm::vec4((t * xz + ys) * s.z, (t * yz - xs) * s.z, (t * axis.z * axis.z + c) * s.z, 0.0f);
+    m[3] = glm::vec4(position, 1.0f);
+    return m;
+}
@@ -5,14 +5,167 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/io.hpp>
 
+// Vector and column major matrix that can be built at compile time, laid out
+// like glm::vec3 and glm::mat4 so arrays of them can be read as glm types
+struct Vec3
+{
+    float x, y, z;
+};
+
+struct Mat4
+{
+    float m[4][4];
+};
+
+static_assert(sizeof(Vec3) == sizeof(glm::vec3), "Vec3 must match glm::vec3");
+static_assert(sizeof(Mat4) == sizeof(glm::mat4), "Mat4 must match glm::mat4");
+
 // Maths class
 class Maths
 {
 public:
+    static constexpr double piDouble = 3.14159265358979323846;
+    static constexpr float pi = static_cast<float>(piDouble);
+
     // Transformation matrices
     static glm::mat4 translate(const glm::vec3& v);
     static glm::mat4 scale(const glm::vec3& v);
-    static float radians(float angle);
+    static constexpr float radians(float angle) { return static_cast<float>(angle * (piDouble / 180.0)); }
     static glm::mat4 rotate(const float& angle, glm::vec3 v);
 
+    // translate(position) * rotate(angle, axis) * scale(s) built directly
+    static glm::mat4 trs(const glm::vec3& position, glm::vec3 axis, float angle, const glm::vec3& s);
+
+    // Compile time transformation matrices, rotateX/Y/Z are about the world
+    // axes and rotate takes any axis
+    static constexpr Mat4 identity();
+    static constexpr Mat4 translate(const Vec3& v);
+    static constexpr Mat4 scale(const Vec3& v);
+    static constexpr Mat4 rotateX(float angle);
+    static constexpr Mat4 rotateY(float angle);
+    static constexpr Mat4 rotateZ(float angle);
+    static constexpr Mat4 rotate(float angle, const Vec3& axis);
+    static constexpr Vec3 transformPoint(const Mat4& m, const Vec3& p);
+
+    // Sine, cosine and square root that can run at compile time, the series
+    // are summed in double so the results are exact to float precision
+    static constexpr double sine(double x);
+    static constexpr double cosine(double x) { return sine(x + piDouble / 2.0); }
+    static constexpr double squareRoot(double x);
 };
+
+constexpr Mat4 operator*(const Mat4& a, const Mat4& b)
+{
+    Mat4 r{};
+    for (int col = 0; col < 4; col++)
+        for (int row = 0; row < 4; row++)
+            r.m[col][row] = a.m[0][row] * b.m[col][0] + a.m[1][row] * b.m[col][1] +
+                            a.m[2][row] * b.m[col][2] + a.m[3][row] * b.m[col][3];
+    return r;
+}
+
+constexpr double Maths::sine(double x)
+{
+    // Bring x into [-pi, pi] then sum the Taylor series
+    double turns = x / (2.0 * piDouble);
+    x -= 2.0 * piDouble * static_cast<double>(static_cast<long long>(turns + (turns < 0.0 ? -0.5 : 0.5)));
+    double term = x, sum = x;
+    for (int n = 1; n < 12; n++)
+    {
+        term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double Maths::squareRoot(double x)
+{
+    if (x <= 0.0)
+        return 0.0;
+
+    // Newton's method until the estimate stops changing
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 128; i++)
+    {
+        double next = 0.5 * (r + x / r);
+        if (next == r)
+            break;
+        r = next;
+    }
+    return r;
+}
+
+constexpr Mat4 Maths::identity()
+{
+    Mat4 r{};
+    r.m[0][0] = r.m[1][1] = r.m[2][2] = r.m[3][3] = 1.0f;
+    return r;
+}
+
+constexpr Mat4 Maths::translate(const Vec3& v)
+{
+    Mat4 r = identity();
+    r.m[3][0] = v.x, r.m[3][1] = v.y, r.m[3][2] = v.z;
+    return r;
+}
+
+constexpr Mat4 Maths::scale(const Vec3& v)
+{
+    Mat4 r = identity();
+    r.m[0][0] = v.x; r.m[1][1] = v.y; r.m[2][2] = v.z;
+    return r;
+}
+
+constexpr Mat4 Maths::rotateX(float angle)
+{
+    float c = static_cast<float>(cosine(angle)), s = static_cast<float>(sine(angle));
+    Mat4 r = identity();
+    r.m[1][1] = c; r.m[1][2] = s;
+    r.m[2][1] = -s; r.m[2][2] = c;
+    return r;
+}
+
+constexpr Mat4 Maths::rotateY(float angle)
+{
+    float c = static_cast<float>(cosine(angle)), s = static_cast<float>(sine(angle));
+    Mat4 r = identity();
+    r.m[0][0] = c; r.m[0][2] = -s;
+    r.m[2][0] = s; r.m[2][2] = c;
+    return r;
+}
+
+constexpr Mat4 Maths::rotateZ(float angle)
+{
+    float c = static_cast<float>(cosine(angle)), s = static_cast<float>(sine(angle));
+    Mat4 r = identity();
+    r.m[0][0] = c; r.m[0][1] = s;
+    r.m[1][0] = -s; r.m[1][1] = c;
+    return r;
+}
+
+constexpr Mat4 Maths::rotate(float angle, const Vec3& axis)
+{
+    // Same terms as the runtime rotate
+    double length = squareRoot(double(axis.x) * axis.x + double(axis.y) * axis.y + double(axis.z) * axis.z);
+    double x = axis.x / length, y = axis.y / length, z = axis.z / length;
+    double c = cosine(angle), s = sine(angle), t = 1.0 - c;
+
+    Mat4 r = identity();
+    r.m[0][0] = float(t * x * x + c);
+    r.m[0][1] = float(t * x * y + z * s);
+    r.m[0][2] = float(t * x * z - y * s);
+    r.m[1][0] = float(t * x * y - z * s);
+    r.m[1][1] = float(t * y * y + c);
+    r.m[1][2] = float(t * y * z + x * s);
+    r.m[2][0] = float(t * x * z + y * s);
+    r.m[2][1] = float(t * y * z - x * s);
+    r.m[2][2] = float(t * z * z + c);
+    return r;
+}
+
+constexpr Vec3 Maths::transformPoint(const Mat4& m, const Vec3& p)
+{
+    return Vec3{ m.m[0][0] * p.x + m.m[1][0] * p.y + m.m[2][0] * p.z + m.m[3][0],
+                 m.m[0][1] * p.x + m.m[1][1] * p.y + m.m[2][1] * p.z + m.m[3][1],
+                 m.m[0][2] * p.x + m.m[1][2] * p.y + m.m[2][2] * p.z + m.m[3][2] };
+}
@@ -0,0 +1,421 @@
+#include <cstdint>
+
+#include <common/matrixbatch.hpp>
+#include <common/maths.hpp>
+
+// The SIMD kernels are compiled for their instruction set with function
+// attributes so the rest of the build keeps the baseline target
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MATRIX_BATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(MATRIX_BATCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MATRIX_TARGET_SSE4 __attribute__((target("sse4.1")))
+#define MATRIX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define MATRIX_TARGET_SSE4
+#define MATRIX_TARGET_AVX2
+#endif
+
+MatrixISA MatrixBatch::isa = MatrixBatch::detect();
+
+namespace
+{
+    unsigned int objectIndex(const unsigned int* objects, unsigned int i)
+    {
+        return objects != nullptr ? objects[i] : i;
+    }
+
+    // The kernels compose the matrices from begin to count
+    void composeTRSScalar(unsigned int begin, unsigned int count, const glm::vec3* positions, const glm::vec3* axes,
+                          const float* angles, const glm::vec3* scales, const unsigned int* objects, glm::mat4* models)
+    {
+        for (unsigned int i = begin; i < count; i++)
+        {
+            unsigned int o = objectIndex(objects, i);
+            models[i] = Maths::trs(positions[o], axes[o], angles[o], scales[o]);
+        }
+    }
+
+    void composeMVPScalar(unsigned int count, const glm::mat4& view, const glm::mat4& viewProjection,
+                          const glm::mat4* models, const unsigned int* objects, glm::mat4* MV, glm::mat4* MVP)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const glm::mat4& model = models[objectIndex(objects, i)];
+            MV[i] = view * model;
+            MVP[i] = viewProjection * model;
+        }
+    }
+
+#ifdef MATRIX_BATCH_X86
+    // Constants of the single precision sine and cosine from Cephes, the
+    // angle is reduced to an octant with pi / 4 split over three floats
+    const float fourOverPi = 1.27323954473516f;
+    const float piOver4A = 0.78515625f, piOver4B = 2.4187564849853515625e-4f, piOver4C = 3.77489497744594108e-8f;
+    const float sin1 = -1.9515295891e-4f, sin2 = 8.3321608736e-3f, sin3 = -1.6666654611e-1f;
+    const float cos1 = 2.443315711809948e-5f, cos2 = -1.388731625493765e-3f, cos3 = 4.166664568298827e-2f;
+
+    void cpuid(unsigned int leaf, unsigned int registers[4])
+    {
+#ifdef _MSC_VER
+        __cpuidex(reinterpret_cast<int*>(registers), static_cast<int>(leaf), 0);
+#else
+        __cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+    }
+
+    // Register state the OS saves on a context switch
+    uint64_t xgetbv()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t low, high;
+        __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+    }
+
+    // ---------------------------------------------------------------------
+    // SSE4, 4 objects at a time
+
+    MATRIX_TARGET_SSE4 __m128 gather4(const float* data, const unsigned int o[4], unsigned int stride, unsigned int offset)
+    {
+        return _mm_set_ps(data[o[3] * stride + offset], data[o[2] * stride + offset],
+                          data[o[1] * stride + offset], data[o[0] * stride + offset]);
+    }
+
+    MATRIX_TARGET_SSE4 void sincos4(__m128 x, __m128& s, __m128& c)
+    {
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        __m128 sinSign = _mm_and_ps(x, signBit);
+        x = _mm_andnot_ps(signBit, x);
+
+        // Even octant and the angle from it
+        __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(fourOverPi)));
+        j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+        __m128 y = _mm_cvtepi32_ps(j);
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(piOver4A)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(piOver4B)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(piOver4C)));
+
+        // The octant decides the signs and which polynomial gives which
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+        sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+        __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(
+            _mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+
+        __m128 z = _mm_mul_ps(x, x);
+        __m128 cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(cos1), z), _mm_set1_ps(cos2));
+        cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(cos3));
+        cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+        cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+        __m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sin1), z), _mm_set1_ps(sin2));
+        sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(sin3));
+        sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+        s = _mm_xor_ps(_mm_blendv_ps(sinPoly, cosPoly, swap), sinSign);
+        c = _mm_xor_ps(_mm_blendv_ps(cosPoly, sinPoly, swap), cosSign);
+    }
+
+    // Write one column of 4 matrices from its x, y, z and w of each
+    MATRIX_TARGET_SSE4 void storeColumn4(glm::mat4* models, unsigned int column, __m128 x, __m128 y, __m128 z, __m128 w)
+    {
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&models[0][column][0], x);
+        _mm_storeu_ps(&models[1][column][0], y);
+        _mm_storeu_ps(&models[2][column][0], z);
+        _mm_storeu_ps(&models[3][column][0], w);
+    }
+
+    MATRIX_TARGET_SSE4 void composeTRSSSE4(unsigned int begin, unsigned int count, const glm::vec3* positions,
+                                           const glm::vec3* axes, const float* angles, const glm::vec3* scales,
+                                           const unsigned int* objects, glm::mat4* models)
+    {
+        const float* p = &positions[0][0];
+        const float* a = &axes[0][0];
+        const float* sc = &scales[0][0];
+        unsigned int i = begin;
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned int o[4];
+            for (unsigned int k = 0; k < 4; k++)
+                o[k] = objectIndex(objects, i + k);
+
+            // Unit axes
+            __m128 x = gather4(a, o, 3, 0), y = gather4(a, o, 3, 1), z = gather4(a, o, 3, 2);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+            __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), length);
+            x = _mm_mul_ps(x, inverse);
+            y = _mm_mul_ps(y, inverse);
+            z = _mm_mul_ps(z, inverse);
+
+            __m128 s, c;
+            sincos4(gather4(angles, o, 1, 0), s, c);
+            __m128 t = _mm_sub_ps(_mm_set1_ps(1.0f), c);
+            __m128 tx = _mm_mul_ps(t, x), ty = _mm_mul_ps(t, y), tz = _mm_mul_ps(t, z);
+            __m128 xs = _mm_mul_ps(x, s), ys = _mm_mul_ps(y, s), zs = _mm_mul_ps(z, s);
+
+            // Rotation columns scaled by the scale, then the translation
+            __m128 sx = gather4(sc, o, 3, 0), sy = gather4(sc, o, 3, 1), sz = gather4(sc, o, 3, 2);
+            __m128 zero = _mm_setzero_ps();
+            storeColumn4(models + i, 0, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, x), c), sx),
+                         _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, y), zs), sx),
+                         _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(tx, z), ys), sx), zero);
+            storeColumn4(models + i, 1, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(tx, y), zs), sy),
+                         _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ty, y), c), sy),
+                         _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ty, z), xs), sy), zero);
+            storeColumn4(models + i, 2, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, z), ys), sz),
+                         _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ty, z), xs), sz),
+                         _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tz, z), c), sz), zero);
+            storeColumn4(models + i, 3, gather4(p, o, 3, 0), gather4(p, o, 3, 1), gather4(p, o, 3, 2), _mm_set1_ps(1.0f));
+        }
+
+        composeTRSScalar(i, count, positions, axes, angles, scales, objects, models);
+    }
+
+    MATRIX_TARGET_SSE4 void composeMVPSSE4(unsigned int count, const glm::mat4& view, const glm::mat4& viewProjection,
+                                           const glm::mat4* models, const unsigned int* objects, glm::mat4* MV, glm::mat4* MVP)
+    {
+        __m128 v0 = _mm_loadu_ps(&view[0][0]), v1 = _mm_loadu_ps(&view[1][0]);
+        __m128 v2 = _mm_loadu_ps(&view[2][0]), v3 = _mm_loadu_ps(&view[3][0]);
+        __m128 p0 = _mm_loadu_ps(&viewProjection[0][0]), p1 = _mm_loadu_ps(&viewProjection[1][0]);
+        __m128 p2 = _mm_loadu_ps(&viewProjection[2][0]), p3 = _mm_loadu_ps(&viewProjection[3][0]);
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const glm::mat4& model = models[objectIndex(objects, i)];
+            for (unsigned int j = 0; j < 4; j++)
+            {
+                // Column j of both products from column j of the model
+                __m128 b0 = _mm_set1_ps(model[j][0]), b1 = _mm_set1_ps(model[j][1]);
+                __m128 b2 = _mm_set1_ps(model[j][2]), b3 = _mm_set1_ps(model[j][3]);
+                __m128 mv = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v0, b0), _mm_mul_ps(v1, b1)),
+                                       _mm_add_ps(_mm_mul_ps(v2, b2), _mm_mul_ps(v3, b3)));
+                __m128 mvp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, b0), _mm_mul_ps(p1, b1)),
+                                        _mm_add_ps(_mm_mul_ps(p2, b2), _mm_mul_ps(p3, b3)));
+                _mm_storeu_ps(&MV[i][j][0], mv);
+                _mm_storeu_ps(&MVP[i][j][0], mvp);
+            }
+        }
+    }
+
+    // ---------------------------------------------------------------------
+    // AVX2, 8 objects at a time
+
+    MATRIX_TARGET_AVX2 __m256 gather8(const float* data, __m256i index, unsigned int offset)
+    {
+        return _mm256_i32gather_ps(data + offset, index, 4);
+    }
+
+    MATRIX_TARGET_AVX2 void sincos8(__m256 x, __m256& s, __m256& c)
+    {
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        __m256 sinSign = _mm256_and_ps(x, signBit);
+        x = _mm256_andnot_ps(signBit, x);
+
+        // Even octant and the angle from it
+        __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(fourOverPi)));
+        j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+        __m256 y = _mm256_cvtepi32_ps(j);
+        x = _mm256_fnmadd_ps(y, _mm256_set1_ps(piOver4A), x);
+        x = _mm256_fnmadd_ps(y, _mm256_set1_ps(piOver4B), x);
+        x = _mm256_fnmadd_ps(y, _mm256_set1_ps(piOver4C), x);
+
+        // The octant decides the signs and which polynomial gives which
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(2)));
+        sinSign = _mm256_xor_ps(sinSign, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29)));
+        __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+            _mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+
+        __m256 z = _mm256_mul_ps(x, x);
+        __m256 cosPoly = _mm256_fmadd_ps(_mm256_set1_ps(cos1), z, _mm256_set1_ps(cos2));
+        cosPoly = _mm256_fmadd_ps(cosPoly, z, _mm256_set1_ps(cos3));
+        cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+        cosPoly = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), cosPoly), _mm256_set1_ps(1.0f));
+        __m256 sinPoly = _mm256_fmadd_ps(_mm256_set1_ps(sin1), z, _mm256_set1_ps(sin2));
+        sinPoly = _mm256_fmadd_ps(sinPoly, z, _mm256_set1_ps(sin3));
+        sinPoly = _mm256_fmadd_ps(_mm256_mul_ps(sinPoly, z), x, x);
+
+        s = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, swap), sinSign);
+        c = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, swap), cosSign);
+    }
+
+    // Write one column of 8 matrices, the transpose works within each half
+    // so the low half holds matrices 0 to 3 and the high half 4 to 7
+    MATRIX_TARGET_AVX2 void storeColumn8(glm::mat4* models, unsigned int column, __m256 x, __m256 y, __m256 z, __m256 w)
+    {
+        __m256 t0 = _mm256_unpacklo_ps(x, y), t1 = _mm256_unpackhi_ps(x, y);
+        __m256 t2 = _mm256_unpacklo_ps(z, w), t3 = _mm256_unpackhi_ps(z, w);
+        __m256 c0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 c1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 c2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 c3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        _mm_storeu_ps(&models[0][column][0], _mm256_castps256_ps128(c0));
+        _mm_storeu_ps(&models[1][column][0], _mm256_castps256_ps128(c1));
+        _mm_storeu_ps(&models[2][column][0], _mm256_castps256_ps128(c2));
+        _mm_storeu_ps(&models[3][column][0], _mm256_castps256_ps128(c3));
+        _mm_storeu_ps(&models[4][column][0], _mm256_extractf128_ps(c0, 1));
+        _mm_storeu_ps(&models[5][column][0], _mm256_extractf128_ps(c1, 1));
+        _mm_storeu_ps(&models[6][column][0], _mm256_extractf128_ps(c2, 1));
+        _mm_storeu_ps(&models[7][column][0], _mm256_extractf128_ps(c3, 1));
+    }
+
+    MATRIX_TARGET_AVX2 void composeTRSAVX2(unsigned int count, const glm::vec3* positions, const glm::vec3* axes,
+                                           const float* angles, const glm::vec3* scales, const unsigned int* objects,
+                                           glm::mat4* models)
+    {
+        const float* p = &positions[0][0];
+        const float* a = &axes[0][0];
+        const float* sc = &scales[0][0];
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        unsigned int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            // Object of each lane, and the float offset of its vectors
+            __m256i o = objects != nullptr ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(objects + i)) :
+                                             _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), lanes);
+            __m256i o3 = _mm256_add_epi32(_mm256_add_epi32(o, o), o);
+
+            // Unit axes
+            __m256 x = gather8(a, o3, 0), y = gather8(a, o3, 1), z = gather8(a, o3, 2);
+            __m256 length = _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z))));
+            __m256 inverse = _mm256_div_ps(_mm256_set1_ps(1.0f), length);
+            x = _mm256_mul_ps(x, inverse);
+            y = _mm256_mul_ps(y, inverse);
+            z = _mm256_mul_ps(z, inverse);
+
+            __m256 s, c;
+            sincos8(_mm256_i32gather_ps(angles, o, 4), s, c);
+            __m256 t = _mm256_sub_ps(_mm256_set1_ps(1.0f), c);
+            __m256 tx = _mm256_mul_ps(t, x), ty = _mm256_mul_ps(t, y), tz = _mm256_mul_ps(t, z);
+            __m256 xs = _mm256_mul_ps(x, s), ys = _mm256_mul_ps(y, s), zs = _mm256_mul_ps(z, s);
+
+            // Rotation columns scaled by the scale, then the translation
+            __m256 sx = gather8(sc, o3, 0), sy = gather8(sc, o3, 1), sz = gather8(sc, o3, 2);
+            __m256 zero = _mm256_setzero_ps();
+            storeColumn8(models + i, 0, _mm256_mul_ps(_mm256_fmadd_ps(tx, x, c), sx),
+                         _mm256_mul_ps(_mm256_fmadd_ps(tx, y, zs), sx),
+                         _mm256_mul_ps(_mm256_fmsub_ps(tx, z, ys), sx), zero);
+            storeColumn8(models + i, 1, _mm256_mul_ps(_mm256_fmsub_ps(tx, y, zs), sy),
+                         _mm256_mul_ps(_mm256_fmadd_ps(ty, y, c), sy),
+                         _mm256_mul_ps(_mm256_fmadd_ps(ty, z, xs), sy), zero);
+            storeColumn8(models + i, 2, _mm256_mul_ps(_mm256_fmadd_ps(tx, z, ys), sz),
+                         _mm256_mul_ps(_mm256_fmsub_ps(ty, z, xs), sz),
+                         _mm256_mul_ps(_mm256_fmadd_ps(tz, z, c), sz), zero);
+            storeColumn8(models + i, 3, gather8(p, o3, 0), gather8(p, o3, 1), gather8(p, o3, 2), _mm256_set1_ps(1.0f));
+        }
+
+        // The last objects go through the 4 wide kernel
+        composeTRSSSE4(i, count, positions, axes, angles, scales, objects, models);
+    }
+
+    MATRIX_TARGET_AVX2 void composeMVPAVX2(unsigned int count, const glm::mat4& view, const glm::mat4& viewProjection,
+                                           const glm::mat4* models, const unsigned int* objects, glm::mat4* MV, glm::mat4* MVP)
+    {
+        // Each column of the left matrices in both halves, so two columns of
+        // a product are made at once
+        __m256 v[4], p[4];
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            v[k] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&view[k][0]));
+            p[k] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[k][0]));
+        }
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            const float* model = &models[objectIndex(objects, i)][0][0];
+            for (unsigned int j = 0; j < 4; j += 2)
+            {
+                __m256 b = _mm256_loadu_ps(model + 4 * j);
+                __m256 b0 = _mm256_shuffle_ps(b, b, 0x00), b1 = _mm256_shuffle_ps(b, b, 0x55);
+                __m256 b2 = _mm256_shuffle_ps(b, b, 0xaa), b3 = _mm256_shuffle_ps(b, b, 0xff);
+                __m256 mv = _mm256_fmadd_ps(v[3], b3, _mm256_fmadd_ps(v[2], b2, _mm256_fmadd_ps(v[1], b1, _mm256_mul_ps(v[0], b0))));
+                __m256 mvp = _mm256_fmadd_ps(p[3], b3, _mm256_fmadd_ps(p[2], b2, _mm256_fmadd_ps(p[1], b1, _mm256_mul_ps(p[0], b0))));
+                _mm256_storeu_ps(&MV[i][j][0], mv);
+                _mm256_storeu_ps(&MVP[i][j][0], mvp);
+            }
+        }
+    }
+#endif
+}
+
+MatrixISA MatrixBatch::detect()
+{
+#ifdef MATRIX_BATCH_X86
+    unsigned int registers[4];
+    cpuid(0, registers);
+    unsigned int maxLeaf = registers[0];
+
+    cpuid(1, registers);
+    bool sse41 = (registers[2] & (1u << 19)) != 0;
+    bool fma = (registers[2] & (1u << 12)) != 0;
+    bool osxsave = (registers[2] & (1u << 27)) != 0;
+    bool avx = (registers[2] & (1u << 28)) != 0;
+
+    // AVX needs the OS to save the upper halves of the registers
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && fma && (xgetbv() & 6) == 6)
+    {
+        cpuid(7, registers);
+        avx2 = (registers[1] & (1u << 5)) != 0;
+    }
+
+    if (avx2)
+        return MatrixISA::AVX2;
+    if (sse41)
+        return MatrixISA::SSE4;
+#endif
+    return MatrixISA::Scalar;
+}
+
+bool MatrixBatch::supported(MatrixISA kernels)
+{
+    return static_cast<int>(kernels) <= static_cast<int>(detect());
+}
+
+const char* MatrixBatch::name(MatrixISA kernels)
+{
+    switch (kernels)
+    {
+    case MatrixISA::SSE4: return "SSE4";
+    case MatrixISA::AVX2: return "AVX2";
+    default:              return "scalar";
+    }
+}
+
+void MatrixBatch::composeTRS(unsigned int count, const glm::vec3* positions, const glm::vec3* axes, const float* angles,
+                             const glm::vec3* scales, const unsigned int* objects, glm::mat4* models)
+{
+    if (count == 0)
+        return;
+
+#ifdef MATRIX_BATCH_X86
+    if (isa == MatrixISA::AVX2)
+        return composeTRSAVX2(count, positions, axes, angles, scales, objects, models);
+    if (isa == MatrixISA::SSE4)
+        return composeTRSSSE4(0, count, positions, axes, angles, scales, objects, models);
+#endif
+    composeTRSScalar(0, count, positions, axes, angles, scales, objects, models);
+}
+
+void MatrixBatch::composeMVP(unsigned int count, const glm::mat4& view, const glm::mat4& projection,
+                             const glm::mat4* models, const unsigned int* objects, glm::mat4* MV, glm::mat4* MVP)
+{
+    glm::mat4 viewProjection = projection * view;
+
+#ifdef MATRIX_BATCH_X86
+    if (isa == MatrixISA::AVX2)
+        return composeMVPAVX2(count, view, viewProjection, models, objects, MV, MVP);
+    if (isa == MatrixISA::SSE4)
+        return composeMVPSSE4(count, view, viewProjection, models, objects, MV, MVP);
+#endif
+    composeMVPScalar(count, view, viewProjection, models, objects, MV, MVP);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Instruction sets of the batch kernels
+enum class MatrixISA { Scalar, SSE4, AVX2 };
+
+// Matrix kernels that work on many objects per call. The SSE4 and AVX2
+// kernels do 4 and 8 objects at a time and are picked at start up from what
+// the CPU supports, the scalar kernels use Maths and are the reference the
+// others match within float rounding.
+class MatrixBatch
+{
+public:
+    // Kernels in use, set to the best supported one at start up
+    static MatrixISA isa;
+
+    // Best instruction set of this CPU, and whether one can run here
+    static MatrixISA detect();
+    static bool supported(MatrixISA isa);
+    static const char* name(MatrixISA isa);
+
+    // Model matrices translate * rotate * scale from the object arrays, angles
+    // in radians. objects picks the inputs of each output, nullptr takes the
+    // first count in order.
+    static void composeTRS(unsigned int count, const glm::vec3* positions, const glm::vec3* axes, const float* angles,
+                           const glm::vec3* scales, const unsigned int* objects, glm::mat4* models);
+
+    // MV = view * model and MVP = projection * view * model of the models
+    // picked by objects, or the first count when it is nullptr
+    static void composeMVP(unsigned int count, const glm::mat4& view, const glm::mat4& projection,
+                           const glm::mat4* models, const unsigned int* objects, glm::mat4* MV, glm::mat4* MVP);
+};
@@ -9,23 +9,32 @@
 
 #include "model.hpp"
 #include "stb_image.hpp"
+#include "profiler.hpp"
+#include "glstate.hpp"
 
-Model::Model(const char *path)
+Model::Model(const char *path) : path(path)
 {
     // Load object
+    printf("Loading file %s\n", path);
     bool res = loadObj(path, vertices, uvs, normals);
     
+    // Calculate the bounding box
+    for (unsigned int i = 0; i < vertices.size(); i++)
+        bounds.expand(vertices[i]);
+    
     // Setup buffers
     setupBuffers();
 }
 
-void Model::draw(unsigned int &shaderID)
+void Model::draw(unsigned int shaderID)
 {
+    PROFILE_SCOPE("Model::draw");
+
     // Send material properties to the shader
-    glUniform1f(glGetUniformLocation(shaderID, "ka"), ka);
-    glUniform1f(glGetUniformLocation(shaderID, "kd"), kd);
-    glUniform1f(glGetUniformLocation(shaderID, "ks"), ks);
-    glUniform1f(glGetUniformLocation(shaderID, "Ns"), Ns);
+    GLState::uniform1f(glGetUniformLocation(shaderID, "ka"), ka);
+    GLState::uniform1f(glGetUniformLocation(shaderID, "kd"), kd);
+    GLState::uniform1f(glGetUniformLocation(shaderID, "ks"), ks);
+    GLState::uniform1f(glGetUniformLocation(shaderID, "Ns"), Ns);
     
     // Bind the textures
     unsigned int diffuseNum = 0;
@@ -33,67 +42,72 @@ void Model::draw(unsigned int &shaderID)
     for (unsigned int i = 0; i < textures.size(); i++)
     {
         // Bind texture
-        std::string name = textures[i].type;
-        glActiveTexture(GL_TEXTURE0 + i);
-        glUniform1i(glGetUniformLocation(shaderID, (name + "Map").c_str()), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        GLState::uniform1i(glGetUniformLocation(shaderID, textures[i].uniform.c_str()), i);
+        GLState::bindTexture(i, GL_TEXTURE_2D, textures[i].id);
     }
     
-    // Draw the triangles
-    glBindVertexArray(VAO);
+    // Draw the triangles, the vertex array stays bound for the next draw
+    GLState::bindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<unsigned int>(vertices.size()));
+}
+
+void Model::drawDepth() const
+{
+    GLState::bindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, static_cast<unsigned int>(vertices.size()));
-    glBindVertexArray(0);
 }
 
 void Model::setupBuffers()
 {
     // Create and bind the Vertex Array Object (VAO)
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    VAO.create(path);
+    GLState::bindVertexArray(VAO);
     
     // Create Vertex Buffer Object
-    unsigned int vertexBuffer;
-    glGenBuffers(1, &vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    vertexBuffer.create(path + " vertices");
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+    vertexBuffer.setBytes(vertices.size() * sizeof(glm::vec3));
     
     // Create uv buffer
-    unsigned int uvBuffer;
-    glGenBuffers(1, &uvBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
+    uvBuffer.create(path + " uvs");
+    GLState::bindBuffer(GL_ARRAY_BUFFER, uvBuffer);
     glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+    uvBuffer.setBytes(uvs.size() * sizeof(glm::vec2));
     
     // Create normal buffer
-    unsigned int normalBuffer;
-    glGenBuffers(1, &normalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+    normalBuffer.create(path + " normals");
+    GLState::bindBuffer(GL_ARRAY_BUFFER, normalBuffer);
     glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
+    normalBuffer.setBytes(normals.size() * sizeof(glm::vec3));
     
     // Bind the vertex buffer
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
     
     // Bind the uv buffer
     glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, uvBuffer);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
     
     // Bind the normal buffer
     glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, normalBuffer);
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
     
      // Unbind the VAO
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
 }
 
 void Model::deleteBuffers()
 {
-    glDeleteBuffers(1, &vertexBuffer);
-    glDeleteBuffers(1, &uvBuffer);
-    glDeleteBuffers(1, &normalBuffer);
-    glDeleteVertexArrays(1, &VAO);
+    vertexBuffer.release();
+    uvBuffer.release();
+    normalBuffer.release();
+    VAO.release();
+    for (unsigned int i = 0; i < textures.size(); i++)
+        textures[i].id.release();
 }
 
 bool Model::loadObj(const char *path,
@@ -101,9 +115,6 @@ bool Model::loadObj(const char *path,
                     std::vector<glm::vec2> &outUVs,
                     std::vector<glm::vec3> &outNormals)
 {
-    
-    printf("Loading file %s\n", path);
-    
     std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
     std::vector<glm::vec3> tempVertices;
     std::vector<glm::vec2> tempUVs;
@@ -214,14 +225,15 @@ void Model::addTexture(const char *path, const std::string type)
     Texture texture;
     texture.id = loadTexture(path);
     texture.type = type;
-    textures.push_back(texture);
+    texture.uniform = type + "Map";
+    textures.push_back(std::move(texture));
 }
 
-unsigned int Model::loadTexture(const char *path)
+GLTexture Model::loadTexture(const char *path)
 {
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    GLTexture textureID;
+    textureID.create(path);
 
     int width, height, numComponents;
     unsigned char *data = stbi_load(path, &width, &height, &numComponents, 0);
@@ -235,9 +247,10 @@ unsigned int Model::loadTexture(const char *path)
         else if (numComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        textureID.setBytes(GLResourceTracker::textureBytes(width, height, 1, numComponents, true));
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
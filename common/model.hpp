@@ -7,11 +7,15 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <common/bounds.hpp>
+#include <common/glresource.hpp>
+
 // Texture struct
 struct Texture
 {
-    unsigned int id;
+    GLTexture id;
     std::string type;
+    std::string uniform;    // sampler name, built once so drawing doesn't allocate
 };
 
 class Model
@@ -24,12 +28,16 @@ public:
     std::vector<Texture>   textures;
     unsigned int textureID;
     float ka, kd, ks, Ns;
+    AABB bounds;
     
     // Constructor
     Model(const char *path);
     
     // Draw model
-    void draw(unsigned int &shaderID);
+    void draw(unsigned int shaderID);
+
+    // Draw the triangles only, for depth passes
+    void drawDepth() const;
     
     // Add textures
     void addTexture(const char *path, const std::string type);
@@ -37,23 +45,24 @@ public:
     // Cleanup
     void deleteBuffers();
     
+    // Load .obj file method, this doesn't need a GL context
+    static bool loadObj(const char *path,
+                        std::vector<glm::vec3> &inVertices,
+                        std::vector<glm::vec2> &inUVs,
+                        std::vector<glm::vec3> &inNormals);
+    
 private:
     
     // Array buffers
-    unsigned int VAO;
-    unsigned int vertexBuffer;
-    unsigned int uvBuffer;
-    unsigned int normalBuffer;
-    
-    // Load .obj file method
-    bool loadObj(const char *path,
-                 std::vector<glm::vec3> &inVertices,
-                 std::vector<glm::vec2> &inUVs,
-                 std::vector<glm::vec3> &inNormals);
+    GLVertexArray VAO;
+    GLBuffer vertexBuffer;
+    GLBuffer uvBuffer;
+    GLBuffer normalBuffer;
+    std::string path;
     
     // Setup buffers
     void setupBuffers();
     
     // Load texture
-    unsigned int loadTexture(const char *path);
+    static GLTexture loadTexture(const char *path);
 };
@@ -0,0 +1,857 @@
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <common/nullgl.hpp>
+
+uint64_t NullGL::calls[NullGLEntryCount] = {};
+uint64_t NullGL::errors = 0;
+
+namespace
+{
+    const char* entryNames[] =
+    {
+#define NULL_GL_NAME(name) "gl" #name,
+        GL_ENTRY_POINTS(NULL_GL_NAME)
+#undef NULL_GL_NAME
+    };
+
+    // Limits reported by the backend
+    const GLuint maxVertexAttribs = 16;
+    const GLuint maxTextureUnits = 32;
+    const GLuint maxUniformBufferBindings = 36;
+    const GLuint maxDrawBuffers = 8;
+
+    // Names handed out for one kind of object, 0 is always valid
+    struct Names
+    {
+        std::vector<bool> live = std::vector<bool>(1, true);
+
+        GLuint create()
+        {
+            live.push_back(true);
+            return static_cast<GLuint>(live.size() - 1);
+        }
+
+        bool valid(GLuint name) const
+        {
+            return name < live.size() && live[name];
+        }
+
+        bool remove(GLuint name)
+        {
+            if (name == 0)
+                return true;
+            if (!valid(name))
+                return false;
+            live[name] = false;
+            return true;
+        }
+    };
+
+    struct State
+    {
+        // Shaders and programs share a namespace like they do in GL
+        Names buffers, textures, vertexArrays, framebuffers, renderbuffers, queries, programs;
+        GLuint program = 0;
+        GLint packAlignment = 4;
+        GLenum error = GL_NO_ERROR;
+        bool reported[NullGLEntryCount] = {};
+
+        // Window
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        int shouldClose = 0;
+        int width = 0, height = 0;
+        double cursorX = 0.0, cursorY = 0.0;
+    };
+
+    State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    // Record a failed validation, the first failure of each entry is printed
+    void fail(NullGLEntry entry, GLenum error)
+    {
+        State& s = state();
+        NullGL::errors++;
+        if (s.error == GL_NO_ERROR)
+            s.error = error;
+        if (!s.reported[entry])
+        {
+            printf("Null GL: invalid call to %s (0x%04x)\n", entryNames[entry], error);
+            s.reported[entry] = true;
+        }
+    }
+
+    // Count a call, then check a condition of it
+#define NULL_GL_CALL(name) NullGL::calls[NullGL_##name]++
+#define NULL_GL_CHECK(name, condition, error) if (!(condition)) { fail(NullGL_##name, error); return; }
+
+    void generate(Names& names, GLsizei n, GLuint* out)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            out[i] = names.create();
+    }
+
+    bool remove(Names& names, GLsizei n, const GLuint* in)
+    {
+        bool valid = true;
+        for (GLsizei i = 0; i < n; i++)
+            valid = names.remove(in[i]) && valid;
+        return valid;
+    }
+
+    // Stable location for a uniform name
+    GLint uniformLocation(const GLchar* name)
+    {
+        uint32_t hash = 2166136261u;
+        for (; *name != '\0'; name++)
+            hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+        return static_cast<GLint>(hash & 0xffff);
+    }
+
+    void GLAPIENTRY nullActiveTexture(GLenum texture)
+    {
+        NULL_GL_CALL(ActiveTexture);
+        NULL_GL_CHECK(ActiveTexture, texture >= GL_TEXTURE0 && texture < GL_TEXTURE0 + maxTextureUnits, GL_INVALID_ENUM);
+    }
+
+    void GLAPIENTRY nullAttachShader(GLuint program, GLuint shader)
+    {
+        NULL_GL_CALL(AttachShader);
+        NULL_GL_CHECK(AttachShader, program != 0 && shader != 0 && state().programs.valid(program) &&
+                      state().programs.valid(shader), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullBeginQuery(GLenum target, GLuint id)
+    {
+        NULL_GL_CALL(BeginQuery);
+        NULL_GL_CHECK(BeginQuery, id != 0 && state().queries.valid(id), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullBindBuffer(GLenum target, GLuint buffer)
+    {
+        NULL_GL_CALL(BindBuffer);
+        NULL_GL_CHECK(BindBuffer, state().buffers.valid(buffer), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        NULL_GL_CALL(BindBufferBase);
+        NULL_GL_CHECK(BindBufferBase, state().buffers.valid(buffer), GL_INVALID_OPERATION);
+        NULL_GL_CHECK(BindBufferBase, index < maxUniformBufferBindings, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullBindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        NULL_GL_CALL(BindFramebuffer);
+        NULL_GL_CHECK(BindFramebuffer, state().framebuffers.valid(framebuffer), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullBindRenderbuffer(GLenum target, GLuint renderbuffer)
+    {
+        NULL_GL_CALL(BindRenderbuffer);
+        NULL_GL_CHECK(BindRenderbuffer, state().renderbuffers.valid(renderbuffer), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullBindVertexArray(GLuint array)
+    {
+        NULL_GL_CALL(BindVertexArray);
+        NULL_GL_CHECK(BindVertexArray, state().vertexArrays.valid(array), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0,
+                                        GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
+    {
+        NULL_GL_CALL(BlitFramebuffer);
+        NULL_GL_CHECK(BlitFramebuffer, (mask & ~(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT)) == 0,
+                      GL_INVALID_VALUE);
+        NULL_GL_CHECK(BlitFramebuffer, filter == GL_NEAREST || (filter == GL_LINEAR && mask == GL_COLOR_BUFFER_BIT),
+                      GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        NULL_GL_CALL(BufferData);
+        NULL_GL_CHECK(BufferData, size >= 0, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        NULL_GL_CALL(BufferSubData);
+        NULL_GL_CHECK(BufferSubData, offset >= 0 && size >= 0, GL_INVALID_VALUE);
+    }
+
+    GLenum GLAPIENTRY nullCheckFramebufferStatus(GLenum target)
+    {
+        NULL_GL_CALL(CheckFramebufferStatus);
+        return GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    void GLAPIENTRY nullCompileShader(GLuint shader)
+    {
+        NULL_GL_CALL(CompileShader);
+        NULL_GL_CHECK(CompileShader, shader != 0 && state().programs.valid(shader), GL_INVALID_VALUE);
+    }
+
+    GLuint GLAPIENTRY nullCreateProgram()
+    {
+        NULL_GL_CALL(CreateProgram);
+        return state().programs.create();
+    }
+
+    GLuint GLAPIENTRY nullCreateShader(GLenum type)
+    {
+        NULL_GL_CALL(CreateShader);
+        return state().programs.create();
+    }
+
+    void GLAPIENTRY nullDeleteBuffers(GLsizei n, const GLuint* buffers)
+    {
+        NULL_GL_CALL(DeleteBuffers);
+        NULL_GL_CHECK(DeleteBuffers, n >= 0 && remove(state().buffers, n, buffers), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullDeleteFramebuffers(GLsizei n, const GLuint* framebuffers)
+    {
+        NULL_GL_CALL(DeleteFramebuffers);
+        NULL_GL_CHECK(DeleteFramebuffers, n >= 0 && remove(state().framebuffers, n, framebuffers), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullDeleteProgram(GLuint program)
+    {
+        NULL_GL_CALL(DeleteProgram);
+        NULL_GL_CHECK(DeleteProgram, state().programs.remove(program), GL_INVALID_VALUE);
+        if (state().program == program)
+            state().program = 0;
+    }
+
+    void GLAPIENTRY nullDeleteQueries(GLsizei n, const GLuint* ids)
+    {
+        NULL_GL_CALL(DeleteQueries);
+        NULL_GL_CHECK(DeleteQueries, n >= 0 && remove(state().queries, n, ids), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers)
+    {
+        NULL_GL_CALL(DeleteRenderbuffers);
+        NULL_GL_CHECK(DeleteRenderbuffers, n >= 0 && remove(state().renderbuffers, n, renderbuffers), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullDeleteShader(GLuint shader)
+    {
+        NULL_GL_CALL(DeleteShader);
+        NULL_GL_CHECK(DeleteShader, state().programs.remove(shader), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+    {
+        NULL_GL_CALL(DeleteVertexArrays);
+        NULL_GL_CHECK(DeleteVertexArrays, n >= 0 && remove(state().vertexArrays, n, arrays), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullDetachShader(GLuint program, GLuint shader)
+    {
+        NULL_GL_CALL(DetachShader);
+        NULL_GL_CHECK(DetachShader, program != 0 && shader != 0 && state().programs.valid(program) &&
+                      state().programs.valid(shader), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        NULL_GL_CALL(DrawArraysInstanced);
+        NULL_GL_CHECK(DrawArraysInstanced, first >= 0 && count >= 0 && instancecount >= 0, GL_INVALID_VALUE);
+        NULL_GL_CHECK(DrawArraysInstanced, state().program != 0, GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullDrawBuffers(GLsizei n, const GLenum* bufs)
+    {
+        NULL_GL_CALL(DrawBuffers);
+        NULL_GL_CHECK(DrawBuffers, n >= 0 && static_cast<GLuint>(n) <= maxDrawBuffers, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullEnableVertexAttribArray(GLuint index)
+    {
+        NULL_GL_CALL(EnableVertexAttribArray);
+        NULL_GL_CHECK(EnableVertexAttribArray, index < maxVertexAttribs, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullEndQuery(GLenum target)
+    {
+        NULL_GL_CALL(EndQuery);
+    }
+
+    void GLAPIENTRY nullFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer)
+    {
+        NULL_GL_CALL(FramebufferRenderbuffer);
+        NULL_GL_CHECK(FramebufferRenderbuffer, state().renderbuffers.valid(renderbuffer), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
+    {
+        NULL_GL_CALL(FramebufferTexture2D);
+        NULL_GL_CHECK(FramebufferTexture2D, state().textures.valid(texture), GL_INVALID_OPERATION);
+        NULL_GL_CHECK(FramebufferTexture2D, level >= 0, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullGenBuffers(GLsizei n, GLuint* buffers)
+    {
+        NULL_GL_CALL(GenBuffers);
+        NULL_GL_CHECK(GenBuffers, n >= 0, GL_INVALID_VALUE);
+        generate(state().buffers, n, buffers);
+    }
+
+    void GLAPIENTRY nullGenFramebuffers(GLsizei n, GLuint* framebuffers)
+    {
+        NULL_GL_CALL(GenFramebuffers);
+        NULL_GL_CHECK(GenFramebuffers, n >= 0, GL_INVALID_VALUE);
+        generate(state().framebuffers, n, framebuffers);
+    }
+
+    void GLAPIENTRY nullGenQueries(GLsizei n, GLuint* ids)
+    {
+        NULL_GL_CALL(GenQueries);
+        NULL_GL_CHECK(GenQueries, n >= 0, GL_INVALID_VALUE);
+        generate(state().queries, n, ids);
+    }
+
+    void GLAPIENTRY nullGenRenderbuffers(GLsizei n, GLuint* renderbuffers)
+    {
+        NULL_GL_CALL(GenRenderbuffers);
+        NULL_GL_CHECK(GenRenderbuffers, n >= 0, GL_INVALID_VALUE);
+        generate(state().renderbuffers, n, renderbuffers);
+    }
+
+    void GLAPIENTRY nullGenVertexArrays(GLsizei n, GLuint* arrays)
+    {
+        NULL_GL_CALL(GenVertexArrays);
+        NULL_GL_CHECK(GenVertexArrays, n >= 0, GL_INVALID_VALUE);
+        generate(state().vertexArrays, n, arrays);
+    }
+
+    void GLAPIENTRY nullGenerateMipmap(GLenum target)
+    {
+        NULL_GL_CALL(GenerateMipmap);
+    }
+
+    void GLAPIENTRY nullGetInteger64v(GLenum pname, GLint64* params)
+    {
+        NULL_GL_CALL(GetInteger64v);
+        *params = 0;
+    }
+
+    void GLAPIENTRY nullGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+    {
+        NULL_GL_CALL(GetProgramInfoLog);
+        if (length != NULL)
+            *length = 0;
+        if (bufSize > 0)
+            infoLog[0] = '\0';
+    }
+
+    void GLAPIENTRY nullGetProgramiv(GLuint program, GLenum pname, GLint* param)
+    {
+        NULL_GL_CALL(GetProgramiv);
+        *param = pname == GL_INFO_LOG_LENGTH ? 0 : GL_TRUE;
+        NULL_GL_CHECK(GetProgramiv, program != 0 && state().programs.valid(program), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params)
+    {
+        NULL_GL_CALL(GetQueryObjectui64v);
+        *params = 0;
+        NULL_GL_CHECK(GetQueryObjectui64v, id != 0 && state().queries.valid(id), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog)
+    {
+        NULL_GL_CALL(GetShaderInfoLog);
+        if (length != NULL)
+            *length = 0;
+        if (bufSize > 0)
+            infoLog[0] = '\0';
+    }
+
+    void GLAPIENTRY nullGetShaderiv(GLuint shader, GLenum pname, GLint* param)
+    {
+        NULL_GL_CALL(GetShaderiv);
+        *param = pname == GL_INFO_LOG_LENGTH ? 0 : GL_TRUE;
+        NULL_GL_CHECK(GetShaderiv, shader != 0 && state().programs.valid(shader), GL_INVALID_VALUE);
+    }
+
+    GLuint GLAPIENTRY nullGetUniformBlockIndex(GLuint program, const GLchar* uniformBlockName)
+    {
+        NULL_GL_CALL(GetUniformBlockIndex);
+        if (program == 0 || !state().programs.valid(program))
+        {
+            fail(NullGL_GetUniformBlockIndex, GL_INVALID_VALUE);
+            return GL_INVALID_INDEX;
+        }
+        return 0;
+    }
+
+    GLint GLAPIENTRY nullGetUniformLocation(GLuint program, const GLchar* name)
+    {
+        NULL_GL_CALL(GetUniformLocation);
+        if (program == 0 || !state().programs.valid(program))
+        {
+            fail(NullGL_GetUniformLocation, GL_INVALID_VALUE);
+            return -1;
+        }
+        return uniformLocation(name);
+    }
+
+    void GLAPIENTRY nullLinkProgram(GLuint program)
+    {
+        NULL_GL_CALL(LinkProgram);
+        NULL_GL_CHECK(LinkProgram, program != 0 && state().programs.valid(program), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullQueryCounter(GLuint id, GLenum target)
+    {
+        NULL_GL_CALL(QueryCounter);
+        NULL_GL_CHECK(QueryCounter, id != 0 && state().queries.valid(id), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+    {
+        NULL_GL_CALL(RenderbufferStorage);
+        NULL_GL_CHECK(RenderbufferStorage, width >= 0 && height >= 0, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length)
+    {
+        NULL_GL_CALL(ShaderSource);
+        NULL_GL_CHECK(ShaderSource, count >= 0 && shader != 0 && state().programs.valid(shader), GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullTexBuffer(GLenum target, GLenum internalFormat, GLuint buffer)
+    {
+        NULL_GL_CALL(TexBuffer);
+        NULL_GL_CHECK(TexBuffer, target == GL_TEXTURE_BUFFER, GL_INVALID_ENUM);
+        NULL_GL_CHECK(TexBuffer, state().buffers.valid(buffer), GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullTexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                                   GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        NULL_GL_CALL(TexImage3D);
+        NULL_GL_CHECK(TexImage3D, level >= 0 && width >= 0 && height >= 0 && depth >= 0 && border == 0, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                                      GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+    {
+        NULL_GL_CALL(TexSubImage3D);
+        NULL_GL_CHECK(TexSubImage3D, level >= 0 && width >= 0 && height >= 0 && depth >= 0, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullUniform1f(GLint location, GLfloat v0)
+    {
+        NULL_GL_CALL(Uniform1f);
+        NULL_GL_CHECK(Uniform1f, state().program != 0, GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullUniform1i(GLint location, GLint v0)
+    {
+        NULL_GL_CALL(Uniform1i);
+        NULL_GL_CHECK(Uniform1i, state().program != 0, GL_INVALID_OPERATION);
+    }
+
+    void GLAPIENTRY nullUniformBlockBinding(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding)
+    {
+        NULL_GL_CALL(UniformBlockBinding);
+        NULL_GL_CHECK(UniformBlockBinding, program != 0 && state().programs.valid(program), GL_INVALID_VALUE);
+        NULL_GL_CHECK(UniformBlockBinding, uniformBlockBinding < maxUniformBufferBindings, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        NULL_GL_CALL(UniformMatrix4fv);
+        NULL_GL_CHECK(UniformMatrix4fv, state().program != 0, GL_INVALID_OPERATION);
+        NULL_GL_CHECK(UniformMatrix4fv, count >= 0, GL_INVALID_VALUE);
+    }
+
+    void GLAPIENTRY nullUseProgram(GLuint program)
+    {
+        NULL_GL_CALL(UseProgram);
+        NULL_GL_CHECK(UseProgram, state().programs.valid(program), GL_INVALID_VALUE);
+        state().program = program;
+    }
+
+    void GLAPIENTRY nullVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride,
+                                            const void* pointer)
+    {
+        NULL_GL_CALL(VertexAttribPointer);
+        NULL_GL_CHECK(VertexAttribPointer, index < maxVertexAttribs && size >= 1 && size <= 4 && stride >= 0, GL_INVALID_VALUE);
+    }
+}
+
+// GLEW's function pointers, glewInit has nothing left to load
+PFNGLACTIVETEXTUREPROC __glewActiveTexture = nullActiveTexture;
+PFNGLATTACHSHADERPROC __glewAttachShader = nullAttachShader;
+PFNGLBEGINQUERYPROC __glewBeginQuery = nullBeginQuery;
+PFNGLBINDBUFFERPROC __glewBindBuffer = nullBindBuffer;
+PFNGLBINDBUFFERBASEPROC __glewBindBufferBase = nullBindBufferBase;
+PFNGLBINDFRAMEBUFFERPROC __glewBindFramebuffer = nullBindFramebuffer;
+PFNGLBINDRENDERBUFFERPROC __glewBindRenderbuffer = nullBindRenderbuffer;
+PFNGLBINDVERTEXARRAYPROC __glewBindVertexArray = nullBindVertexArray;
+PFNGLBLITFRAMEBUFFERPROC __glewBlitFramebuffer = nullBlitFramebuffer;
+PFNGLBUFFERDATAPROC __glewBufferData = nullBufferData;
+PFNGLBUFFERSUBDATAPROC __glewBufferSubData = nullBufferSubData;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC __glewCheckFramebufferStatus = nullCheckFramebufferStatus;
+PFNGLCOMPILESHADERPROC __glewCompileShader = nullCompileShader;
+PFNGLCREATEPROGRAMPROC __glewCreateProgram = nullCreateProgram;
+PFNGLCREATESHADERPROC __glewCreateShader = nullCreateShader;
+PFNGLDELETEBUFFERSPROC __glewDeleteBuffers = nullDeleteBuffers;
+PFNGLDELETEFRAMEBUFFERSPROC __glewDeleteFramebuffers = nullDeleteFramebuffers;
+PFNGLDELETEPROGRAMPROC __glewDeleteProgram = nullDeleteProgram;
+PFNGLDELETEQUERIESPROC __glewDeleteQueries = nullDeleteQueries;
+PFNGLDELETERENDERBUFFERSPROC __glewDeleteRenderbuffers = nullDeleteRenderbuffers;
+PFNGLDELETESHADERPROC __glewDeleteShader = nullDeleteShader;
+PFNGLDELETEVERTEXARRAYSPROC __glewDeleteVertexArrays = nullDeleteVertexArrays;
+PFNGLDETACHSHADERPROC __glewDetachShader = nullDetachShader;
+PFNGLDRAWARRAYSINSTANCEDPROC __glewDrawArraysInstanced = nullDrawArraysInstanced;
+PFNGLDRAWBUFFERSPROC __glewDrawBuffers = nullDrawBuffers;
+PFNGLENABLEVERTEXATTRIBARRAYPROC __glewEnableVertexAttribArray = nullEnableVertexAttribArray;
+PFNGLENDQUERYPROC __glewEndQuery = nullEndQuery;
+PFNGLFRAMEBUFFERRENDERBUFFERPROC __glewFramebufferRenderbuffer = nullFramebufferRenderbuffer;
+PFNGLFRAMEBUFFERTEXTURE2DPROC __glewFramebufferTexture2D = nullFramebufferTexture2D;
+PFNGLGENBUFFERSPROC __glewGenBuffers = nullGenBuffers;
+PFNGLGENFRAMEBUFFERSPROC __glewGenFramebuffers = nullGenFramebuffers;
+PFNGLGENQUERIESPROC __glewGenQueries = nullGenQueries;
+PFNGLGENRENDERBUFFERSPROC __glewGenRenderbuffers = nullGenRenderbuffers;
+PFNGLGENVERTEXARRAYSPROC __glewGenVertexArrays = nullGenVertexArrays;
+PFNGLGENERATEMIPMAPPROC __glewGenerateMipmap = nullGenerateMipmap;
+PFNGLGETINTEGER64VPROC __glewGetInteger64v = nullGetInteger64v;
+PFNGLGETPROGRAMINFOLOGPROC __glewGetProgramInfoLog = nullGetProgramInfoLog;
+PFNGLGETPROGRAMIVPROC __glewGetProgramiv = nullGetProgramiv;
+PFNGLGETQUERYOBJECTUI64VPROC __glewGetQueryObjectui64v = nullGetQueryObjectui64v;
+PFNGLGETSHADERINFOLOGPROC __glewGetShaderInfoLog = nullGetShaderInfoLog;
+PFNGLGETSHADERIVPROC __glewGetShaderiv = nullGetShaderiv;
+PFNGLGETUNIFORMBLOCKINDEXPROC __glewGetUniformBlockIndex = nullGetUniformBlockIndex;
+PFNGLGETUNIFORMLOCATIONPROC __glewGetUniformLocation = nullGetUniformLocation;
+PFNGLLINKPROGRAMPROC __glewLinkProgram = nullLinkProgram;
+PFNGLQUERYCOUNTERPROC __glewQueryCounter = nullQueryCounter;
+PFNGLRENDERBUFFERSTORAGEPROC __glewRenderbufferStorage = nullRenderbufferStorage;
+PFNGLSHADERSOURCEPROC __glewShaderSource = nullShaderSource;
+PFNGLTEXBUFFERPROC __glewTexBuffer = nullTexBuffer;
+PFNGLTEXIMAGE3DPROC __glewTexImage3D = nullTexImage3D;
+PFNGLTEXSUBIMAGE3DPROC __glewTexSubImage3D = nullTexSubImage3D;
+PFNGLUNIFORM1FPROC __glewUniform1f = nullUniform1f;
+PFNGLUNIFORM1IPROC __glewUniform1i = nullUniform1i;
+PFNGLUNIFORMBLOCKBINDINGPROC __glewUniformBlockBinding = nullUniformBlockBinding;
+PFNGLUNIFORMMATRIX4FVPROC __glewUniformMatrix4fv = nullUniformMatrix4fv;
+PFNGLUSEPROGRAMPROC __glewUseProgram = nullUseProgram;
+PFNGLVERTEXATTRIBPOINTERPROC __glewVertexAttribPointer = nullVertexAttribPointer;
+
+GLboolean glewExperimental = GL_FALSE;
+
+GLenum GLEWAPIENTRY glewInit()
+{
+    return GLEW_OK;
+}
+
+// GL 1.1 entry points, these are linked directly rather than loaded
+void GLAPIENTRY glBindTexture(GLenum target, GLuint texture)
+{
+    NULL_GL_CALL(BindTexture);
+    NULL_GL_CHECK(BindTexture, state().textures.valid(texture), GL_INVALID_OPERATION);
+}
+
+void GLAPIENTRY glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    NULL_GL_CALL(BlendFunc);
+}
+
+void GLAPIENTRY glClear(GLbitfield mask)
+{
+    NULL_GL_CALL(Clear);
+    NULL_GL_CHECK(Clear, (mask & ~(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT)) == 0, GL_INVALID_VALUE);
+}
+
+void GLAPIENTRY glClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)
+{
+    NULL_GL_CALL(ClearColor);
+}
+
+void GLAPIENTRY glColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+    NULL_GL_CALL(ColorMask);
+}
+
+void GLAPIENTRY glCullFace(GLenum mode)
+{
+    NULL_GL_CALL(CullFace);
+}
+
+void GLAPIENTRY glDeleteTextures(GLsizei n, const GLuint* textures)
+{
+    NULL_GL_CALL(DeleteTextures);
+    NULL_GL_CHECK(DeleteTextures, n >= 0 && remove(state().textures, n, textures), GL_INVALID_VALUE);
+}
+
+void GLAPIENTRY glDepthFunc(GLenum func)
+{
+    NULL_GL_CALL(DepthFunc);
+}
+
+void GLAPIENTRY glDepthMask(GLboolean flag)
+{
+    NULL_GL_CALL(DepthMask);
+}
+
+void GLAPIENTRY glDisable(GLenum cap)
+{
+    NULL_GL_CALL(Disable);
+}
+
+void GLAPIENTRY glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    NULL_GL_CALL(DrawArrays);
+    NULL_GL_CHECK(DrawArrays, first >= 0 && count >= 0, GL_INVALID_VALUE);
+    NULL_GL_CHECK(DrawArrays, state().program != 0, GL_INVALID_OPERATION);
+}
+
+void GLAPIENTRY glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+    NULL_GL_CALL(DrawElements);
+    NULL_GL_CHECK(DrawElements, count >= 0, GL_INVALID_VALUE);
+    NULL_GL_CHECK(DrawElements, state().program != 0, GL_INVALID_OPERATION);
+}
+
+void GLAPIENTRY glEnable(GLenum cap)
+{
+    NULL_GL_CALL(Enable);
+}
+
+void GLAPIENTRY glFinish()
+{
+    NULL_GL_CALL(Finish);
+}
+
+void GLAPIENTRY glFlush()
+{
+    NULL_GL_CALL(Flush);
+}
+
+void GLAPIENTRY glGenTextures(GLsizei n, GLuint* textures)
+{
+    NULL_GL_CALL(GenTextures);
+    NULL_GL_CHECK(GenTextures, n >= 0, GL_INVALID_VALUE);
+    generate(state().textures, n, textures);
+}
+
+GLenum GLAPIENTRY glGetError()
+{
+    NULL_GL_CALL(GetError);
+    GLenum error = state().error;
+    state().error = GL_NO_ERROR;
+    return error;
+}
+
+void GLAPIENTRY glGetIntegerv(GLenum pname, GLint* params)
+{
+    NULL_GL_CALL(GetIntegerv);
+    if (pname == GL_MAX_VERTEX_ATTRIBS)
+        *params = static_cast<GLint>(maxVertexAttribs);
+    else if (pname == GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS)
+        *params = static_cast<GLint>(maxTextureUnits);
+    else if (pname == GL_CURRENT_PROGRAM)
+        *params = static_cast<GLint>(state().program);
+    else
+        *params = 0;
+}
+
+const GLubyte* GLAPIENTRY glGetString(GLenum name)
+{
+    NULL_GL_CALL(GetString);
+    if (name == GL_VERSION)
+        return reinterpret_cast<const GLubyte*>("3.3 Null GL");
+    if (name == GL_SHADING_LANGUAGE_VERSION)
+        return reinterpret_cast<const GLubyte*>("3.30");
+    return reinterpret_cast<const GLubyte*>("Null GL");
+}
+
+void GLAPIENTRY glPixelStorei(GLenum pname, GLint param)
+{
+    NULL_GL_CALL(PixelStorei);
+    NULL_GL_CHECK(PixelStorei, param == 1 || param == 2 || param == 4 || param == 8, GL_INVALID_VALUE);
+    if (pname == GL_PACK_ALIGNMENT)
+        state().packAlignment = param;
+}
+
+void GLAPIENTRY glReadBuffer(GLenum mode)
+{
+    NULL_GL_CALL(ReadBuffer);
+    NULL_GL_CHECK(ReadBuffer, mode == GL_NONE || mode == GL_BACK || mode == GL_FRONT ||
+                  (mode >= GL_COLOR_ATTACHMENT0 && mode < GL_COLOR_ATTACHMENT0 + maxDrawBuffers), GL_INVALID_ENUM);
+}
+
+void GLAPIENTRY glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels)
+{
+    NULL_GL_CALL(ReadPixels);
+    NULL_GL_CHECK(ReadPixels, width >= 0 && height >= 0, GL_INVALID_VALUE);
+
+    // The image is black, rows are padded to the pack alignment
+    size_t components = format == GL_RGBA || format == GL_BGRA ? 4 : format == GL_RGB || format == GL_BGR ? 3 : 1;
+    size_t size = type == GL_FLOAT || type == GL_UNSIGNED_INT ? 4 : 1;
+    size_t alignment = static_cast<size_t>(state().packAlignment);
+    size_t row = (width * components * size + alignment - 1) / alignment * alignment;
+    memset(pixels, 0, row * height);
+}
+
+void GLAPIENTRY glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    NULL_GL_CALL(Scissor);
+    NULL_GL_CHECK(Scissor, width >= 0 && height >= 0, GL_INVALID_VALUE);
+}
+
+void GLAPIENTRY glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                             GLint border, GLenum format, GLenum type, const void* pixels)
+{
+    NULL_GL_CALL(TexImage2D);
+    NULL_GL_CHECK(TexImage2D, level >= 0 && width >= 0 && height >= 0 && border == 0, GL_INVALID_VALUE);
+}
+
+void GLAPIENTRY glTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+    NULL_GL_CALL(TexParameteri);
+}
+
+void GLAPIENTRY glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                                GLenum format, GLenum type, const void* pixels)
+{
+    NULL_GL_CALL(TexSubImage2D);
+    NULL_GL_CHECK(TexSubImage2D, level >= 0 && width >= 0 && height >= 0, GL_INVALID_VALUE);
+}
+
+void GLAPIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    NULL_GL_CALL(Viewport);
+    NULL_GL_CHECK(Viewport, width >= 0 && height >= 0, GL_INVALID_VALUE);
+}
+
+// GLFW without a display, there is one window that never gets any input
+int glfwInit()
+{
+    state().startTime = std::chrono::steady_clock::now();
+    return GL_TRUE;
+}
+
+void glfwTerminate()
+{
+}
+
+void glfwWindowHint(int hint, int value)
+{
+}
+
+GLFWwindow* glfwCreateWindow(int width, int height, const char* title, GLFWmonitor* monitor, GLFWwindow* share)
+{
+    static int window;
+    state().width = width;
+    state().height = height;
+    return reinterpret_cast<GLFWwindow*>(&window);
+}
+
+void glfwGetFramebufferSize(GLFWwindow* window, int* width, int* height)
+{
+    if (width != NULL)
+        *width = state().width;
+    if (height != NULL)
+        *height = state().height;
+}
+
+void glfwMakeContextCurrent(GLFWwindow* window)
+{
+}
+
+void glfwSwapInterval(int interval)
+{
+}
+
+void glfwSwapBuffers(GLFWwindow* window)
+{
+}
+
+void glfwPollEvents()
+{
+}
+
+double glfwGetTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - state().startTime).count();
+}
+
+int glfwWindowShouldClose(GLFWwindow* window)
+{
+    return state().shouldClose;
+}
+
+void glfwSetWindowShouldClose(GLFWwindow* window, int value)
+{
+    state().shouldClose = value;
+}
+
+void glfwSetWindowTitle(GLFWwindow* window, const char* title)
+{
+}
+
+void glfwSetInputMode(GLFWwindow* window, int mode, int value)
+{
+}
+
+int glfwGetKey(GLFWwindow* window, int key)
+{
+    return GLFW_RELEASE;
+}
+
+int glfwGetMouseButton(GLFWwindow* window, int button)
+{
+    return GLFW_RELEASE;
+}
+
+void glfwGetCursorPos(GLFWwindow* window, double* xpos, double* ypos)
+{
+    if (xpos != NULL)
+        *xpos = state().cursorX;
+    if (ypos != NULL)
+        *ypos = state().cursorY;
+}
+
+void glfwSetCursorPos(GLFWwindow* window, double xpos, double ypos)
+{
+    state().cursorX = xpos;
+    state().cursorY = ypos;
+}
+
+const char* NullGL::name(unsigned int entry)
+{
+    return entry < NullGLEntryCount ? entryNames[entry] : "";
+}
+
+void NullGL::snapshot(std::vector<uint64_t>& counts)
+{
+    counts.assign(calls, calls + NullGLEntryCount);
+}
+
+uint64_t NullGL::totalCalls()
+{
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < NullGLEntryCount; i++)
+        total += calls[i];
+    return total;
+}
+
+void NullGL::reset()
+{
+    for (unsigned int i = 0; i < NullGLEntryCount; i++)
+        calls[i] = 0;
+    errors = 0;
+}
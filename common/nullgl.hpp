@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <common/glentrypoints.hpp>
+
+enum NullGLEntry
+{
+#define NULL_GL_ENUM(name) NullGL_##name,
+    GL_ENTRY_POINTS(NULL_GL_ENUM)
+#undef NULL_GL_ENUM
+    NullGLEntryCount
+};
+
+// Null OpenGL backend, compiled in with the NULL_GL build option. It fills
+// GLEW's function pointers and provides the GL 1.1 and GLFW functions the
+// renderer uses, so the CPU side runs at full speed with no GPU, driver or
+// display. Objects get valid names, arguments are checked cheaply and every
+// call is counted by entry point.
+class NullGL
+{
+public:
+    // Calls of each entry point and calls that failed validation
+    static uint64_t calls[NullGLEntryCount];
+    static uint64_t errors;
+
+    // Name of an entry point, e.g. "glDrawArrays"
+    static const char* name(unsigned int entry);
+
+    // Copy of the call counters, for differences over a number of frames
+    static void snapshot(std::vector<uint64_t>& counts);
+
+    static uint64_t totalCalls();
+    static void reset();
+};
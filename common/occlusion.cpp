@@ -0,0 +1,382 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <common/occlusion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+// Tile and pyramid block sizes in pixels
+static const int tileWidth = 64;
+static const int tileHeight = 32;
+static const int blockSize = 8;
+
+// Triangles a tile can bin, and the room reserved by the constructor
+static const unsigned int maxTileTriangles = 16384;
+static const unsigned int defaultTriangles = 4096;
+
+// Triangle list of the 12 faces of a box, indices of the corners below
+static const int boxIndices[36] = {
+    0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5,
+    0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3,
+    0, 4, 5, 0, 5, 1,   2, 3, 7, 2, 7, 6
+};
+
+static glm::vec3 corner(const AABB& box, int i)
+{
+    return glm::vec3(i & 1 ? box.max.x : box.min.x,
+                     i & 2 ? box.max.y : box.min.y,
+                     i & 4 ? box.max.z : box.min.z);
+}
+
+OcclusionCuller::OcclusionCuller(ThreadPool& Pool, int Width, int Height) : pool(Pool)
+{
+    tilesX = (Width + tileWidth - 1) / tileWidth;
+    tilesY = (Height + tileHeight - 1) / tileHeight;
+    width = tilesX * tileWidth;
+    height = tilesY * tileHeight;
+    depth.assign(width * height, 1.0f);
+    bins.resize(tilesX * tilesY);
+    reserve(defaultTriangles);
+
+    // Allocate the depth pyramid, the first level holds the farthest depth
+    // of each block of pixels and each level above halves the resolution
+    glm::ivec2 size(width / blockSize, height / blockSize);
+    while (true)
+    {
+        pyramid.push_back(std::vector<float>(size.x * size.y, 1.0f));
+        pyramidSize.push_back(size);
+        if (size.x == 1 && size.y == 1)
+            break;
+        size = glm::ivec2(std::max(1, (size.x + 1) / 2), std::max(1, (size.y + 1) / 2));
+    }
+}
+
+void OcclusionCuller::reserve(unsigned int maxTriangles)
+{
+    triangleCapacity = std::max(triangleCapacity, maxTriangles);
+    binCapacity = std::min(triangleCapacity, maxTileTriangles);
+    triangles.reserve(triangleCapacity);
+    for (std::vector<unsigned int>& bin : bins)
+        bin.reserve(binCapacity);
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& ViewProjection)
+{
+    viewProjection = ViewProjection;
+    stats = OcclusionStats();
+    triangles.clear();
+    for (unsigned int i = 0; i < bins.size(); i++)
+        bins[i].clear();
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* vertices, unsigned int count, const glm::mat4& model)
+{
+    glm::mat4 MVP = viewProjection * model;
+    for (unsigned int i = 0; i + 2 < count; i += 3)
+        addTriangle(MVP * glm::vec4(vertices[i], 1.0f),
+                    MVP * glm::vec4(vertices[i + 1], 1.0f),
+                    MVP * glm::vec4(vertices[i + 2], 1.0f));
+    stats.occluders++;
+}
+
+void OcclusionCuller::addOccluder(const AABB& box)
+{
+    glm::vec4 clip[8];
+    for (int i = 0; i < 8; i++)
+        clip[i] = viewProjection * glm::vec4(corner(box, i), 1.0f);
+
+    for (int i = 0; i < 36; i += 3)
+        addTriangle(clip[boxIndices[i]], clip[boxIndices[i + 1]], clip[boxIndices[i + 2]]);
+    stats.occluders++;
+}
+
+void OcclusionCuller::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+{
+    // Clip against the near plane z + w >= 0
+    glm::vec4 in[3] = { a, b, c };
+    glm::vec4 out[4];
+    int n = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec4& p = in[i];
+        const glm::vec4& q = in[(i + 1) % 3];
+        float dp = p.z + p.w;
+        float dq = q.z + q.w;
+        if (dp >= 0.0f)
+            out[n++] = p;
+        if ((dp >= 0.0f) != (dq >= 0.0f))
+            out[n++] = p + (q - p) * (dp / (dp - dq));
+    }
+    if (n < 3)
+        return;
+
+    // Project to the screen
+    glm::vec3 screen[4];
+    for (int i = 0; i < n; i++)
+    {
+        float w = std::max(out[i].w, 1e-6f);
+        screen[i] = glm::vec3((0.5f * out[i].x / w + 0.5f) * width,
+                              (0.5f * out[i].y / w + 0.5f) * height,
+                              0.5f * out[i].z / w + 0.5f);
+    }
+
+    setupTriangle(screen[0], screen[1], screen[2]);
+    if (n == 4)
+        setupTriangle(screen[0], screen[2], screen[3]);
+}
+
+void OcclusionCuller::setupTriangle(const glm::vec3& a, const glm::vec3& B, const glm::vec3& C)
+{
+    // Make the winding counter-clockwise
+    float area = (B.x - a.x) * (C.y - a.y) - (B.y - a.y) * (C.x - a.x);
+    if (std::abs(area) < 1e-8f)
+        return;
+    glm::vec3 b = area > 0.0f ? B : C;
+    glm::vec3 c = area > 0.0f ? C : B;
+    area = std::abs(area);
+
+    // Pixels whose centres lie inside the bounding rectangle
+    Triangle t;
+    t.minX = std::max(0, static_cast<int>(std::ceil(std::min(a.x, std::min(b.x, c.x)) - 0.5f)));
+    t.maxX = std::min(width - 1, static_cast<int>(std::floor(std::max(a.x, std::max(b.x, c.x)) - 0.5f)));
+    t.minY = std::max(0, static_cast<int>(std::ceil(std::min(a.y, std::min(b.y, c.y)) - 0.5f)));
+    t.maxY = std::min(height - 1, static_cast<int>(std::floor(std::max(a.y, std::max(b.y, c.y)) - 0.5f)));
+    if (t.minX > t.maxX || t.minY > t.maxY)
+        return;
+
+    // Edge functions, positive inside the triangle
+    const glm::vec3* v[3] = { &a, &b, &c };
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec3& p = *v[i];
+        const glm::vec3& q = *v[(i + 1) % 3];
+        t.edge[i][0] = p.y - q.y;
+        t.edge[i][1] = q.x - p.x;
+        t.edge[i][2] = p.x * q.y - p.y * q.x;
+    }
+
+    // Depth plane z = A x + B y + C
+    float dzdx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+    float dzdy = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+    t.plane[0] = dzdx;
+    t.plane[1] = dzdy;
+    t.plane[2] = a.z - dzdx * a.x - dzdy * a.y;
+
+    // Bin the triangle to the tiles it overlaps, within the reserved room
+    unsigned int index = static_cast<unsigned int>(triangles.size());
+    if (index == triangleCapacity)
+    {
+        stats.dropped++;
+        return;
+    }
+    triangles.push_back(t);
+    for (int ty = t.minY / tileHeight; ty <= t.maxY / tileHeight; ty++)
+    {
+        for (int tx = t.minX / tileWidth; tx <= t.maxX / tileWidth; tx++)
+        {
+            std::vector<unsigned int>& bin = bins[ty * tilesX + tx];
+            if (bin.size() < binCapacity)
+                bin.push_back(index);
+        }
+    }
+    stats.triangles++;
+}
+
+void OcclusionCuller::rasterize()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Each tile only touches its own pixels so they rasterize independently
+    pool.parallelFor(tilesX * tilesY, [this](unsigned int tile) { rasterizeTile(tile); });
+    buildPyramid();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.rasterTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void OcclusionCuller::rasterizeTile(int tile)
+{
+    int tileX = (tile % tilesX) * tileWidth;
+    int tileY = (tile / tilesX) * tileHeight;
+
+    // Clear the tile
+    for (int y = tileY; y < tileY + tileHeight; y++)
+        std::fill(depth.begin() + y * width + tileX, depth.begin() + y * width + tileX + tileWidth, 1.0f);
+
+    const std::vector<unsigned int>& bin = bins[tile];
+    for (unsigned int i = 0; i < bin.size(); i++)
+    {
+        const Triangle& t = triangles[bin[i]];
+        int x0 = std::max(t.minX, tileX) & ~3;
+        int x1 = std::min(t.maxX, tileX + tileWidth - 1);
+        int y0 = std::max(t.minY, tileY);
+        int y1 = std::min(t.maxY, tileY + tileHeight - 1);
+
+#ifdef OCCLUSION_SSE
+        // Four pixels at a time
+        __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 a0 = _mm_set1_ps(t.edge[0][0]), a1 = _mm_set1_ps(t.edge[1][0]), a2 = _mm_set1_ps(t.edge[2][0]);
+        __m128 za = _mm_set1_ps(t.plane[0]);
+        __m128 zero = _mm_setzero_ps();
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            __m128 b0 = _mm_set1_ps(t.edge[0][1] * py + t.edge[0][2]);
+            __m128 b1 = _mm_set1_ps(t.edge[1][1] * py + t.edge[1][2]);
+            __m128 b2 = _mm_set1_ps(t.edge[2][1] * py + t.edge[2][2]);
+            __m128 zb = _mm_set1_ps(t.plane[1] * py + t.plane[2]);
+            float* row = &depth[y * width];
+            for (int x = x0; x <= x1; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), b0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), b1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), b2);
+                __m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                         _mm_cmpge_ps(e2, zero));
+                if (_mm_movemask_ps(mask) == 0)
+                    continue;
+
+                __m128 z = _mm_add_ps(_mm_mul_ps(za, px), zb);
+                __m128 d = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(d, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearest), _mm_andnot_ps(mask, d)));
+            }
+        }
+#else
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            float* row = &depth[y * width];
+            for (int x = x0; x < x0 + ((x1 - x0) / 4 + 1) * 4; x++)
+            {
+                float px = x + 0.5f;
+                if (t.edge[0][0] * px + t.edge[0][1] * py + t.edge[0][2] < 0.0f ||
+                    t.edge[1][0] * px + t.edge[1][1] * py + t.edge[1][2] < 0.0f ||
+                    t.edge[2][0] * px + t.edge[2][1] * py + t.edge[2][2] < 0.0f)
+                    continue;
+
+                float z = t.plane[0] * px + t.plane[1] * py + t.plane[2];
+                row[x] = std::min(row[x], z);
+            }
+        }
+#endif
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    // First level, farthest depth of each block of pixels
+    glm::ivec2 size = pyramidSize[0];
+    std::vector<float>& level = pyramid[0];
+    pool.parallelFor(size.y, [&](unsigned int by)
+    {
+        for (int bx = 0; bx < size.x; bx++)
+        {
+            float farthest = 0.0f;
+            for (int y = by * blockSize; y < (static_cast<int>(by) + 1) * blockSize; y++)
+            {
+                const float* row = &depth[y * width + bx * blockSize];
+                for (int x = 0; x < blockSize; x++)
+                    farthest = std::max(farthest, row[x]);
+            }
+            level[by * size.x + bx] = farthest;
+        }
+    });
+
+    // Reduce each level by 2x2 blocks
+    for (unsigned int l = 1; l < pyramid.size(); l++)
+    {
+        const std::vector<float>& below = pyramid[l - 1];
+        glm::ivec2 belowSize = pyramidSize[l - 1];
+        glm::ivec2 levelSize = pyramidSize[l];
+        for (int y = 0; y < levelSize.y; y++)
+        {
+            int y0 = std::min(2 * y, belowSize.y - 1), y1 = std::min(2 * y + 1, belowSize.y - 1);
+            for (int x = 0; x < levelSize.x; x++)
+            {
+                int x0 = std::min(2 * x, belowSize.x - 1), x1 = std::min(2 * x + 1, belowSize.x - 1);
+                pyramid[l][y * levelSize.x + x] = std::max(
+                    std::max(below[y0 * belowSize.x + x0], below[y0 * belowSize.x + x1]),
+                    std::max(below[y1 * belowSize.x + x0], below[y1 * belowSize.x + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const AABB& box) const
+{
+    // Screen space bounds and nearest depth of the box
+    glm::vec3 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec4 clip = viewProjection * glm::vec4(corner(box, i), 1.0f);
+
+        // Boxes crossing the near plane are always visible
+        if (clip.w < 1e-5f || clip.z < -clip.w)
+            return true;
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+    if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+        return false;
+
+    float nearest = 0.5f * ndcMin.z + 0.5f - bias;
+    int x0 = std::max(0, static_cast<int>((0.5f * ndcMin.x + 0.5f) * width));
+    int x1 = std::min(width - 1, static_cast<int>((0.5f * ndcMax.x + 0.5f) * width));
+    int y0 = std::max(0, static_cast<int>((0.5f * ndcMin.y + 0.5f) * height));
+    int y1 = std::min(height - 1, static_cast<int>((0.5f * ndcMax.y + 0.5f) * height));
+
+    // Pick the level where the rectangle covers at most 2x2 texels
+    unsigned int l = 0;
+    int block = blockSize;
+    while (l + 1 < pyramid.size() && (x1 / block - x0 / block > 1 || y1 / block - y0 / block > 1))
+    {
+        l++;
+        block *= 2;
+    }
+
+    // Visible if the box is in front of the farthest occluder anywhere
+    const std::vector<float>& level = pyramid[l];
+    glm::ivec2 size = pyramidSize[l];
+    for (int y = y0 / block; y <= std::min(y1 / block, size.y - 1); y++)
+        for (int x = x0 / block; x <= std::min(x1 / block, size.x - 1); x++)
+            if (level[y * size.x + x] >= nearest)
+                return true;
+
+    return false;
+}
+
+void OcclusionCuller::filter(const std::vector<AABB>& bounds, std::vector<unsigned int>& objects)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Test the candidates in batches across the workers
+    const unsigned int batch = 256;
+    unsigned int count = static_cast<unsigned int>(objects.size());
+    visibility.resize(count);
+    pool.parallelFor((count + batch - 1) / batch, [&](unsigned int b)
+    {
+        for (unsigned int i = b * batch; i < std::min(count, (b + 1) * batch); i++)
+            visibility[i] = isVisible(bounds[objects[i]]);
+    });
+
+    // Compact the list
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < count; i++)
+        if (visibility[i])
+            objects[n++] = objects[i];
+    objects.resize(n);
+
+    stats.tested += count;
+    stats.culled += count - n;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.testTime += std::chrono::duration<float, std::milli>(end - start).count();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+#include <common/threadpool.hpp>
+
+// Per frame occlusion culling statistics, times are in milliseconds
+struct OcclusionStats
+{
+    unsigned int occluders = 0;
+    unsigned int triangles = 0;
+    unsigned int tested = 0;
+    unsigned int culled = 0;
+    unsigned int dropped = 0;       // triangles past the reserved room
+    float rasterTime = 0.0f;
+    float testTime = 0.0f;
+
+    float culledPercentage() const { return tested > 0 ? 100.0f * culled / tested : 0.0f; }
+    float totalTime() const { return rasterTime + testTime; }
+};
+
+// Software occlusion culler. Large occluders are rasterized into a low
+// resolution CPU depth buffer, one screen tile per job, and the screen space
+// bounds of each candidate are tested against a hierarchical-Z pyramid built
+// from it. Nothing is read back from the GPU so it also runs headless.
+class OcclusionCuller
+{
+public:
+    // Statistics for the current frame
+    OcclusionStats stats;
+
+    // Depth bias used when comparing candidates against the pyramid
+    float bias = 1e-4f;
+
+    // Constructor, the width is rounded up to a multiple of the tile width
+    OcclusionCuller(ThreadPool& pool, int width = 256, int height = 192);
+
+    // Make room for up to maxTriangles occluder triangles a frame so adding
+    // them never allocates, the room only grows. A tile bins a limited number
+    // of them, the triangles past either limit are dropped, which only culls
+    // less.
+    void reserve(unsigned int maxTriangles);
+
+    // Start a new frame
+    void beginFrame(const glm::mat4& viewProjection);
+
+    // Add occluders, vertices are triangle lists in model space
+    void addOccluder(const glm::vec3* vertices, unsigned int count, const glm::mat4& model);
+    void addOccluder(const AABB& box);
+
+    // Rasterize the occluders and build the depth pyramid
+    void rasterize();
+
+    // Test a world space box against the depth pyramid
+    bool isVisible(const AABB& box) const;
+
+    // Remove the occluded objects from a list of object indices
+    void filter(const std::vector<AABB>& bounds, std::vector<unsigned int>& objects);
+
+    // Depth buffer access for debugging
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const float* getDepth() const { return depth.data(); }
+
+private:
+    // Screen space triangle with its edge and depth equations
+    struct Triangle
+    {
+        float edge[3][3];
+        float plane[3];
+        int minX, maxX, minY, maxY;
+    };
+
+    ThreadPool& pool;
+    int width, height;
+    int tilesX, tilesY;
+    glm::mat4 viewProjection;
+
+    std::vector<float> depth;
+    std::vector<std::vector<float>> pyramid;
+    std::vector<glm::ivec2> pyramidSize;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<unsigned int>> bins;
+    unsigned int triangleCapacity = 0, binCapacity = 0;
+    std::vector<unsigned char> visibility;
+
+    // Triangle setup
+    void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void setupTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+    // Rasterize the triangles binned to a tile
+    void rasterizeTile(int tile);
+
+    // Build the hierarchical-Z pyramid
+    void buildPyramid();
+};
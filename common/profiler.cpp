@@ -0,0 +1,406 @@
+#include <cstdio>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+#include <common/profiler.hpp>
+
+#ifdef ENABLE_PROFILER
+std::atomic<bool> Profiler::enabled(true);
+#else
+std::atomic<bool> Profiler::enabled(false);
+#endif
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Frames a GPU query waits before it is read back
+    const unsigned int gpuLatency = 4;
+
+    // Frames kept for the rolling statistics
+    const unsigned int historyFrames = 240;
+
+    // Thread id used for the GPU track of a trace
+    const uint32_t gpuThread = 0xffffffffu;
+
+    struct GPUQuery
+    {
+        const char* name;
+        unsigned int begin, end;
+    };
+
+    // Queries issued during one frame
+    struct GPUFrame
+    {
+        std::vector<GPUQuery> queries;
+        unsigned int used = 0;
+        uint64_t frame = 0;
+    };
+
+    // Totals of a scope over one frame
+    struct FrameTotal
+    {
+        uint64_t time = 0;
+        unsigned int calls = 0;
+    };
+
+    // Per frame totals of a scope over the recent frames
+    struct ScopeHistory
+    {
+        const char* name;
+        bool gpu;
+        float times[historyFrames];
+        float calls[historyFrames];
+        unsigned int count = 0;
+    };
+
+    struct State
+    {
+        Clock::time_point startTime = Clock::now();
+
+        // Rings of the threads that have recorded events
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ProfileThread>> threads;
+        uint32_t renderThread = 0;
+
+        // Current frame
+        uint64_t frameIndex = 0;
+        uint64_t frameStart = 0;
+        std::unordered_map<const char*, FrameTotal> cpuTotals, gpuTotals;
+
+        // GPU queries of the frames in flight
+        GPUFrame gpuFrames[gpuLatency];
+        float gpuFrameTime = 0.0f;
+        int64_t gpuOffset = 0;
+        bool calibrated = false;
+
+        // Rolling statistics
+        std::vector<ScopeHistory> histories;
+
+        // Capture
+        bool capturing = false;
+        uint64_t captureStart = 0, captureEnd = 0;
+        std::string capturePath;
+        std::vector<ProfileEvent> captured;
+    };
+
+    State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    thread_local ProfileThread* localThread = nullptr;
+
+    ProfileThread* registerThread()
+    {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.threads.push_back(std::unique_ptr<ProfileThread>(new ProfileThread()));
+        s.threads.back()->id = static_cast<uint32_t>(s.threads.size() - 1);
+        return s.threads.back().get();
+    }
+
+    bool inCapture(uint64_t frame)
+    {
+        State& s = state();
+        return s.capturing && frame >= s.captureStart && frame < s.captureEnd;
+    }
+
+    // Add the totals of a frame to the rolling statistics. The entries are
+    // zeroed rather than erased so later frames don't allocate map nodes.
+    void commitTotals(std::unordered_map<const char*, FrameTotal>& totals, bool gpu)
+    {
+        State& s = state();
+        for (auto it = totals.begin(); it != totals.end(); ++it)
+        {
+            if (it->second.calls == 0)
+                continue;
+
+            ScopeHistory* history = nullptr;
+            for (unsigned int i = 0; i < s.histories.size(); i++)
+                if (s.histories[i].name == it->first && s.histories[i].gpu == gpu)
+                    history = &s.histories[i];
+
+            if (history == nullptr)
+            {
+                s.histories.push_back(ScopeHistory());
+                history = &s.histories.back();
+                history->name = it->first;
+                history->gpu = gpu;
+            }
+
+            unsigned int slot = history->count++ % historyFrames;
+            history->times[slot] = static_cast<float>(it->second.time * 1e-6);
+            history->calls[slot] = static_cast<float>(it->second.calls);
+            it->second = FrameTotal();
+        }
+    }
+
+    // Read back the queries of a frame, they were issued gpuLatency frames ago
+    void readGPUFrame(GPUFrame& frame)
+    {
+        State& s = state();
+        GLuint64 first = ~0ull, last = 0;
+        for (unsigned int i = 0; i < frame.used; i++)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[i].begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[i].end, GL_QUERY_RESULT, &end);
+            first = std::min(first, begin);
+            last = std::max(last, end);
+
+            FrameTotal& total = s.gpuTotals[frame.queries[i].name];
+            total.time += end - begin;
+            total.calls++;
+
+            if (inCapture(frame.frame))
+            {
+                ProfileEvent event = { frame.queries[i].name, static_cast<uint64_t>(begin + s.gpuOffset),
+                                       static_cast<uint64_t>(end + s.gpuOffset), gpuThread };
+                s.captured.push_back(event);
+            }
+        }
+        if (frame.used > 0)
+        {
+            s.gpuFrameTime = static_cast<float>((last - first) * 1e-6);
+            commitTotals(s.gpuTotals, true);
+        }
+        frame.used = 0;
+    }
+
+    void writeTrace()
+    {
+        State& s = state();
+        FILE* file = fopen(s.capturePath.c_str(), "w");
+        if (file == NULL)
+        {
+            printf("Impossible to write the trace %s.\n", s.capturePath.c_str());
+            return;
+        }
+
+        // Name the tracks
+        fprintf(file, "{\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", gpuThread);
+        for (unsigned int i = 0; i < s.threads.size(); i++)
+        {
+            if (i == s.renderThread)
+                fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Render\"}}", i);
+            else
+                fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Worker %u\"}}", i, i);
+        }
+
+        // Complete events with microsecond times
+        for (unsigned int i = 0; i < s.captured.size(); i++)
+        {
+            const ProfileEvent& e = s.captured[i];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    e.name, e.thread, e.start * 1e-3, (e.end - e.start) * 1e-3);
+        }
+        fprintf(file, "\n]}\n");
+        fclose(file);
+
+        printf("Wrote %u profiler events to %s\n", static_cast<unsigned int>(s.captured.size()), s.capturePath.c_str());
+    }
+}
+
+void Profiler::beginFrame()
+{
+    if (!enabled)
+        return;
+
+    State& s = state();
+    if (localThread == nullptr)
+        localThread = registerThread();
+    s.renderThread = localThread->id;
+    s.frameStart = now();
+
+    // Map GPU timestamps onto the CPU clock
+    if (!s.calibrated)
+    {
+        GLint64 timestamp = 0;
+        glGetInteger64v(GL_TIMESTAMP, &timestamp);
+        s.gpuOffset = static_cast<int64_t>(now()) - timestamp;
+        s.calibrated = true;
+    }
+
+    // The queries of this slot were issued gpuLatency frames ago
+    GPUFrame& frame = s.gpuFrames[s.frameIndex % gpuLatency];
+    readGPUFrame(frame);
+    frame.frame = s.frameIndex;
+}
+
+void Profiler::endFrame()
+{
+    if (!enabled)
+        return;
+
+    State& s = state();
+    record("Frame", s.frameStart, now());
+
+    // Drain the rings of all threads
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (unsigned int i = 0; i < s.threads.size(); i++)
+        {
+            ProfileThread& thread = *s.threads[i];
+            uint32_t head = thread.head.load(std::memory_order_acquire);
+            if (head - thread.tail > ProfileThread::capacity)
+                thread.tail = head - ProfileThread::capacity;
+
+            for (; thread.tail != head; thread.tail++)
+            {
+                const ProfileEvent& event = thread.events[thread.tail & (ProfileThread::capacity - 1)];
+                FrameTotal& total = s.cpuTotals[event.name];
+                total.time += event.end - event.start;
+                total.calls++;
+
+                if (inCapture(s.frameIndex))
+                    s.captured.push_back(event);
+            }
+        }
+    }
+    commitTotals(s.cpuTotals, false);
+
+    // Finish the capture once its GPU queries have been read back
+    if (s.capturing && s.frameIndex >= s.captureEnd + gpuLatency)
+    {
+        writeTrace();
+        printSummary();
+        s.captured.clear();
+        s.capturing = false;
+    }
+    s.frameIndex++;
+}
+
+uint64_t Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - state().startTime).count();
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end)
+{
+    ProfileThread* thread = localThread;
+    if (thread == nullptr)
+        thread = localThread = registerThread();
+
+    // Write the event, then publish it
+    uint32_t head = thread->head.load(std::memory_order_relaxed);
+    ProfileEvent& event = thread->events[head & (ProfileThread::capacity - 1)];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    event.thread = thread->id;
+    thread->head.store(head + 1, std::memory_order_release);
+}
+
+int Profiler::beginGPU(const char* name)
+{
+    State& s = state();
+    GPUFrame& frame = s.gpuFrames[s.frameIndex % gpuLatency];
+    if (frame.used == frame.queries.size())
+    {
+        GPUQuery query;
+        glGenQueries(1, &query.begin);
+        glGenQueries(1, &query.end);
+        frame.queries.push_back(query);
+    }
+
+    GPUQuery& query = frame.queries[frame.used];
+    query.name = name;
+    glQueryCounter(query.begin, GL_TIMESTAMP);
+    return static_cast<int>(frame.used++);
+}
+
+void Profiler::endGPU(int handle)
+{
+    State& s = state();
+    GPUFrame& frame = s.gpuFrames[s.frameIndex % gpuLatency];
+    glQueryCounter(frame.queries[handle].end, GL_TIMESTAMP);
+}
+
+float Profiler::lastGPUFrame()
+{
+    return state().gpuFrameTime;
+}
+
+void Profiler::capture(unsigned int frames, const char* path)
+{
+    State& s = state();
+    if (s.capturing)
+        return;
+
+    s.capturing = true;
+    s.captureStart = s.frameIndex + 1;
+    s.captureEnd = s.captureStart + frames;
+    s.capturePath = path;
+    s.captured.clear();
+}
+
+bool Profiler::capturing()
+{
+    return state().capturing;
+}
+
+std::vector<ProfileSummary> Profiler::summary()
+{
+    State& s = state();
+    std::vector<ProfileSummary> result;
+    std::vector<float> times;
+    for (unsigned int i = 0; i < s.histories.size(); i++)
+    {
+        const ScopeHistory& history = s.histories[i];
+        unsigned int count = std::min(history.count, historyFrames);
+        if (count == 0)
+            continue;
+
+        ProfileSummary summary;
+        summary.name = history.name;
+        summary.gpu = history.gpu;
+        summary.min = history.times[0];
+        summary.average = 0.0f;
+        summary.calls = 0.0f;
+        times.assign(history.times, history.times + count);
+        for (unsigned int j = 0; j < count; j++)
+        {
+            summary.min = std::min(summary.min, times[j]);
+            summary.average += times[j] / count;
+            summary.calls += history.calls[j] / count;
+        }
+        unsigned int rank = std::min(count - 1, static_cast<unsigned int>(0.99f * count));
+        std::nth_element(times.begin(), times.begin() + rank, times.end());
+        summary.p99 = times[rank];
+        result.push_back(summary);
+    }
+
+    return result;
+}
+
+void Profiler::printSummary()
+{
+    std::vector<ProfileSummary> scopes = summary();
+    printf("%-24s %4s %10s %10s %10s %8s\n", "Scope", "", "min ms", "avg ms", "p99 ms", "calls");
+    for (unsigned int i = 0; i < scopes.size(); i++)
+        printf("%-24s %4s %10.3f %10.3f %10.3f %8.1f\n", scopes[i].name, scopes[i].gpu ? "GPU" : "CPU",
+               scopes[i].min, scopes[i].average, scopes[i].p99, scopes[i].calls);
+}
+
+void Profiler::shutdown()
+{
+    State& s = state();
+    for (unsigned int i = 0; i < gpuLatency; i++)
+    {
+        for (unsigned int j = 0; j < s.gpuFrames[i].queries.size(); j++)
+        {
+            glDeleteQueries(1, &s.gpuFrames[i].queries[j].begin);
+            glDeleteQueries(1, &s.gpuFrames[i].queries[j].end);
+        }
+        s.gpuFrames[i].queries.clear();
+        s.gpuFrames[i].used = 0;
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Timed section, times are in nanoseconds since the profiler started
+struct ProfileEvent
+{
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    uint32_t thread;
+};
+
+// Rolling statistics of a scope over the recent frames, times are the total
+// per frame in milliseconds
+struct ProfileSummary
+{
+    const char* name;
+    bool gpu;
+    float min, average, p99;
+    float calls;        // average calls per frame
+};
+
+// Events recorded by one thread. Only the owning thread writes to the ring
+// and only the frame thread reads from it, so publishing the head with
+// release ordering is all the synchronisation needed.
+struct ProfileThread
+{
+    static const uint32_t capacity = 1 << 16;
+    ProfileEvent events[capacity];
+    std::atomic<uint32_t> head{ 0 }; // written by the owning thread
+    uint32_t tail = 0;              // read by the frame thread
+    uint32_t id = 0;
+};
+
+// Frame profiler. CPU scopes are recorded into per-thread rings and drained
+// once a frame, GPU scopes use GL_TIMESTAMP queries that are read back a few
+// frames later so the CPU never waits on them. Frames can be captured and
+// written as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+class Profiler
+{
+public:
+    // Runtime switch, also off when the profiler is compiled out
+    static std::atomic<bool> enabled;
+
+    // Frame boundaries, called on the render thread
+    static void beginFrame();
+    static void endFrame();
+
+    // CPU timing
+    static uint64_t now();
+    static void record(const char* name, uint64_t start, uint64_t end);
+
+    // GPU timing, beginGPU returns the handle passed to endGPU
+    static int beginGPU(const char* name);
+    static void endGPU(int handle);
+
+    // Milliseconds from the first to the last GPU scope of the latest frame
+    // read back, a few frames behind the current one
+    static float lastGPUFrame();
+
+    // Capture the next frames and write them to a trace file when done
+    static void capture(unsigned int frames, const char* path);
+    static bool capturing();
+
+    // Min, average and 99th percentile over the recent frames
+    static std::vector<ProfileSummary> summary();
+    static void printSummary();
+
+    // Delete the GL queries, the context must still be current
+    static void shutdown();
+};
+
+// Times the enclosing block on the CPU
+class ProfileScope
+{
+public:
+    ProfileScope(const char* Name) : name(Profiler::enabled.load(std::memory_order_relaxed) ? Name : nullptr)
+    {
+        if (name)
+            start = Profiler::now();
+    }
+    ~ProfileScope()
+    {
+        if (name)
+            Profiler::record(name, start, Profiler::now());
+    }
+
+private:
+    const char* name;
+    uint64_t start = 0;
+};
+
+// Times the GL commands issued in the enclosing block on the GPU
+class GPUProfileScope
+{
+public:
+    GPUProfileScope(const char* name) : handle(Profiler::enabled.load(std::memory_order_relaxed) ? Profiler::beginGPU(name) : -1) {}
+    ~GPUProfileScope()
+    {
+        if (handle >= 0)
+            Profiler::endGPU(handle);
+    }
+
+private:
+    int handle;
+};
+
+// Instrumentation macros, these compile to nothing without ENABLE_PROFILER
+#ifdef ENABLE_PROFILER
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GPUProfileScope PROFILE_JOIN(gpuProfileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#endif
@@ -0,0 +1,579 @@
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <common/scene.hpp>
+#include <common/maths.hpp>
+
+// Snapshot identification
+static const char sceneMagic[8] = { 'C', 'G', 'S', 'C', 'E', 'N', 'E', '\0' };
+static const uint32_t sceneVersion = 1;
+
+// Alignment of the arrays in a snapshot
+static const uint64_t sceneAlignment = 64;
+
+// Table records of a snapshot, strings are offsets into the string blob
+struct SceneMeshRecord
+{
+    uint32_t name;
+    uint32_t path;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct SceneMaterialRecord
+{
+    uint32_t name;
+    uint32_t texture;
+    float ka, kd, ks, Ns;
+};
+
+Scene::~Scene()
+{
+    unmap();
+}
+
+bool Scene::load(const char* path)
+{
+    // Binary snapshots start with the magic number
+    char magic[8] = { 0 };
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("Impossible to open the scene %s.\n", path);
+        return false;
+    }
+    size_t n = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    if (n == sizeof(magic) && memcmp(magic, sceneMagic, sizeof(magic)) == 0)
+        return loadBinary(path);
+
+    return loadText(path);
+}
+
+bool Scene::loadText(const char* path)
+{
+    std::ifstream stream(path);
+    if (!stream.is_open())
+    {
+        printf("Impossible to open the scene %s.\n", path);
+        return false;
+    }
+
+    clear();
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(stream, line))
+    {
+        lineNumber++;
+
+        // Skip comments and blank lines
+        std::istringstream words(line);
+        std::string keyword;
+        if (!(words >> keyword) || keyword[0] == '#')
+            continue;
+
+        if (keyword == "mesh")
+        {
+            std::string name, file;
+            words >> name >> file;
+            addMesh(name, file);
+        }
+        else if (keyword == "material")
+        {
+            SceneMaterial material;
+            words >> material.name >> material.texture;
+            words >> material.ka >> material.kd >> material.ks >> material.Ns;
+            addMaterial(material);
+        }
+        else if (keyword == "object")
+        {
+            std::string mesh, material;
+            glm::vec3 position, scale(1.0f), axis(0.0f, 1.0f, 0.0f);
+            float angle = 0.0f;
+            words >> mesh >> material >> position.x >> position.y >> position.z;
+            if (words.fail())
+            {
+                printf("%s:%u: object needs a mesh, a material and a position.\n", path, lineNumber);
+                return false;
+            }
+            words >> scale.x >> scale.y >> scale.z >> axis.x >> axis.y >> axis.z >> angle;
+
+            int meshID = findMesh(mesh);
+            int materialID = findMaterial(material);
+            if (meshID < 0 || materialID < 0)
+            {
+                printf("%s:%u: unknown mesh or material.\n", path, lineNumber);
+                return false;
+            }
+            addObject(meshID, materialID, position, scale, axis, Maths::radians(angle));
+        }
+        else
+        {
+            printf("%s:%u: unknown keyword %s.\n", path, lineNumber, keyword.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Scene::loadBinary(const char* path)
+{
+    clear();
+
+    // Map the whole file
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        printf("Impossible to open the scene %s.\n", path);
+        return false;
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* data = handle ? MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0) : NULL;
+    fileHandle = file;
+    mappingHandle = handle;
+    mapping = data;
+    mappingSize = static_cast<size_t>(size.QuadPart);
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        printf("Impossible to open the scene %s.\n", path);
+        return false;
+    }
+    struct stat info;
+    fstat(file, &info);
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data != MAP_FAILED)
+    {
+        mapping = data;
+        mappingSize = info.st_size;
+    }
+#endif
+    if (mapping == nullptr || mappingSize < sizeof(SceneHeader))
+    {
+        printf("Impossible to map the scene %s.\n", path);
+        unmap();
+        return false;
+    }
+
+    // Check the header, every section must lie in the file and be aligned
+    // for its type. The strings run up to the mesh table.
+    const char* base = static_cast<const char*>(mapping);
+    const SceneHeader* header = reinterpret_cast<const SceneHeader*>(base);
+    uint64_t size = mappingSize;
+    auto section = [size](uint64_t offset, uint64_t count, uint64_t stride)
+    {
+        return offset % 4 == 0 && offset <= size && count * stride <= size - offset;
+    };
+    uint64_t objects = header->objectCount;
+    bool valid = memcmp(header->magic, sceneMagic, sizeof(sceneMagic)) == 0 && header->version == sceneVersion &&
+                 header->stringsOffset <= header->meshesOffset && header->meshesOffset <= size &&
+                 section(header->meshesOffset, header->meshCount, sizeof(SceneMeshRecord)) &&
+                 section(header->materialsOffset, header->materialCount, sizeof(SceneMaterialRecord)) &&
+                 section(header->positionsOffset, objects, sizeof(glm::vec3)) &&
+                 section(header->scalesOffset, objects, sizeof(glm::vec3)) &&
+                 section(header->axesOffset, objects, sizeof(glm::vec3)) &&
+                 section(header->anglesOffset, objects, sizeof(float)) &&
+                 section(header->meshIDsOffset, objects, sizeof(uint32_t)) &&
+                 section(header->materialIDsOffset, objects, sizeof(uint32_t)) &&
+                 section(header->boundsMinOffset, objects, sizeof(glm::vec3)) &&
+                 section(header->boundsMaxOffset, objects, sizeof(glm::vec3));
+    if (!valid)
+    {
+        printf("Scene %s is not a valid snapshot.\n", path);
+        unmap();
+        return false;
+    }
+
+    // Strings must start in the blob and end with a terminator inside it
+    const char* strings = base + header->stringsOffset;
+    uint64_t stringsSize = header->meshesOffset - header->stringsOffset;
+    auto readString = [&](uint32_t offset, std::string& string)
+    {
+        if (offset >= stringsSize || memchr(strings + offset, '\0', stringsSize - offset) == NULL)
+            return false;
+        string = strings + offset;
+        return true;
+    };
+
+    // Copy the tables
+    const SceneMeshRecord* meshRecords = reinterpret_cast<const SceneMeshRecord*>(base + header->meshesOffset);
+    for (unsigned int i = 0; i < header->meshCount && valid; i++)
+    {
+        SceneMesh mesh;
+        valid = readString(meshRecords[i].name, mesh.name) && readString(meshRecords[i].path, mesh.path);
+        mesh.bounds = AABB(glm::vec3(meshRecords[i].boundsMin[0], meshRecords[i].boundsMin[1], meshRecords[i].boundsMin[2]),
+                           glm::vec3(meshRecords[i].boundsMax[0], meshRecords[i].boundsMax[1], meshRecords[i].boundsMax[2]));
+        meshes.push_back(mesh);
+    }
+
+    const SceneMaterialRecord* materialRecords = reinterpret_cast<const SceneMaterialRecord*>(base + header->materialsOffset);
+    for (unsigned int i = 0; i < header->materialCount && valid; i++)
+    {
+        SceneMaterial material;
+        valid = readString(materialRecords[i].name, material.name) &&
+                readString(materialRecords[i].texture, material.texture);
+        material.ka = materialRecords[i].ka;
+        material.kd = materialRecords[i].kd;
+        material.ks = materialRecords[i].ks;
+        material.Ns = materialRecords[i].Ns;
+        materials.push_back(material);
+    }
+
+    // Every object must reference a mesh and a material of the tables
+    const uint32_t* meshIndices = reinterpret_cast<const uint32_t*>(base + header->meshIDsOffset);
+    const uint32_t* materialIndices = reinterpret_cast<const uint32_t*>(base + header->materialIDsOffset);
+    for (uint32_t i = 0; i < header->objectCount && valid; i++)
+        valid = meshIndices[i] < header->meshCount && materialIndices[i] < header->materialCount;
+    if (!valid)
+    {
+        printf("Scene %s is not a valid snapshot.\n", path);
+        clear();
+        return false;
+    }
+
+    // Point the object arrays straight into the mapping
+    objectCount = header->objectCount;
+    positions = reinterpret_cast<const glm::vec3*>(base + header->positionsOffset);
+    scales = reinterpret_cast<const glm::vec3*>(base + header->scalesOffset);
+    axes = reinterpret_cast<const glm::vec3*>(base + header->axesOffset);
+    angles = reinterpret_cast<const float*>(base + header->anglesOffset);
+    meshIDs = reinterpret_cast<const uint32_t*>(base + header->meshIDsOffset);
+    materialIDs = reinterpret_cast<const uint32_t*>(base + header->materialIDsOffset);
+    boundsMin = reinterpret_cast<const glm::vec3*>(base + header->boundsMinOffset);
+    boundsMax = reinterpret_cast<const glm::vec3*>(base + header->boundsMaxOffset);
+    bounds = AABB(glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]),
+                  glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]));
+
+    return true;
+}
+
+bool Scene::saveBinary(const char* path) const
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("Impossible to write the scene %s.\n", path);
+        return false;
+    }
+
+    // String blob
+    std::string strings;
+    auto addString = [&strings](const std::string& s)
+    {
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings += s;
+        strings += '\0';
+        return offset;
+    };
+
+    std::vector<SceneMeshRecord> meshRecords(meshes.size());
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        meshRecords[i].name = addString(meshes[i].name);
+        meshRecords[i].path = addString(meshes[i].path);
+        for (int j = 0; j < 3; j++)
+        {
+            meshRecords[i].boundsMin[j] = meshes[i].bounds.min[j];
+            meshRecords[i].boundsMax[j] = meshes[i].bounds.max[j];
+        }
+    }
+
+    std::vector<SceneMaterialRecord> materialRecords(materials.size());
+    for (unsigned int i = 0; i < materials.size(); i++)
+    {
+        materialRecords[i].name = addString(materials[i].name);
+        materialRecords[i].texture = addString(materials[i].texture);
+        materialRecords[i].ka = materials[i].ka;
+        materialRecords[i].kd = materials[i].kd;
+        materialRecords[i].ks = materials[i].ks;
+        materialRecords[i].Ns = materials[i].Ns;
+    }
+
+    // Lay out the sections
+    SceneHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, sceneMagic, sizeof(sceneMagic));
+    header.version = sceneVersion;
+    header.objectCount = objectCount;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.materialCount = static_cast<uint32_t>(materials.size());
+    for (int j = 0; j < 3; j++)
+    {
+        header.boundsMin[j] = bounds.min[j];
+        header.boundsMax[j] = bounds.max[j];
+    }
+
+    uint64_t offset = sizeof(SceneHeader);
+    auto place = [&offset](uint64_t size)
+    {
+        offset = (offset + sceneAlignment - 1) / sceneAlignment * sceneAlignment;
+        uint64_t start = offset;
+        offset += size;
+        return start;
+    };
+    header.stringsOffset = place(strings.size());
+    header.meshesOffset = place(meshRecords.size() * sizeof(SceneMeshRecord));
+    header.materialsOffset = place(materialRecords.size() * sizeof(SceneMaterialRecord));
+    header.positionsOffset = place(objectCount * sizeof(glm::vec3));
+    header.scalesOffset = place(objectCount * sizeof(glm::vec3));
+    header.axesOffset = place(objectCount * sizeof(glm::vec3));
+    header.anglesOffset = place(objectCount * sizeof(float));
+    header.meshIDsOffset = place(objectCount * sizeof(uint32_t));
+    header.materialIDsOffset = place(objectCount * sizeof(uint32_t));
+    header.boundsMinOffset = place(objectCount * sizeof(glm::vec3));
+    header.boundsMaxOffset = place(objectCount * sizeof(glm::vec3));
+
+    // Write the sections with padding in between
+    uint64_t written = 0;
+    auto write = [&](uint64_t at, const void* data, uint64_t size)
+    {
+        static const char zeros[sceneAlignment] = { 0 };
+        while (written < at)
+        {
+            uint64_t pad = at - written < sceneAlignment ? at - written : sceneAlignment;
+            fwrite(zeros, 1, static_cast<size_t>(pad), file);
+            written += pad;
+        }
+        if (size > 0)
+            fwrite(data, 1, static_cast<size_t>(size), file);
+        written += size;
+    };
+    write(0, &header, sizeof(header));
+    write(header.stringsOffset, strings.data(), strings.size());
+    write(header.meshesOffset, meshRecords.data(), meshRecords.size() * sizeof(SceneMeshRecord));
+    write(header.materialsOffset, materialRecords.data(), materialRecords.size() * sizeof(SceneMaterialRecord));
+    write(header.positionsOffset, positions, objectCount * sizeof(glm::vec3));
+    write(header.scalesOffset, scales, objectCount * sizeof(glm::vec3));
+    write(header.axesOffset, axes, objectCount * sizeof(glm::vec3));
+    write(header.anglesOffset, angles, objectCount * sizeof(float));
+    write(header.meshIDsOffset, meshIDs, objectCount * sizeof(uint32_t));
+    write(header.materialIDsOffset, materialIDs, objectCount * sizeof(uint32_t));
+    write(header.boundsMinOffset, boundsMin, objectCount * sizeof(glm::vec3));
+    write(header.boundsMaxOffset, boundsMax, objectCount * sizeof(glm::vec3));
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+unsigned int Scene::addMesh(const std::string& name, const std::string& path)
+{
+    SceneMesh mesh;
+    mesh.name = name;
+    mesh.path = path;
+    mesh.bounds = objBounds(path.c_str());
+    meshes.push_back(mesh);
+    return static_cast<unsigned int>(meshes.size() - 1);
+}
+
+unsigned int Scene::addMaterial(const SceneMaterial& material)
+{
+    materials.push_back(material);
+    return static_cast<unsigned int>(materials.size() - 1);
+}
+
+void Scene::addObject(unsigned int mesh, unsigned int material, const glm::vec3& position,
+                      const glm::vec3& scale, const glm::vec3& axis, float angle)
+{
+    // Objects added in code are stored in the owned arrays, after the
+    // objects of a mapped snapshot or of a static scene
+    if (mapping != nullptr || models != nullptr)
+        copyToOwnedData();
+
+    positionData.push_back(position);
+    scaleData.push_back(scale);
+    axisData.push_back(axis);
+    angleData.push_back(angle);
+    meshData.push_back(mesh);
+    materialData.push_back(material);
+
+    // World space bounds
+    AABB box = meshes[mesh].bounds.transformed(Maths::trs(position, axis, angle, scale));
+    boundsMinData.push_back(box.min);
+    boundsMaxData.push_back(box.max);
+    bounds.expand(box);
+
+    objectCount = static_cast<unsigned int>(positionData.size());
+    pointAtOwnedData();
+}
+
+void Scene::reserve(unsigned int count)
+{
+    positionData.reserve(count);
+    scaleData.reserve(count);
+    axisData.reserve(count);
+    angleData.reserve(count);
+    meshData.reserve(count);
+    materialData.reserve(count);
+    boundsMinData.reserve(count);
+    boundsMaxData.reserve(count);
+}
+
+void Scene::clear()
+{
+    unmap();
+    meshes.clear();
+    materials.clear();
+    positionData.clear();
+    scaleData.clear();
+    axisData.clear();
+    angleData.clear();
+    meshData.clear();
+    materialData.clear();
+    boundsMinData.clear();
+    boundsMaxData.clear();
+    objectCount = 0;
+    bounds = AABB();
+    pointAtOwnedData();
+}
+
+int Scene::findMesh(const std::string& name) const
+{
+    for (unsigned int i = 0; i < meshes.size(); i++)
+        if (meshes[i].name == name)
+            return static_cast<int>(i);
+
+    return -1;
+}
+
+int Scene::findMaterial(const std::string& name) const
+{
+    for (unsigned int i = 0; i < materials.size(); i++)
+        if (materials[i].name == name)
+            return static_cast<int>(i);
+
+    return -1;
+}
+
+glm::mat4 Scene::modelMatrix(unsigned int i) const
+{
+    if (models != nullptr)
+        return models[i];
+
+    return Maths::trs(positions[i], axes[i], angles[i], scales[i]);
+}
+
+AABB Scene::objBounds(const char* path)
+{
+    AABB box;
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        printf("Impossible to open the file %s.\n", path);
+        return AABB(glm::vec3(-1.0f), glm::vec3(1.0f));
+    }
+
+    // Only the vertex positions are needed
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        glm::vec3 v;
+        if (line[0] == 'v' && line[1] == ' ' && sscanf(line + 2, "%f %f %f", &v.x, &v.y, &v.z) == 3)
+            box.expand(v);
+    }
+    fclose(file);
+
+    return box;
+}
+
+void Scene::unmap()
+{
+    if (mapping == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(mapping, mappingSize);
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    objectCount = 0;
+    pointAtOwnedData();
+}
+
+void Scene::copyToOwnedData()
+{
+    // Copy first, the arrays may point into the mapping or a static scene.
+    // The baked model matrices are dropped, they're composed from the
+    // arrays like those of the other scenes.
+    unsigned int count = objectCount;
+    positionData.assign(positions, positions + count);
+    scaleData.assign(scales, scales + count);
+    axisData.assign(axes, axes + count);
+    angleData.assign(angles, angles + count);
+    meshData.assign(meshIDs, meshIDs + count);
+    materialData.assign(materialIDs, materialIDs + count);
+    boundsMinData.assign(boundsMin, boundsMin + count);
+    boundsMaxData.assign(boundsMax, boundsMax + count);
+
+    unmap();
+    objectCount = count;
+    pointAtOwnedData();
+}
+
+void Scene::pointAtOwnedData()
+{
+    positions = positionData.data();
+    scales = scaleData.data();
+    axes = axisData.data();
+    angles = angleData.data();
+    meshIDs = meshData.data();
+    materialIDs = materialData.data();
+    boundsMin = boundsMinData.data();
+    boundsMax = boundsMaxData.data();
+    models = nullptr;
+}
+
+void Scene::loadStaticTables(const StaticMesh* staticMeshes, unsigned int meshCount,
+                             const StaticMaterial* staticMaterials, unsigned int materialCount)
+{
+    clear();
+
+    // The tables are small and kept as strings like the other formats
+    for (unsigned int i = 0; i < meshCount; i++)
+    {
+        SceneMesh mesh;
+        mesh.name = staticMeshes[i].name;
+        mesh.path = staticMeshes[i].path;
+        mesh.bounds = AABB(glm::vec3(staticMeshes[i].boundsMin.x, staticMeshes[i].boundsMin.y, staticMeshes[i].boundsMin.z),
+                           glm::vec3(staticMeshes[i].boundsMax.x, staticMeshes[i].boundsMax.y, staticMeshes[i].boundsMax.z));
+        meshes.push_back(mesh);
+    }
+
+    for (unsigned int i = 0; i < materialCount; i++)
+    {
+        SceneMaterial material;
+        material.name = staticMaterials[i].name;
+        material.texture = staticMaterials[i].texture;
+        material.ka = staticMaterials[i].ka;
+        material.kd = staticMaterials[i].kd;
+        material.ks = staticMaterials[i].ks;
+        material.Ns = staticMaterials[i].Ns;
+        materials.push_back(material);
+    }
+}
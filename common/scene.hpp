@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+#include <common/staticscene.hpp>
+
+// Mesh table entry
+struct SceneMesh
+{
+    std::string name;
+    std::string path;
+    AABB bounds;
+};
+
+// Material table entry
+struct SceneMaterial
+{
+    std::string name;
+    std::string texture;
+    float ka = 0.2f, kd = 0.7f, ks = 1.0f, Ns = 20.0f;
+};
+
+// Header of a binary scene snapshot. Every array is 64 byte aligned and the
+// offsets are from the start of the file.
+struct SceneHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t objectCount;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t stringsOffset;
+    uint64_t meshesOffset;
+    uint64_t materialsOffset;
+    uint64_t positionsOffset;
+    uint64_t scalesOffset;
+    uint64_t axesOffset;
+    uint64_t anglesOffset;
+    uint64_t meshIDsOffset;
+    uint64_t materialIDsOffset;
+    uint64_t boundsMinOffset;
+    uint64_t boundsMaxOffset;
+};
+
+// Scene made of objects that each reference a mesh and a material. Objects
+// are stored as structure of arrays, the arrays either point into a memory
+// mapped binary snapshot, into a static scene baked at compile time or into
+// storage owned by the scene.
+//
+// The text format has one entry per line, angles are in degrees:
+//
+//     mesh <name> <obj file>
+//     material <name> <texture> [ka kd ks Ns]
+//     object <mesh> <material> <x> <y> <z> [sx sy sz [ax ay az angle]]
+class Scene
+{
+public:
+    // Tables
+    std::vector<SceneMesh> meshes;
+    std::vector<SceneMaterial> materials;
+
+    // Objects
+    unsigned int objectCount = 0;
+    const glm::vec3* positions = nullptr;
+    const glm::vec3* scales = nullptr;
+    const glm::vec3* axes = nullptr;
+    const float* angles = nullptr;            // radians
+    const uint32_t* meshIDs = nullptr;
+    const uint32_t* materialIDs = nullptr;
+    const glm::vec3* boundsMin = nullptr;     // world space
+    const glm::vec3* boundsMax = nullptr;
+    const glm::mat4* models = nullptr;        // baked with static scenes, else nullptr
+    AABB bounds;
+
+    // Constructor and destructor
+    Scene() {}
+    ~Scene();
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Load a text or binary scene depending on the contents of the file
+    bool load(const char* path);
+    bool loadText(const char* path);
+    bool loadBinary(const char* path);
+
+    // Point at a static scene baked at compile time, nothing is computed
+    template <size_t N>
+    void loadStatic(const StaticScene<N>& baked);
+
+    // Write a binary snapshot
+    bool saveBinary(const char* path) const;
+
+    // Build a scene in code
+    unsigned int addMesh(const std::string& name, const std::string& path);
+    unsigned int addMaterial(const SceneMaterial& material);
+    void addObject(unsigned int mesh, unsigned int material, const glm::vec3& position,
+                   const glm::vec3& scale = glm::vec3(1.0f),
+                   const glm::vec3& axis = glm::vec3(0.0f, 1.0f, 0.0f), float angle = 0.0f);
+    void reserve(unsigned int count);
+    void clear();
+
+    // Lookup
+    int findMesh(const std::string& name) const;
+    int findMaterial(const std::string& name) const;
+    AABB objectBounds(unsigned int i) const { return AABB(boundsMin[i], boundsMax[i]); }
+    glm::mat4 modelMatrix(unsigned int i) const;
+
+    // Bounds of the vertices of an .obj file
+    static AABB objBounds(const char* path);
+
+private:
+    // Owned object storage
+    std::vector<glm::vec3> positionData, scaleData, axisData, boundsMinData, boundsMaxData;
+    std::vector<float> angleData;
+    std::vector<uint32_t> meshData, materialData;
+
+    // Memory mapped snapshot
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    void unmap();
+    void copyToOwnedData();
+    void pointAtOwnedData();
+    void loadStaticTables(const StaticMesh* staticMeshes, unsigned int meshCount,
+                          const StaticMaterial* staticMaterials, unsigned int materialCount);
+};
+
+template <size_t N>
+void Scene::loadStatic(const StaticScene<N>& baked)
+{
+    loadStaticTables(baked.meshes, baked.meshCount, baked.materials, baked.materialCount);
+
+    // Vec3 and Mat4 are laid out as glm::vec3 and glm::mat4
+    objectCount = static_cast<unsigned int>(N);
+    positions = reinterpret_cast<const glm::vec3*>(baked.positions);
+    scales = reinterpret_cast<const glm::vec3*>(baked.scales);
+    axes = reinterpret_cast<const glm::vec3*>(baked.axes);
+    angles = baked.angles;
+    meshIDs = baked.meshIDs;
+    materialIDs = baked.materialIDs;
+    boundsMin = reinterpret_cast<const glm::vec3*>(baked.boundsMin);
+    boundsMax = reinterpret_cast<const glm::vec3*>(baked.boundsMax);
+    models = reinterpret_cast<const glm::mat4*>(baked.models);
+    bounds = AABB(glm::vec3(baked.sceneMin.x, baked.sceneMin.y, baked.sceneMin.z),
+                  glm::vec3(baked.sceneMax.x, baked.sceneMax.y, baked.sceneMax.z));
+}
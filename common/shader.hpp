@@ -4,11 +4,28 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
+#include <string>
 #include <fstream>
 #include <sstream>
 
-unsigned int LoadShaders(const char *vertex_file_path,
-                         const char *fragment_file_path)
+// Put #define lines after the #version line of a shader's source
+inline void InjectDefines(std::string& code, const std::string& defines)
+{
+    if (defines.empty())
+        return;
+
+    size_t line = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+    if (line == std::string::npos)
+        code.insert(0, defines);
+    else
+        code.insert(line + 1, defines);
+}
+
+// Compile and link a program, the defines are added to both shaders, so
+// one source can be compiled into several variants
+inline unsigned int LoadShaders(const char *vertex_file_path,
+                                const char *fragment_file_path,
+                                const std::string& defines)
 {
 
     // Create the shaders
@@ -43,6 +60,9 @@ unsigned int LoadShaders(const char *vertex_file_path,
         FragmentShaderStream.close();
     }
 
+    InjectDefines(VertexShaderCode, defines);
+    InjectDefines(FragmentShaderCode, defines);
+
     GLint Result = GL_FALSE;
     int InfoLogLength;
 
@@ -106,3 +126,9 @@ unsigned int LoadShaders(const char *vertex_file_path,
 
     return ProgramID;
 }
+
+inline unsigned int LoadShaders(const char *vertex_file_path,
+                                const char *fragment_file_path)
+{
+    return LoadShaders(vertex_file_path, fragment_file_path, std::string());
+}
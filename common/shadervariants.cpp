@@ -0,0 +1,121 @@
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+
+#include <common/shadervariants.hpp>
+#include <common/shader.hpp>
+#include <common/glstate.hpp>
+
+std::string ShaderPermutation::defines() const
+{
+    std::string code = "#define LIGHT_VARIANT\n";
+    code += "#define POINT_LIGHTS " + std::to_string(pointLights) + "\n";
+    code += "#define SPOT_LIGHTS " + std::to_string(spotLights) + "\n";
+    code += "#define DIRECTIONAL_LIGHTS " + std::to_string(directionalLights) + "\n";
+    if (shadows)
+        code += "#define SHADOWS\n";
+    return code;
+}
+
+std::string ShaderPermutation::name() const
+{
+    return "P" + std::to_string(pointLights) + " S" + std::to_string(spotLights) + " D" +
+           std::to_string(directionalLights) + (shadows ? " shadows" : "");
+}
+
+ShaderVariants::ShaderVariants(const char* VertexPath, const char* FragmentPath)
+    : vertexPath(VertexPath), fragmentPath(FragmentPath)
+{
+}
+
+void ShaderVariants::select(const LightManager& lights, const AABB& bounds, bool shadowed, VariantLights& selection)
+{
+    ShaderPermutation& permutation = selection.permutation;
+    permutation = ShaderPermutation();
+    selection.fits = true;
+    for (unsigned int i = 0; i < lights.count(); i++)
+    {
+        const Light& light = lights.get(i);
+        if (lights.bounded(i) && !Bounds::intersects(Sphere{ light.position, light.range }, bounds))
+            continue;
+
+        unsigned int& count = light.type == LightPoint ? permutation.pointLights :
+                              light.type == LightSpot ? permutation.spotLights : permutation.directionalLights;
+        int* indices = light.type == LightPoint ? selection.point :
+                       light.type == LightSpot ? selection.spot : selection.directional;
+        if (count == ShaderPermutation::maxLights)
+        {
+            selection.fits = false;
+            break;
+        }
+        indices[count++] = static_cast<int>(i);
+        permutation.shadows = permutation.shadows || (shadowed && light.shadow >= 0);
+    }
+    if (!selection.fits)
+        fallbacks++;
+}
+
+ShaderVariant& ShaderVariants::get(const ShaderPermutation& permutation)
+{
+    auto it = variants.find(permutation.key());
+    if (it != variants.end())
+        return it->second;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ShaderVariant& variant = variants[permutation.key()];
+    variant.name = permutation.name();
+    variant.program.adopt(LoadShaders(vertexPath.c_str(), fragmentPath.c_str(), permutation.defines()),
+                          "Object shader " + variant.name);
+
+    // Locations of the light indices, the unused ones stay -1 so setting
+    // them is skipped
+    std::string index;
+    for (unsigned int i = 0; i < ShaderPermutation::maxLights; i++)
+    {
+        index = "[" + std::to_string(i) + "]";
+        variant.pointLocations[i] = glGetUniformLocation(variant.program, ("pointLightIndices" + index).c_str());
+        variant.spotLocations[i] = glGetUniformLocation(variant.program, ("spotLightIndices" + index).c_str());
+        variant.directionalLocations[i] =
+            glGetUniformLocation(variant.program, ("directionalLightIndices" + index).c_str());
+    }
+
+    GLState::useProgram(variant.program);
+    if (setup)
+        setup(variant.program);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    variant.compileTime = std::chrono::duration<float, std::milli>(end - start).count();
+    return variant;
+}
+
+void ShaderVariants::setLights(const ShaderVariant& variant, const VariantLights& selection)
+{
+    const ShaderPermutation& permutation = selection.permutation;
+    for (unsigned int i = 0; i < permutation.pointLights; i++)
+        GLState::uniform1i(variant.pointLocations[i], selection.point[i]);
+    for (unsigned int i = 0; i < permutation.spotLights; i++)
+        GLState::uniform1i(variant.spotLocations[i], selection.spot[i]);
+    for (unsigned int i = 0; i < permutation.directionalLights; i++)
+        GLState::uniform1i(variant.directionalLocations[i], selection.directional[i]);
+}
+
+void ShaderVariants::printSummary() const
+{
+    // Most drawn first
+    std::vector<const ShaderVariant*> sorted;
+    for (auto it = variants.begin(); it != variants.end(); ++it)
+        sorted.push_back(&it->second);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const ShaderVariant* a, const ShaderVariant* b) { return a->draws > b->draws; });
+
+    printf("%u shader variants, %llu draws fell back to the light loop\n", count(),
+           static_cast<unsigned long long>(fallbacks));
+    for (const ShaderVariant* variant : sorted)
+        printf("  %-20s %10llu draws, compiled in %.1f ms\n", variant->name.c_str(),
+               static_cast<unsigned long long>(variant->draws), variant->compileTime);
+}
+
+void ShaderVariants::release()
+{
+    variants.clear();
+}
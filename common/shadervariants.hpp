@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include <common/bounds.hpp>
+#include <common/light.hpp>
+#include <common/glresource.hpp>
+
+// Compile time features of a variant of the lit shader
+struct ShaderPermutation
+{
+    // Lights of each type a variant can take
+    static const unsigned int maxLights = 16;
+
+    unsigned int pointLights = 0;
+    unsigned int spotLights = 0;
+    unsigned int directionalLights = 0;
+    bool shadows = false;
+
+    uint32_t key() const
+    {
+        return pointLights | (spotLights << 8) | (directionalLights << 16) | (shadows ? 1u << 24 : 0u);
+    }
+
+    // #define lines passed to LoadShaders
+    std::string defines() const;
+
+    // Short name such as "P2 S0 D1 shadows", also the GPU profiler scope
+    std::string name() const;
+};
+
+// Lights reaching a draw, sorted by type in light order
+struct VariantLights
+{
+    ShaderPermutation permutation;
+    bool fits = true;           // false when a type has more lights than a variant takes
+    int point[ShaderPermutation::maxLights];
+    int spot[ShaderPermutation::maxLights];
+    int directional[ShaderPermutation::maxLights];
+};
+
+// Compiled variant and the locations of its light indices
+struct ShaderVariant
+{
+    GLProgram program;
+    std::string name;
+    int pointLocations[ShaderPermutation::maxLights];
+    int spotLocations[ShaderPermutation::maxLights];
+    int directionalLocations[ShaderPermutation::maxLights];
+    float compileTime = 0.0f;   // milliseconds
+    uint64_t draws = 0;         // since it was compiled
+};
+
+// Variants of one shader source with the number of lights of each type
+// compiled in. A variant loops over a constant number of lights picked per
+// draw from the ones that reach the object, so the compiler can unroll the
+// loops and drop the branches on the light type. Each variant is compiled
+// the first time a draw needs it and kept until release.
+class ShaderVariants
+{
+public:
+    // Called once with each new program in use, to point it at the light
+    // and shadow buffers
+    std::function<void(unsigned int)> setup;
+
+    // Selections with more lights than a variant takes, since construction
+    uint64_t fallbacks = 0;
+
+    ShaderVariants(const char* vertexPath, const char* fragmentPath);
+
+    // Find the lights reaching a box and the variant they need. Shadow maps
+    // are only compiled in when shadowed is set and a light has a map.
+    void select(const LightManager& lights, const AABB& bounds, bool shadowed, VariantLights& selection);
+
+    // Variant of a permutation, compiled on first use
+    ShaderVariant& get(const ShaderPermutation& permutation);
+
+    // Set the light indices of a selection, with the variant's program in use
+    static void setLights(const ShaderVariant& variant, const VariantLights& selection);
+
+    // Number of compiled variants
+    unsigned int count() const { return static_cast<unsigned int>(variants.size()); }
+
+    // Draws and compile time of each variant
+    void printSummary() const;
+
+    // Delete the programs
+    void release();
+
+private:
+    std::string vertexPath, fragmentPath;
+    std::unordered_map<uint32_t, ShaderVariant> variants;
+};
@@ -0,0 +1,416 @@
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/shadows.hpp>
+#include <common/glstate.hpp>
+#include <common/profiler.hpp>
+
+// Half size of the square a cascade covers, in radii of its part of the view
+static const float cascadeCoverage = 1.5f;
+
+// Near plane of the light projections
+static const float lightNear = 0.05f;
+
+bool ShadowMaps::create(unsigned int depthProgram, const AABB& bounds, int Width, int Height)
+{
+    width = Width;
+    height = Height;
+    casterBounds = AABB(bounds.min - glm::vec3(1.0f), bounds.max + glm::vec3(1.0f));
+    program.adopt(depthProgram, "Shadow depth shader");
+    viewProjectionLocation = glGetUniformLocation(program, "viewProjection");
+    modelLocation = glGetUniformLocation(program, "model");
+
+    // Depth atlas compared against in the shaders, filtered over 2x2 texels
+    atlas.create("Shadow atlas");
+    GLState::bindTexture(textureUnit, GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlasSize, atlasSize, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    atlas.setBytes(GLResourceTracker::textureBytes(atlasSize, atlasSize, 1, 4, false));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    // Depth only framebuffer
+    FBO.create("Shadow atlas");
+    GLState::bindFramebuffer(FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas, 0);
+    const GLenum none = GL_NONE;
+    glDrawBuffers(1, &none);
+    glReadBuffer(GL_NONE);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete)
+        printf("Shadow atlas is incomplete.\n");
+    GLState::bindFramebuffer(0);
+
+    // The cascades along the bottom row, the blocks of the lights above them
+    const unsigned int tilesPerRow = atlasSize / tileSize;
+    for (unsigned int i = 0; i < maxMaps; i++)
+    {
+        ShadowMap& map = maps[i];
+        if (i < cascades)
+        {
+            map.x = i * cascadeSize;
+            map.y = 0;
+            map.size = cascadeSize;
+        }
+        else
+        {
+            map.x = (i - cascades) % tilesPerRow * tileSize;
+            map.y = cascadeSize + (i - cascades) / tilesPerRow * tileSize;
+            map.size = tileSize;
+        }
+        map.valid = false;
+
+        // Half a texel in, so the 2x2 filter stays inside the tile
+        glm::vec2 origin = glm::vec2(map.x, map.y) / static_cast<float>(atlasSize);
+        float size = static_cast<float>(map.size) / atlasSize, inset = 0.5f / atlasSize;
+        block.rects[i] = glm::vec4(origin + inset, origin + size - inset);
+        block.matrices[i] = glm::mat4(1.0f);
+        block.texels[i] = glm::vec4(0.0f);
+    }
+    block.cascadeSplits = glm::vec4(0.0f);
+
+    buffer.create("Shadows");
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+    buffer.setBytes(sizeof(Block));
+
+    directional = -1;
+    for (LocalShadow& local : locals)
+        local = LocalShadow();
+    pending.reserve(maxMaps);
+    stats = ShadowStats();
+    dirty = false;
+    return complete;
+}
+
+void ShadowMaps::update(const Camera& camera, LightManager& lights)
+{
+    PROFILE_SCOPE("ShadowMaps::update");
+    auto start = std::chrono::high_resolution_clock::now();
+    pending.clear();
+    stats.maps = stats.rendered = stats.casters = 0;
+
+    // The cascades follow the first directional light
+    int first = -1;
+    for (unsigned int i = 0; i < lights.count() && first < 0; i++)
+    {
+        if (!lights.bounded(i))
+            first = static_cast<int>(i);
+    }
+    if (first != directional)
+    {
+        if (directional >= 0 && directional < static_cast<int>(lights.count()))
+            lights.setShadow(directional, -1);
+        directional = first;
+        for (unsigned int c = 0; c < cascades; c++)
+        {
+            cascadeState[c] = Cascade();
+            maps[c].valid = false;
+        }
+    }
+    if (directional >= 0)
+    {
+        lights.setShadow(directional, 0);
+        updateCascades(camera, lights.get(directional));
+        stats.maps += cascades;
+    }
+
+    // The bounded lights in view that reach closest to the camera
+    candidates.clear();
+    for (unsigned int i = 0; i < lights.count(); i++)
+    {
+        const Light& light = lights.get(i);
+        if (!lights.bounded(i) || light.range <= 0.0f || light.range == FLT_MAX ||
+            !Bounds::intersects(camera.frustum, lights.sphere(i)))
+            continue;
+        candidates.push_back(std::make_pair(std::max(glm::length(light.position - camera.eye) - light.range, 0.0f), i));
+    }
+    unsigned int chosen = static_cast<unsigned int>(candidates.size());
+    if (chosen > localLights)
+        chosen = localLights;
+    std::partial_sort(candidates.begin(), candidates.begin() + chosen, candidates.end());
+
+    // Lights that are still chosen keep their blocks and their maps
+    for (LocalShadow& local : locals)
+    {
+        if (local.light < 0)
+            continue;
+
+        bool kept = false;
+        for (unsigned int j = 0; j < chosen && !kept; j++)
+            kept = static_cast<int>(candidates[j].second) == local.light;
+        if (!kept)
+        {
+            if (local.light < static_cast<int>(lights.count()))
+                lights.setShadow(local.light, -1);
+            local.light = -1;
+        }
+    }
+    for (unsigned int j = 0; j < chosen; j++)
+    {
+        int light = static_cast<int>(candidates[j].second);
+        unsigned int slot = localLights, free = localLights;
+        for (unsigned int k = 0; k < localLights; k++)
+        {
+            if (locals[k].light == light)
+                slot = k;
+            else if (locals[k].light < 0 && free == localLights)
+                free = k;
+        }
+        if (slot == localLights)
+        {
+            // A new light, the type of zero never matches so the maps are set up
+            slot = free;
+            locals[slot].light = light;
+            locals[slot].state.type = 0;
+        }
+    }
+    for (unsigned int k = 0; k < localLights; k++)
+    {
+        if (locals[k].light < 0)
+            continue;
+
+        const Light& light = lights.get(locals[k].light);
+        lights.setShadow(locals[k].light, static_cast<int32_t>(cascades + 6 * k));
+        updateLocal(k, light);
+        stats.maps += light.type == LightPoint ? 6 : 1;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.time = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void ShadowMaps::updateCascades(const Camera& camera, const Light& light)
+{
+    // Split the view between the planes, three quarters of the way from
+    // uniform to logarithmic spacing
+    float splits[cascades + 1];
+    splits[0] = camera.near;
+    for (unsigned int c = 1; c <= cascades; c++)
+    {
+        float f = static_cast<float>(c) / cascades;
+        float uniform = camera.near + (camera.far - camera.near) * f;
+        float logarithmic = camera.near * std::pow(camera.far / camera.near, f);
+        splits[c] = 0.25f * uniform + 0.75f * logarithmic;
+    }
+    glm::vec4 cascadeSplits(splits[1], splits[2], splits[3], splits[4]);
+    if (cascadeSplits != block.cascadeSplits)
+    {
+        block.cascadeSplits = cascadeSplits;
+        dirty = true;
+    }
+
+    // Light space, looking along the light
+    glm::vec3 up = std::fabs(light.direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), light.direction, up);
+
+    // Depth range of the casters along the light
+    float minZ = FLT_MAX, maxZ = -FLT_MAX;
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner((i & 1) ? casterBounds.max.x : casterBounds.min.x,
+                         (i & 2) ? casterBounds.max.y : casterBounds.min.y,
+                         (i & 4) ? casterBounds.max.z : casterBounds.min.z);
+        float z = (lightView * glm::vec4(corner, 1.0f)).z;
+        minZ = std::min(minZ, z);
+        maxZ = std::max(maxZ, z);
+    }
+
+    // Squared ratio of the distance of a corner of the view from its axis to its depth
+    float t = std::tan(0.5f * camera.fov);
+    float k2 = (1.0f + camera.aspect * camera.aspect) * t * t;
+    for (unsigned int c = 0; c < cascades; c++)
+    {
+        // Bounding sphere of the part of the view, it's centred on the view
+        // axis so turning the camera doesn't change its size. The radius is
+        // rounded up so small changes of the planes keep the map.
+        float n = splits[c], f = splits[c + 1];
+        float z = std::min(f, 0.5f * (n + f) * (1.0f + k2));
+        float radius = std::sqrt((f - z) * (f - z) + f * f * k2);
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+        glm::vec3 centre = glm::vec3(camera.inverseView * glm::vec4(0.0f, 0.0f, -z, 1.0f));
+        glm::vec2 point = glm::vec2(lightView * glm::vec4(centre, 1.0f));
+
+        // Keep the map while the sphere is inside the covered square
+        Cascade& cascade = cascadeState[c];
+        glm::vec2 offset = glm::abs(point - cascade.centre);
+        if (cascade.radius == radius && cascade.direction == light.direction &&
+            std::max(offset.x, offset.y) <= cascade.extent - radius)
+        {
+            if (!maps[c].valid)
+                pending.push_back(c);
+            continue;
+        }
+
+        // Cover more than the sphere and snap the centre to the texels, so
+        // the edges of the shadows stay put when the map moves
+        float extent = cascadeCoverage * radius;
+        float texel = 2.0f * extent / cascadeSize;
+        point = glm::floor(point / texel + 0.5f) * texel;
+        cascade.direction = light.direction;
+        cascade.centre = point;
+        cascade.radius = radius;
+        cascade.extent = extent;
+
+        glm::mat4 projection = glm::ortho(point.x - extent, point.x + extent, point.y - extent, point.y + extent, -maxZ, -minZ);
+        setMatrix(c, projection * lightView, texel, 0.0f);
+    }
+}
+
+void ShadowMaps::updateLocal(unsigned int slot, const Light& light)
+{
+    LocalShadow& local = locals[slot];
+    unsigned int first = cascades + 6 * slot;
+    bool moved = local.state.type != light.type || local.state.position != light.position ||
+                 local.state.direction != light.direction || local.state.cosPhi != light.cosPhi ||
+                 local.state.range != light.range;
+    if (!moved)
+    {
+        unsigned int faces = light.type == LightPoint ? 6 : 1;
+        for (unsigned int f = 0; f < faces; f++)
+        {
+            if (!maps[first + f].valid)
+                pending.push_back(first + f);
+        }
+        return;
+    }
+    local.state = light;
+
+    // A point light has a map for each face of a cube, in the order of the
+    // major axis of the direction: +x, -x, +y, -y, +z, -z
+    float far = std::max(light.range, 2.0f * lightNear);
+    if (light.type == LightPoint)
+    {
+        const glm::vec3 axes[6] = {
+            glm::vec3( 1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0,  1, 0),
+            glm::vec3(0, -1, 0), glm::vec3(0, 0,  1), glm::vec3(0, 0, -1)
+        };
+        glm::mat4 projection = glm::perspective(Maths::radians(90.0f), 1.0f, lightNear, far);
+        for (unsigned int f = 0; f < 6; f++)
+        {
+            glm::vec3 up = f == 2 || f == 3 ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::mat4 view = glm::lookAt(light.position, light.position + axes[f], up);
+            setMatrix(first + f, projection * view, 0.0f, 2.0f / tileSize);
+        }
+        return;
+    }
+
+    // A spotlight looks down its cone
+    float angle = std::min(2.0f * std::acos(light.cosPhi) + Maths::radians(4.0f), Maths::radians(150.0f));
+    glm::vec3 up = std::fabs(light.direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 projection = glm::perspective(angle, 1.0f, lightNear, far);
+    glm::mat4 view = glm::lookAt(light.position, light.position + light.direction, up);
+    setMatrix(first, projection * view, 0.0f, 2.0f * std::tan(0.5f * angle) / tileSize);
+}
+
+void ShadowMaps::setMatrix(unsigned int i, const glm::mat4& viewProjection, float texel, float texelPerDistance)
+{
+    ShadowMap& map = maps[i];
+    map.viewProjection = viewProjection;
+    map.frustum = Frustum::fromMatrix(viewProjection);
+    map.valid = false;
+    pending.push_back(i);
+
+    // Clip space to the texture coordinates of the tile
+    float size = static_cast<float>(map.size) / atlasSize;
+    glm::mat4 toAtlas(1.0f);
+    toAtlas[0][0] = 0.5f * size;
+    toAtlas[1][1] = 0.5f * size;
+    toAtlas[2][2] = 0.5f;
+    toAtlas[3] = glm::vec4(static_cast<float>(map.x) / atlasSize + 0.5f * size,
+                           static_cast<float>(map.y) / atlasSize + 0.5f * size, 0.5f, 1.0f);
+    block.matrices[i] = toAtlas * viewProjection;
+    block.texels[i] = glm::vec4(texel, texelPerDistance, 0.0f, 0.0f);
+    dirty = true;
+}
+
+void ShadowMaps::invalidate(const AABB& box)
+{
+    if (!box.isValid())
+        return;
+
+    for (ShadowMap& map : maps)
+    {
+        if (map.valid && Bounds::intersects(map.frustum, box))
+            map.valid = false;
+    }
+}
+
+void ShadowMaps::render(const std::function<unsigned int(const Frustum&)>& drawCasters, unsigned int framebuffer)
+{
+    PROFILE_SCOPE("ShadowMaps::render");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (!pending.empty())
+    {
+        // Each map clears and draws its own tile
+        GLState::bindFramebuffer(FBO);
+        GLState::useProgram(program);
+        GLState::enable(GL_SCISSOR_TEST);
+        GLState::enable(GL_DEPTH_TEST);
+        GLState::depthMask(true);
+        for (unsigned int i : pending)
+        {
+            ShadowMap& map = maps[i];
+            glViewport(map.x, map.y, map.size, map.size);
+            glScissor(map.x, map.y, map.size, map.size);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            GLState::uniformMatrix4fv(viewProjectionLocation, &map.viewProjection[0][0]);
+            stats.casters += drawCasters(map.frustum);
+            map.valid = true;
+            stats.rendered++;
+        }
+        GLState::disable(GL_SCISSOR_TEST);
+        GLState::bindFramebuffer(framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+    // The whole block goes up when a matrix moved
+    if (dirty)
+    {
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        dirty = false;
+    }
+
+    stats.totalMaps += stats.maps;
+    stats.totalRendered += stats.rendered;
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.time += std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void ShadowMaps::setModel(const glm::mat4& model)
+{
+    GLState::uniformMatrix4fv(modelLocation, &model[0][0]);
+}
+
+void ShadowMaps::setupProgram(unsigned int program, bool enabled)
+{
+    unsigned int block = glGetUniformBlockIndex(program, "Shadows");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, uniformBinding);
+    GLState::uniform1i(glGetUniformLocation(program, "shadowAtlas"), textureUnit);
+    GLState::uniform1i(glGetUniformLocation(program, "shadows"), enabled ? 1 : 0);
+}
+
+void ShadowMaps::bind() const
+{
+    GLState::bindBufferBase(GL_UNIFORM_BUFFER, uniformBinding, buffer);
+    GLState::bindTexture(textureUnit, GL_TEXTURE_2D, atlas);
+}
+
+void ShadowMaps::deleteBuffers()
+{
+    atlas.release();
+    FBO.release();
+    buffer.release();
+    program.release();
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+#include <common/camera.hpp>
+#include <common/light.hpp>
+#include <common/glresource.hpp>
+
+// Statistics of the shadow pass, times are in milliseconds
+struct ShadowStats
+{
+    unsigned int maps = 0;          // maps in use this frame
+    unsigned int rendered = 0;      // maps drawn again this frame, the others were cached
+    unsigned int casters = 0;       // caster draw calls this frame
+    float time = 0.0f;              // CPU time of update and render this frame
+    uint64_t totalMaps = 0;         // since create
+    uint64_t totalRendered = 0;
+
+    float hitRate() const { return maps > 0 ? 1.0f - static_cast<float>(rendered) / maps : 0.0f; }
+    float totalHitRate() const { return totalMaps > 0 ? 1.0f - static_cast<float>(totalRendered) / totalMaps : 0.0f; }
+};
+
+// Shadow map of a cascade or of a light, a square tile of the atlas
+struct ShadowMap
+{
+    glm::mat4 viewProjection;       // world to clip space of the light
+    Frustum frustum;                // world space volume of the casters
+    int x = 0, y = 0, size = 0;     // tile in the atlas, pixels
+    bool valid = false;             // the tile holds the casters of the current matrix
+};
+
+// Shadow maps kept in one depth atlas. The first directional light gets
+// cascades, the bounded lights closest to the camera get a block of six tiles
+// each, the cube faces of a point light, of which a spotlight uses the first.
+// The casters don't move, so a map is only drawn again when its light moves
+// or invalidate() is called with a box its casters are in. Each cascade
+// covers more than its part of the view and is snapped to its texels, it's
+// only moved when the view leaves the covered area.
+class ShadowMaps
+{
+public:
+    static const unsigned int atlasSize = 4096;
+    static const unsigned int cascades = 4;
+    static const unsigned int cascadeSize = 1024;
+    static const unsigned int tileSize = 512;
+    static const unsigned int localLights = 8;
+    static const unsigned int maxMaps = cascades + 6 * localLights;
+
+    // Uniform block binding and texture unit of the atlas
+    static const unsigned int uniformBinding = 1;
+    static const unsigned int textureUnit = 15;
+
+    // Statistics of the last frame
+    ShadowStats stats;
+
+    // Create the atlas, takes ownership of the depth program. The casters
+    // are inside the bounds, the viewport is restored to the size after
+    // rendering.
+    bool create(unsigned int depthProgram, const AABB& casterBounds, int width, int height);
+
+    // Assign the maps to the lights and find the ones to draw again, sets
+    // the shadow of the lights
+    void update(const Camera& camera, LightManager& lights);
+
+    // The casters in a box changed, the maps they are in are drawn again
+    void invalidate(const AABB& box);
+
+    // Draw the maps found by update, drawCasters draws the casters in a
+    // volume with the depth program and returns its draw calls. The
+    // framebuffer is bound again afterwards.
+    void render(const std::function<unsigned int(const Frustum&)>& drawCasters, unsigned int framebuffer);
+
+    // Model matrix of the next caster
+    void setModel(const glm::mat4& model);
+
+    // Point a program at the Shadows block and the atlas, once after linking
+    // with the program in use. A program drawn without shadows still needs
+    // the atlas on its unit, GL rejects samplers of different types on one.
+    static void setupProgram(unsigned int program, bool enabled = true);
+
+    // Bind the atlas and the Shadows block
+    void bind() const;
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    // Shadows block in the std140 layout of the shaders
+    struct Block
+    {
+        glm::mat4 matrices[maxMaps];    // world to atlas texture coordinates
+        glm::vec4 rects[maxMaps];       // tile in texture coordinates
+        glm::vec4 texels[maxMaps];      // world size of a texel, x constant, y per unit of distance
+        glm::vec4 cascadeSplits;        // view depth where each cascade ends
+    };
+
+    // Cascade covering a sphere around a point of the view in light space
+    struct Cascade
+    {
+        glm::vec3 direction;
+        glm::vec2 centre;
+        float radius = 0.0f;            // of the part of the view, rounded up
+        float extent = 0.0f;            // half size of the covered square
+    };
+
+    // Bounded light owning a block of six maps
+    struct LocalShadow
+    {
+        int light = -1;
+        Light state;
+    };
+
+    GLProgram program;
+    GLFramebuffer FBO;
+    GLTexture atlas;
+    GLBuffer buffer;
+    int viewProjectionLocation = -1, modelLocation = -1;
+    int width = 0, height = 0;
+    AABB casterBounds;
+
+    ShadowMap maps[maxMaps];
+    Cascade cascadeState[cascades];
+    LocalShadow locals[localLights];
+    int directional = -1;
+    Block block;
+    bool dirty = true;
+
+    // Maps to draw, and the candidates of the local shadows
+    std::vector<unsigned int> pending;
+    std::vector<std::pair<float, unsigned int>> candidates;
+
+    void updateCascades(const Camera& camera, const Light& light);
+    void updateLocal(unsigned int slot, const Light& light);
+    void setMatrix(unsigned int map, const glm::mat4& viewProjection, float texel, float texelPerDistance);
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+
+#include <common/maths.hpp>
+
+// Mesh table entry of static content, bounds in object space
+struct StaticMesh
+{
+    const char* name;
+    const char* path;
+    Vec3 boundsMin, boundsMax;
+};
+
+// Material table entry of static content
+struct StaticMaterial
+{
+    const char* name;
+    const char* texture;
+    float ka, kd, ks, Ns;
+};
+
+// Object placed in code, the angle is in degrees like the text format
+struct StaticObject
+{
+    uint32_t mesh, material;
+    Vec3 position;
+    Vec3 scale;
+    Vec3 axis;
+    float angle;
+};
+
+// Object arrays of a static scene along with the model matrices and world
+// space bounds. Declared constexpr the compiler works all of it out and the
+// scene lives in the read only data of the binary, Scene::loadStatic points
+// straight at the arrays.
+template <size_t N>
+struct StaticScene
+{
+    const StaticMesh* meshes;
+    unsigned int meshCount;
+    const StaticMaterial* materials;
+    unsigned int materialCount;
+
+    Vec3 positions[N];
+    Vec3 scales[N];
+    Vec3 axes[N];
+    float angles[N];                // radians
+    uint32_t meshIDs[N];
+    uint32_t materialIDs[N];
+    Vec3 boundsMin[N];              // world space
+    Vec3 boundsMax[N];
+    Mat4 models[N];
+    Vec3 sceneMin, sceneMax;
+};
+
+// Bake a static scene from its tables and objects, the same maths as
+// Scene::addObject
+template <size_t M, size_t T, size_t N>
+constexpr StaticScene<N> bakeScene(const StaticMesh (&meshes)[M], const StaticMaterial (&materials)[T],
+                                   const StaticObject (&objects)[N])
+{
+    StaticScene<N> scene{};
+    scene.meshes = meshes;
+    scene.meshCount = M;
+    scene.materials = materials;
+    scene.materialCount = T;
+    scene.sceneMin = Vec3{ FLT_MAX, FLT_MAX, FLT_MAX };
+    scene.sceneMax = Vec3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (size_t i = 0; i < N; i++)
+    {
+        const StaticObject& object = objects[i];
+        float angle = Maths::radians(object.angle);
+        scene.positions[i] = object.position;
+        scene.scales[i] = object.scale;
+        scene.axes[i] = object.axis;
+        scene.angles[i] = angle;
+        scene.meshIDs[i] = object.mesh;
+        scene.materialIDs[i] = object.material;
+
+        // Rotations about a world axis skip the general form
+        Mat4 rotation = Maths::rotate(angle, object.axis);
+        if (object.axis.y == 0.0f && object.axis.z == 0.0f && object.axis.x > 0.0f)
+            rotation = Maths::rotateX(angle);
+        else if (object.axis.x == 0.0f && object.axis.z == 0.0f && object.axis.y > 0.0f)
+            rotation = Maths::rotateY(angle);
+        else if (object.axis.x == 0.0f && object.axis.y == 0.0f && object.axis.z > 0.0f)
+            rotation = Maths::rotateZ(angle);
+        Mat4 model = Maths::translate(object.position) * rotation * Maths::scale(object.scale);
+        scene.models[i] = model;
+
+        // World space bounds from the centre and the extents projected with
+        // the absolute matrix, as AABB::transformed
+        const StaticMesh& mesh = meshes[object.mesh];
+        Vec3 centre{ (mesh.boundsMin.x + mesh.boundsMax.x) * 0.5f, (mesh.boundsMin.y + mesh.boundsMax.y) * 0.5f,
+                     (mesh.boundsMin.z + mesh.boundsMax.z) * 0.5f };
+        float extents[3] = { (mesh.boundsMax.x - mesh.boundsMin.x) * 0.5f, (mesh.boundsMax.y - mesh.boundsMin.y) * 0.5f,
+                             (mesh.boundsMax.z - mesh.boundsMin.z) * 0.5f };
+        Vec3 c = Maths::transformPoint(model, centre);
+        float e[3] = {};
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+            {
+                float v = model.m[col][row];
+                e[row] += (v < 0.0f ? -v : v) * extents[col];
+            }
+        scene.boundsMin[i] = Vec3{ c.x - e[0], c.y - e[1], c.z - e[2] };
+        scene.boundsMax[i] = Vec3{ c.x + e[0], c.y + e[1], c.z + e[2] };
+
+        scene.sceneMin.x = scene.boundsMin[i].x < scene.sceneMin.x ? scene.boundsMin[i].x : scene.sceneMin.x;
+        scene.sceneMin.y = scene.boundsMin[i].y < scene.sceneMin.y ? scene.boundsMin[i].y : scene.sceneMin.y;
+        scene.sceneMin.z = scene.boundsMin[i].z < scene.sceneMin.z ? scene.boundsMin[i].z : scene.sceneMin.z;
+        scene.sceneMax.x = scene.boundsMax[i].x > scene.sceneMax.x ? scene.boundsMax[i].x : scene.sceneMax.x;
+        scene.sceneMax.y = scene.boundsMax[i].y > scene.sceneMax.y ? scene.boundsMax[i].y : scene.sceneMax.y;
+        scene.sceneMax.z = scene.boundsMax[i].z > scene.sceneMax.z ? scene.boundsMax[i].z : scene.sceneMax.z;
+    }
+
+    return scene;
+}
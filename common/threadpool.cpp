@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include <common/threadpool.hpp>
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+    active = 0;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+    for (unsigned int i = 0; i < threads; i++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    // Without workers run the job straight away
+    if (workers.empty())
+    {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (jobCount == jobs.size())
+        {
+            // Unwrap the ring into one twice the size
+            std::vector<std::function<void()>> grown(std::max<size_t>(16, 2 * jobs.size()));
+            for (size_t i = 0; i < jobCount; i++)
+                grown[i] = std::move(jobs[(jobHead + i) % jobs.size()]);
+            jobs.swap(grown);
+            jobHead = 0;
+        }
+        jobs[(jobHead + jobCount) % jobs.size()] = std::move(job);
+        jobCount++;
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsFinished.wait(lock, [this] { return jobCount == 0 && active == 0; });
+}
+
+void ThreadPool::runLoop(unsigned int count, const std::function<void(unsigned int)>& job)
+{
+    if (count == 0)
+        return;
+
+    // A helper that starts late still reads the state of its loop, so a
+    // state is only reused once all its helpers have returned
+    Loop* loop = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned int i = 0; i < loops.size() && loop == nullptr; i++)
+            if (!loops[i]->inUse && loops[i]->helpers.load() == 0)
+                loop = loops[i].get();
+
+        if (loop == nullptr)
+        {
+            loops.push_back(std::unique_ptr<Loop>(new Loop()));
+            loop = loops.back().get();
+        }
+        loop->inUse = true;
+    }
+    loop->next = 0;
+    loop->finished = 0;
+    loop->count = count;
+    loop->job = &job;
+
+    // Enlist the workers and take part on the calling thread
+    unsigned int helpers = std::min(size(), count - 1);
+    loop->helpers = helpers;
+    for (unsigned int i = 0; i < helpers; i++)
+    {
+        submit([loop]
+        {
+            runItems(*loop);
+            loop->helpers.fetch_sub(1);
+        });
+    }
+    runItems(*loop);
+
+    {
+        std::unique_lock<std::mutex> lock(loop->mutex);
+        loop->done.wait(lock, [&] { return loop->finished.load() == count; });
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    loop->inUse = false;
+}
+
+void ThreadPool::runItems(Loop& loop)
+{
+    unsigned int i;
+    while ((i = loop.next.fetch_add(1)) < loop.count)
+    {
+        (*loop.job)(i);
+        if (loop.finished.fetch_add(1) + 1 == loop.count)
+        {
+            std::lock_guard<std::mutex> lock(loop.mutex);
+            loop.done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || jobCount > 0; });
+            if (stopping && jobCount == 0)
+                return;
+
+            job = std::move(jobs[jobHead]);
+            jobs[jobHead] = nullptr;
+            jobHead = (jobHead + 1) % jobs.size();
+            jobCount--;
+            active++;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+            if (jobCount == 0 && active == 0)
+                jobsFinished.notify_all();
+        }
+    }
+}
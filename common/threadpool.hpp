@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+// Pool of worker threads shared by the CPU side systems. Jobs can be
+// submitted to run in the background or spread over the workers with
+// parallelFor(), in which case the calling thread also takes part so the
+// loop completes even when the workers are busy. Once the queue and the loop
+// states have grown to their working size neither call allocates.
+class ThreadPool
+{
+public:
+    // Constructor, zero threads uses one less than the number of cores
+    ThreadPool(unsigned int threads = 0);
+    ~ThreadPool();
+
+    // Run a job on a worker thread
+    void submit(std::function<void()> job);
+
+    // Call job(i) for i = 0, ..., count - 1 and wait until all have finished.
+    // The job is passed on by reference so std::function never allocates.
+    template <typename Job>
+    void parallelFor(unsigned int count, const Job& job)
+    {
+        runLoop(count, std::function<void(unsigned int)>([&job](unsigned int i) { job(i); }));
+    }
+
+    // Wait until all submitted jobs have finished
+    void wait();
+
+    // Number of worker threads
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // Number of workers currently running a job
+    unsigned int busy() const { return active.load(); }
+
+private:
+    // State of a parallelFor, reused once no helper job refers to it
+    struct Loop
+    {
+        std::atomic<unsigned int> next{ 0 };
+        std::atomic<unsigned int> finished{ 0 };
+        std::atomic<unsigned int> helpers{ 0 };  // helper jobs that haven't returned
+        unsigned int count = 0;
+        const std::function<void(unsigned int)>* job = nullptr;
+        bool inUse = false;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    std::vector<std::thread> workers;
+
+    // Ring of queued jobs, it doubles when full
+    std::vector<std::function<void()>> jobs;
+    size_t jobHead = 0, jobCount = 0;
+    std::vector<std::unique_ptr<Loop>> loops;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsFinished;
+    std::atomic<unsigned int> active;
+    bool stopping = false;
+
+    void runLoop(unsigned int count, const std::function<void(unsigned int)>& job);
+    static void runItems(Loop& loop);
+    void workerLoop();
+};
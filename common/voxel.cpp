@@ -0,0 +1,380 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <common/voxel.hpp>
+
+// Integer division rounding towards negative infinity
+static int floorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+VoxelWorld::VoxelWorld()
+{
+    // Empty space
+    blockTypes.push_back({ "air", false, 0 });
+}
+
+BlockID VoxelWorld::addBlockType(const std::string& name, bool opaque, int layer)
+{
+    blockTypes.push_back({ name, opaque, layer });
+    return static_cast<BlockID>(blockTypes.size() - 1);
+}
+
+BlockID VoxelWorld::findBlockType(const std::string& name) const
+{
+    for (unsigned int i = 1; i < blockTypes.size(); i++)
+        if (blockTypes[i].name == name)
+            return static_cast<BlockID>(i);
+
+    return 0;
+}
+
+glm::ivec3 VoxelWorld::chunkCoord(const glm::ivec3& block)
+{
+    return glm::ivec3(floorDiv(block.x, Chunk::size),
+                      floorDiv(block.y, Chunk::size),
+                      floorDiv(block.z, Chunk::size));
+}
+
+unsigned long long VoxelWorld::chunkKey(const glm::ivec3& coord)
+{
+    // Pack 21 bits of each coordinate
+    const unsigned long long mask = (1ull << 21) - 1;
+    return (static_cast<unsigned long long>(coord.x) & mask) |
+           ((static_cast<unsigned long long>(coord.y) & mask) << 21) |
+           ((static_cast<unsigned long long>(coord.z) & mask) << 42);
+}
+
+glm::ivec3 VoxelWorld::worldToBlock(const glm::vec3& position) const
+{
+    glm::vec3 p = position / blockSize;
+    return glm::ivec3(static_cast<int>(std::floor(p.x + 0.5f)),
+                      static_cast<int>(std::floor(p.y + 0.5f)),
+                      static_cast<int>(std::floor(p.z + 0.5f)));
+}
+
+Chunk* VoxelWorld::getChunk(const glm::ivec3& coord)
+{
+    auto it = chunks.find(chunkKey(coord));
+    return it == chunks.end() ? nullptr : &it->second;
+}
+
+const Chunk* VoxelWorld::getChunk(const glm::ivec3& coord) const
+{
+    auto it = chunks.find(chunkKey(coord));
+    return it == chunks.end() ? nullptr : &it->second;
+}
+
+BlockID VoxelWorld::getBlock(const glm::ivec3& block) const
+{
+    glm::ivec3 coord = chunkCoord(block);
+    const Chunk* chunk = getChunk(coord);
+    if (chunk == nullptr)
+        return 0;
+
+    glm::ivec3 local = block - coord * Chunk::size;
+    return chunk->get(local.x, local.y, local.z);
+}
+
+void VoxelWorld::setBlock(const glm::ivec3& block, BlockID id)
+{
+    glm::ivec3 coord = chunkCoord(block);
+    Chunk* chunk = getChunk(coord);
+    if (chunk == nullptr)
+    {
+        if (id == 0)
+            return;
+
+        // Create an empty chunk
+        chunk = &chunks[chunkKey(coord)];
+        chunk->coord = coord;
+        chunk->dirty = false;
+        memset(chunk->blocks, 0, sizeof(chunk->blocks));
+    }
+
+    glm::ivec3 local = block - coord * Chunk::size;
+    BlockID& current = chunk->blocks[(local.z * Chunk::size + local.y) * Chunk::size + local.x];
+    if (current == id)
+        return;
+
+    chunk->blockCount += (id != 0) - (current != 0);
+    current = id;
+    markDirty(coord);
+
+    // Neighbouring chunks sharing a face with the block
+    for (int i = 0; i < 3; i++)
+    {
+        glm::ivec3 offset(0);
+        if (local[i] == 0)
+            offset[i] = -1;
+        else if (local[i] == Chunk::size - 1)
+            offset[i] = 1;
+        else
+            continue;
+
+        if (getChunk(coord + offset) != nullptr)
+            markDirty(coord + offset);
+    }
+}
+
+void VoxelWorld::markDirty(const glm::ivec3& coord)
+{
+    Chunk* chunk = getChunk(coord);
+    if (chunk == nullptr || chunk->dirty)
+        return;
+
+    chunk->dirty = true;
+    dirtyChunks.push_back(coord);
+}
+
+bool VoxelWorld::raycast(const Ray& ray, float maxDistance, glm::ivec3& block, glm::ivec3& normal) const
+{
+    // Step through the blocks along the ray (Amanatides and Woo)
+    glm::vec3 origin = ray.origin / blockSize + 0.5f;
+    glm::ivec3 p = glm::ivec3(glm::floor(origin));
+    glm::ivec3 step;
+    glm::vec3 tMax, tDelta;
+    for (int i = 0; i < 3; i++)
+    {
+        step[i] = ray.direction[i] >= 0.0f ? 1 : -1;
+        tDelta[i] = std::abs(blockSize * ray.invDirection[i]);
+        float boundary = step[i] > 0 ? p[i] + 1.0f - origin[i] : origin[i] - p[i];
+        tMax[i] = ray.direction[i] != 0.0f ? boundary * tDelta[i] : FLT_MAX;
+    }
+
+    normal = glm::ivec3(0);
+    float t = 0.0f;
+    while (t <= maxDistance)
+    {
+        if (getBlock(p) != 0)
+        {
+            block = p;
+            return true;
+        }
+
+        // Advance to the nearest block boundary
+        int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        t = tMax[axis];
+        tMax[axis] += tDelta[axis];
+        p[axis] += step[axis];
+        normal = glm::ivec3(0);
+        normal[axis] = -step[axis];
+    }
+
+    return false;
+}
+
+AABB VoxelWorld::chunkBounds(const glm::ivec3& coord) const
+{
+    glm::vec3 min = glm::vec3(coord * Chunk::size) * blockSize - 0.5f * blockSize;
+    return AABB(min, min + glm::vec3(Chunk::size * blockSize));
+}
+
+unsigned int VoxelWorld::blockCount() const
+{
+    unsigned int count = 0;
+    for (auto it = chunks.begin(); it != chunks.end(); ++it)
+        count += it->second.blockCount;
+
+    return count;
+}
+
+void VoxelWorld::gatherChunk(const glm::ivec3& coord, PaddedChunk& padded) const
+{
+    const int S = Chunk::size;
+    padded.coord = coord;
+    memset(padded.blocks, 0, sizeof(padded.blocks));
+
+    // Copy the 3x3x3 neighbourhood of chunks clipped to the padded region
+    for (int cz = -1; cz <= 1; cz++)
+    for (int cy = -1; cy <= 1; cy++)
+    for (int cx = -1; cx <= 1; cx++)
+    {
+        const Chunk* chunk = getChunk(coord + glm::ivec3(cx, cy, cz));
+        if (chunk == nullptr || chunk->blockCount == 0)
+            continue;
+
+        // Range of local coordinates of the neighbour inside the padded region
+        glm::ivec3 offset = glm::ivec3(cx, cy, cz) * S;
+        glm::ivec3 lo, hi;
+        for (int i = 0; i < 3; i++)
+        {
+            lo[i] = glm::max(0, -1 - offset[i]);
+            hi[i] = glm::min(S - 1, S - offset[i]);
+        }
+
+        for (int z = lo.z; z <= hi.z; z++)
+        for (int y = lo.y; y <= hi.y; y++)
+        {
+            int px = offset.x + lo.x + 1, py = offset.y + y + 1, pz = offset.z + z + 1;
+            memcpy(&padded.blocks[(pz * PaddedChunk::size + py) * PaddedChunk::size + px],
+                   &chunk->blocks[(z * S + y) * S + lo.x], hi.x - lo.x + 1);
+        }
+    }
+}
+
+void VoxelWorld::meshChunk(const glm::ivec3& coord, ChunkMesh& mesh) const
+{
+    PaddedChunk padded;
+    gatherChunk(coord, padded);
+    greedyMesh(padded, mesh);
+}
+
+void VoxelWorld::greedyMesh(const PaddedChunk& padded, ChunkMesh& mesh) const
+{
+    const int S = Chunk::size;
+    mesh.clear();
+
+    BlockID mask[S * S];
+    glm::ivec3 base = padded.coord * S;
+
+    // Row of the lightmap being filled
+    int rowX = 0, rowY = 0, rowHeight = 0;
+
+    // Sweep each axis in both directions
+    for (int d = 0; d < 3; d++)
+    {
+        int u = (d + 1) % 3;
+        int v = (d + 2) % 3;
+
+        for (int side = 0; side < 2; side++)
+        {
+            glm::ivec3 step(0);
+            step[d] = side == 1 ? 1 : -1;
+            glm::vec3 normal = glm::vec3(step);
+
+            for (int slice = 0; slice < S; slice++)
+            {
+                // Mask of the visible faces in this slice. A face is dropped
+                // when the neighbour is opaque or is the same transparent block
+                glm::ivec3 p;
+                p[d] = slice;
+                for (int j = 0; j < S; j++)
+                {
+                    p[v] = j;
+                    for (int i = 0; i < S; i++)
+                    {
+                        p[u] = i;
+                        BlockID a = padded.get(p.x, p.y, p.z);
+                        BlockID n = padded.get(p.x + step.x, p.y + step.y, p.z + step.z);
+                        bool visible = a != 0 && (n == 0 || (!blockTypes[n].opaque && n != a));
+                        mask[j * S + i] = visible ? a : 0;
+                    }
+                }
+
+                // Merge rectangles of the same block type
+                for (int j = 0; j < S; j++)
+                {
+                    for (int i = 0; i < S;)
+                    {
+                        BlockID id = mask[j * S + i];
+                        if (id == 0)
+                        {
+                            i++;
+                            continue;
+                        }
+
+                        // Extend along u then along v
+                        int w = 1;
+                        while (i + w < S && mask[j * S + i + w] == id)
+                            w++;
+
+                        int h = 1;
+                        for (; j + h < S; h++)
+                        {
+                            int k = 0;
+                            while (k < w && mask[(j + h) * S + i + k] == id)
+                                k++;
+                            if (k < w)
+                                break;
+                        }
+
+                        // Corners of the quad in block coordinates
+                        glm::ivec3 corner[4];
+                        corner[0] = base;
+                        corner[0][d] += slice + side;
+                        corner[0][u] += i;
+                        corner[0][v] += j;
+                        glm::ivec3 du(0), dv(0);
+                        du[u] = w;
+                        dv[v] = h;
+                        corner[1] = corner[0] + du;
+                        corner[2] = corner[0] + du + dv;
+                        corner[3] = corner[0] + dv;
+
+                        // Pack the face into the lightmap, starting a new row
+                        // when it doesn't fit in the current one
+                        LightmapFace face;
+                        face.width = w * lightmapTexels;
+                        face.height = h * lightmapTexels;
+                        if (rowX + face.width + 2 > lightmapWidth)
+                        {
+                            rowX = 0;
+                            rowY += rowHeight;
+                            rowHeight = 0;
+                        }
+                        face.x = rowX;
+                        face.y = rowY;
+                        face.origin = glm::vec3(corner[0]) * blockSize - 0.5f * blockSize;
+                        face.u = glm::vec3(du) * blockSize / static_cast<float>(face.width);
+                        face.v = glm::vec3(dv) * blockSize / static_cast<float>(face.height);
+                        face.normal = normal;
+                        mesh.lightmapFaces.push_back(face);
+                        rowX += face.width + 2;
+                        rowHeight = std::max(rowHeight, face.height + 2);
+                        mesh.lightmapHeight = rowY + rowHeight;
+                        const glm::vec2 lightmapCorner[4] = {
+                            glm::vec2(0.0f, 0.0f), glm::vec2(face.width, 0.0f),
+                            glm::vec2(face.width, face.height), glm::vec2(0.0f, face.height)
+                        };
+
+                        // Add the vertices, texture co-ordinates repeat once per block
+                        // with v pointing up on the side faces
+                        unsigned int first = static_cast<unsigned int>(mesh.vertices.size());
+                        float layer = static_cast<float>(blockTypes[id].layer);
+                        for (int c = 0; c < 4; c++)
+                        {
+                            glm::vec3 g = glm::vec3(corner[c]);
+                            glm::vec2 uv;
+                            if (d == 0)
+                                uv = glm::vec2(side == 1 ? -g.z : g.z, g.y);
+                            else if (d == 1)
+                                uv = glm::vec2(g.x, side == 1 ? -g.z : g.z);
+                            else
+                                uv = glm::vec2(side == 1 ? g.x : -g.x, g.y);
+
+                            VoxelVertex vertex;
+                            vertex.position = g * blockSize - 0.5f * blockSize;
+                            vertex.uv = uv;
+                            vertex.normal = normal;
+                            vertex.layer = layer;
+                            vertex.lightmapUV = glm::vec2(face.x + 1, face.y + 1) + lightmapCorner[c];
+                            mesh.vertices.push_back(vertex);
+                        }
+
+                        // Counter-clockwise when seen from the side the face points to
+                        static const unsigned int front[6] = { 0, 1, 2, 0, 2, 3 };
+                        static const unsigned int back[6] = { 0, 2, 1, 0, 3, 2 };
+                        const unsigned int* order = side == 1 ? front : back;
+                        for (int k = 0; k < 6; k++)
+                            mesh.indices.push_back(first + order[k]);
+
+                        // Opaque faces hide what is behind them
+                        if (blockTypes[id].opaque)
+                            for (int k = 0; k < 6; k++)
+                                mesh.occluders.push_back(mesh.vertices[first + order[k]].position);
+
+                        // Clear the merged faces
+                        for (int y = 0; y < h; y++)
+                            for (int x = 0; x < w; x++)
+                                mask[(j + y) * S + i + x] = 0;
+
+                        i += w;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include <common/bounds.hpp>
+
+// Block identifier, zero is empty space
+typedef unsigned char BlockID;
+
+// Block type properties
+struct BlockType
+{
+    std::string name;
+    bool opaque;
+    int layer;      // texture array layer
+};
+
+// Cube of blocks stored in x, y, z order
+struct Chunk
+{
+    static constexpr int size = 16;
+    static constexpr int volume = size * size * size;
+
+    glm::ivec3 coord;
+    BlockID blocks[volume];
+    unsigned int blockCount = 0;
+    bool dirty = false;
+
+    BlockID get(int x, int y, int z) const { return blocks[(z * size + y) * size + x]; }
+};
+
+// Interleaved vertex of a chunk mesh, the lightmap co-ordinates are in texels
+struct VoxelVertex
+{
+    glm::vec3 position;
+    glm::vec2 uv;
+    glm::vec3 normal;
+    float layer;
+    glm::vec2 lightmapUV;
+};
+
+// Merged face of a chunk mesh and its rectangle in the chunk's lightmap. The
+// rectangle has a one texel border around the texels of the face, texel
+// (i, j) inside it covers origin + (i + 0.5) u + (j + 0.5) v.
+struct LightmapFace
+{
+    glm::vec3 origin;
+    glm::vec3 u, v;         // world space size of a texel along each side
+    glm::vec3 normal;
+    int x, y;               // corner of the rectangle, including the border
+    int width, height;      // texels of the face, excluding the border
+};
+
+// Mesh data of a chunk, one vertex buffer and one index buffer. The merged
+// faces of opaque blocks are also kept as a triangle list for occlusion culling.
+// Every merged face is packed into the chunk's lightmap in rows.
+struct ChunkMesh
+{
+    std::vector<VoxelVertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> occluders;
+    std::vector<LightmapFace> lightmapFaces;
+    int lightmapHeight = 0;
+
+    unsigned int triangleCount() const { return static_cast<unsigned int>(indices.size() / 3); }
+    void clear() { vertices.clear(); indices.clear(); occluders.clear(); lightmapFaces.clear(); lightmapHeight = 0; }
+};
+
+// Blocks of a chunk with a one block border copied from the neighbouring
+// chunks so that it can be meshed without touching the world
+struct PaddedChunk
+{
+    static constexpr int size = Chunk::size + 2;
+
+    glm::ivec3 coord;
+    BlockID blocks[size * size * size];
+
+    BlockID get(int x, int y, int z) const { return blocks[((z + 1) * size + y + 1) * size + x + 1]; }
+};
+
+// Chunked voxel world. Block v covers the cube of side blockSize centred at
+// v * blockSize, matching the cube.obj model scaled by one.
+class VoxelWorld
+{
+public:
+    float blockSize = 2.0f;
+
+    // Lightmap texels along the edge of a block face, and the width of the
+    // lightmap of a chunk
+    static constexpr int lightmapTexels = 4;
+    static constexpr int lightmapWidth = 256;
+
+    // Block types, the index is the block ID and entry 0 is empty space
+    std::vector<BlockType> blockTypes;
+
+    // Chunks indexed by packed chunk coordinates
+    std::unordered_map<unsigned long long, Chunk> chunks;
+
+    // Constructor
+    VoxelWorld();
+
+    // Block types
+    BlockID addBlockType(const std::string& name, bool opaque, int layer);
+    BlockID findBlockType(const std::string& name) const;
+
+    // Chunks marked dirty by edits and waiting to be remeshed
+    std::vector<glm::ivec3> dirtyChunks;
+
+    // Block access, setting a block on the border of a chunk also marks the
+    // neighbour sharing that face as dirty
+    BlockID getBlock(const glm::ivec3& block) const;
+    void setBlock(const glm::ivec3& block, BlockID id);
+    glm::ivec3 worldToBlock(const glm::vec3& position) const;
+
+    // First block hit by a ray along with the normal of the face hit
+    bool raycast(const Ray& ray, float maxDistance, glm::ivec3& block, glm::ivec3& normal) const;
+
+    // Chunk access
+    Chunk* getChunk(const glm::ivec3& coord);
+    const Chunk* getChunk(const glm::ivec3& coord) const;
+    AABB chunkBounds(const glm::ivec3& coord) const;
+    unsigned int blockCount() const;
+    void markDirty(const glm::ivec3& coord);
+
+    // Meshing
+    void gatherChunk(const glm::ivec3& coord, PaddedChunk& padded) const;
+    void meshChunk(const glm::ivec3& coord, ChunkMesh& mesh) const;
+    void greedyMesh(const PaddedChunk& padded, ChunkMesh& mesh) const;
+
+    // Coordinate helpers
+    static glm::ivec3 chunkCoord(const glm::ivec3& block);
+    static unsigned long long chunkKey(const glm::ivec3& coord);
+};
@@ -0,0 +1,151 @@
+#include <cstdio>
+#include <cstddef>
+
+#include <common/voxelrenderer.hpp>
+#include <common/stb_image.hpp>
+#include <common/glstate.hpp>
+
+void VoxelRenderer::loadTextures(const std::vector<std::string>& paths, int size)
+{
+    textureArray.create("Block textures");
+    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, size, size, static_cast<int>(paths.size()), 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    textureArray.setBytes(GLResourceTracker::textureBytes(size, size, static_cast<int>(paths.size()), 4, true));
+
+    std::vector<unsigned char> layer(size * size * 4);
+    stbi_set_flip_vertically_on_load(true);
+    for (unsigned int i = 0; i < paths.size(); i++)
+    {
+        int width, height, nChannels;
+        unsigned char *data = stbi_load(paths[i].c_str(), &width, &height, &nChannels, 4);
+        if (data == NULL)
+        {
+            printf("Texture %s failed to load.\n", paths[i].c_str());
+            continue;
+        }
+
+        // Resample to the size of the array
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                const unsigned char* texel = &data[4 * ((y * height / size) * width + x * width / size)];
+                for (int c = 0; c < 4; c++)
+                    layer[4 * (y * size + x) + c] = texel[c];
+            }
+        }
+
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, &layer[0]);
+        stbi_image_free(data);
+    }
+    stbi_set_flip_vertically_on_load(false);
+
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void VoxelRenderer::upload(const VoxelWorld& world, const glm::ivec3& coord, const ChunkMesh& mesh)
+{
+    unsigned long long key = VoxelWorld::chunkKey(coord);
+    if (mesh.indices.empty())
+    {
+        remove(coord);
+        return;
+    }
+
+    // Create the back buffers the first time they are used
+    ChunkBuffers& chunk = chunks[key];
+    int back = 1 - chunk.front;
+    if (chunk.VAO[back] == 0)
+    {
+        chunk.coord = coord;
+        chunk.bounds = world.chunkBounds(coord);
+
+        chunk.VAO[back].create("Chunk");
+        GLState::bindVertexArray(chunk.VAO[back]);
+        chunk.vertexBuffer[back].create("Chunk vertices");
+        chunk.indexBuffer[back].create("Chunk indices");
+        GLState::bindBuffer(GL_ARRAY_BUFFER, chunk.vertexBuffer[back]);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.indexBuffer[back]);
+
+        // Interleaved position, uv, normal, texture layer and lightmap uv
+        GLsizei stride = sizeof(VoxelVertex);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VoxelVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VoxelVertex, uv));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VoxelVertex, normal));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VoxelVertex, layer));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VoxelVertex, lightmapUV));
+    }
+    else
+    {
+        GLState::bindVertexArray(chunk.VAO[back]);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, chunk.vertexBuffer[back]);
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(VoxelVertex), &mesh.vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), &mesh.indices[0], GL_STATIC_DRAW);
+    chunk.vertexBuffer[back].setBytes(mesh.vertices.size() * sizeof(VoxelVertex));
+    chunk.indexBuffer[back].setBytes(mesh.indices.size() * sizeof(unsigned int));
+    chunk.indexCount[back] = static_cast<unsigned int>(mesh.indices.size());
+    GLState::bindVertexArray(0);
+
+    // Swap the buffers
+    chunk.front = back;
+    chunk.occluders = mesh.occluders;
+    chunk.lightmapFaces = mesh.lightmapFaces;
+    chunk.lightmapHeight = mesh.lightmapHeight;
+    chunk.lightmapped = false;
+    changed.push_back(chunk.bounds);
+}
+
+void VoxelRenderer::remove(const glm::ivec3& coord)
+{
+    auto it = chunks.find(VoxelWorld::chunkKey(coord));
+    if (it == chunks.end())
+        return;
+
+    // The handles delete the buffers
+    changed.push_back(it->second.bounds);
+    chunks.erase(it);
+}
+
+void VoxelRenderer::bind(unsigned int program) const
+{
+    GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, textureArray);
+    GLState::uniform1i(glGetUniformLocation(program, "diffuseMap"), 0);
+    GLState::uniform1f(glGetUniformLocation(program, "ka"), ka);
+    GLState::uniform1f(glGetUniformLocation(program, "kd"), kd);
+    GLState::uniform1f(glGetUniformLocation(program, "ks"), ks);
+    GLState::uniform1f(glGetUniformLocation(program, "Ns"), Ns);
+}
+
+void VoxelRenderer::draw(const ChunkBuffers& chunk) const
+{
+    GLState::bindVertexArray(chunk.VAO[chunk.front]);
+    glDrawElements(GL_TRIANGLES, chunk.indexCount[chunk.front], GL_UNSIGNED_INT, (void*)0);
+}
+
+unsigned int VoxelRenderer::triangleCount() const
+{
+    unsigned int count = 0;
+    for (auto it = chunks.begin(); it != chunks.end(); ++it)
+        count += it->second.indexCount[it->second.front] / 3;
+
+    return count;
+}
+
+void VoxelRenderer::deleteBuffers()
+{
+    chunks.clear();
+    changed.clear();
+    textureArray.release();
+}
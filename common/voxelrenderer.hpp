@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <common/voxel.hpp>
+#include <common/glresource.hpp>
+
+// GPU buffers of a chunk mesh. The buffers are double-buffered, a new mesh
+// is written to the back buffers which then become the front buffers so a
+// frame still using the old mesh doesn't stall the upload.
+struct ChunkBuffers
+{
+    glm::ivec3 coord;
+    AABB bounds;
+    GLVertexArray VAO[2];
+    GLBuffer vertexBuffer[2];
+    GLBuffer indexBuffer[2];
+    unsigned int indexCount[2] = { 0, 0 };
+    int front = 0;
+
+    // World space triangles of the opaque faces
+    std::vector<glm::vec3> occluders;
+
+    // Faces of the front mesh in the lightmap, which is only drawn once it
+    // has been baked for them
+    std::vector<LightmapFace> lightmapFaces;
+    int lightmapHeight = 0;
+    GLTexture lightmap;
+    bool lightmapped = false;
+};
+
+// Draws the chunks of a voxel world with one draw call per chunk. The block
+// textures are stored as the layers of a single texture array.
+class VoxelRenderer
+{
+public:
+    // Texture array of the block types
+    GLTexture textureArray;
+
+    // Buffers of each chunk indexed by packed chunk coordinates
+    std::unordered_map<unsigned long long, ChunkBuffers> chunks;
+
+    // Bounds of the chunks uploaded or removed, cleared by the caller
+    std::vector<AABB> changed;
+
+    // Material of the blocks in the lit shaders, as in the scene file
+    float ka = 0.2f;
+    float kd = 0.7f;
+    float ks = 1.0f;
+    float Ns = 20.0f;
+
+    // Load the textures into an array, each is resampled to size x size
+    void loadTextures(const std::vector<std::string>& paths, int size = 256);
+
+    // Upload the mesh of a chunk to its back buffers and swap them to the front
+    void upload(const VoxelWorld& world, const glm::ivec3& coord, const ChunkMesh& mesh);
+    void remove(const glm::ivec3& coord);
+
+    // Bind the texture array to unit 0 and send the block material to a
+    // program in use
+    void bind(unsigned int program) const;
+
+    // Draw a chunk, the texture array must be bound
+    void draw(const ChunkBuffers& chunk) const;
+
+    // Number of triangles in the uploaded chunks
+    unsigned int triangleCount() const;
+
+    // Cleanup
+    void deleteBuffers();
+};
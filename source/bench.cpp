@@ -0,0 +1,926 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <common/stb_image.hpp>
+
+#include <common/maths.hpp>
+#include <common/matrixbatch.hpp>
+#include <common/camera.hpp>
+#include <common/model.hpp>
+#include <common/scene.hpp>
+#include <common/light.hpp>
+#include <common/lightclusters.hpp>
+#include <common/bvh.hpp>
+#include <common/voxel.hpp>
+#include <common/lightmap.hpp>
+#include <common/threadpool.hpp>
+#include <common/profiler.hpp>
+
+// Microbenchmarks of the CPU side of the renderer. None of them need a window
+// or a GL context. Each benchmark is calibrated to run for a minimum time per
+// repetition, the statistics are over the repetitions and the results can be
+// written as JSON and compared against a previous run.
+
+// Statistics of one benchmark, times are in nanoseconds per item
+struct BenchResult
+{
+    std::string name;
+    unsigned int repetitions = 0;
+    unsigned long long iterations = 0;  // calls per repetition
+    unsigned int items = 1;             // items processed per call
+    double min = 0.0, median = 0.0, mean = 0.0, stddev = 0.0, max = 0.0;
+};
+
+// Median of a benchmark in a baseline file
+struct BaselineEntry
+{
+    std::string name;
+    double median;
+};
+
+// Command line options
+struct BenchOptions
+{
+    std::string assets = "../assets";
+    std::string filter;
+    unsigned int repetitions = 10;
+    double minTime = 0.05;              // seconds per repetition
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+};
+BenchOptions options;
+
+std::vector<BenchResult> results;
+std::vector<BaselineEntry> baseline;
+bool failed = false;                    // a kernel didn't match its reference
+
+// Stores to a volatile keep the compiler from removing the measured work
+volatile float sink;
+
+void consume(const glm::mat4& m, glm::vec4& sum)
+{
+    sum += m[0] + m[1] + m[2] + m[3];
+}
+
+void consume(const glm::vec4& sum)
+{
+    sink = sum.x + sum.y + sum.z + sum.w;
+}
+
+double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const BaselineEntry* findBaseline(const std::string& name)
+{
+    for (unsigned int i = 0; i < baseline.size(); i++)
+        if (baseline[i].name == name)
+            return &baseline[i];
+
+    return nullptr;
+}
+
+// Time a function that processes a number of items per call
+void run(const std::string& name, unsigned int items, const std::function<void()>& function)
+{
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+        return;
+
+    // Calibrate the calls per repetition, this also warms the caches up
+    unsigned long long iterations = 1;
+    while (true)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long long i = 0; i < iterations; i++)
+            function();
+        double time = seconds(start);
+        if (time >= options.minTime)
+            break;
+
+        unsigned long long estimate = time > 0.0 ? static_cast<unsigned long long>(1.2 * iterations * options.minTime / time) : 0;
+        iterations = std::max(iterations * 2, std::min(estimate, iterations * 100));
+    }
+
+    std::vector<double> times(options.repetitions);
+    for (unsigned int r = 0; r < options.repetitions; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long long i = 0; i < iterations; i++)
+            function();
+        times[r] = 1e9 * seconds(start) / (static_cast<double>(iterations) * items);
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.repetitions = options.repetitions;
+    result.iterations = iterations;
+    result.items = items;
+    std::sort(times.begin(), times.end());
+    result.min = times.front();
+    result.max = times.back();
+    unsigned int n = static_cast<unsigned int>(times.size());
+    result.median = n % 2 == 1 ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+    for (unsigned int i = 0; i < n; i++)
+        result.mean += times[i] / n;
+    for (unsigned int i = 0; i < n; i++)
+        result.stddev += (times[i] - result.mean) * (times[i] - result.mean) / std::max(n - 1, 1u);
+    result.stddev = std::sqrt(result.stddev);
+    results.push_back(result);
+
+    // Report the change of the median against the baseline
+    printf("%-36s %12llu %12.2f %12.2f %12.2f %8.2f", name.c_str(), iterations, result.min, result.median,
+           result.mean, result.stddev);
+    const BaselineEntry* entry = findBaseline(name);
+    if (entry != nullptr && entry->median > 0.0)
+        printf(" %+9.1f%%", 100.0 * (result.median - entry->median) / entry->median);
+    printf("\n");
+}
+
+bool readFile(const std::string& path, std::vector<unsigned char>& data)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        printf("Impossible to open %s.\n", path.c_str());
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    data.resize(static_cast<size_t>(ftell(file)));
+    fseek(file, 0, SEEK_SET);
+    bool read = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return read;
+}
+
+// Grid of quads in the .obj layout loadObj reads, two triangles per quad
+bool writeGridObj(const char* path, unsigned int side)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("Impossible to write %s.\n", path);
+        return false;
+    }
+
+    for (unsigned int z = 0; z <= side; z++)
+        for (unsigned int x = 0; x <= side; x++)
+            fprintf(file, "v %f 0.000000 %f\n", static_cast<float>(x) / side - 0.5f, static_cast<float>(z) / side - 0.5f);
+    for (unsigned int z = 0; z <= side; z++)
+        for (unsigned int x = 0; x <= side; x++)
+            fprintf(file, "vt %f %f\n", static_cast<float>(x) / side, static_cast<float>(z) / side);
+    fprintf(file, "vn 0.000000 1.000000 0.000000\n");
+    for (unsigned int z = 0; z < side; z++)
+    {
+        for (unsigned int x = 0; x < side; x++)
+        {
+            unsigned int a = z * (side + 1) + x + 1, b = a + 1, c = a + side + 1, d = c + 1;
+            fprintf(file, "f %u/%u/1 %u/%u/1 %u/%u/1\n", a, a, c, c, b, b);
+            fprintf(file, "f %u/%u/1 %u/%u/1 %u/%u/1\n", b, b, c, c, d, d);
+        }
+    }
+    fclose(file);
+
+    return true;
+}
+
+void benchLoaders()
+{
+    // Small mesh from the assets and a generated one with half a million triangles
+    std::string cube = options.assets + "/cube.obj";
+    run("loadObj/cube", 1, [&]()
+    {
+        std::vector<glm::vec3> vertices, normals;
+        std::vector<glm::vec2> uvs;
+        Model::loadObj(cube.c_str(), vertices, uvs, normals);
+        sink = static_cast<float>(vertices.size());
+    });
+
+    const char* grid = "bench_grid.obj";
+    if (writeGridObj(grid, 512))
+    {
+        run("loadObj/grid_512", 1, [&]()
+        {
+            std::vector<glm::vec3> vertices, normals;
+            std::vector<glm::vec2> uvs;
+            Model::loadObj(grid, vertices, uvs, normals);
+            sink = static_cast<float>(vertices.size());
+        });
+        remove(grid);
+    }
+
+    // Decode from memory so only the decoder is timed, one item per pixel
+    const char* textures[] = { "oak_wood.jpg", "glass.png" };
+    for (unsigned int t = 0; t < 2; t++)
+    {
+        std::vector<unsigned char> data;
+        int width, height, channels;
+        if (!readFile(options.assets + "/" + textures[t], data) ||
+            !stbi_info_from_memory(data.data(), static_cast<int>(data.size()), &width, &height, &channels))
+            continue;
+
+        stbi_set_flip_vertically_on_load(true);
+        run(std::string("decode/") + textures[t], static_cast<unsigned int>(width * height), [&]()
+        {
+            int w, h, n;
+            unsigned char* pixels = stbi_load_from_memory(data.data(), static_cast<int>(data.size()), &w, &h, &n, 0);
+            sink = pixels != NULL ? pixels[0] : 0.0f;
+            stbi_image_free(pixels);
+        });
+    }
+}
+
+void benchMaths()
+{
+    // Random inputs so nothing is folded at compile time
+    const unsigned int count = 1024;
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    std::vector<glm::vec3> vectors(count), axes(count);
+    std::vector<float> angles(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        vectors[i] = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+        axes[i] = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+        angles[i] = distribution(generator);
+    }
+
+    run("Maths::translate", count, [&]()
+    {
+        glm::vec4 sum(0.0f);
+        for (unsigned int i = 0; i < count; i++)
+            consume(Maths::translate(vectors[i]), sum);
+        consume(sum);
+    });
+
+    run("Maths::rotate", count, [&]()
+    {
+        glm::vec4 sum(0.0f);
+        for (unsigned int i = 0; i < count; i++)
+            consume(Maths::rotate(angles[i], axes[i]), sum);
+        consume(sum);
+    });
+
+    run("Maths::scale", count, [&]()
+    {
+        glm::vec4 sum(0.0f);
+        for (unsigned int i = 0; i < count; i++)
+            consume(Maths::scale(vectors[i]), sum);
+        consume(sum);
+    });
+
+    run("Maths TRS", count, [&]()
+    {
+        glm::vec4 sum(0.0f);
+        for (unsigned int i = 0; i < count; i++)
+            consume(Maths::translate(vectors[i]) * Maths::rotate(angles[i], axes[i]) * Maths::scale(vectors[count - 1 - i]), sum);
+        consume(sum);
+    });
+
+    run("Maths::trs", count, [&]()
+    {
+        glm::vec4 sum(0.0f);
+        for (unsigned int i = 0; i < count; i++)
+            consume(Maths::trs(vectors[i], axes[i], angles[i], vectors[count - 1 - i]), sum);
+        consume(sum);
+    });
+
+    Camera camera(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f));
+    unsigned int frame = 0;
+    run("Camera::calculateMatrices", 1, [&]()
+    {
+        camera.yaw = angles[frame++ % count];
+        camera.target = camera.eye + camera.front;
+        camera.calculateMatrices();
+        glm::vec4 sum(0.0f);
+        consume(camera.view, sum);
+        consume(camera.projection, sum);
+        consume(sum);
+    });
+
+    // A camera that doesn't move only compares its inputs
+    run("Camera::calculateMatrices/still", 1, [&]()
+    {
+        camera.calculateMatrices();
+        glm::vec4 sum(0.0f);
+        consume(camera.viewProjection, sum);
+        consume(sum);
+    });
+}
+
+// Largest difference between two sets of matrices, relative to the size of
+// the reference values above one
+float maxError(const std::vector<glm::mat4>& result, const std::vector<glm::mat4>& reference)
+{
+    float error = 0.0f;
+    for (unsigned int i = 0; i < result.size(); i++)
+        for (unsigned int c = 0; c < 4; c++)
+            for (unsigned int r = 0; r < 4; r++)
+                error = std::max(error, std::fabs(result[i][c][r] - reference[i][c][r]) /
+                                        std::max(1.0f, std::fabs(reference[i][c][r])));
+    return error;
+}
+
+// Throughput of a benchmark that was run, in millions of matrices per second
+void printRate(const std::string& name, unsigned int matricesPerItem)
+{
+    for (unsigned int i = 0; i < results.size(); i++)
+        if (results[i].name == name && results[i].median > 0.0)
+            printf("%-36s %12.1f M matrices/s\n", name.c_str(), 1e3 * matricesPerItem / results[i].median);
+}
+
+void benchMatrixBatch()
+{
+    // Objects in the layout of a scene, picked through an index list like
+    // the visible objects of a frame
+    const unsigned int count = 4096;
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+    std::vector<glm::vec3> positions(count), axes(count), scales(count);
+    std::vector<float> angles(count);
+    std::vector<unsigned int> objects(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        positions[i] = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+        axes[i] = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+        scales[i] = glm::vec3(1.0f + 0.01f * std::fabs(distribution(generator)));
+        angles[i] = Maths::radians(distribution(generator) * 1.8f);
+        objects[i] = (i * 2654435761u) % count;
+    }
+    std::sort(objects.begin(), objects.end() - count / 2);
+
+    Camera camera(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(0.0f, 0.0f, 0.0f));
+    camera.calculateMatrices();
+
+    // The scalar kernels are the reference of the others
+    MatrixISA detected = MatrixBatch::isa;
+    std::vector<glm::mat4> referenceModels(count), referenceMV(count), referenceMVP(count);
+    MatrixBatch::isa = MatrixISA::Scalar;
+    MatrixBatch::composeTRS(count, positions.data(), axes.data(), angles.data(), scales.data(), objects.data(),
+                            referenceModels.data());
+    MatrixBatch::composeMVP(count, camera.view, camera.projection, referenceModels.data(), objects.data(),
+                            referenceMV.data(), referenceMVP.data());
+
+    const float tolerance = 1e-5f;
+    std::vector<glm::mat4> models(count), MV(count), MVP(count);
+    const MatrixISA kernels[] = { MatrixISA::Scalar, MatrixISA::SSE4, MatrixISA::AVX2 };
+    for (MatrixISA isa : kernels)
+    {
+        if (!MatrixBatch::supported(isa))
+            continue;
+
+        MatrixBatch::isa = isa;
+        std::string name = MatrixBatch::name(isa);
+        MatrixBatch::composeTRS(count, positions.data(), axes.data(), angles.data(), scales.data(), objects.data(),
+                                models.data());
+        MatrixBatch::composeMVP(count, camera.view, camera.projection, referenceModels.data(), objects.data(),
+                                MV.data(), MVP.data());
+        float error = std::max(maxError(models, referenceModels), std::max(maxError(MV, referenceMV), maxError(MVP, referenceMVP)));
+        if (error > tolerance)
+        {
+            printf("MatrixBatch %s differs from the scalar kernels by %g\n", name.c_str(), error);
+            failed = true;
+        }
+
+        run("MatrixBatch::composeTRS/" + name, count, [&]()
+        {
+            MatrixBatch::composeTRS(count, positions.data(), axes.data(), angles.data(), scales.data(), nullptr,
+                                    models.data());
+            glm::vec4 sum(0.0f);
+            consume(models[count - 1], sum);
+            consume(sum);
+        });
+
+        run("MatrixBatch::composeMVP/" + name, count, [&]()
+        {
+            MatrixBatch::composeMVP(count, camera.view, camera.projection, referenceModels.data(), objects.data(),
+                                    MV.data(), MVP.data());
+            glm::vec4 sum(0.0f);
+            consume(MVP[count - 1], sum);
+            consume(sum);
+        });
+    }
+
+    for (MatrixISA isa : kernels)
+    {
+        if (!MatrixBatch::supported(isa))
+            continue;
+        printRate("MatrixBatch::composeTRS/" + std::string(MatrixBatch::name(isa)), 1);
+        printRate("MatrixBatch::composeMVP/" + std::string(MatrixBatch::name(isa)), 2);
+    }
+    MatrixBatch::isa = detected;
+}
+
+void benchObjectLoop()
+{
+    // Objects scattered like the non-block objects of a large scene
+    Scene scene;
+    unsigned int cube = scene.addMesh("cube", options.assets + "/cube.obj");
+    SceneMaterial material;
+    material.name = "oak_wood";
+    material.texture = options.assets + "/oak_wood.jpg";
+    unsigned int wood = scene.addMaterial(material);
+
+    const unsigned int sizes[] = { 1000, 100000 };
+    for (unsigned int s = 0; s < 2; s++)
+    {
+        unsigned int count = sizes[s];
+        std::mt19937 generator(12345);
+        std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+        scene.clear();
+        scene.reserve(count);
+        for (unsigned int i = 0; i < count; i++)
+            scene.addObject(cube, wood, glm::vec3(distribution(generator), distribution(generator), distribution(generator)),
+                            glm::vec3(1.0f + 0.01f * std::fabs(distribution(generator))),
+                            glm::vec3(distribution(generator), distribution(generator), distribution(generator)),
+                            Maths::radians(distribution(generator)));
+
+        Camera camera(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(0.0f, 0.0f, 0.0f));
+        camera.calculateMatrices();
+
+        // The render loop multiplies the cached model matrices by the camera
+        std::vector<glm::mat4> modelMatrices(count);
+        for (unsigned int i = 0; i < count; i++)
+            modelMatrices[i] = scene.modelMatrix(i);
+
+        run("object loop/" + std::to_string(count), count, [&]()
+        {
+            glm::vec4 sum(0.0f);
+            for (unsigned int i = 0; i < count; i++)
+            {
+                glm::mat4 MV = camera.view * modelMatrices[i];
+                glm::mat4 MVP = camera.projection * MV;
+                consume(MV, sum);
+                consume(MVP, sum);
+            }
+            consume(sum);
+        });
+
+        // Rebuilding the model matrices from the scene every frame
+        run("object loop TRS/" + std::to_string(count), count, [&]()
+        {
+            glm::vec4 sum(0.0f);
+            for (unsigned int i = 0; i < count; i++)
+            {
+                glm::mat4 MV = camera.view * scene.modelMatrix(i);
+                glm::mat4 MVP = camera.projection * MV;
+                consume(MV, sum);
+                consume(MVP, sum);
+            }
+            consume(sum);
+        });
+    }
+}
+
+void benchLightClusters()
+{
+    // Point lights filling the view of a camera, each reaching a few metres
+    ThreadPool pool;
+    Camera camera(glm::vec3(0.0f, 0.0f, 60.0f), glm::vec3(0.0f, 0.0f, 0.0f));
+    camera.calculateMatrices();
+
+    const unsigned int sizes[] = { 256, 1024, 4096 };
+    for (unsigned int count : sizes)
+    {
+        std::mt19937 generator(12345);
+        std::uniform_real_distribution<float> distribution(-50.0f, 50.0f);
+        LightManager lights;
+        lights.add(Light::directional(glm::vec3(-0.3f, -1.0f, -0.2f), glm::vec3(0.6f)));
+        for (unsigned int i = 1; i < count; i++)
+            lights.add(Light::point(glm::vec3(distribution(generator), distribution(generator), distribution(generator)),
+                                    glm::vec3(1.0f), 1.0f, 1.0f, 8.0f));
+
+        // The scalar lists are the reference of the SSE ones
+        LightClusters clusters(pool);
+        clusters.simd = false;
+        clusters.build(camera, lights);
+        std::vector<std::vector<uint32_t>> reference(LightClusters::clusterCount);
+        for (unsigned int c = 0; c < LightClusters::clusterCount; c++)
+        {
+            unsigned int n = 0;
+            const uint32_t* list = clusters.clusterLights(c, n);
+            reference[c].assign(list, list + n);
+        }
+        clusters.simd = true;
+        lights.set(0, lights.get(0));
+        clusters.build(camera, lights);
+        for (unsigned int c = 0; c < LightClusters::clusterCount; c++)
+        {
+            unsigned int n = 0;
+            const uint32_t* list = clusters.clusterLights(c, n);
+            if (std::vector<uint32_t>(list, list + n) != reference[c])
+            {
+                printf("LightClusters SSE lists differ from the scalar ones in cluster %u\n", c);
+                failed = true;
+                break;
+            }
+        }
+
+        // Setting a light forces a rebuild as a moving light would
+        const bool modes[][2] = { { false, false }, { true, false }, { true, true } };
+        const char* names[] = { "scalar", "sse", "sse threads" };
+        for (unsigned int m = 0; m < 3; m++)
+        {
+            clusters.simd = modes[m][0];
+            clusters.parallel = modes[m][1];
+            run("LightClusters::build/" + std::to_string(count) + " " + names[m], 1, [&]()
+            {
+                lights.set(0, lights.get(0));
+                clusters.build(camera, lights);
+                consume(glm::vec4(static_cast<float>(clusters.stats.references)));
+            });
+        }
+        printf("%u lights, %.1f per cluster, at most %u\n", count,
+               clusters.stats.averageLights(LightClusters::clusterCount) + clusters.globalLights(),
+               clusters.stats.maxLights + clusters.globalLights());
+    }
+}
+
+// Random box of up to two metres inside a cube
+AABB randomBox(std::mt19937& generator, float extent)
+{
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> size(0.1f, 1.0f);
+    glm::vec3 centre(position(generator), position(generator), position(generator));
+    glm::vec3 half(size(generator), size(generator), size(generator));
+    return AABB(centre - half, centre + half);
+}
+
+// Compare the queries of a tree with brute-force scans over the boxes of its
+// proxies, returns the name of the first query that differs
+const char* checkBVHQueries(const BVH& bvh, const std::vector<int>& proxies, const Frustum& frustum,
+                            const std::vector<Ray>& rays, float maxDistance, std::mt19937& generator, float extent)
+{
+    std::vector<unsigned int> found, expected;
+    auto differs = [&]()
+    {
+        std::sort(found.begin(), found.end());
+        std::sort(expected.begin(), expected.end());
+        return found != expected;
+    };
+
+    found.clear();
+    expected.clear();
+    bvh.queryFrustum(frustum, found);
+    for (int proxy : proxies)
+        if (Bounds::classify(frustum, bvh.bounds(proxy)) != Containment::Outside)
+            expected.push_back(bvh.object(proxy));
+    if (differs())
+        return "frustum";
+
+    for (const Ray& ray : rays)
+    {
+        found.clear();
+        expected.clear();
+        bvh.queryRay(ray, maxDistance, found);
+        float distance;
+        for (int proxy : proxies)
+            if (Bounds::intersects(ray, bvh.bounds(proxy), maxDistance, distance))
+                expected.push_back(bvh.object(proxy));
+        if (differs())
+            return "ray";
+    }
+
+    std::uniform_real_distribution<float> position(-extent, extent);
+    for (unsigned int i = 0; i < 16; i++)
+    {
+        Sphere sphere = { glm::vec3(position(generator), position(generator), position(generator)), 0.1f * extent };
+        found.clear();
+        expected.clear();
+        bvh.querySphere(sphere, found);
+        for (int proxy : proxies)
+            if (Bounds::intersects(sphere, bvh.bounds(proxy)))
+                expected.push_back(bvh.object(proxy));
+        if (differs())
+            return "sphere";
+
+        AABB box(sphere.centre - glm::vec3(sphere.radius), sphere.centre + glm::vec3(sphere.radius));
+        found.clear();
+        expected.clear();
+        bvh.queryAABB(box, found);
+        for (int proxy : proxies)
+            if (Bounds::intersects(box, bvh.bounds(proxy)))
+                expected.push_back(bvh.object(proxy));
+        if (differs())
+            return "box";
+    }
+
+    return nullptr;
+}
+
+void benchBVH()
+{
+    // Small boxes scattered over a cube, the camera on one face sees the
+    // ones in front of it up to its far plane
+    const float extent = 100.0f;
+    const float maxDistance = 2.0f * extent;
+    Camera camera(glm::vec3(0.0f, 20.0f, extent), glm::vec3(0.0f, 0.0f, 0.0f));
+    camera.calculateMatrices();
+
+    const unsigned int sizes[] = { 1000, 10000, 100000 };
+    for (unsigned int count : sizes)
+    {
+        std::string suffix = "/" + std::to_string(count);
+        std::mt19937 generator(12345);
+        std::vector<AABB> boxes(count);
+        for (AABB& box : boxes)
+            box = randomBox(generator, extent);
+
+        // Rays from inside the cube in every direction
+        std::uniform_real_distribution<float> position(-extent, extent);
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+        std::vector<Ray> rays;
+        for (unsigned int i = 0; i < 64; i++)
+            rays.push_back(Ray(glm::vec3(position(generator), position(generator), position(generator)),
+                               glm::vec3(direction(generator), direction(generator), 0.5f + direction(generator))));
+
+        // Static tree, checked after the build and after moving every box
+        BVH bvh;
+        std::vector<int> proxies = bvh.build(boxes);
+        const char* query = checkBVHQueries(bvh, proxies, camera.frustum, rays, maxDistance, generator, extent);
+        if (!bvh.validate(false) || query != nullptr)
+        {
+            printf("BVH build with %u objects: %s\n", count, query != nullptr ? query : "invalid tree");
+            failed = true;
+        }
+
+        run("BVH::build" + suffix, count, [&]()
+        {
+            proxies = bvh.build(boxes);
+            consume(glm::vec4(static_cast<float>(bvh.height())));
+        });
+
+        // Every object moves back and forth, the boxes are refitted in place
+        unsigned int frame = 0;
+        run("BVH::refit" + suffix, count, [&]()
+        {
+            glm::vec3 offset(frame++ % 2 == 0 ? 0.5f : 0.0f);
+            for (unsigned int i = 0; i < count; i++)
+                bvh.setBounds(proxies[i], AABB(boxes[i].min + offset, boxes[i].max + offset));
+            bvh.refit();
+            consume(glm::vec4(bvh.bounds(proxies[0]).min, 0.0f));
+        });
+        query = checkBVHQueries(bvh, proxies, camera.frustum, rays, maxDistance, generator, extent);
+        if (!bvh.validate(false) || query != nullptr)
+        {
+            printf("BVH refit with %u objects: %s\n", count, query != nullptr ? query : "invalid tree");
+            failed = true;
+        }
+
+        std::vector<unsigned int> objects;
+        objects.reserve(count);
+        run("BVH::queryFrustum" + suffix, 1, [&]()
+        {
+            objects.clear();
+            bvh.queryFrustum(camera.frustum, objects);
+            consume(glm::vec4(static_cast<float>(objects.size())));
+        });
+        run("BVH::queryRay" + suffix, static_cast<unsigned int>(rays.size()), [&]()
+        {
+            objects.clear();
+            for (const Ray& ray : rays)
+                bvh.queryRay(ray, maxDistance, objects);
+            consume(glm::vec4(static_cast<float>(objects.size())));
+        });
+
+        // Dynamic tree: a tenth of the objects move further than the margin and
+        // a hundredth are removed and inserted again somewhere else each call
+        BVH dynamic;
+        std::vector<int> handles(count);
+        for (unsigned int i = 0; i < count; i++)
+            handles[i] = dynamic.insert(boxes[i], i);
+        std::vector<AABB> moved = boxes;
+        std::uniform_int_distribution<unsigned int> pick(0, count - 1);
+        unsigned int moves = std::max(count / 10, 1u), respawns = std::max(count / 100, 1u);
+        auto churn = [&]()
+        {
+            for (unsigned int i = 0; i < moves; i++)
+            {
+                unsigned int object = pick(generator);
+                glm::vec3 offset(direction(generator), direction(generator), direction(generator));
+                moved[object] = AABB(moved[object].min + offset, moved[object].max + offset);
+                dynamic.update(handles[object], moved[object]);
+            }
+            for (unsigned int i = 0; i < respawns; i++)
+            {
+                unsigned int object = pick(generator);
+                dynamic.remove(handles[object]);
+                moved[object] = randomBox(generator, extent);
+                handles[object] = dynamic.insert(moved[object], object);
+            }
+        };
+        for (unsigned int i = 0; i < 10; i++)
+            churn();
+        query = checkBVHQueries(dynamic, handles, camera.frustum, rays, maxDistance, generator, extent);
+        if (!dynamic.validate(true) || dynamic.size() != count || query != nullptr)
+        {
+            printf("BVH churn with %u objects: %s\n", count, query != nullptr ? query : "invalid tree");
+            failed = true;
+        }
+
+        run("BVH churn" + suffix, moves + respawns, [&]()
+        {
+            churn();
+            consume(glm::vec4(static_cast<float>(dynamic.height())));
+        });
+        if (!dynamic.validate(true))
+        {
+            printf("BVH churn with %u objects: invalid tree\n", count);
+            failed = true;
+        }
+
+        objects.clear();
+        bvh.queryFrustum(camera.frustum, objects);
+        printf("%u objects, height %d static, %d dynamic, %u in the frustum\n", count, bvh.height(),
+               dynamic.height(), static_cast<unsigned int>(objects.size()));
+    }
+}
+
+void benchLightmap()
+{
+    // A floor of blocks with pillars and a wall, lit by a sun and a few lamps
+    ThreadPool pool;
+    VoxelWorld world;
+    BlockID stone = world.addBlockType("oak_plank", true, 1);
+    for (int x = 0; x < 32; x++)
+        for (int z = 0; z < 32; z++)
+        {
+            world.setBlock(glm::ivec3(x, 0, z), stone);
+            if ((x % 8 == 3 && z % 8 == 3) || (z == 20 && x > 4 && x < 28))
+                for (int y = 1; y < 6; y++)
+                    world.setBlock(glm::ivec3(x, y, z), stone);
+        }
+
+    std::vector<ChunkMesh> meshes(world.chunks.size());
+    std::vector<LightmapTarget> targets;
+    unsigned int texels = 0;
+    for (auto it = world.chunks.begin(); it != world.chunks.end(); ++it)
+    {
+        ChunkMesh& mesh = meshes[targets.size()];
+        world.meshChunk(it->second.coord, mesh);
+        targets.push_back(LightmapTarget{ it->first, world.chunkBounds(it->second.coord), &mesh.lightmapFaces,
+                                          mesh.lightmapHeight });
+        for (const LightmapFace& face : mesh.lightmapFaces)
+            texels += face.width * face.height;
+    }
+
+    std::vector<Light> lights;
+    lights.push_back(Light::directional(glm::vec3(-0.3f, -1.0f, -0.2f), glm::vec3(0.6f)));
+    for (int i = 0; i < 4; i++)
+        lights.push_back(Light::point(glm::vec3(8.0f + 16.0f * i, 8.0f, 30.0f), glm::vec3(1.0f), 1.0f, 0.0f, 0.01f));
+    LightmapBaker baker(pool);
+    baker.setLights(lights);
+
+    // The threaded bake is checked against the serial one
+    baker.parallel = false;
+    baker.bake(world, targets);
+    std::vector<std::vector<uint32_t>> reference;
+    for (const LightmapTarget& target : targets)
+        reference.push_back(baker.find(target.key)->texels);
+    baker.parallel = true;
+    baker.bake(world, targets);
+    for (unsigned int t = 0; t < targets.size(); t++)
+    {
+        if (baker.find(targets[t].key)->texels != reference[t])
+        {
+            printf("LightmapBaker threaded bake differs from the serial one in chunk %u\n", t);
+            failed = true;
+            break;
+        }
+    }
+
+    const char* names[] = { "serial", "threads" };
+    for (unsigned int m = 0; m < 2; m++)
+    {
+        baker.parallel = m == 1;
+        run(std::string("LightmapBaker::bake/") + names[m], texels, [&]()
+        {
+            baker.bake(world, targets);
+            consume(glm::vec4(static_cast<float>(baker.stats.rays)));
+        });
+    }
+    printf("%u texels in %u chunks, %u surface blocks, %.1f rays per texel\n", texels,
+           static_cast<unsigned int>(targets.size()), baker.stats.blocks,
+           static_cast<double>(baker.stats.rays) / std::max(texels, 1u));
+}
+
+bool loadBaseline(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        printf("Impossible to open the baseline %s.\n", path);
+        return false;
+    }
+
+    // One benchmark per line, as written by writeJSON
+    char line[1024];
+    while (fgets(line, sizeof(line), file))
+    {
+        const char* name = strstr(line, "\"name\": \"");
+        const char* median = strstr(line, "\"median_ns\": ");
+        if (name == NULL || median == NULL)
+            continue;
+
+        name += strlen("\"name\": \"");
+        const char* end = strchr(name, '"');
+        BaselineEntry entry;
+        entry.name.assign(name, end != NULL ? end - name : strlen(name));
+        if (sscanf(median + strlen("\"median_ns\": "), "%lf", &entry.median) == 1)
+            baseline.push_back(entry);
+    }
+    fclose(file);
+
+    return true;
+}
+
+bool writeJSON(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("Impossible to write the results to %s.\n", path);
+        return false;
+    }
+
+    // One benchmark per line so runs diff cleanly
+    fprintf(file, "{\n  \"unit\": \"ns per item\",\n  \"benchmarks\": [\n");
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"repetitions\": %u, \"iterations\": %llu, \"items\": %u, "
+                "\"min_ns\": %.3f, \"median_ns\": %.3f, \"mean_ns\": %.3f, \"stddev_ns\": %.3f, \"max_ns\": %.3f}%s\n",
+                r.name.c_str(), r.repetitions, r.iterations, r.items, r.min, r.median, r.mean, r.stddev, r.max,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+
+    printf("Wrote %u results to %s\n", static_cast<unsigned int>(results.size()), path);
+    return true;
+}
+
+bool parseOptions(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue)
+            options.filter = argv[++i];
+        else if (arg == "--repetitions" && hasValue)
+            options.repetitions = std::max(1, atoi(argv[++i]));
+        else if (arg == "--min-time" && hasValue)
+            options.minTime = std::max(0.0, atof(argv[++i]) / 1000.0);
+        else if (arg == "--assets" && hasValue)
+            options.assets = argv[++i];
+        else if (arg == "--json" && hasValue)
+            options.jsonPath = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            options.baselinePath = argv[++i];
+        else
+        {
+            printf("Usage: %s [--filter text] [--repetitions n] [--min-time ms] [--assets directory]\n"
+                   "       [--json results.json] [--baseline results.json]\n",
+                   argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (!parseOptions(argc, argv))
+        return 1;
+    if (options.baselinePath != nullptr && !loadBaseline(options.baselinePath))
+        return 1;
+
+    // Nothing drains the profiler here, keep its scopes out of the timings
+    Profiler::enabled = false;
+
+    printf("%-36s %12s %12s %12s %12s %8s%s\n", "Benchmark (ns per item)", "iterations", "min", "median", "mean", "stddev",
+           baseline.empty() ? "" : "  vs base");
+    benchLoaders();
+    benchMaths();
+    benchMatrixBatch();
+    benchObjectLoop();
+    benchLightClusters();
+    benchBVH();
+    benchLightmap();
+
+    if (options.jsonPath != nullptr && !writeJSON(options.jsonPath))
+        return 1;
+    return failed ? 1 : 0;
+}
@@ -1,5 +1,9 @@
 #include <iostream>
+#include <sstream>
+#include <functional>
 #include <cmath>
+#include <cstdlib>
+#include <algorithm>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -9,32 +13,120 @@
 #include <common/maths.hpp>
 #include <common/camera.hpp>
 #include <common/model.hpp>
+#include <common/bvh.hpp>
+#include <common/occlusion.hpp>
+#include <common/voxel.hpp>
+#include <common/voxelrenderer.hpp>
+#include <common/chunkmesher.hpp>
+#include <common/scene.hpp>
+#include <common/benchmark.hpp>
+#include <common/profiler.hpp>
+#include <common/camerapath.hpp>
+#include <common/framebuffer.hpp>
+#include <common/glresource.hpp>
+#include <common/hud.hpp>
+#include <common/glstate.hpp>
+#include <common/input.hpp>
+#include <common/allocationtracker.hpp>
+#include <common/glcapture.hpp>
+#include <common/matrixbatch.hpp>
+#include <common/light.hpp>
+#include <common/lightclusters.hpp>
+#include <common/deferred.hpp>
+#include <common/shadows.hpp>
+#include <common/lightmap.hpp>
+#include <common/shadervariants.hpp>
+#include <source/houselevel.hpp>
+#ifdef NULL_GL
+#include <common/nullgl.hpp>
+#endif
 
 // Function prototypes
-void keyboardInput(GLFWwindow* window);
-void mouseInput(GLFWwindow* window);
+void keyboardInput(GLFWwindow* window, const InputFrame& input);
+void mouseInput(const InputFrame& input);
+bool renderScene(GLFWwindow* window, const Scene& scene, Benchmark* benchmark);
+void placeLights(LightManager& lights, const AABB& bounds, unsigned int count);
+bool parseOptions(int argc, char* argv[]);
+
+// Command line options
+struct Options
+{
+    const char* scenePath = nullptr;    // nullptr uses the house baked into the binary
+    bool benchmark = false;
+    BenchmarkLayout layout = BenchmarkLayout::Houses;
+    const char* resultsPath = "benchmark.csv";
+    bool headless = false;              // invisible window drawing into a framebuffer object
+    bool software = false;              // use Mesa's software rasterizer
+    unsigned int frames = 0;            // zero runs until the window is closed
+    const char* cameraPath = nullptr;   // scripted camera path
+    std::vector<unsigned int> captureFrames;
+    unsigned int captureEvery = 0;
+    std::string outputDirectory = ".";
+    const char* recordPath = nullptr;   // input log to record
+    const char* replayPath = nullptr;   // input log to replay with a fixed timestep
+    const char* timingPath = "replay_timing.csv";
+    AllocationStrictness allocationStrictness = AllocationStrictness::Off;
+    bool hud = false;                   // start with the performance HUD shown
+    const char* glCapturePath = nullptr;    // GL call trace to record
+    unsigned int glCaptureFrames = 0;       // zero records the whole render loop
+    unsigned int lights = 0;            // lit objects with this many lights, zero draws them unlit
+    bool flatLights = false;            // loop over every light instead of the cluster lists
+    bool deferred = false;              // light the opaque objects through a G-buffer
+    bool shadows = false;               // cached shadow maps of the lights
+    bool shaderVariants = false;        // lit shader variants with the lights of each draw compiled in
+    bool lightmaps = false;             // bake the static lights into lightmaps of the blocks
+    const char* lightmapPath = nullptr;     // lightmap cache to load and save
+};
+Options options;
 
 // Frame timers
 float previousTime = 0.0f;  // time of previous iteration of the loop
 float deltaTime = 0.0f;  // time elapsed since the previous frame
+float animationTime = 0.0f;  // time of the animated lights
+const float animationStep = 1.0f / 60.0f;  // animation time per frame of runs that count frames
+
+// The one light that moves, it circles the scene and isn't baked into the
+// lightmaps
+const unsigned int movingLight = 1;
 
 // Create camera object
 Camera camera(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f));
 
-// Object struct
-struct Object
-{
-    glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
-    glm::vec3 rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    float angle = 0.0f;
-    std::string name;
-};
+// Render target of the headless mode
+Framebuffer offscreen;
 
+// Size of the window in screen coordinates
+const int windowWidth = 1024;
+const int windowHeight = 768;
 
+// Pixels of the default framebuffer, the targets drawn at screen size match
+// it. Read once the window is open.
+int frameWidth = windowWidth;
+int frameHeight = windowHeight;
 
-int main(void)
+// Performance HUD, toggled with F3
+bool showHUD = false;
+bool hudKeyDown = false;
+
+int main(int argc, char* argv[])
 {
+    if (!parseOptions(argc, argv))
+        return -1;
+    AllocationTracker::strict = options.allocationStrictness;
+    showHUD = options.hud;
+
+    // Ask Mesa for its software rasterizer before the context is created
+    if (options.software)
+    {
+#ifdef _WIN32
+        _putenv_s("LIBGL_ALWAYS_SOFTWARE", "1");
+        _putenv_s("GALLIUM_DRIVER", "llvmpipe");
+#else
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+        setenv("GALLIUM_DRIVER", "llvmpipe", 1);
+#endif
+    }
+
     // =========================================================================
     // Window creation - you shouldn't need to change this code
     // -------------------------------------------------------------------------
@@ -42,7 +134,8 @@ int main(void)
     if (!glfwInit())
     {
         fprintf(stderr, "Failed to initialize GLFW\n");
-        getchar();
+        if (!options.headless)
+            getchar();
         return -1;
     }
 
@@ -52,14 +145,17 @@ int main(void)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, options.headless ? GL_FALSE : GL_TRUE);
 
     // Open a window and create its OpenGL context
     GLFWwindow* window;
-    window = glfwCreateWindow(1024, 768, "Coursework", NULL, NULL);
+    window = glfwCreateWindow(windowWidth, windowHeight, "Coursework", NULL, NULL);
 
     if (window == NULL) {
         fprintf(stderr, "Failed to open GLFW window.\n");
-        getchar();
+        if (!options.headless)
+            getchar();
+        offscreen.deleteBuffers();
         glfwTerminate();
         return -1;
     }
@@ -69,387 +165,926 @@ int main(void)
     glewExperimental = true; // Needed for core profile
     if (glewInit() != GLEW_OK) {
         fprintf(stderr, "Failed to initialize GLEW\n");
-        getchar();
+        if (!options.headless)
+            getchar();
+        offscreen.deleteBuffers();
         glfwTerminate();
         return -1;
     }
+    glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
     // -------------------------------------------------------------------------
     // End of window creation
     // =========================================================================
 
+    // Record every GL call from here on, including the setup
+    if (options.glCapturePath != nullptr)
+        GLCapture::begin(options.glCapturePath, options.glCaptureFrames);
+
     // Enable depth test
-    glEnable(GL_DEPTH_TEST);
+    GLState::enable(GL_DEPTH_TEST);
 
     // DISABLED CULLING
-    glDisable(GL_CULL_FACE);
+    GLState::disable(GL_CULL_FACE);
 
     // Ensure we can capture keyboard inputs
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
-    // Capture mouse inputs
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwPollEvents();
-    glfwSetCursorPos(window, 1024 / 2, 768 / 2);
+    // Capture mouse inputs, the headless mode draws into a framebuffer
+    // object instead as the invisible window has no pixels of its own
+    if (options.headless)
+    {
+        if (!offscreen.create(frameWidth, frameHeight))
+        {
+            offscreen.deleteBuffers();
+            glfwTerminate();
+            return -1;
+        }
+        glfwSwapInterval(0);
+    }
+    else
+    {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwPollEvents();
+        glfwSetCursorPos(window, windowWidth / 2, windowHeight / 2);
+    }
+    printf("Renderer: %s\n", glGetString(GL_RENDERER));
+    printf("Matrix kernels: %s\n", MatrixBatch::name(MatrixBatch::isa));
+
+    // Load the scene, either a binary snapshot or the text form, or point at
+    // the baked house. In benchmark mode scenes of increasing size are
+    // generated from it and timed instead
+    Scene scene;
+    if (options.scenePath == nullptr)
+        scene.loadStatic(houselevel::scene);
+    else if (!scene.load(options.scenePath))
+    {
+        if (!options.headless)
+            getchar();
+        offscreen.deleteBuffers();
+        glfwTerminate();
+        return -1;
+    }
+
+    if (options.benchmark)
+    {
+        Benchmark benchmark;
+        benchmark.layout = options.layout;
+
+        // Don't wait for the vertical sync
+        glfwSwapInterval(0);
+        bool running = true;
+        if (options.layout == BenchmarkLayout::Lights)
+        {
+            // The same houses lit forward then deferred by each light count
+            for (unsigned int i = 0; running && i < static_cast<unsigned int>(benchmark.lightCounts.size()); i++)
+            {
+                for (unsigned int deferred = 0; running && deferred < 2; deferred++)
+                {
+                    Scene generated;
+                    benchmark.generate(scene, benchmark.sizes[0], generated);
+                    options.lights = benchmark.lightCounts[i];
+                    options.deferred = deferred != 0;
+                    running = renderScene(window, generated, &benchmark);
+                }
+            }
+        }
+        for (unsigned int i = 0; running && options.layout != BenchmarkLayout::Lights &&
+                                 i < static_cast<unsigned int>(benchmark.sizes.size()); i++)
+        {
+            Scene generated;
+            benchmark.generate(scene, benchmark.sizes[i], generated);
+            running = renderScene(window, generated, &benchmark);
+        }
+        benchmark.writeCSV(options.resultsPath);
+    }
+    else
+    {
+        renderScene(window, scene, nullptr);
+    }
+
+    // Close OpenGL window and terminate GLFW
+    Profiler::shutdown();
+    offscreen.deleteBuffers();
+    GLResourceTracker::reportLeaks();
+    glfwTerminate();
+    return 0;
+}
+
+// Set up and draw a scene until the window is closed or the benchmark run is
+// over, returns false when the window was closed
+bool renderScene(GLFWwindow* window, const Scene& scene, Benchmark* benchmark)
+{
+    double setupStart = glfwGetTime();
 
     // Compile shader program
-    unsigned int shaderID, lightShaderID;
-    shaderID = LoadShaders("vertexShader.glsl", "fragmentShader.glsl");
-    lightShaderID = LoadShaders("lightVertexShader.glsl", "lightFragmentShader.glsl");
+    GLProgram shaderID, lightShaderID;
+    if (options.lights > 0)
+        shaderID.adopt(LoadShaders("multipleLightsVertexShader.glsl", "multipleLightsFragmentShader.glsl"), "Object shader");
+    else
+        shaderID.adopt(LoadShaders("vertexShader.glsl", "fragmentShader.glsl"), "Object shader");
+    lightShaderID.adopt(LoadShaders("lightVertexShader.glsl", "lightFragmentShader.glsl"), "Light shader");
 
     // Activate shader
-    glUseProgram(shaderID);
+    GLState::useProgram(shaderID);
 
-    // Load models
-    Model plane("../assets/plane.obj");
-    Model oak_wood("../assets/cube.obj"); 
-    Model oak_plank("../assets/cube.obj");
-    Model glass("../assets/cube.obj");
-    Model door_top("../assets/cube.obj");
-    Model door_bottom("../assets/cube.obj"); 
+    // Lights of the lit shader
+    LightManager lights;
+    if (options.lights > 0)
+    {
+        LightManager::setupProgram(shaderID);
+        placeLights(lights, scene.bounds, options.lights);
+        lights.create();
+    }
 
-    
-    // Load the textures
-    plane.addTexture("../assets/grass.jpg", "diffuse");
-    oak_wood.addTexture("../assets/oak_wood.jpg", "diffuse");
-    oak_plank.addTexture("../assets/oak_plank.jpg", "diffuse");
-    glass.addTexture("../assets/glass.png", "diffuse");  
-    door_top.addTexture("../assets/door_top.png", "diffuse");
-    door_bottom.addTexture("../assets/door_bottom.png", "diffuse");
-
-
-    // this will store different types of objects
-    std::vector<Object> objects;
-    Object object;
-
-    // i will manually adjust the block postion and scale
-
-    //plain (grass field)
-    object.position = glm::vec3(-2.0f, -1.0f, 0.0f);
-    object.scale = glm::vec3(20.0f, 1.0f, 20.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "plane";
-    objects.push_back(object);
-
-    //front part of the house
-    object.position = glm::vec3(0.0f, 2.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "door_top";
-    objects.push_back(object);
-
-    object.position = glm::vec3(0.0f, 0.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "door_bottom";
-    objects.push_back(object);
-
- 
-    object.position = glm::vec3(-2.0f, 0.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "oak_plank";
-    objects.push_back(object);
-
-    object.position = glm::vec3(2.0f, 0.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "oak_plank";
-    objects.push_back(object);
-
-    object.position = glm::vec3(2.0f, 4.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "oak_plank";
-    objects.push_back(object);
-
-    object.position = glm::vec3(0.0f, 4.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "oak_plank";
-    objects.push_back(object);
-
-    object.position = glm::vec3(-2.0f, 4.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "oak_plank";
-    objects.push_back(object);
-
-    object.position = glm::vec3(-2.0f, 2.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "glass";
-    objects.push_back(object);
-
-    object.position = glm::vec3(2.0f, 2.0f, 0.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "glass";
-    objects.push_back(object);
+    // Store the axis aligned unit cubes in a chunked voxel world, the block
+    // types use the layers of the texture array in this order
+    VoxelWorld world;
+    world.addBlockType("oak_wood", true, 0);
+    world.addBlockType("oak_plank", true, 1);
+    world.addBlockType("glass", false, 2);
+    world.addBlockType("door_top", true, 3);
+    world.addBlockType("door_bottom", true, 4);
+    int cubeMesh = scene.findMesh("cube");
+    std::vector<BlockID> objectBlocks(scene.objectCount, 0);
+    for (unsigned int i = 0; i < scene.objectCount; i++)
+    {
+        if (static_cast<int>(scene.meshIDs[i]) != cubeMesh || scene.angles[i] != 0.0f || scene.scales[i] != glm::vec3(1.0f))
+            continue;
 
-    
-    object.position = glm::vec3(0.0f, 8.0f, -4.0f);
-    object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    object.angle = 0.0f;
-    object.name = "oak_wood";
-    objects.push_back(object);
-
-    float x = 0.0f;
-
-    int count = 0;
-
-    while (count < 3) {
-
-        // four oak wood postions (pillars)
-        object.position = glm::vec3(-4.0f, x, 0.0f); // front left
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_wood";
-        objects.push_back(object);
-
-        object.position = glm::vec3(4.0f, x, 0.0f); // front right
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_wood";
-        objects.push_back(object);
-
-        object.position = glm::vec3(4.0f, x, -8.0f); // back right
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_wood";
-        objects.push_back(object);
-
-        object.position = glm::vec3(-4.0f, x, -8.0f); // back left
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_wood";
-        objects.push_back(object);
-        
-        //left side of house
-        object.position = glm::vec3(-4.0f, 0.0f, -2.0f-x);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_plank";
-        objects.push_back(object);
-
-        object.position = glm::vec3(-4.0f, 2.0f, -2.0f - x);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "glass";
-        objects.push_back(object);
-
-        object.position = glm::vec3(-4.0f, 4.0f, -2.0f - x);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_plank";
-        objects.push_back(object);
-
-        // right side of house
-
-        object.position = glm::vec3(4.0f, 0.0f, -2.0f - x);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_plank";
-        objects.push_back(object);
-
-        object.position = glm::vec3(4.0f, 2.0f, -2.0f - x);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "glass";
-        objects.push_back(object);
-
-        object.position = glm::vec3(4.0f, 4.0f, -2.0f - x);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_plank";
-        objects.push_back(object);
-
-
-        // back side of house
-
-        object.position = glm::vec3(-2.0f + x, 0.0f, -8.0f);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_plank";
-        objects.push_back(object);
-
-        object.position = glm::vec3(-2.0f + x, 2.0f, -8.0f);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "glass";
-        objects.push_back(object);
-
-        object.position = glm::vec3(-2.0f + x, 4.0f, -8.0f);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_plank";
-        objects.push_back(object);
-
-        //top 
-
-
-        object.position = glm::vec3(-2.0f + x, 6.0f, -6.0f);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_wood";
-        objects.push_back(object);
-
-        object.position = glm::vec3(-2.0f + x, 6.0f, -4.0f);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_wood";
-        objects.push_back(object);
-
-        object.position = glm::vec3(-2.0f + x, 6.0f, -2.0f);
-        object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-        object.angle = 0.0f;
-        object.name = "oak_wood";
-        objects.push_back(object);
-
-        // adds a block
-        x += 2.0f;
-        count++; 
+        objectBlocks[i] = world.findBlockType(scene.materials[scene.materialIDs[i]].name);
+        if (objectBlocks[i] != 0)
+            world.setBlock(world.worldToBlock(scene.positions[i]), objectBlocks[i]);
     }
 
+    // Load one model for each mesh and material pair used by the other objects
+    std::vector<Model> models;
+    std::vector<unsigned int> objectModels(scene.objectCount, 0);
+    std::vector<int> pairModels(scene.meshes.size() * scene.materials.size(), -1);
+    for (unsigned int i = 0; i < scene.objectCount; i++)
+    {
+        if (objectBlocks[i] != 0)
+            continue;
 
+        unsigned int pair = scene.meshIDs[i] * static_cast<unsigned int>(scene.materials.size()) + scene.materialIDs[i];
+        if (pairModels[pair] < 0)
+        {
+            const SceneMaterial& material = scene.materials[scene.materialIDs[i]];
+            models.push_back(Model(scene.meshes[scene.meshIDs[i]].path.c_str()));
+            models.back().addTexture(material.texture.c_str(), "diffuse");
+            models.back().ka = material.ka;
+            models.back().kd = material.kd;
+            models.back().ks = material.ks;
+            models.back().Ns = material.Ns;
+            pairModels[pair] = static_cast<int>(models.size()) - 1;
+        }
+        objectModels[i] = pairModels[pair];
+    }
+    int glassMaterial = scene.findMaterial("glass");
 
-    //object.position = glm::vec3(-4.0f, 0.0f, -0.0f);
-    //object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    //object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    //object.angle = 0.0f;
-    //object.name = "oak_wood";
-    //objects.push_back(object);
-
-    //object.position = glm::vec3(4.0f, 0.0f, -0.0f);
-    //object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    //object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    //object.angle = 0.0f;
-    //object.name = "oak_wood";
-    //objects.push_back(object);
+    // Build the bounding volume hierarchy over the world space bounds of the
+    // objects that aren't blocks
+    std::vector<unsigned int> bvhObjects;
+    std::vector<AABB> objectBounds;
+    for (unsigned int i = 0; i < scene.objectCount; i++)
+    {
+        if (objectBlocks[i] != 0)
+            continue;
 
-    //object.position = glm::vec3(4.0f, 0.0f, -8.0f);
-    //object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    //object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    //object.angle = 0.0f;
-    //object.name = "oak_wood";
-    //objects.push_back(object);
+        bvhObjects.push_back(i);
+        objectBounds.push_back(scene.objectBounds(i));
+    }
 
-    //object.position = glm::vec3(4.0f, 0.0f, -8.0f);
-    //object.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    //object.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    //object.angle = 0.0f;
-    //object.name = "oak_wood";
-    //objects.push_back(object);
+    // Model matrices of the BVH objects, and the MV and MVP of the visible
+    // ones that are composed each frame
+    std::vector<glm::mat4> modelMatrices(bvhObjects.size());
+    if (scene.models != nullptr)
+    {
+        for (unsigned int i = 0; i < bvhObjects.size(); i++)
+            modelMatrices[i] = scene.models[bvhObjects[i]];
+    }
+    else
+    {
+        MatrixBatch::composeTRS(static_cast<unsigned int>(bvhObjects.size()), scene.positions, scene.axes, scene.angles,
+                                scene.scales, bvhObjects.data(), modelMatrices.data());
+    }
+    std::vector<glm::mat4> objectMV(bvhObjects.size()), objectMVP(bvhObjects.size());
+    BVH bvh;
+    bvh.build(objectBounds);
+    std::vector<unsigned int> visibleObjects, frustumObjects;
+    std::vector<const ChunkBuffers*> visibleChunks;
+    visibleObjects.reserve(bvhObjects.size());
+    frustumObjects.reserve(bvhObjects.size());
+    uint64_t frustumVersion = 0;        // camera version of frustumObjects
+    bool picking = false, removing = false, placing = false;
+
+    // Software occlusion culler, opaque objects and chunk faces act as occluders
+    ThreadPool threadPool;
+    OcclusionCuller occlusionCuller(threadPool);
+
+    // Per cluster light lists of the lit shader, binned on the worker threads
+    LightClusters lightClusters(threadPool, frameWidth, frameHeight);
+    bool clustered = options.lights > 0 && !options.flatLights;
+    if (options.lights > 0)
+    {
+        GLState::useProgram(shaderID);
+        LightClusters::setupProgram(shaderID);
+    }
+    if (clustered)
+        lightClusters.create();
+
+    // G-buffer of the deferred path, glass is still drawn forward. The
+    // chunks go into it with their own program for the texture array.
+    DeferredRenderer deferredRenderer;
+    GLProgram voxelGeometryShaderID;
+    bool deferred = options.lights > 0 && options.deferred;
+    std::vector<unsigned int> forwardObjects;
+    if (deferred)
+    {
+        deferredRenderer.create(LoadShaders("multipleLightsVertexShader.glsl", "gbufferFragmentShader.glsl"),
+                                LoadShaders("deferredLightVertexShader.glsl", "deferredLightFragmentShader.glsl"), frameWidth, frameHeight);
+        voxelGeometryShaderID.adopt(LoadShaders("multipleLightsVertexShader.glsl", "gbufferFragmentShader.glsl",
+                                                "#define VOXEL\n"), "Voxel G-buffer shader");
+        forwardObjects.reserve(bvhObjects.size());
+    }
+    float reportTime = 0.0f;
+
+    // Mesh the chunks on the worker threads, one vertex buffer and one draw
+    // call per chunk. With lights the chunks use the lit shader built for
+    // the block vertices and texture array. The lightmap sampler keeps its
+    // own unit even without lightmaps, off the unit of the texture array.
+    GLProgram voxelShaderID, voxelLitShaderID;
+    voxelShaderID.adopt(LoadShaders("voxelVertexShader.glsl", "voxelFragmentShader.glsl"), "Voxel shader");
+    GLState::useProgram(voxelShaderID);
+    GLState::uniform1i(glGetUniformLocation(voxelShaderID, "lightmap"), LightmapBaker::textureUnit);
+    if (options.lights > 0)
+    {
+        voxelLitShaderID.adopt(LoadShaders("multipleLightsVertexShader.glsl", "multipleLightsFragmentShader.glsl",
+                                           "#define VOXEL\n"), "Lit voxel shader");
+        GLState::useProgram(voxelLitShaderID);
+        GLState::uniform1i(glGetUniformLocation(voxelLitShaderID, "lightmap"), LightmapBaker::textureUnit);
+        LightManager::setupProgram(voxelLitShaderID);
+        LightClusters::setupProgram(voxelLitShaderID);
+    }
+    VoxelRenderer voxelRenderer;
+    voxelRenderer.loadTextures({ "../assets/oak_wood.jpg", "../assets/oak_plank.jpg", "../assets/glass.png",
+                                 "../assets/door_top.png", "../assets/door_bottom.png" });
+    ChunkMesher chunkMesher(world, threadPool);
+    chunkMesher.update();
+    chunkMesher.finish();
+    chunkMesher.swap(voxelRenderer);
+    printf("Voxel world: %u blocks in %u chunks, %u triangles (%u as separate cubes)\n",
+           world.blockCount(), static_cast<unsigned int>(world.chunks.size()),
+           voxelRenderer.triangleCount(), 12 * world.blockCount());
+    voxelRenderer.changed.clear();
+
+    // Room in the occlusion culler for every occluder triangle, with a
+    // quarter to spare for new blocks and triangles split by the near plane
+    unsigned int occluderTriangles = 0;
+    for (unsigned int i : bvhObjects)
+        if (static_cast<int>(scene.materialIDs[i]) != glassMaterial)
+            occluderTriangles += static_cast<unsigned int>(models[objectModels[i]].vertices.size() / 3);
+    for (auto it = voxelRenderer.chunks.begin(); it != voxelRenderer.chunks.end(); ++it)
+        occluderTriangles += static_cast<unsigned int>(it->second.occluders.size() / 3);
+    occlusionCuller.reserve(occluderTriangles + occluderTriangles / 4);
+
+    // Shadow maps of the lit shaders, drawn again only when a light or a
+    // chunk in them changes. Glass doesn't cast a shadow.
+    ShadowMaps shadowMaps;
+    bool shadowed = options.lights > 0 && options.shadows;
+    std::vector<unsigned int> shadowCasters;
+    std::function<unsigned int(const Frustum&)> drawCasters;
+    if (options.lights > 0)
+    {
+        GLState::useProgram(shaderID);
+        ShadowMaps::setupProgram(shaderID, shadowed);
+        GLState::useProgram(voxelLitShaderID);
+        ShadowMaps::setupProgram(voxelLitShaderID, shadowed);
+        if (deferred)
+        {
+            GLState::useProgram(deferredRenderer.lightingProgram());
+            ShadowMaps::setupProgram(deferredRenderer.lightingProgram(), shadowed);
+        }
+    }
+    if (shadowed)
+    {
+        shadowMaps.create(LoadShaders("shadowVertexShader.glsl", "shadowFragmentShader.glsl"), scene.bounds, frameWidth, frameHeight);
+        shadowCasters.reserve(bvhObjects.size());
+        drawCasters = [&](const Frustum& volume)
+        {
+            unsigned int draws = 0;
+            shadowCasters.clear();
+            bvh.queryFrustum(volume, shadowCasters);
+            for (unsigned int k : shadowCasters)
+            {
+                unsigned int i = bvhObjects[k];
+                if (static_cast<int>(scene.materialIDs[i]) == glassMaterial)
+                    continue;
+
+                shadowMaps.setModel(modelMatrices[k]);
+                models[objectModels[i]].drawDepth();
+                draws++;
+            }
+            shadowMaps.setModel(glm::mat4(1.0f));
+            for (auto it = voxelRenderer.chunks.begin(); it != voxelRenderer.chunks.end(); ++it)
+            {
+                if (Bounds::intersects(volume, it->second.bounds))
+                {
+                    voxelRenderer.draw(it->second);
+                    draws++;
+                }
+            }
+            return draws;
+        };
+    }
 
+    // Variants of the lit shader, picked per draw from the lights reaching
+    // the object. Draws with more lights than a variant takes use the
+    // shader above.
+    ShaderVariants shaderVariants("multipleLightsVertexShader.glsl", "multipleLightsFragmentShader.glsl");
+    bool useVariants = options.lights > 0 && options.shaderVariants;
+    std::vector<VariantLights> variantLights;
+    std::vector<std::pair<uint32_t, unsigned int>> variantDraws;
+    if (useVariants)
+    {
+        shaderVariants.setup = [&](unsigned int program)
+        {
+            LightManager::setupProgram(program);
+            LightClusters::setupProgram(program);
+            ShadowMaps::setupProgram(program, shadowed);
+        };
+        variantLights.resize(bvhObjects.size());
+        variantDraws.reserve(bvhObjects.size());
+        forwardObjects.reserve(bvhObjects.size());
+    }
 
+    // Lightmaps of the blocks, baked on the worker threads from the lights
+    // that don't move, or a sun when the scene is unlit. The lit voxel
+    // shader adds the moving light to them.
+    LightmapBaker lightmapBaker(threadPool);
+    if (options.lightmaps)
+    {
+        std::vector<Light> staticLights;
+        std::vector<int> dynamicLights;
+        for (unsigned int i = 0; i < lights.count(); i++)
+        {
+            if (i == movingLight)
+                dynamicLights.push_back(static_cast<int>(i));
+            else
+                staticLights.push_back(lights.get(i));
+        }
+        if (staticLights.empty())
+            staticLights.push_back(Light::directional(glm::vec3(-0.3f, -1.0f, -0.2f), glm::vec3(0.6f)));
+        lightmapBaker.setLights(staticLights);
+
+        bool loaded = options.lightmapPath != nullptr && lightmapBaker.load(options.lightmapPath, world);
+        lightmapBaker.update(world, voxelRenderer);
+        const LightmapStats& stats = lightmapBaker.stats;
+        printf("Lightmaps: %u chunks baked in %.1f ms (%llu texels, %.1f M rays, %u blocks), %u from the cache\n",
+               stats.chunks, stats.bakeTime, static_cast<unsigned long long>(stats.texels),
+               static_cast<double>(stats.rays) / 1e6, stats.blocks, stats.cached);
+        if (options.lightmapPath != nullptr && (!loaded || stats.chunks > 0) &&
+            lightmapBaker.save(options.lightmapPath, world))
+            printf("Lightmap cache written to %s\n", options.lightmapPath);
+
+        if (options.lights > 0)
+        {
+            GLState::useProgram(voxelLitShaderID);
+            GLState::uniform1i(glGetUniformLocation(voxelLitShaderID, "dynamicLightCount"),
+                               static_cast<int>(dynamicLights.size()));
+            for (size_t i = 0; i < dynamicLights.size(); i++)
+            {
+                std::string name = "dynamicLightIndices[" + std::to_string(i) + "]";
+                GLState::uniform1i(glGetUniformLocation(voxelLitShaderID, name.c_str()), dynamicLights[i]);
+            }
+        }
+    }
 
+    // Scripted camera path, the headless mode orbits the scene by default
+    CameraPath cameraPath;
+    bool scripted = false;
+    if (options.cameraPath != nullptr)
+        scripted = cameraPath.load(options.cameraPath);
+    else if (options.headless && options.replayPath == nullptr)
+    {
+        cameraPath = CameraPath::orbit(scene.bounds, options.frames);
+        scripted = true;
+    }
+    unsigned int frame = 0;
+    animationTime = 0.0f;
+
+    // Record or replay the input, both use the fixed timestep of the log so
+    // a replay sees exactly the frames that were recorded
+    InputLog inputLog;
+    bool recording = options.recordPath != nullptr && benchmark == nullptr;
+    bool replaying = options.replayPath != nullptr && benchmark == nullptr && inputLog.load(options.replayPath);
+    GPUFrameTimer frameTimer;
+    std::vector<float> frameTimes;
+    std::vector<RenderStats> frameStats;
+
+    // Performance overlay
+    HUD hud;
+    hud.create(LoadShaders("hudVertexShader.glsl", "hudFragmentShader.glsl"), frameWidth, frameHeight);
+    HUDStats hudStats;
+
+    // Benchmark runs start once everything is set up
+    RenderStats renderStats;
+    if (benchmark != nullptr)
+        benchmark->beginRun(scene.bounds, world.blockCount(), static_cast<unsigned int>(bvhObjects.size()),
+                            static_cast<float>(1000.0 * (glfwGetTime() - setupStart)), options.lights, deferred);
 
     // Render loop
-    while (!glfwWindowShouldClose(window))
+    double loopStart = glfwGetTime();
+#ifdef NULL_GL
+    uint64_t loopCalls = NullGL::totalCalls();
+#endif
+    uint64_t loopHits = GLState::hits, loopMisses = GLState::misses;
+    while (!glfwWindowShouldClose(window) &&
+           (benchmark != nullptr ? benchmark->running() : options.frames == 0 || frame < options.frames) &&
+           (!replaying || frame < inputLog.frames.size()))
     {
         // Update timer
-        float time = glfwGetTime();
-        deltaTime = time - previousTime;
+        double frameStart = glfwGetTime();
+        float time = static_cast<float>(frameStart);
+        deltaTime = recording || replaying ? inputLog.timestep : time - previousTime;
         previousTime = time;
 
-        // Get inputs
-        keyboardInput(window);
-        mouseInput(window);
+        // Clock of the animated lights. It follows the fixed timestep of
+        // recorded input and counts frames in headless and benchmark runs, so
+        // those draw the same frames at any frame rate.
+        if (recording || replaying)
+            animationTime += deltaTime;
+        else if (benchmark != nullptr || options.headless)
+            animationTime = static_cast<float>(frame) * animationStep;
+        else
+            animationTime = time;
+        AllocationTracker::beginFrame();
+        Profiler::beginFrame();
+        GLCapture::beginFrame();
+        if (replaying)
+            frameTimer.begin(frame);
+
+        // Get inputs, the benchmark and scripted paths move the camera themselves
+        InputFrame input;
+        {
+            PROFILE_SCOPE("Input");
+            if (replaying)
+                input = inputLog.frames[frame];
+            else if (!options.headless)
+                input = InputLog::poll(window, windowWidth / 2, windowHeight / 2);
+            if (recording)
+                inputLog.frames.push_back(input);
+
+            keyboardInput(window, input);
+            mouseInput(input);
+            if (benchmark != nullptr)
+                benchmark->beginFrame(camera);
+            else if (scripted)
+                cameraPath.apply(camera, static_cast<float>(frame));
+        }
+        if (options.headless)
+            offscreen.bind();
+        renderStats.reset();
+        uint64_t frameHits = GLState::hits, frameMisses = GLState::misses;
 
         // Clear the window
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            PROFILE_GPU_SCOPE("Clear");
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
         // Calculate view and projection matrices
         camera.target = camera.eye + camera.front;
         camera.calculateMatrices();
 
-        // Activate shader
-        glUseProgram(shaderID);
+        // Pick the block or object under the cursor when the left mouse button is pressed
+        Ray cursorRay(camera.eye, camera.front);
+        glm::ivec3 hitBlock, hitNormal;
+        bool blockHit = world.raycast(cursorRay, camera.far, hitBlock, hitNormal);
+        bool mouseDown = input.down(InputMouseLeft);
+        if (mouseDown && !picking)
+        {
+            float distance;
+            int picked = bvh.raycast(cursorRay, camera.far, distance);
+            if (blockHit)
+                printf("Picked %s block at (%d, %d, %d)\n", world.blockTypes[world.getBlock(hitBlock)].name.c_str(),
+                       hitBlock.x, hitBlock.y, hitBlock.z);
+            else if (picked >= 0)
+                printf("Picked %s at distance %.2f\n",
+                       scene.materials[scene.materialIDs[bvhObjects[picked]]].name.c_str(), distance);
+        }
+        picking = mouseDown;
 
- 
+        // Remove the block under the cursor with the right mouse button and
+        // place an oak plank against it with the middle mouse button
+        mouseDown = input.down(InputMouseRight);
+        if (mouseDown && !removing && blockHit)
+            world.setBlock(hitBlock, 0);
+        removing = mouseDown;
 
-        // Loop through objects
-        for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+        mouseDown = input.down(InputMouseMiddle);
+        if (mouseDown && !placing && blockHit)
+            world.setBlock(hitBlock + hitNormal, world.findBlockType("oak_plank"));
+        placing = mouseDown;
+
+        // Remesh the edited chunks in the background and swap in finished meshes
         {
-            // Calculate model matrix
-            glm::mat4 translate = Maths::translate(objects[i].position);
-            glm::mat4 scale = Maths::scale(objects[i].scale);
-            glm::mat4 rotate = Maths::rotate(objects[i].angle, objects[i].rotation);
-            glm::mat4 model = translate * rotate * scale;
+            PROFILE_SCOPE("Remesh");
+            chunkMesher.update();
+            chunkMesher.swap(voxelRenderer);
+            for (const AABB& box : voxelRenderer.changed)
+            {
+                shadowMaps.invalidate(box);
+                lightmapBaker.invalidate(box);
+            }
+            voxelRenderer.changed.clear();
+            if (options.lightmaps)
+                lightmapBaker.update(world, voxelRenderer);
+        }
 
-            // Send the MVP and MV matrices to the vertex shader
-            glm::mat4 MV = camera.view * model;
-            glm::mat4 MVP = camera.projection * MV;
-            glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
-            glUniformMatrix4fv(glGetUniformLocation(shaderID, "MV"), 1, GL_FALSE, &MV[0][0]);
+        // Cull the objects outside of the view frustum, the objects don't move
+        // so the query only runs again when the camera does
+        const Frustum& frustum = camera.frustum;
+        {
+            PROFILE_SCOPE("Frustum culling");
+            if (frustumVersion != camera.version())
+            {
+                frustumObjects.clear();
+                bvh.queryFrustum(frustum, frustumObjects);
+                frustumVersion = camera.version();
+            }
+            visibleObjects.assign(frustumObjects.begin(), frustumObjects.end());
+        }
 
+        // Cull the objects hidden behind the occluders
+        {
+            PROFILE_SCOPE("Occlusion culling");
+            occlusionCuller.beginFrame(camera.viewProjection);
+            for (unsigned int j = 0; j < static_cast<unsigned int>(visibleObjects.size()); j++)
+            {
+                unsigned int i = bvhObjects[visibleObjects[j]];
+                if (static_cast<int>(scene.materialIDs[i]) == glassMaterial)
+                    continue;
+
+                const Model& model = models[objectModels[i]];
+                occlusionCuller.addOccluder(&model.vertices[0], static_cast<unsigned int>(model.vertices.size()),
+                                            modelMatrices[visibleObjects[j]]);
+            }
+            for (auto it = voxelRenderer.chunks.begin(); it != voxelRenderer.chunks.end(); ++it)
+            {
+                const ChunkBuffers& chunk = it->second;
+                if (!chunk.occluders.empty() && Bounds::intersects(frustum, chunk.bounds))
+                    occlusionCuller.addOccluder(&chunk.occluders[0], static_cast<unsigned int>(chunk.occluders.size()),
+                                                glm::mat4(1.0f));
+            }
+            occlusionCuller.rasterize();
+            occlusionCuller.filter(objectBounds, visibleObjects);
+
+            visibleChunks.clear();
+            for (auto it = voxelRenderer.chunks.begin(); it != voxelRenderer.chunks.end(); ++it)
+            {
+                const ChunkBuffers& chunk = it->second;
+                if (Bounds::intersects(frustum, chunk.bounds) && occlusionCuller.isVisible(chunk.bounds))
+                    visibleChunks.push_back(&chunk);
+            }
+        }
 
-            if (objects[i].name == "plane")
-                plane.draw(shaderID);
+        // Report the culling and remeshing statistics once a second
+        if (time - reportTime > 1.0f)
+        {
+            char title[192];
+            snprintf(title, sizeof(title),
+                     "Coursework - occlusion culled %.1f%% in %.3f ms - remesh latency %.2f ms, workers %.0f%% busy",
+                     occlusionCuller.stats.culledPercentage(), occlusionCuller.stats.totalTime(),
+                     chunkMesher.stats.averageLatency, 100.0f * chunkMesher.stats.utilization);
+            glfwSetWindowTitle(window, title);
+            reportTime = time;
+        }
 
-            if (objects[i].name == "oak_wood")
-                oak_wood.draw(shaderID);
+        // Activate shader
+        GLState::useProgram(shaderID);
 
-            if (objects[i].name == "oak_plank")
-                oak_plank.draw(shaderID);
+        // The first point light circles the scene, only it is uploaded again
+        if (options.lights > movingLight)
+        {
+            Light light = lights.get(movingLight);
+            glm::vec3 centre = scene.bounds.centre();
+            float radius = 0.4f * glm::length(scene.bounds.extent());
+            light.position = glm::vec3(centre.x + radius * cos(animationTime), light.position.y,
+                                       centre.z + radius * sin(animationTime));
+            lights.set(movingLight, light);
+        }
+        if (options.lights > 0)
+        {
+            // The shadow maps go first, they give the lights their maps
+            if (shadowed)
+            {
+                PROFILE_GPU_SCOPE("Shadows");
+                shadowMaps.update(camera, lights);
+                shadowMaps.render(drawCasters, options.headless ? static_cast<unsigned int>(offscreen.FBO) : 0);
+                shadowMaps.bind();
+                renderStats.drawCalls += shadowMaps.stats.casters;
+                GLState::useProgram(shaderID);
+            }
+            lights.upload();
+            lights.bind(shaderID);
+            if (clustered)
+            {
+                lightClusters.build(camera, lights);
+                lightClusters.upload();
+                lightClusters.bind(shaderID);
+            }
+            GLState::uniformMatrix4fv(glGetUniformLocation(shaderID, "inverseView"), &camera.inverseView[0][0]);
+        }
+
+        auto drawChunk = [&](const ChunkBuffers& chunk)
+        {
+            voxelRenderer.draw(chunk);
+            renderStats.drawCalls++;
+            renderStats.triangles += chunk.indexCount[chunk.front] / 3;
+        };
+
+        // Loop through the visible objects, in the deferred path the opaque
+        // ones go into the G-buffer and the rest are drawn forward once the
+        // lights have been added
+        {
+            PROFILE_SCOPE("Object loop");
+            PROFILE_GPU_SCOPE("Objects");
+            unsigned int visibleCount = static_cast<unsigned int>(visibleObjects.size());
+            MatrixBatch::composeMVP(visibleCount, camera.view, camera.projection, modelMatrices.data(),
+                                    visibleObjects.data(), objectMV.data(), objectMVP.data());
+            auto drawObject = [&](unsigned int program, unsigned int j)
+            {
+                unsigned int i = bvhObjects[visibleObjects[j]];
+
+                // Send the MVP and MV matrices to the vertex shader
+                GLState::uniformMatrix4fv(glGetUniformLocation(program, "MVP"), &objectMVP[j][0][0]);
+                GLState::uniformMatrix4fv(glGetUniformLocation(program, "MV"), &objectMV[j][0][0]);
+
+                models[objectModels[i]].draw(program);
+                renderStats.drawCalls++;
+                renderStats.triangles += models[objectModels[i]].vertices.size() / 3;
+            };
+
+            // Draws of the lit shader, the shader variants are grouped by
+            // variant, each group timed on its own
+            auto drawForward = [&]()
+            {
+                if (!useVariants)
+                {
+                    for (unsigned int j : forwardObjects)
+                        drawObject(shaderID, j);
+                    return;
+                }
+
+                const uint32_t fallback = 0xFFFFFFFFu;
+                variantDraws.clear();
+                for (unsigned int j : forwardObjects)
+                {
+                    VariantLights& selection = variantLights[j];
+                    shaderVariants.select(lights, objectBounds[visibleObjects[j]], shadowed, selection);
+                    variantDraws.push_back(std::make_pair(selection.fits ? selection.permutation.key() : fallback, j));
+                }
+                std::sort(variantDraws.begin(), variantDraws.end());
+
+                for (size_t begin = 0, end = 0; begin < variantDraws.size(); begin = end)
+                {
+                    uint32_t key = variantDraws[begin].first;
+                    for (end = begin; end < variantDraws.size() && variantDraws[end].first == key; end++)
+                        ;
+                    if (key == fallback)
+                    {
+                        GLState::useProgram(shaderID);
+                        for (size_t k = begin; k < end; k++)
+                            drawObject(shaderID, variantDraws[k].second);
+                        continue;
+                    }
+
+                    ShaderVariant& variant = shaderVariants.get(variantLights[variantDraws[begin].second].permutation);
+                    PROFILE_GPU_SCOPE(variant.name.c_str());
+                    GLState::useProgram(variant.program);
+                    lights.bind(variant.program);
+                    GLState::uniformMatrix4fv(glGetUniformLocation(variant.program, "inverseView"), &camera.inverseView[0][0]);
+                    for (size_t k = begin; k < end; k++)
+                    {
+                        ShaderVariants::setLights(variant, variantLights[variantDraws[k].second]);
+                        drawObject(variant.program, variantDraws[k].second);
+                    }
+                    variant.draws += end - begin;
+                }
+            };
+
+            unsigned int objectShader = shaderID;
+            forwardObjects.clear();
+            if (deferred)
+            {
+                deferredRenderer.beginGeometry();
+                objectShader = deferredRenderer.geometryProgram();
+                GLState::uniformMatrix4fv(glGetUniformLocation(objectShader, "inverseView"), &camera.inverseView[0][0]);
+            }
+            for (unsigned int j = 0; j < visibleCount; j++)
+            {
+                if (deferred ? static_cast<int>(scene.materialIDs[bvhObjects[visibleObjects[j]]]) == glassMaterial : useVariants)
+                    forwardObjects.push_back(j);
+                else
+                    drawObject(objectShader, j);
+            }
+
+            if (deferred)
+            {
+                // The chunk vertices are in world space, the baked chunks
+                // are drawn forward with their lightmaps
+                GLState::useProgram(voxelGeometryShaderID);
+                GLState::uniformMatrix4fv(glGetUniformLocation(voxelGeometryShaderID, "MVP"), &camera.viewProjection[0][0]);
+                GLState::uniformMatrix4fv(glGetUniformLocation(voxelGeometryShaderID, "MV"), &camera.view[0][0]);
+                GLState::uniformMatrix4fv(glGetUniformLocation(voxelGeometryShaderID, "inverseView"), &camera.inverseView[0][0]);
+                voxelRenderer.bind(voxelGeometryShaderID);
+                for (const ChunkBuffers* chunk : visibleChunks)
+                    if (!chunk->lightmapped)
+                        drawChunk(*chunk);
+
+                deferredRenderer.light(lights, camera);
+                renderStats.drawCalls += deferredRenderer.stats.drawCalls();
+                GLState::useProgram(shaderID);
+            }
+            drawForward();
+        }
 
-            if (objects[i].name == "glass")
-                glass.draw(shaderID);
+        // Draw the visible voxel chunks that aren't in the G-buffer, lit by
+        // the scene lights when there are any
+        {
+            PROFILE_SCOPE("Chunk draw");
+            PROFILE_GPU_SCOPE("Chunks");
+            unsigned int chunkShader = options.lights > 0 ? voxelLitShaderID : voxelShaderID;
+            GLState::useProgram(chunkShader);
+            GLState::uniformMatrix4fv(glGetUniformLocation(chunkShader, "MVP"), &camera.viewProjection[0][0]);
+            if (options.lights > 0)
+            {
+                // The chunk vertices are in world space
+                lights.bind(chunkShader);
+                if (clustered)
+                    lightClusters.bind(chunkShader);
+                GLState::uniformMatrix4fv(glGetUniformLocation(chunkShader, "MV"), &camera.view[0][0]);
+                GLState::uniformMatrix4fv(glGetUniformLocation(chunkShader, "inverseView"), &camera.inverseView[0][0]);
+            }
+            voxelRenderer.bind(chunkShader);
+            for (const ChunkBuffers* chunk : visibleChunks)
+            {
+                if (deferred && !chunk->lightmapped)
+                    continue;
+
+                GLState::uniform1i(glGetUniformLocation(chunkShader, "lightmapped"), chunk->lightmapped ? 1 : 0);
+                if (chunk->lightmapped)
+                    GLState::bindTexture(LightmapBaker::textureUnit, GL_TEXTURE_2D, chunk->lightmap);
+                drawChunk(*chunk);
+            }
+        }
 
-            if (objects[i].name == "door_top")
-                door_top.draw(shaderID);
+        // Copy the lit frame out of the G-buffer
+        if (deferred)
+            deferredRenderer.resolve(options.headless ? static_cast<unsigned int>(offscreen.FBO) : 0);
+        renderStats.stateChanges = static_cast<unsigned int>(GLState::misses - frameMisses);
+        renderStats.stateSkips = static_cast<unsigned int>(GLState::hits - frameHits);
 
-            if (objects[i].name == "door_bottom")
-                door_bottom.draw(shaderID);
+        // Draw the performance HUD over the frame, it shows the CPU time of
+        // the previous frame
+        if (showHUD)
+        {
+            PROFILE_SCOPE("HUD");
+            PROFILE_GPU_SCOPE("HUD");
+            hudStats.gpuTime = Profiler::lastGPUFrame();
+            hudStats.drawCalls = renderStats.drawCalls;
+            hudStats.triangles = renderStats.triangles;
+            hudStats.stateChanges = renderStats.stateChanges;
+            hudStats.stateSkips = renderStats.stateSkips;
+            hudStats.textureBytes = GLResourceTracker::bytes(GLResourceType::Texture) +
+                                    GLResourceTracker::bytes(GLResourceType::Renderbuffer);
+            hudStats.meshBytes = GLResourceTracker::bytes(GLResourceType::Buffer);
+            hudStats.shadowMaps = shadowMaps.stats.maps;
+            hudStats.shadowTime = shadowMaps.stats.time;
+            hudStats.shadowHitRate = shadowMaps.stats.hitRate();
+            hud.update(hudStats, deltaTime);
+            hud.draw();
         }
 
+        // Record the frame before waiting for the swap
+        if (benchmark != nullptr)
+            benchmark->endFrame(static_cast<float>(1000.0 * (glfwGetTime() - frameStart)), renderStats);
+        if (replaying)
+        {
+            frameTimer.end();
+            frameTimes.push_back(static_cast<float>(1000.0 * (glfwGetTime() - frameStart)));
+            frameStats.push_back(renderStats);
+        }
 
+        // Write the selected frames to images
+        bool captureFrame = options.captureEvery > 0 && frame % options.captureEvery == 0;
+        for (unsigned int i = 0; i < static_cast<unsigned int>(options.captureFrames.size()); i++)
+            captureFrame = captureFrame || options.captureFrames[i] == frame;
+        if (captureFrame)
+        {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/frame_%05u.ppm", options.outputDirectory.c_str(), frame);
+            Framebuffer::saveImage(path, frameWidth, frameHeight);
+        }
+
+        hudStats.cpuTime = static_cast<float>(1000.0 * (glfwGetTime() - frameStart));
 
         // Swap buffers
-        glfwSwapBuffers(window);
+        {
+            PROFILE_SCOPE("Swap");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
+        Profiler::endFrame();
+        AllocationTracker::endFrame();
+        frame++;
+    }
+    GLCapture::end();
+
+    // Report the timings of a fixed length run
+    if (benchmark == nullptr && options.frames > 0)
+    {
+        glFinish();
+        double seconds = glfwGetTime() - loopStart;
+        printf("Rendered %u frames in %.2f s, %.3f ms per frame\n", frame, seconds, 1000.0 * seconds / std::max(frame, 1u));
+#ifdef NULL_GL
+        printf("%.1f GL calls per frame, %llu failed validation\n",
+               static_cast<double>(NullGL::totalCalls() - loopCalls) / std::max(frame, 1u),
+               static_cast<unsigned long long>(NullGL::errors));
+#endif
+        printf("%.1f state changes per frame, %.1f redundant ones skipped\n",
+               static_cast<double>(GLState::misses - loopMisses) / std::max(frame, 1u),
+               static_cast<double>(GLState::hits - loopHits) / std::max(frame, 1u));
+        Profiler::printSummary();
+        AllocationTracker::printSummary();
+        GLResourceTracker::printSummary();
+        if (options.lights > 0)
+            printf("%u lights, %.1f KB uploaded in %u uploads\n", lights.count(),
+                   static_cast<double>(lights.uploadedBytes) / 1024.0, lights.uploads);
+        if (clustered)
+            printf("%u cluster builds, last %.3f ms, %.1f lights per cluster, at most %u\n",
+                   lightClusters.stats.builds, lightClusters.stats.binTime,
+                   lightClusters.stats.averageLights(LightClusters::clusterCount) + lightClusters.globalLights(),
+                   lightClusters.stats.maxLights + lightClusters.globalLights());
+        if (useVariants)
+            shaderVariants.printSummary();
+        if (shadowed)
+            printf("%u shadow maps, %.1f%% cached over the run, last pass %.3f ms with %u caster draws\n",
+                   shadowMaps.stats.maps, 100.0f * shadowMaps.stats.totalHitRate(), shadowMaps.stats.time,
+                   shadowMaps.stats.casters);
+    }
+
+    // Save the recorded input
+    if (recording && inputLog.save(options.recordPath))
+        printf("Recorded %u frames of input to %s\n", static_cast<unsigned int>(inputLog.frames.size()), options.recordPath);
+
+    // Write the timings of a replay, one row per frame
+    if (replaying)
+    {
+        frameTimer.flush();
+        std::vector<float> gpuTimes(frameTimes.size(), 0.0f);
+        for (unsigned int i = 0; i < static_cast<unsigned int>(frameTimer.frames.size()); i++)
+            if (frameTimer.frames[i] < gpuTimes.size())
+                gpuTimes[frameTimer.frames[i]] = frameTimer.times[i];
+
+        FILE* file = fopen(options.timingPath, "w");
+        if (file != NULL)
+        {
+            fprintf(file, "frame,cpu_ms,gpu_ms,draw_calls,triangles\n");
+            for (unsigned int i = 0; i < static_cast<unsigned int>(frameTimes.size()); i++)
+                fprintf(file, "%u,%.4f,%.4f,%u,%llu\n", i, frameTimes[i], gpuTimes[i], frameStats[i].drawCalls,
+                        frameStats[i].triangles);
+            fclose(file);
+            printf("Replayed %u frames, timings written to %s\n", static_cast<unsigned int>(frameTimes.size()),
+                   options.timingPath);
+        }
+        else
+            printf("Impossible to write the replay timings to %s.\n", options.timingPath);
     }
 
     // Cleanup
     
-    plane.deleteBuffers();
-    oak_wood.deleteBuffers();
-    oak_plank.deleteBuffers();
-    glass.deleteBuffers(); 
-    door_top.deleteBuffers(); 
-    door_bottom.deleteBuffers(); 
-    glDeleteProgram(shaderID); 
-
-    // Close OpenGL window and terminate GLFW
-    glfwTerminate();
-    return 0;
+    for (unsigned int i = 0; i < static_cast<unsigned int>(models.size()); i++)
+        models[i].deleteBuffers();
+    voxelRenderer.deleteBuffers();
+    hud.deleteBuffers();
+    deferredRenderer.deleteBuffers();
+    shadowMaps.deleteBuffers();
+    shaderVariants.release();
+    lightClusters.release();
+    lights.release();
+    shaderID.release();
+    lightShaderID.release();
+    voxelShaderID.release();
+    voxelLitShaderID.release();
+    voxelGeometryShaderID.release();
+
+    // Store the results of a finished benchmark run
+    if (benchmark != nullptr && !benchmark->running())
+        benchmark->endRun();
+
+    return !glfwWindowShouldClose(window);
 }
 
 
@@ -457,47 +1092,178 @@ int main(void)
 
 
 
-void keyboardInput(GLFWwindow* window)
+// A white sun and coloured point lights spread over the top of the scene
+void placeLights(LightManager& lights, const AABB& bounds, unsigned int count)
+{
+    lights.add(Light::directional(glm::vec3(-0.3f, -1.0f, -0.2f), glm::vec3(0.6f)));
+    unsigned int side = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    glm::vec3 size = bounds.max - bounds.min;
+
+    // Each light reaches the ground below it and its neighbours on the grid
+    float range = std::max(2.0f * std::max(size.x, size.z) / side, size.y + 2.0f);
+    for (unsigned int i = 1; i < count; i++)
+    {
+        float u = (static_cast<float>(i % side) + 0.5f) / side;
+        float v = (static_cast<float>(i / side) + 0.5f) / side;
+        glm::vec3 position(bounds.min.x + u * size.x, bounds.max.y + 1.0f, bounds.min.z + v * size.z);
+        glm::vec3 colour(0.5f + 0.5f * std::sin(1.7f * i), 0.5f + 0.5f * std::sin(2.3f * i + 2.0f),
+                         0.5f + 0.5f * std::sin(2.9f * i + 4.0f));
+        float brightness = std::max(colour.r, std::max(colour.g, colour.b));
+        lights.add(Light::point(position, colour, 1.0f, 0.0f, (brightness / LightManager::cutoff - 1.0f) / (range * range)));
+    }
+}
+
+// Read the command line, returns false after printing the usage on an error
+bool parseOptions(int argc, char* argv[])
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--benchmark")
+        {
+            // Optional layout and results file
+            options.benchmark = true;
+            std::string layout = hasValue ? argv[i + 1] : "";
+            if (layout == "houses" || layout == "blocks" || layout == "lights")
+            {
+                options.layout = layout == "blocks" ? BenchmarkLayout::Blocks :
+                                 layout == "lights" ? BenchmarkLayout::Lights : BenchmarkLayout::Houses;
+                i++;
+            }
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                options.resultsPath = argv[++i];
+        }
+        else if (arg == "--headless")
+            options.headless = true;
+        else if (arg == "--software")
+            options.software = true;
+        else if (arg == "--frames" && hasValue)
+            options.frames = static_cast<unsigned int>(atoi(argv[++i]));
+        else if (arg == "--path" && hasValue)
+            options.cameraPath = argv[++i];
+        else if (arg == "--capture" && hasValue)
+        {
+            // Comma separated frame numbers
+            std::stringstream list(argv[++i]);
+            std::string number;
+            while (std::getline(list, number, ','))
+                options.captureFrames.push_back(static_cast<unsigned int>(atoi(number.c_str())));
+        }
+        else if (arg == "--capture-every" && hasValue)
+            options.captureEvery = static_cast<unsigned int>(atoi(argv[++i]));
+        else if (arg == "--output" && hasValue)
+            options.outputDirectory = argv[++i];
+        else if (arg == "--record" && hasValue)
+            options.recordPath = argv[++i];
+        else if (arg == "--replay" && hasValue)
+            options.replayPath = argv[++i];
+        else if (arg == "--timing" && hasValue)
+            options.timingPath = argv[++i];
+        else if (arg == "--alloc-strict")
+        {
+            options.allocationStrictness = AllocationStrictness::Log;
+            if (hasValue && std::string(argv[i + 1]) == "abort")
+                options.allocationStrictness = AllocationStrictness::Abort;
+            if (hasValue && (std::string(argv[i + 1]) == "log" || std::string(argv[i + 1]) == "abort"))
+                i++;
+        }
+        else if (arg == "--hud")
+            options.hud = true;
+        else if (arg == "--lights" && hasValue)
+            options.lights = static_cast<unsigned int>(atoi(argv[++i]));
+        else if (arg == "--flat-lights")
+            options.flatLights = true;
+        else if (arg == "--deferred")
+            options.deferred = true;
+        else if (arg == "--shadows")
+            options.shadows = true;
+        else if (arg == "--shader-variants")
+            options.shaderVariants = true;
+        else if (arg == "--lightmaps")
+        {
+            // Optional cache file
+            options.lightmaps = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                options.lightmapPath = argv[++i];
+        }
+        else if (arg == "--gl-capture" && hasValue)
+        {
+            // Optional number of frames
+            options.glCapturePath = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+                options.glCaptureFrames = static_cast<unsigned int>(atoi(argv[++i]));
+        }
+        else if (arg[0] != '-')
+            options.scenePath = argv[i];
+        else
+        {
+            printf("Usage: %s [scene] [--benchmark [houses|blocks|lights] [results.csv]] [--headless] [--software]\n"
+                   "       [--frames n] [--path camera.path] [--capture n,m,...] [--capture-every n] [--output directory]\n"
+                   "       [--record input.log] [--replay input.log [--timing timing.csv]] [--alloc-strict [log|abort]]\n"
+                   "       [--hud] [--gl-capture trace.bin [frames]] [--lights n [--flat-lights] [--deferred] [--shadows]]\n"
+                   "       [--shader-variants] [--lightmaps [cache.bin]]\n",
+                   argv[0]);
+            return false;
+        }
+    }
+
+#ifdef NULL_GL
+    // The null backend has no window to show or take input from
+    options.headless = true;
+#endif
+
+    // Headless runs always end, replays end with the log
+    if (options.headless && options.frames == 0 && options.replayPath == nullptr)
+        options.frames = 300;
+
+    return true;
+}
+
+void keyboardInput(GLFWwindow* window, const InputFrame& input)
+{
+    if (input.down(InputKeyEscape))
         glfwSetWindowShouldClose(window, true);
 
     // Move the camera using WASD keys
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (input.down(InputKeyW))
         camera.eye += 15.0f * deltaTime * camera.front;
 
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (input.down(InputKeyS))
         camera.eye -= 15.0f * deltaTime * camera.front;
 
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (input.down(InputKeyA))
         camera.eye -= 15.0f * deltaTime * camera.right;
 
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (input.down(InputKeyD))
         camera.eye += 15.0f * deltaTime * camera.right;
 
 
     // left shift key only will go down in the y axis
-    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) 
+    if (input.down(InputKeyShift)) 
         camera.eye -= 15.0f * deltaTime * camera.up;
 
 
     // go up in the y axis
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+    if (input.down(InputKeySpace))
         camera.eye += 15.0f * deltaTime * camera.up;  
+
+    // Capture the next 120 frames into a Chrome trace with F2
+    if (input.down(InputKeyF2) && !Profiler::capturing())
+        Profiler::capture(120, "profile.json");
+
+    // Toggle the performance HUD with F3
+    if (input.down(InputKeyF3) && !hudKeyDown)
+        showHUD = !showHUD;
+    hudKeyDown = input.down(InputKeyF3);
 }
 
-void mouseInput(GLFWwindow* window)
+void mouseInput(const InputFrame& input)
 {
-    // Get mouse cursor position and reset to centre
-    double xPos, yPos;
-    glfwGetCursorPos(window, &xPos, &yPos);
-    glfwSetCursorPos(window, 1024 / 2, 768 / 2);
-
-    // Update yaw and pitch angles
-    camera.yaw += 0.005f * float(xPos - 1024 / 2);
-    camera.pitch += 0.005f * float(768 / 2 - yPos);
+    // Update yaw and pitch angles from the cursor movement
+    camera.yaw += 0.005f * input.mouseX;
+    camera.pitch -= 0.005f * input.mouseY;
 
     // Calculate camera vectors from the yaw and pitch angles
     camera.calculateCameraVectors();
 }
-
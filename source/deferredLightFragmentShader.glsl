@@ -0,0 +1,257 @@
+#version 330 core
+
+# define maxShadowMaps 52
+
+// Inputs
+flat in int lightID;
+
+// Outputs, added to the output target
+out vec3 fragmentColour;
+
+// Light struct, std140 layout of Light in common/light.hpp
+struct Light
+{
+    vec3 position;
+    float constant;
+    vec3 colour;
+    float linear;
+    vec3 direction;
+    float quadratic;
+    float cosPhi;
+    int type;
+    float range;
+    int shadow;
+};
+
+// Uniforms
+uniform sampler2D albedoMap;
+uniform sampler2D normalMap;
+uniform sampler2D materialMap;
+uniform sampler2D depthMap;
+uniform samplerBuffer lightBuffer;
+uniform mat4 inverseViewProjection;
+uniform mat4 inverseView;
+
+// Shadow maps in one depth atlas, filled by ShadowMaps. The matrices take
+// world space to the texture coordinates of a tile, the first four maps of
+// a directional light are the cascades split at the view depths.
+uniform int shadows;
+uniform sampler2DShadow shadowAtlas;
+layout(std140) uniform Shadows
+{
+    mat4 shadowMatrices[maxShadowMaps];
+    vec4 shadowRects[maxShadowMaps];
+    vec4 shadowTexels[maxShadowMaps];
+    vec4 cascadeSplits;
+};
+
+// Surface of the pixel, read from the G-buffer, world space
+vec3 objectColour;
+vec3 fragmentPosition;
+vec3 Normal;
+float ka;
+float kd;
+float ks;
+float Ns;
+
+// Function prototypes
+Light getLight(int i);
+float shadowFactor(Light source);
+vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float linear, float quadratic, float visibility);
+vec3 spotLight(vec3 lightPosition, vec3 direction, vec3 lightColour, float cosPhi, float constant, float linear, float quadratic, float visibility);
+vec3 directionalLight(vec3 lightDirection, vec3 lightColour, float visibility);
+
+void main ()
+{
+    // Nothing was drawn where the depth is still cleared
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(depthMap, pixel, 0).r;
+    if (depth >= 1.0)
+        discard;
+
+    // World space position from the depth
+    vec2 ndc = 2.0 * gl_FragCoord.xy / vec2(textureSize(depthMap, 0)) - 1.0;
+    vec4 position = inverseViewProjection * vec4(ndc, 2.0 * depth - 1.0, 1.0);
+    fragmentPosition = position.xyz / position.w;
+
+    vec4 albedo   = texelFetch(albedoMap, pixel, 0);
+    vec4 material = texelFetch(materialMap, pixel, 0);
+    objectColour  = albedo.rgb;
+    Normal        = 2.0 * texelFetch(normalMap, pixel, 0).xyz - 1.0;
+    ka            = albedo.a;
+    kd            = material.r;
+    ks            = material.g;
+    Ns            = material.b * 255.0;
+
+    // Determine light properties for current light source
+    Light source = getLight(lightID);
+
+    // Skip the pixels that are out of range
+    if (source.type != 3 && length(source.position - fragmentPosition) > source.range)
+        discard;
+
+    // Fraction of the light that isn't blocked
+    float visibility = shadowFactor(source);
+
+    // Calculate point light
+    if (source.type == 1)
+        fragmentColour = pointLight(source.position, source.colour, source.constant, source.linear, source.quadratic,
+                                    visibility);
+
+    // Calculate spotlight
+    else if (source.type == 2)
+        fragmentColour = spotLight(source.position, source.direction, source.colour, source.cosPhi, source.constant,
+                                   source.linear, source.quadratic, visibility);
+
+    // Calculate directional light
+    else
+        fragmentColour = directionalLight(source.direction, source.colour, visibility);
+}
+
+// Read a light from the buffer texture
+Light getLight(int i)
+{
+    vec4 texel0 = texelFetch(lightBuffer, 4 * i);
+    vec4 texel1 = texelFetch(lightBuffer, 4 * i + 1);
+    vec4 texel2 = texelFetch(lightBuffer, 4 * i + 2);
+    vec4 texel3 = texelFetch(lightBuffer, 4 * i + 3);
+
+    Light light;
+    light.position  = texel0.xyz;
+    light.constant  = texel0.w;
+    light.colour    = texel1.xyz;
+    light.linear    = texel1.w;
+    light.direction = texel2.xyz;
+    light.quadratic = texel2.w;
+    light.cosPhi    = texel3.x;
+    light.type      = floatBitsToInt(texel3.y);
+    light.range     = texel3.z;
+    light.shadow    = floatBitsToInt(texel3.w);
+    return light;
+}
+
+// Calculate point light
+vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float linear, float quadratic, float visibility)
+{
+    // Ambient reflection
+    vec3 ambient = ka * objectColour;
+    
+    // Diffuse reflection
+    vec3 light      = normalize(lightPosition - fragmentPosition);
+    vec3 normal     = normalize(Normal);
+    float cosTheta  = max(dot(normal, light), 0);
+    vec3 diffuse    = kd * lightColour * objectColour * cosTheta;
+    
+    // Specular reflection
+    vec3 reflection = - light + 2 * dot(light, normal) * normal;
+    vec3 camera     = normalize(vec3(inverseView[3]) - fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
+    
+    // Attenuation
+    float distance    = length(lightPosition - fragmentPosition);
+    float attenuation = 1.0 / (constant + linear * distance +
+                               quadratic * distance * distance);
+    
+    // Fragment colour
+    return (ambient + visibility * (diffuse + specular)) * attenuation;
+}
+
+// Calculate spotlight
+vec3 spotLight(vec3 lightPosition, vec3 lightDirection, vec3 lightColour, float cosPhi, float constant, float linear, float quadratic, float visibility)
+{
+    // Ambient reflection
+    vec3 ambient = ka * objectColour;
+    
+    // Diffuse reflection
+    vec3 light     = normalize(lightPosition - fragmentPosition);
+    vec3 normal    = normalize(Normal);
+    float cosTheta = max(dot(normal, light), 0);
+    vec3 diffuse   = kd * lightColour * objectColour * cosTheta;
+    
+    // Specular reflection
+    vec3 reflection = - light + 2 * dot(light, normal) * normal;
+    vec3 camera     = normalize(vec3(inverseView[3]) - fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
+    
+    // Attenuation
+    float distance    = length(lightPosition - fragmentPosition);
+    float attenuation = 1.0 / (constant + linear * distance +
+                               quadratic * distance * distance);
+    
+    // Directional light intensity
+    vec3 direction  = normalize(lightDirection);
+    cosTheta        = dot(-light, direction);
+    //float intensity = 0.0;
+    //if (cosTheta > cosPhi)
+    //   intensity = 1.0;
+
+    float delta     = radians(2.0);
+    float intensity = clamp((cosTheta - cosPhi) / delta, 0.0, 1.0);
+    
+    // Return fragment colour
+    return (ambient + visibility * (diffuse + specular)) * attenuation * intensity;
+}
+
+// Calculate directional light
+vec3 directionalLight(vec3 lightDirection, vec3 lightColour, float visibility)
+{
+    // Ambient reflection
+    vec3 ambient = ka * objectColour;
+    
+    // Diffuse reflection
+    vec3 light     = normalize(-lightDirection);
+    vec3 normal    = normalize(Normal);
+    float cosTheta = max(dot(normal, light), 0);
+    vec3 diffuse   = kd * lightColour * objectColour * cosTheta;
+    
+    // Specular reflection
+    vec3 reflection = - light + 2 * dot(light, normal) * normal;
+    vec3 camera     = normalize(vec3(inverseView[3]) - fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
+    
+    // Return fragment colour
+    return ambient + visibility * (diffuse + specular);
+}
+
+// Fraction of a light that reaches the fragment
+float shadowFactor(Light source)
+{
+    if (shadows == 0 || source.shadow < 0)
+        return 1.0;
+
+    // Cascade of the view depth, or cube face of the direction from a point light
+    int map = source.shadow;
+    float distance = length(source.position - fragmentPosition);
+    if (source.type == 3)
+    {
+        float depth = dot(fragmentPosition - vec3(inverseView[3]), -vec3(inverseView[2]));
+        if (depth >= cascadeSplits.w)
+            return 1.0;
+        map += depth < cascadeSplits.x ? 0 : depth < cascadeSplits.y ? 1 : depth < cascadeSplits.z ? 2 : 3;
+        distance = 0.0;
+    }
+    else if (source.type == 1)
+    {
+        vec3 direction = fragmentPosition - source.position;
+        vec3 size = abs(direction);
+        if (size.x >= size.y && size.x >= size.z)
+            map += direction.x > 0.0 ? 0 : 1;
+        else if (size.y >= size.z)
+            map += direction.y > 0.0 ? 2 : 3;
+        else
+            map += direction.z > 0.0 ? 4 : 5;
+    }
+
+    // Look up a point moved off the surface by a texel or so against acne
+    vec4 texel = shadowTexels[map];
+    vec3 offset = normalize(Normal) * 1.5 * (texel.x + texel.y * distance);
+    vec4 position = shadowMatrices[map] * vec4(fragmentPosition + offset, 1.0);
+    position.xyz /= position.w;
+    vec4 rect = shadowRects[map];
+    if (any(lessThan(position.xy, rect.xy)) || any(greaterThan(position.xy, rect.zw)) || position.z > 1.0)
+        return 1.0;
+    return texture(shadowAtlas, vec3(position.xy, position.z - 0.0005));
+}
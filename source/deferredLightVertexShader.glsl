@@ -0,0 +1,38 @@
+#version 330 core
+
+// Inputs, the unit light volume
+layout(location = 0) in vec3 position;
+
+// Outputs
+flat out int lightID;
+
+// Uniforms
+uniform samplerBuffer lightBuffer;
+uniform mat4 viewProjection;
+uniform int volumes;        // 1 draws an instance per light, 0 a full screen triangle
+uniform int lightIndex;     // light of the full screen triangle
+
+void main()
+{
+    // Triangle covering the screen
+    if (volumes == 0)
+    {
+        lightID = lightIndex;
+        gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0);
+        return;
+    }
+
+    // Volume around the light's range, unbounded lights collapse to a point
+    lightID = gl_InstanceID;
+    vec4 texel0 = texelFetch(lightBuffer, 4 * lightID);
+    vec4 texel3 = texelFetch(lightBuffer, 4 * lightID + 3);
+    if (floatBitsToInt(texel3.y) == 3)
+    {
+        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    gl_Position = viewProjection * vec4(texel0.xyz + texel3.z * position, 1.0);
+
+    // Keep the far side of volumes that cross the far plane
+    gl_Position.z = min(gl_Position.z, gl_Position.w);
+}
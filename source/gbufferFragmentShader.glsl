@@ -0,0 +1,39 @@
+#version 330 core
+
+// Inputs, world space, the chunks of the voxel world are drawn with VOXEL
+// defined and sample a layer of the block texture array
+#ifdef VOXEL
+in vec3 UV;
+#else
+in vec2 UV;
+#endif
+in vec3 fragmentPosition;
+in vec3 Normal;
+
+// Outputs, the G-buffer targets of DeferredRenderer
+layout(location = 0) out vec4 albedo;
+layout(location = 1) out vec4 normal;
+layout(location = 2) out vec4 material;
+
+// Uniforms
+#ifdef VOXEL
+uniform sampler2DArray diffuseMap;
+#else
+uniform sampler2D diffuseMap;
+#endif
+uniform float ka;
+uniform float kd;
+uniform float ks;
+uniform float Ns;
+
+void main()
+{
+    // Object colour and ambient coefficient
+    albedo = vec4(vec3(texture(diffuseMap, UV)), ka);
+
+    // Normal mapped from [-1, 1] to [0, 1]
+    normal = vec4(0.5 * normalize(Normal) + 0.5, 1.0);
+
+    // Diffuse and specular coefficients, the shininess goes up to 255
+    material = vec4(kd, ks, min(Ns, 255.0) / 255.0, 1.0);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// Generated from ../assets/house.scene by Computer_Graphics_Coursework_sceneconverter
+
+#include <common/staticscene.hpp>
+
+namespace houselevel
+{
+    constexpr StaticMesh meshes[] = {
+        { "plane", "../assets/plane.obj", { -10, 0, -10 }, { 10, 0, 10 } },
+        { "cube", "../assets/cube.obj", { -1, -1, -1 }, { 1, 1, 1 } },
+    };
+
+    constexpr StaticMaterial materials[] = {
+        { "grass", "../assets/grass.jpg", 0.2, 0.7, 1, 20 },
+        { "oak_wood", "../assets/oak_wood.jpg", 0.2, 0.7, 1, 20 },
+        { "oak_plank", "../assets/oak_plank.jpg", 0.2, 0.7, 1, 20 },
+        { "glass", "../assets/glass.png", 0.2, 0.7, 1, 20 },
+        { "door_top", "../assets/door_top.png", 0.2, 0.7, 1, 20 },
+        { "door_bottom", "../assets/door_bottom.png", 0.2, 0.7, 1, 20 },
+    };
+
+    constexpr StaticObject objects[] = {
+        { 0, 0, { -2, -1, 0 }, { 20, 1, 20 }, { 0, 1, 0 }, 0 },
+        { 1, 4, { 0, 2, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 5, { 0, 0, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -2, 0, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 2, 0, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 2, 4, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 0, 4, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -2, 4, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { -2, 2, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { 2, 2, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 0, 8, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -4, 0, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 4, 0, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 4, 0, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -4, 0, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -4, 0, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { -4, 2, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -4, 4, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 4, 0, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { 4, 2, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 4, 4, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -2, 0, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { -2, 2, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -2, 4, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -2, 6, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -2, 6, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -2, 6, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -4, 2, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 4, 2, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 4, 2, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -4, 2, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -4, 0, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { -4, 2, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -4, 4, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 4, 0, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { 4, 2, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 4, 4, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 0, 0, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { 0, 2, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 0, 4, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 0, 6, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 0, 6, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 0, 6, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -4, 4, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 4, 4, 0 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 4, 4, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { -4, 4, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -4, 0, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { -4, 2, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { -4, 4, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 4, 0, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { 4, 2, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 4, 4, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 2, 0, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 3, { 2, 2, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 2, { 2, 4, -8 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 2, 6, -6 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 2, 6, -4 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+        { 1, 1, { 2, 6, -2 }, { 1, 1, 1 }, { 0, 1, 0 }, 0 },
+    };
+
+    constexpr StaticScene<sizeof(objects) / sizeof(objects[0])> scene = bakeScene(meshes, materials, objects);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+in vec4 Colour;
+
+// Outputs
+out vec4 colour;
+
+// Uniforms
+uniform sampler2D atlas;
+
+void main()
+{
+    // The font atlas only stores coverage
+    colour = vec4(Colour.rgb, Colour.a * texture(atlas, UV).r);
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+
+// Inputs
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec4 colour;
+
+// Outputs
+out vec2 UV;
+out vec4 Colour;
+
+// Uniforms
+uniform mat4 projection;
+
+void main()
+{
+    // Output vertex position, the HUD is laid out in pixels from the top left
+    gl_Position = projection * vec4(position, 0.0, 1.0);
+    
+    // Output texture co-ordinates and colour
+    UV = uv;
+    Colour = colour;
+}
@@ -1,87 +1,282 @@
 #version 330 core
 
-# define maxLights 10
+# define maxLights 256
+# define maxShadowMaps 52
+# define maxDynamicLights 4
 
-// Inputs
+// Variants compiled by ShaderVariants define LIGHT_VARIANT with the number of
+// lights of each type, whose indices are set per draw, and SHADOWS when any
+// of them has a shadow map. Without it the shader loops over the lights.
+// The chunks of the voxel world are drawn with VOXEL defined, their texture
+// is a layer of the block texture array and the static lights of a baked
+// chunk are in its lightmap.
+
+// Inputs, world space
+#ifdef VOXEL
+in vec3 UV;
+in vec2 LightmapUV;
+#else
 in vec2 UV;
+#endif
 in vec3 fragmentPosition;
 in vec3 Normal;
 
 // Outputs
 out vec3 fragmentColour;
 
-// Light struct
+// Light struct, std140 layout of Light in common/light.hpp
 struct Light
 {
     vec3 position;
-    vec3 colour;
     float constant;
+    vec3 colour;
     float linear;
-    float quadratic;
     vec3 direction;
+    float quadratic;
     float cosPhi;
     int type;
+    float range;
+    int shadow;
 };
 
 // Uniforms
+#ifdef VOXEL
+uniform sampler2DArray diffuseMap;
+#else
 uniform sampler2D diffuseMap;
+#endif
 uniform float ka;
 uniform float kd;
 uniform float ks;
 uniform float Ns;
-uniform Light lightSources[maxLights];
+uniform mat4 inverseView;
+
+// The first maxLights lights, filled by LightManager
+layout(std140) uniform Lights
+{
+    Light lightSources[maxLights];
+};
+
+// All of the lights as four texels each, read when there are more lights
+// than fit in the uniform block
+uniform samplerBuffer lightBuffer;
+uniform int lightCount;
+
+// Clustered shading, the grid holds the (offset, count) of each cluster's
+// list and the lists hold light indices, filled by LightClusters
+uniform int clustered;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLights;
+uniform int clusterTilesX;
+uniform int clusterTilesY;
+uniform int clusterSlices;
+uniform float clusterTileWidth;
+uniform float clusterTileHeight;
+uniform float clusterNear;
+uniform float clusterFar;
+uniform int clusterGlobalCount;
+
+// Shadow maps in one depth atlas, filled by ShadowMaps. The matrices take
+// world space to the texture coordinates of a tile, the first four maps of
+// a directional light are the cascades split at the view depths.
+uniform int shadows;
+uniform sampler2DShadow shadowAtlas;
+layout(std140) uniform Shadows
+{
+    mat4 shadowMatrices[maxShadowMaps];
+    vec4 shadowRects[maxShadowMaps];
+    vec4 shadowTexels[maxShadowMaps];
+    vec4 cascadeSplits;
+};
+
+#ifdef VOXEL
+// Lightmap of a baked chunk, filled by LightmapBaker with the co-ordinates
+// in texels, and the lights that weren't baked into it
+uniform int lightmapped;
+uniform sampler2D lightmap;
+uniform int dynamicLightCount;
+uniform int dynamicLightIndices[maxDynamicLights];
+
+// Lightmap value of an irradiance of one, LightmapBaker::scale
+const float lightmapScale = 0.5;
+#endif
+
+#ifdef LIGHT_VARIANT
+#if POINT_LIGHTS > 0
+uniform int pointLightIndices[POINT_LIGHTS];
+#endif
+#if SPOT_LIGHTS > 0
+uniform int spotLightIndices[SPOT_LIGHTS];
+#endif
+#if DIRECTIONAL_LIGHTS > 0
+uniform int directionalLightIndices[DIRECTIONAL_LIGHTS];
+#endif
+#endif
+
+// Terms shared by the lights, set once at the start of main
+vec3 objectColour;
+vec3 ambient;
+vec3 normal;
+vec3 camera;
 
 // Function prototypes
-vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float linear, float quadratic);
-vec3 spotLight(vec3 lightPosition, vec3 direction, vec3 lightColour, float cosPhi, float constant, float linear, float quadratic);
-vec3 directionalLight(vec3 lightDirection, vec3 lightColour);
+Light getLight(int i);
+vec3 shadeLight(int i);
+float shadowFactor(Light source);
+float lightVisibility(Light source);
+vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float linear, float quadratic, float visibility);
+vec3 spotLight(vec3 lightPosition, vec3 direction, vec3 lightColour, float cosPhi, float constant, float linear, float quadratic, float visibility);
+vec3 directionalLight(vec3 lightDirection, vec3 lightColour, float visibility);
 
 void main ()
 {
+    // Object colour, ambient reflection and the vectors of the fragment
+    objectColour = vec3(texture(diffuseMap, UV));
+    ambient      = ka * objectColour;
+    normal       = normalize(Normal);
+    camera       = normalize(vec3(inverseView[3]) - fragmentPosition);
+
     fragmentColour = vec3(0.0, 0.0, 0.0);
-    for (int i = 0; i < maxLights; i++)
+
+#ifdef VOXEL
+    // The static lights of a baked chunk come from its lightmap with their
+    // shadows and ambient occlusion, the lights that move are added to it
+    if (lightmapped == 1)
+    {
+        fragmentColour = objectColour * texture(lightmap, LightmapUV / vec2(textureSize(lightmap, 0))).rgb / lightmapScale;
+        for (int i = 0; i < dynamicLightCount; i++)
+            fragmentColour += shadeLight(dynamicLightIndices[i]);
+        return;
+    }
+#endif
+
+#ifdef LIGHT_VARIANT
+    // The lights of the draw by type, the loops have constant bounds
+#if POINT_LIGHTS > 0
+    for (int i = 0; i < POINT_LIGHTS; i++)
+    {
+        Light source = getLight(pointLightIndices[i]);
+        if (length(source.position - fragmentPosition) <= source.range)
+            fragmentColour += pointLight(source.position, source.colour, source.constant, source.linear,
+                                         source.quadratic, lightVisibility(source));
+    }
+#endif
+#if SPOT_LIGHTS > 0
+    for (int i = 0; i < SPOT_LIGHTS; i++)
+    {
+        Light source = getLight(spotLightIndices[i]);
+        if (length(source.position - fragmentPosition) <= source.range)
+            fragmentColour += spotLight(source.position, source.direction, source.colour, source.cosPhi,
+                                        source.constant, source.linear, source.quadratic, lightVisibility(source));
+    }
+#endif
+#if DIRECTIONAL_LIGHTS > 0
+    for (int i = 0; i < DIRECTIONAL_LIGHTS; i++)
+    {
+        Light source = getLight(directionalLightIndices[i]);
+        fragmentColour += directionalLight(source.direction, source.colour, lightVisibility(source));
+    }
+#endif
+    return;
+#endif
+
+    if (clustered == 0)
     {
-        // Determine light properties for current light source
-        vec3 lightPosition  = lightSources[i].position;
-        vec3 lightColour    = lightSources[i].colour;
-        float constant      = lightSources[i].constant;
-        float linear        = lightSources[i].linear;
-        float quadratic     = lightSources[i].quadratic;
-        vec3 lightDirection = lightSources[i].direction;
-        float cosPhi        = lightSources[i].cosPhi;
-        
-        // Calculate point light
-        if (lightSources[i].type == 1)
-            fragmentColour += pointLight(lightPosition, lightColour, constant, linear, quadratic);
-
-        // Calculate spotlight
-            if (lightSources[i].type == 2)
-                fragmentColour += spotLight(lightPosition, lightDirection, lightColour, cosPhi, constant, linear, quadratic);
-
-        // Calculate directional light
-        if (lightSources[i].type == 3)
-            fragmentColour += directionalLight(lightDirection, lightColour);
+        for (int i = 0; i < lightCount; i++)
+            fragmentColour += shadeLight(i);
+        return;
     }
+
+    // Lights that reach every cluster come first in the lists
+    for (int i = 0; i < clusterGlobalCount; i++)
+        fragmentColour += shadeLight(int(texelFetch(clusterLights, i).r));
+
+    // Cluster of the fragment from its tile and its view depth, the slices
+    // are spaced exponentially between the near and far planes
+    float depth = dot(fragmentPosition - vec3(inverseView[3]), -vec3(inverseView[2]));
+    int slice   = int(log(max(depth, clusterNear) / clusterNear) / log(clusterFar / clusterNear) * float(clusterSlices));
+    int tileX   = int(gl_FragCoord.x / clusterTileWidth);
+    int tileY   = int(gl_FragCoord.y / clusterTileHeight);
+    slice = clamp(slice, 0, clusterSlices - 1);
+    tileX = clamp(tileX, 0, clusterTilesX - 1);
+    tileY = clamp(tileY, 0, clusterTilesY - 1);
+
+    uvec2 cluster = texelFetch(clusterGrid, (slice * clusterTilesY + tileY) * clusterTilesX + tileX).rg;
+    for (uint i = 0u; i < cluster.y; i++)
+        fragmentColour += shadeLight(int(texelFetch(clusterLights, int(cluster.x + i)).r));
+}
+
+// Contribution of one light
+vec3 shadeLight(int i)
+{
+    // Determine light properties for current light source
+    Light source        = getLight(i);
+    vec3 lightPosition  = source.position;
+    vec3 lightColour    = source.colour;
+    float constant      = source.constant;
+    float linear        = source.linear;
+    float quadratic     = source.quadratic;
+    vec3 lightDirection = source.direction;
+    float cosPhi        = source.cosPhi;
+
+    // Skip the lights that are out of range
+    if (source.type != 3 && length(lightPosition - fragmentPosition) > source.range)
+        return vec3(0.0);
+
+    // Fraction of the light that isn't blocked
+    float visibility = lightVisibility(source);
+
+    // Calculate point light
+    if (source.type == 1)
+        return pointLight(lightPosition, lightColour, constant, linear, quadratic, visibility);
+
+    // Calculate spotlight
+    if (source.type == 2)
+        return spotLight(lightPosition, lightDirection, lightColour, cosPhi, constant, linear, quadratic, visibility);
+
+    // Calculate directional light
+    if (source.type == 3)
+        return directionalLight(lightDirection, lightColour, visibility);
+
+    return vec3(0.0);
+}
+
+// Read a light from the uniform block, or from the buffer texture when they
+// don't all fit in the block
+Light getLight(int i)
+{
+    if (lightCount <= maxLights)
+        return lightSources[i];
+
+    vec4 texel0 = texelFetch(lightBuffer, 4 * i);
+    vec4 texel1 = texelFetch(lightBuffer, 4 * i + 1);
+    vec4 texel2 = texelFetch(lightBuffer, 4 * i + 2);
+    vec4 texel3 = texelFetch(lightBuffer, 4 * i + 3);
+
+    Light light;
+    light.position  = texel0.xyz;
+    light.constant  = texel0.w;
+    light.colour    = texel1.xyz;
+    light.linear    = texel1.w;
+    light.direction = texel2.xyz;
+    light.quadratic = texel2.w;
+    light.cosPhi    = texel3.x;
+    light.type      = floatBitsToInt(texel3.y);
+    light.range     = texel3.z;
+    light.shadow    = floatBitsToInt(texel3.w);
+    return light;
 }
 
 // Calculate point light
-vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float linear, float quadratic)
+vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float linear, float quadratic, float visibility)
 {
-    // Object colour
-    vec3 objectColour = vec3(texture(diffuseMap, UV));
-    
-    // Ambient reflection
-    vec3 ambient = ka * objectColour;
-    
     // Diffuse reflection
     vec3 light      = normalize(lightPosition - fragmentPosition);
-    vec3 normal     = normalize(Normal);
     float cosTheta  = max(dot(normal, light), 0);
     vec3 diffuse    = kd * lightColour * objectColour * cosTheta;
     
     // Specular reflection
     vec3 reflection = - light + 2 * dot(light, normal) * normal;
-    vec3 camera     = normalize(-fragmentPosition);
     float cosAlpha  = max(dot(camera, reflection), 0);
     vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
     
@@ -91,27 +286,19 @@ vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float line
                                quadratic * distance * distance);
     
     // Fragment colour
-    return (ambient + diffuse + specular) * attenuation;
+    return (ambient + visibility * (diffuse + specular)) * attenuation;
 }
 
 // Calculate spotlight
-vec3 spotLight(vec3 lightPosition, vec3 lightDirection, vec3 lightColour, float cosPhi, float constant, float linear, float quadratic)
+vec3 spotLight(vec3 lightPosition, vec3 lightDirection, vec3 lightColour, float cosPhi, float constant, float linear, float quadratic, float visibility)
 {
-    // Object colour
-    vec3 objectColour = vec3(texture(diffuseMap, UV));
-    
-    // Ambient reflection
-    vec3 ambient = ka * objectColour;
-    
     // Diffuse reflection
     vec3 light     = normalize(lightPosition - fragmentPosition);
-    vec3 normal    = normalize(Normal);
     float cosTheta = max(dot(normal, light), 0);
     vec3 diffuse   = kd * lightColour * objectColour * cosTheta;
     
     // Specular reflection
     vec3 reflection = - light + 2 * dot(light, normal) * normal;
-    vec3 camera     = normalize(-fragmentPosition);
     float cosAlpha  = max(dot(camera, reflection), 0);
     vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
     
@@ -131,30 +318,73 @@ vec3 spotLight(vec3 lightPosition, vec3 lightDirection, vec3 lightColour, float
     float intensity = clamp((cosTheta - cosPhi) / delta, 0.0, 1.0);
     
     // Return fragment colour
-    return (ambient + diffuse + specular) * attenuation * intensity;
+    return (ambient + visibility * (diffuse + specular)) * attenuation * intensity;
 }
 
 // Calculate directional light
-vec3 directionalLight(vec3 lightDirection, vec3 lightColour)
+vec3 directionalLight(vec3 lightDirection, vec3 lightColour, float visibility)
 {
-    // Object colour
-    vec3 objectColour = vec3(texture(diffuseMap, UV));
-    
-    // Ambient reflection
-    vec3 ambient = ka * objectColour;
-    
     // Diffuse reflection
     vec3 light     = normalize(-lightDirection);
-    vec3 normal    = normalize(Normal);
     float cosTheta = max(dot(normal, light), 0);
     vec3 diffuse   = kd * lightColour * objectColour * cosTheta;
     
     // Specular reflection
     vec3 reflection = - light + 2 * dot(light, normal) * normal;
-    vec3 camera     = normalize(-fragmentPosition);
     float cosAlpha  = max(dot(camera, reflection), 0);
     vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
     
     // Return fragment colour
-    return ambient + diffuse + specular;
-}
\ No newline at end of file
+    return ambient + visibility * (diffuse + specular);
+}
+
+// Fraction of a light that reaches the fragment, a variant without shadow
+// maps leaves the lookup out
+float lightVisibility(Light source)
+{
+#if defined(LIGHT_VARIANT) && !defined(SHADOWS)
+    return 1.0;
+#else
+    return shadowFactor(source);
+#endif
+}
+
+// Shadow map lookup of a light
+float shadowFactor(Light source)
+{
+    if (shadows == 0 || source.shadow < 0)
+        return 1.0;
+
+    // Cascade of the view depth, or cube face of the direction from a point light
+    int map = source.shadow;
+    float distance = length(source.position - fragmentPosition);
+    if (source.type == 3)
+    {
+        float depth = dot(fragmentPosition - vec3(inverseView[3]), -vec3(inverseView[2]));
+        if (depth >= cascadeSplits.w)
+            return 1.0;
+        map += depth < cascadeSplits.x ? 0 : depth < cascadeSplits.y ? 1 : depth < cascadeSplits.z ? 2 : 3;
+        distance = 0.0;
+    }
+    else if (source.type == 1)
+    {
+        vec3 direction = fragmentPosition - source.position;
+        vec3 size = abs(direction);
+        if (size.x >= size.y && size.x >= size.z)
+            map += direction.x > 0.0 ? 0 : 1;
+        else if (size.y >= size.z)
+            map += direction.y > 0.0 ? 2 : 3;
+        else
+            map += direction.z > 0.0 ? 4 : 5;
+    }
+
+    // Look up a point moved off the surface by a texel or so against acne
+    vec4 texel = shadowTexels[map];
+    vec3 offset = normal * 1.5 * (texel.x + texel.y * distance);
+    vec4 position = shadowMatrices[map] * vec4(fragmentPosition + offset, 1.0);
+    position.xyz /= position.w;
+    vec4 rect = shadowRects[map];
+    if (any(lessThan(position.xy, rect.xy)) || any(greaterThan(position.xy, rect.zw)) || position.z > 1.0)
+        return 1.0;
+    return texture(shadowAtlas, vec3(position.xy, position.z - 0.0005));
+}
@@ -0,0 +1,46 @@
+#version 330 core
+
+// Inputs
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec3 normal;
+
+// The blocks of the voxel world, compiled with VOXEL, also have the layer of
+// the texture array and the lightmap co-ordinates
+#ifdef VOXEL
+layout(location = 3) in float layer;
+layout(location = 4) in vec2 lightmapUV;
+#endif
+
+// Outputs, world space so the lights don't change with the camera
+#ifdef VOXEL
+out vec3 UV;
+out vec2 LightmapUV;
+#else
+out vec2 UV;
+#endif
+out vec3 fragmentPosition;
+out vec3 Normal;
+
+// Uniforms
+uniform mat4 MVP;
+uniform mat4 MV;
+uniform mat4 inverseView;
+
+void main()
+{
+    // Output vertex position
+    gl_Position = MVP * vec4(position, 1.0);
+
+    // World space position and normal from the view space ones
+    fragmentPosition = vec3(inverseView * MV * vec4(position, 1.0));
+    Normal = mat3(inverseView) * mat3(MV) * normal;
+
+    // Output vertex UV
+#ifdef VOXEL
+    UV = vec3(uv, layer);
+    LightmapUV = lightmapUV;
+#else
+    UV = uv;
+#endif
+}
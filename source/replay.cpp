@@ -0,0 +1,1055 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <common/glcapture.hpp>
+
+// Plays back a trace recorded with the --gl-capture option of the coursework
+// as fast as possible, without any of the scene logic, and reports the time
+// spent in each kind of GL call. The calls before the first frame are the
+// setup and are replayed once, the frames can be looped.
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options
+    {
+        const char* tracePath = nullptr;
+        unsigned int loops = 1;             // times the frames are replayed
+        bool finish = false;                // wait for the GPU at the end of each frame
+        bool show = false;                  // show the window and swap at the end of each frame
+        const char* csvPath = nullptr;      // per call results
+    };
+    Options options;
+
+    // Time spent in one kind of call
+    struct CallTiming
+    {
+        uint64_t calls = 0;
+        double nanoseconds = 0.0;
+    };
+
+    // Records of a trace loaded into memory
+    struct Reader
+    {
+        std::vector<unsigned char> data;
+        size_t position = 0;
+        bool failed = false;
+
+        bool done() const
+        {
+            return position >= data.size() || failed;
+        }
+
+        template <typename T>
+        T read()
+        {
+            T value = T();
+            if (position + sizeof(T) > data.size())
+            {
+                failed = true;
+                return value;
+            }
+            memcpy(&value, &data[position], sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        // Bytes passed with a call, nullptr when the call passed a null pointer
+        const void* payload(uint32_t& bytes)
+        {
+            bytes = read<uint32_t>();
+            if (bytes == 0 || position + bytes > data.size())
+            {
+                failed = failed || bytes > 0;
+                return nullptr;
+            }
+            const void* bytesStart = &data[position];
+            position += bytes;
+            return bytesStart;
+        }
+
+        // Object names of a Gen or Delete call
+        void names(GLsizei n, std::vector<GLuint>& ids)
+        {
+            ids.resize(std::max(n, 0));
+            for (GLsizei i = 0; i < n; i++)
+                ids[i] = read<GLuint>();
+        }
+    };
+
+    // Captured object names and the ones created by the replay
+    struct NameMap
+    {
+        std::unordered_map<GLuint, GLuint> names;
+
+        GLuint operator()(GLuint name) const
+        {
+            auto it = names.find(name);
+            return it == names.end() ? name : it->second;
+        }
+
+        void add(const std::vector<GLuint>& captured, const std::vector<GLuint>& created)
+        {
+            for (size_t i = 0; i < captured.size(); i++)
+                names[captured[i]] = created[i];
+        }
+
+        void remove(const std::vector<GLuint>& captured, std::vector<GLuint>& created)
+        {
+            created.resize(captured.size());
+            for (size_t i = 0; i < captured.size(); i++)
+            {
+                created[i] = (*this)(captured[i]);
+                names.erase(captured[i]);
+            }
+        }
+    };
+
+    struct Replay
+    {
+        Reader trace;
+        NameMap buffers, vertexArrays, textures, framebuffers, renderbuffers, queries;
+        NameMap programs;           // shaders and programs share a namespace
+        GLuint program = 0;         // captured name of the program in use
+
+        // Uniform locations and block indices keyed by captured program and
+        // location or index
+        std::unordered_map<uint64_t, GLint> locations;
+        std::unordered_map<uint64_t, GLuint> blockIndices;
+
+        CallTiming timings[GLCallCount];
+        bool measuring = false;
+        double timerOverhead = 0.0;
+
+        // Scratch memory for the calls that return data
+        std::vector<GLuint> captured, created;
+        std::vector<unsigned char> pixels;
+        std::string text;
+        GLint64 integer64 = 0;
+        GLuint64 unsigned64 = 0;
+        GLint integer = 0;
+        GLint packAlignment = 4;
+        char log[4096];
+
+        // Run a GL call and add its time to the call's total
+        template <typename Function>
+        void timed(GLCall call, Function function)
+        {
+            Clock::time_point start = Clock::now();
+            function();
+            Clock::time_point end = Clock::now();
+
+            if (measuring)
+            {
+                double ns = std::chrono::duration<double, std::nano>(end - start).count() - timerOverhead;
+                timings[call].calls++;
+                timings[call].nanoseconds += std::max(ns, 0.0);
+            }
+        }
+
+        GLint location(GLint captured) const
+        {
+            auto it = locations.find((static_cast<uint64_t>(program) << 32) | static_cast<uint32_t>(captured));
+            return it == locations.end() ? captured : it->second;
+        }
+
+        bool execute(uint16_t call);
+    };
+
+    bool Replay::execute(uint16_t call)
+    {
+        Reader& r = trace;
+        uint32_t bytes = 0;
+
+        switch (call)
+        {
+        case GLCall_BindTexture:
+        {
+            GLenum target = r.read<GLenum>();
+            GLuint texture = textures(r.read<GLuint>());
+            timed(GLCall_BindTexture, [&] { glBindTexture(target, texture); });
+            break;
+        }
+        case GLCall_BlendFunc:
+        {
+            GLenum source = r.read<GLenum>();
+            GLenum destination = r.read<GLenum>();
+            timed(GLCall_BlendFunc, [&] { glBlendFunc(source, destination); });
+            break;
+        }
+        case GLCall_Clear:
+        {
+            GLbitfield mask = r.read<GLbitfield>();
+            timed(GLCall_Clear, [&] { glClear(mask); });
+            break;
+        }
+        case GLCall_ClearColor:
+        {
+            GLfloat red = r.read<GLfloat>(), green = r.read<GLfloat>(), blue = r.read<GLfloat>(), alpha = r.read<GLfloat>();
+            timed(GLCall_ClearColor, [&] { glClearColor(red, green, blue, alpha); });
+            break;
+        }
+        case GLCall_ColorMask:
+        {
+            GLboolean red = r.read<GLboolean>(), green = r.read<GLboolean>(), blue = r.read<GLboolean>(), alpha = r.read<GLboolean>();
+            timed(GLCall_ColorMask, [&] { glColorMask(red, green, blue, alpha); });
+            break;
+        }
+        case GLCall_CullFace:
+        {
+            GLenum mode = r.read<GLenum>();
+            timed(GLCall_CullFace, [&] { glCullFace(mode); });
+            break;
+        }
+        case GLCall_DeleteTextures:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            textures.remove(captured, created);
+            timed(GLCall_DeleteTextures, [&] { glDeleteTextures(n, created.data()); });
+            break;
+        }
+        case GLCall_DepthFunc:
+        {
+            GLenum function = r.read<GLenum>();
+            timed(GLCall_DepthFunc, [&] { glDepthFunc(function); });
+            break;
+        }
+        case GLCall_DepthMask:
+        {
+            GLboolean flag = r.read<GLboolean>();
+            timed(GLCall_DepthMask, [&] { glDepthMask(flag); });
+            break;
+        }
+        case GLCall_Disable:
+        {
+            GLenum cap = r.read<GLenum>();
+            timed(GLCall_Disable, [&] { glDisable(cap); });
+            break;
+        }
+        case GLCall_DrawArrays:
+        {
+            GLenum mode = r.read<GLenum>();
+            GLint first = r.read<GLint>();
+            GLsizei count = r.read<GLsizei>();
+            timed(GLCall_DrawArrays, [&] { glDrawArrays(mode, first, count); });
+            break;
+        }
+        case GLCall_DrawElements:
+        {
+            GLenum mode = r.read<GLenum>();
+            GLsizei count = r.read<GLsizei>();
+            GLenum type = r.read<GLenum>();
+            const void* indices = reinterpret_cast<const void*>(static_cast<uintptr_t>(r.read<uint64_t>()));
+            timed(GLCall_DrawElements, [&] { glDrawElements(mode, count, type, indices); });
+            break;
+        }
+        case GLCall_Enable:
+        {
+            GLenum cap = r.read<GLenum>();
+            timed(GLCall_Enable, [&] { glEnable(cap); });
+            break;
+        }
+        case GLCall_Finish:
+            timed(GLCall_Finish, [&] { glFinish(); });
+            break;
+        case GLCall_Flush:
+            timed(GLCall_Flush, [&] { glFlush(); });
+            break;
+        case GLCall_GenTextures:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            created.resize(captured.size());
+            timed(GLCall_GenTextures, [&] { glGenTextures(n, created.data()); });
+            textures.add(captured, created);
+            break;
+        }
+        case GLCall_GetError:
+            timed(GLCall_GetError, [&] { glGetError(); });
+            break;
+        case GLCall_GetIntegerv:
+        {
+            GLenum pname = r.read<GLenum>();
+            timed(GLCall_GetIntegerv, [&] { glGetIntegerv(pname, &integer); });
+            break;
+        }
+        case GLCall_GetString:
+        {
+            GLenum name = r.read<GLenum>();
+            timed(GLCall_GetString, [&] { glGetString(name); });
+            break;
+        }
+        case GLCall_PixelStorei:
+        {
+            GLenum pname = r.read<GLenum>();
+            GLint param = r.read<GLint>();
+            if (pname == GL_PACK_ALIGNMENT)
+                packAlignment = param;
+            timed(GLCall_PixelStorei, [&] { glPixelStorei(pname, param); });
+            break;
+        }
+        case GLCall_ReadBuffer:
+        {
+            GLenum mode = r.read<GLenum>();
+            timed(GLCall_ReadBuffer, [&] { glReadBuffer(mode); });
+            break;
+        }
+        case GLCall_ReadPixels:
+        {
+            GLint x = r.read<GLint>(), y = r.read<GLint>();
+            GLsizei width = r.read<GLsizei>(), height = r.read<GLsizei>();
+            GLenum format = r.read<GLenum>(), type = r.read<GLenum>();
+            pixels.resize(GLCapture::imageBytes(width, height, 1, format, type, packAlignment));
+            timed(GLCall_ReadPixels, [&] { glReadPixels(x, y, width, height, format, type, pixels.data()); });
+            break;
+        }
+        case GLCall_Scissor:
+        {
+            GLint x = r.read<GLint>(), y = r.read<GLint>();
+            GLsizei width = r.read<GLsizei>(), height = r.read<GLsizei>();
+            timed(GLCall_Scissor, [&] { glScissor(x, y, width, height); });
+            break;
+        }
+        case GLCall_TexImage2D:
+        {
+            GLenum target = r.read<GLenum>();
+            GLint level = r.read<GLint>(), internalFormat = r.read<GLint>();
+            GLsizei width = r.read<GLsizei>(), height = r.read<GLsizei>();
+            GLint border = r.read<GLint>();
+            GLenum format = r.read<GLenum>(), type = r.read<GLenum>();
+            const void* data = r.payload(bytes);
+            timed(GLCall_TexImage2D, [&] { glTexImage2D(target, level, internalFormat, width, height, border, format, type, data); });
+            break;
+        }
+        case GLCall_TexParameteri:
+        {
+            GLenum target = r.read<GLenum>(), pname = r.read<GLenum>();
+            GLint param = r.read<GLint>();
+            timed(GLCall_TexParameteri, [&] { glTexParameteri(target, pname, param); });
+            break;
+        }
+        case GLCall_TexSubImage2D:
+        {
+            GLenum target = r.read<GLenum>();
+            GLint level = r.read<GLint>(), x = r.read<GLint>(), y = r.read<GLint>();
+            GLsizei width = r.read<GLsizei>(), height = r.read<GLsizei>();
+            GLenum format = r.read<GLenum>(), type = r.read<GLenum>();
+            const void* data = r.payload(bytes);
+            timed(GLCall_TexSubImage2D, [&] { glTexSubImage2D(target, level, x, y, width, height, format, type, data); });
+            break;
+        }
+        case GLCall_Viewport:
+        {
+            GLint x = r.read<GLint>(), y = r.read<GLint>();
+            GLsizei width = r.read<GLsizei>(), height = r.read<GLsizei>();
+            timed(GLCall_Viewport, [&] { glViewport(x, y, width, height); });
+            break;
+        }
+        case GLCall_ActiveTexture:
+        {
+            GLenum texture = r.read<GLenum>();
+            timed(GLCall_ActiveTexture, [&] { glActiveTexture(texture); });
+            break;
+        }
+        case GLCall_AttachShader:
+        {
+            GLuint program = programs(r.read<GLuint>()), shader = programs(r.read<GLuint>());
+            timed(GLCall_AttachShader, [&] { glAttachShader(program, shader); });
+            break;
+        }
+        case GLCall_BeginQuery:
+        {
+            GLenum target = r.read<GLenum>();
+            GLuint id = queries(r.read<GLuint>());
+            timed(GLCall_BeginQuery, [&] { glBeginQuery(target, id); });
+            break;
+        }
+        case GLCall_BindBuffer:
+        {
+            GLenum target = r.read<GLenum>();
+            GLuint buffer = buffers(r.read<GLuint>());
+            timed(GLCall_BindBuffer, [&] { glBindBuffer(target, buffer); });
+            break;
+        }
+        case GLCall_BindBufferBase:
+        {
+            GLenum target = r.read<GLenum>();
+            GLuint index = r.read<GLuint>();
+            GLuint buffer = buffers(r.read<GLuint>());
+            timed(GLCall_BindBufferBase, [&] { glBindBufferBase(target, index, buffer); });
+            break;
+        }
+        case GLCall_BindFramebuffer:
+        {
+            GLenum target = r.read<GLenum>();
+            GLuint framebuffer = framebuffers(r.read<GLuint>());
+            timed(GLCall_BindFramebuffer, [&] { glBindFramebuffer(target, framebuffer); });
+            break;
+        }
+        case GLCall_BindRenderbuffer:
+        {
+            GLenum target = r.read<GLenum>();
+            GLuint renderbuffer = renderbuffers(r.read<GLuint>());
+            timed(GLCall_BindRenderbuffer, [&] { glBindRenderbuffer(target, renderbuffer); });
+            break;
+        }
+        case GLCall_BindVertexArray:
+        {
+            GLuint array = vertexArrays(r.read<GLuint>());
+            timed(GLCall_BindVertexArray, [&] { glBindVertexArray(array); });
+            break;
+        }
+        case GLCall_BlitFramebuffer:
+        {
+            GLint srcX0 = r.read<GLint>(), srcY0 = r.read<GLint>(), srcX1 = r.read<GLint>(), srcY1 = r.read<GLint>();
+            GLint dstX0 = r.read<GLint>(), dstY0 = r.read<GLint>(), dstX1 = r.read<GLint>(), dstY1 = r.read<GLint>();
+            GLbitfield mask = r.read<GLbitfield>();
+            GLenum filter = r.read<GLenum>();
+            timed(GLCall_BlitFramebuffer, [&] { glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter); });
+            break;
+        }
+        case GLCall_BufferData:
+        {
+            GLenum target = r.read<GLenum>();
+            GLsizeiptr size = static_cast<GLsizeiptr>(r.read<int64_t>());
+            GLenum usage = r.read<GLenum>();
+            const void* data = r.payload(bytes);
+            timed(GLCall_BufferData, [&] { glBufferData(target, size, data, usage); });
+            break;
+        }
+        case GLCall_BufferSubData:
+        {
+            GLenum target = r.read<GLenum>();
+            GLintptr offset = static_cast<GLintptr>(r.read<int64_t>());
+            GLsizeiptr size = static_cast<GLsizeiptr>(r.read<int64_t>());
+            const void* data = r.payload(bytes);
+            timed(GLCall_BufferSubData, [&] { glBufferSubData(target, offset, size, data); });
+            break;
+        }
+        case GLCall_CheckFramebufferStatus:
+        {
+            GLenum target = r.read<GLenum>();
+            timed(GLCall_CheckFramebufferStatus, [&] { glCheckFramebufferStatus(target); });
+            break;
+        }
+        case GLCall_CompileShader:
+        {
+            GLuint shader = programs(r.read<GLuint>());
+            timed(GLCall_CompileShader, [&] { glCompileShader(shader); });
+            break;
+        }
+        case GLCall_CreateProgram:
+        {
+            captured.assign(1, r.read<GLuint>());
+            created.resize(1);
+            timed(GLCall_CreateProgram, [&] { created[0] = glCreateProgram(); });
+            programs.add(captured, created);
+            break;
+        }
+        case GLCall_CreateShader:
+        {
+            GLenum type = r.read<GLenum>();
+            captured.assign(1, r.read<GLuint>());
+            created.resize(1);
+            timed(GLCall_CreateShader, [&] { created[0] = glCreateShader(type); });
+            programs.add(captured, created);
+            break;
+        }
+        case GLCall_DeleteBuffers:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            buffers.remove(captured, created);
+            timed(GLCall_DeleteBuffers, [&] { glDeleteBuffers(n, created.data()); });
+            break;
+        }
+        case GLCall_DeleteFramebuffers:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            framebuffers.remove(captured, created);
+            timed(GLCall_DeleteFramebuffers, [&] { glDeleteFramebuffers(n, created.data()); });
+            break;
+        }
+        case GLCall_DeleteProgram:
+        {
+            captured.assign(1, r.read<GLuint>());
+            programs.remove(captured, created);
+            timed(GLCall_DeleteProgram, [&] { glDeleteProgram(created[0]); });
+            break;
+        }
+        case GLCall_DeleteQueries:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            queries.remove(captured, created);
+            timed(GLCall_DeleteQueries, [&] { glDeleteQueries(n, created.data()); });
+            break;
+        }
+        case GLCall_DeleteRenderbuffers:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            renderbuffers.remove(captured, created);
+            timed(GLCall_DeleteRenderbuffers, [&] { glDeleteRenderbuffers(n, created.data()); });
+            break;
+        }
+        case GLCall_DeleteShader:
+        {
+            captured.assign(1, r.read<GLuint>());
+            programs.remove(captured, created);
+            timed(GLCall_DeleteShader, [&] { glDeleteShader(created[0]); });
+            break;
+        }
+        case GLCall_DeleteVertexArrays:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            vertexArrays.remove(captured, created);
+            timed(GLCall_DeleteVertexArrays, [&] { glDeleteVertexArrays(n, created.data()); });
+            break;
+        }
+        case GLCall_DetachShader:
+        {
+            GLuint program = programs(r.read<GLuint>()), shader = programs(r.read<GLuint>());
+            timed(GLCall_DetachShader, [&] { glDetachShader(program, shader); });
+            break;
+        }
+        case GLCall_DrawArraysInstanced:
+        {
+            GLenum mode = r.read<GLenum>();
+            GLint first = r.read<GLint>();
+            GLsizei count = r.read<GLsizei>(), instances = r.read<GLsizei>();
+            timed(GLCall_DrawArraysInstanced, [&] { glDrawArraysInstanced(mode, first, count, instances); });
+            break;
+        }
+        case GLCall_DrawBuffers:
+        {
+            GLsizei n = r.read<GLsizei>();
+            const GLenum* buffers = static_cast<const GLenum*>(r.payload(bytes));
+            timed(GLCall_DrawBuffers, [&] { glDrawBuffers(n, buffers); });
+            break;
+        }
+        case GLCall_EnableVertexAttribArray:
+        {
+            GLuint index = r.read<GLuint>();
+            timed(GLCall_EnableVertexAttribArray, [&] { glEnableVertexAttribArray(index); });
+            break;
+        }
+        case GLCall_EndQuery:
+        {
+            GLenum target = r.read<GLenum>();
+            timed(GLCall_EndQuery, [&] { glEndQuery(target); });
+            break;
+        }
+        case GLCall_FramebufferRenderbuffer:
+        {
+            GLenum target = r.read<GLenum>(), attachment = r.read<GLenum>(), renderbufferTarget = r.read<GLenum>();
+            GLuint renderbuffer = renderbuffers(r.read<GLuint>());
+            timed(GLCall_FramebufferRenderbuffer, [&] { glFramebufferRenderbuffer(target, attachment, renderbufferTarget, renderbuffer); });
+            break;
+        }
+        case GLCall_FramebufferTexture2D:
+        {
+            GLenum target = r.read<GLenum>(), attachment = r.read<GLenum>(), textureTarget = r.read<GLenum>();
+            GLuint texture = textures(r.read<GLuint>());
+            GLint level = r.read<GLint>();
+            timed(GLCall_FramebufferTexture2D, [&] { glFramebufferTexture2D(target, attachment, textureTarget, texture, level); });
+            break;
+        }
+        case GLCall_GenBuffers:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            created.resize(captured.size());
+            timed(GLCall_GenBuffers, [&] { glGenBuffers(n, created.data()); });
+            buffers.add(captured, created);
+            break;
+        }
+        case GLCall_GenFramebuffers:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            created.resize(captured.size());
+            timed(GLCall_GenFramebuffers, [&] { glGenFramebuffers(n, created.data()); });
+            framebuffers.add(captured, created);
+            break;
+        }
+        case GLCall_GenQueries:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            created.resize(captured.size());
+            timed(GLCall_GenQueries, [&] { glGenQueries(n, created.data()); });
+            queries.add(captured, created);
+            break;
+        }
+        case GLCall_GenRenderbuffers:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            created.resize(captured.size());
+            timed(GLCall_GenRenderbuffers, [&] { glGenRenderbuffers(n, created.data()); });
+            renderbuffers.add(captured, created);
+            break;
+        }
+        case GLCall_GenVertexArrays:
+        {
+            GLsizei n = r.read<GLsizei>();
+            r.names(n, captured);
+            created.resize(captured.size());
+            timed(GLCall_GenVertexArrays, [&] { glGenVertexArrays(n, created.data()); });
+            vertexArrays.add(captured, created);
+            break;
+        }
+        case GLCall_GenerateMipmap:
+        {
+            GLenum target = r.read<GLenum>();
+            timed(GLCall_GenerateMipmap, [&] { glGenerateMipmap(target); });
+            break;
+        }
+        case GLCall_GetInteger64v:
+        {
+            GLenum pname = r.read<GLenum>();
+            timed(GLCall_GetInteger64v, [&] { glGetInteger64v(pname, &integer64); });
+            break;
+        }
+        case GLCall_GetProgramInfoLog:
+        {
+            GLuint program = programs(r.read<GLuint>());
+            GLsizei size = std::min(r.read<GLsizei>(), static_cast<GLsizei>(sizeof(log)));
+            timed(GLCall_GetProgramInfoLog, [&] { glGetProgramInfoLog(program, size, NULL, log); });
+            break;
+        }
+        case GLCall_GetProgramiv:
+        {
+            GLuint program = programs(r.read<GLuint>());
+            GLenum pname = r.read<GLenum>();
+            timed(GLCall_GetProgramiv, [&] { glGetProgramiv(program, pname, &integer); });
+            break;
+        }
+        case GLCall_GetQueryObjectui64v:
+        {
+            GLuint id = queries(r.read<GLuint>());
+            GLenum pname = r.read<GLenum>();
+            timed(GLCall_GetQueryObjectui64v, [&] { glGetQueryObjectui64v(id, pname, &unsigned64); });
+            break;
+        }
+        case GLCall_GetShaderInfoLog:
+        {
+            GLuint shader = programs(r.read<GLuint>());
+            GLsizei size = std::min(r.read<GLsizei>(), static_cast<GLsizei>(sizeof(log)));
+            timed(GLCall_GetShaderInfoLog, [&] { glGetShaderInfoLog(shader, size, NULL, log); });
+            break;
+        }
+        case GLCall_GetShaderiv:
+        {
+            GLuint shader = programs(r.read<GLuint>());
+            GLenum pname = r.read<GLenum>();
+            timed(GLCall_GetShaderiv, [&] { glGetShaderiv(shader, pname, &integer); });
+            break;
+        }
+        case GLCall_GetUniformBlockIndex:
+        {
+            GLuint capturedProgram = r.read<GLuint>();
+            GLuint capturedIndex = r.read<GLuint>();
+            const void* name = r.payload(bytes);
+            text.assign(static_cast<const char*>(name), name == nullptr ? 0 : bytes);
+            GLuint program = programs(capturedProgram);
+            GLuint index = GL_INVALID_INDEX;
+            timed(GLCall_GetUniformBlockIndex, [&] { index = glGetUniformBlockIndex(program, text.c_str()); });
+            blockIndices[(static_cast<uint64_t>(capturedProgram) << 32) | capturedIndex] = index;
+            break;
+        }
+        case GLCall_GetUniformLocation:
+        {
+            // Remember which location of this replay a captured one stands for
+            GLuint capturedProgram = r.read<GLuint>();
+            GLint capturedLocation = r.read<GLint>();
+            const void* name = r.payload(bytes);
+            text.assign(static_cast<const char*>(name), name == nullptr ? 0 : bytes);
+            GLuint program = programs(capturedProgram);
+            GLint location = -1;
+            timed(GLCall_GetUniformLocation, [&] { location = glGetUniformLocation(program, text.c_str()); });
+            locations[(static_cast<uint64_t>(capturedProgram) << 32) | static_cast<uint32_t>(capturedLocation)] = location;
+            break;
+        }
+        case GLCall_LinkProgram:
+        {
+            GLuint program = programs(r.read<GLuint>());
+            timed(GLCall_LinkProgram, [&] { glLinkProgram(program); });
+            break;
+        }
+        case GLCall_QueryCounter:
+        {
+            GLuint id = queries(r.read<GLuint>());
+            GLenum target = r.read<GLenum>();
+            timed(GLCall_QueryCounter, [&] { glQueryCounter(id, target); });
+            break;
+        }
+        case GLCall_RenderbufferStorage:
+        {
+            GLenum target = r.read<GLenum>(), internalFormat = r.read<GLenum>();
+            GLsizei width = r.read<GLsizei>(), height = r.read<GLsizei>();
+            timed(GLCall_RenderbufferStorage, [&] { glRenderbufferStorage(target, internalFormat, width, height); });
+            break;
+        }
+        case GLCall_ShaderSource:
+        {
+            GLuint shader = programs(r.read<GLuint>());
+            const void* source = r.payload(bytes);
+            text.assign(static_cast<const char*>(source), source == nullptr ? 0 : bytes);
+            const GLchar* string = text.c_str();
+            timed(GLCall_ShaderSource, [&] { glShaderSource(shader, 1, &string, NULL); });
+            break;
+        }
+        case GLCall_TexBuffer:
+        {
+            GLenum target = r.read<GLenum>(), internalFormat = r.read<GLenum>();
+            GLuint buffer = buffers(r.read<GLuint>());
+            timed(GLCall_TexBuffer, [&] { glTexBuffer(target, internalFormat, buffer); });
+            break;
+        }
+        case GLCall_TexImage3D:
+        {
+            GLenum target = r.read<GLenum>();
+            GLint level = r.read<GLint>(), internalFormat = r.read<GLint>();
+            GLsizei width = r.read<GLsizei>(), height = r.read<GLsizei>(), depth = r.read<GLsizei>();
+            GLint border = r.read<GLint>();
+            GLenum format = r.read<GLenum>(), type = r.read<GLenum>();
+            const void* data = r.payload(bytes);
+            timed(GLCall_TexImage3D, [&] { glTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, data); });
+            break;
+        }
+        case GLCall_TexSubImage3D:
+        {
+            GLenum target = r.read<GLenum>();
+            GLint level = r.read<GLint>(), x = r.read<GLint>(), y = r.read<GLint>(), z = r.read<GLint>();
+            GLsizei width = r.read<GLsizei>(), height = r.read<GLsizei>(), depth = r.read<GLsizei>();
+            GLenum format = r.read<GLenum>(), type = r.read<GLenum>();
+            const void* data = r.payload(bytes);
+            timed(GLCall_TexSubImage3D, [&] { glTexSubImage3D(target, level, x, y, z, width, height, depth, format, type, data); });
+            break;
+        }
+        case GLCall_Uniform1f:
+        {
+            GLint uniform = location(r.read<GLint>());
+            GLfloat value = r.read<GLfloat>();
+            timed(GLCall_Uniform1f, [&] { glUniform1f(uniform, value); });
+            break;
+        }
+        case GLCall_Uniform1i:
+        {
+            GLint uniform = location(r.read<GLint>());
+            GLint value = r.read<GLint>();
+            timed(GLCall_Uniform1i, [&] { glUniform1i(uniform, value); });
+            break;
+        }
+        case GLCall_UniformBlockBinding:
+        {
+            GLuint capturedProgram = r.read<GLuint>();
+            GLuint capturedIndex = r.read<GLuint>();
+            GLuint binding = r.read<GLuint>();
+            auto it = blockIndices.find((static_cast<uint64_t>(capturedProgram) << 32) | capturedIndex);
+            GLuint index = it == blockIndices.end() ? capturedIndex : it->second;
+            GLuint program = programs(capturedProgram);
+            timed(GLCall_UniformBlockBinding, [&] { glUniformBlockBinding(program, index, binding); });
+            break;
+        }
+        case GLCall_UniformMatrix4fv:
+        {
+            GLint uniform = location(r.read<GLint>());
+            GLsizei count = r.read<GLsizei>();
+            GLboolean transpose = r.read<GLboolean>();
+            const GLfloat* value = static_cast<const GLfloat*>(r.payload(bytes));
+            timed(GLCall_UniformMatrix4fv, [&] { glUniformMatrix4fv(uniform, count, transpose, value); });
+            break;
+        }
+        case GLCall_UseProgram:
+        {
+            program = r.read<GLuint>();
+            GLuint replayProgram = programs(program);
+            timed(GLCall_UseProgram, [&] { glUseProgram(replayProgram); });
+            break;
+        }
+        case GLCall_VertexAttribPointer:
+        {
+            GLuint index = r.read<GLuint>();
+            GLint size = r.read<GLint>();
+            GLenum type = r.read<GLenum>();
+            GLboolean normalized = r.read<GLboolean>();
+            GLsizei stride = r.read<GLsizei>();
+            const void* pointer = reinterpret_cast<const void*>(static_cast<uintptr_t>(r.read<uint64_t>()));
+            timed(GLCall_VertexAttribPointer, [&] { glVertexAttribPointer(index, size, type, normalized, stride, pointer); });
+            break;
+        }
+        default:
+            return false;
+        }
+        return !r.failed;
+    }
+
+    // Cost of reading the clock twice, taken off every timed call
+    double measureTimerOverhead()
+    {
+        const int samples = 100000;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < samples; i++)
+        {
+            Clock::time_point a = Clock::now();
+            Clock::time_point b = Clock::now();
+            (void)a;
+            (void)b;
+        }
+        double total = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        return total / samples * 0.5;
+    }
+
+    // Read the command line, returns false after printing the usage on an error
+    bool parseOptions(int argc, char* argv[])
+    {
+        bool valid = true;
+        for (int i = 1; i < argc && valid; i++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--loops" && hasValue)
+                options.loops = std::max(atoi(argv[++i]), 1);
+            else if (arg == "--finish")
+                options.finish = true;
+            else if (arg == "--show")
+                options.show = true;
+            else if (arg == "--csv" && hasValue)
+                options.csvPath = argv[++i];
+            else if (arg[0] != '-' && options.tracePath == nullptr)
+                options.tracePath = argv[i];
+            else
+                valid = false;
+        }
+
+        if (!valid || options.tracePath == nullptr)
+        {
+            printf("Usage: Computer_Graphics_Coursework_replay trace.bin [--loops n] [--finish] [--show] [--csv results.csv]\n");
+            return false;
+        }
+        return true;
+    }
+
+    bool loadTrace(const char* path, Reader& reader)
+    {
+        FILE* file = fopen(path, "rb");
+        if (file == nullptr)
+        {
+            printf("Impossible to open %s\n", path);
+            return false;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        reader.data.resize(size > 0 ? size : 0);
+        size_t read = reader.data.empty() ? 0 : fread(&reader.data[0], 1, reader.data.size(), file);
+        fclose(file);
+
+        GLTraceHeader header;
+        if (read != reader.data.size() || read < sizeof(header))
+        {
+            printf("Impossible to read %s\n", path);
+            return false;
+        }
+
+        memcpy(&header, &reader.data[0], sizeof(header));
+        if (memcmp(header.magic, GLCapture::magic, sizeof(header.magic)) != 0 || header.version != GLCapture::version)
+        {
+            printf("%s is not a version %u GL trace\n", path, GLCapture::version);
+            return false;
+        }
+        if (header.coreCalls == 0)
+        {
+            printf("%s doesn't have the calls into the GL library, capture it with a GL_CAPTURE build\n", path);
+            return false;
+        }
+
+        reader.position = sizeof(header);
+        return true;
+    }
+
+    void printResults(const Replay& replay, const std::vector<double>& frameTimes, double setupTime)
+    {
+        std::vector<unsigned int> order;
+        double total = 0.0;
+        for (unsigned int i = 0; i < GLCallCount; i++)
+        {
+            if (replay.timings[i].calls > 0)
+                order.push_back(i);
+            total += replay.timings[i].nanoseconds;
+        }
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+        {
+            return replay.timings[a].nanoseconds > replay.timings[b].nanoseconds;
+        });
+
+        double average = 0.0, minimum = 0.0, maximum = 0.0;
+        if (!frameTimes.empty())
+        {
+            for (double time : frameTimes)
+                average += time;
+            average /= frameTimes.size();
+            minimum = *std::min_element(frameTimes.begin(), frameTimes.end());
+            maximum = *std::max_element(frameTimes.begin(), frameTimes.end());
+        }
+
+        printf("Replayed %zu frames of %s, setup %.2f ms\n", frameTimes.size(), options.tracePath, setupTime);
+        printf("Frame time %.3f ms average, %.3f ms min, %.3f ms max\n", average, minimum, maximum);
+        printf("Calls take %.3f ms per frame, %.1f ns timer overhead taken off each\n",
+               frameTimes.empty() ? 0.0 : total / 1.0e6 / frameTimes.size(), replay.timerOverhead);
+        printf("%-28s %10s %10s %10s %7s\n", "Call", "Calls", "Total ms", "ns/call", "Share");
+        for (unsigned int i : order)
+        {
+            const CallTiming& timing = replay.timings[i];
+            printf("%-28s %10llu %10.3f %10.1f %6.1f%%\n", GLCapture::name(i),
+                   static_cast<unsigned long long>(timing.calls), timing.nanoseconds / 1.0e6,
+                   timing.nanoseconds / timing.calls, total > 0.0 ? 100.0 * timing.nanoseconds / total : 0.0);
+        }
+
+        if (options.csvPath == nullptr)
+            return;
+
+        FILE* file = fopen(options.csvPath, "w");
+        if (file == nullptr)
+        {
+            printf("Impossible to open %s\n", options.csvPath);
+            return;
+        }
+        fprintf(file, "call,calls,total_ms,ns_per_call\n");
+        for (unsigned int i : order)
+        {
+            const CallTiming& timing = replay.timings[i];
+            fprintf(file, "%s,%llu,%.4f,%.2f\n", GLCapture::name(i), static_cast<unsigned long long>(timing.calls),
+                    timing.nanoseconds / 1.0e6, timing.nanoseconds / timing.calls);
+        }
+        fclose(file);
+        printf("Results written to %s\n", options.csvPath);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (!parseOptions(argc, argv))
+        return -1;
+
+    Replay replay;
+    if (!loadTrace(options.tracePath, replay.trace))
+        return -1;
+
+    // Same context as the coursework
+    if (!glfwInit())
+    {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return -1;
+    }
+    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, options.show ? GL_TRUE : GL_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(1024, 768, "Coursework replay", NULL, NULL);
+    if (window == NULL)
+    {
+        fprintf(stderr, "Failed to open GLFW window.\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    glewExperimental = true;
+    if (glewInit() != GLEW_OK)
+    {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    replay.timerOverhead = measureTimerOverhead();
+
+    // Setup calls run once, then the frames are looped
+    Reader& trace = replay.trace;
+    size_t firstFrame = 0;
+    unsigned int loop = 0;
+    std::vector<double> frameTimes;
+    double setupTime = 0.0;
+    Clock::time_point start = Clock::now();
+    bool ok = true;
+
+    // Time from the last frame marker, the frames end at a marker or at the
+    // end of the trace
+    auto endFrame = [&]()
+    {
+        if (options.finish)
+            glFinish();
+        if (options.show)
+        {
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+
+        double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (replay.measuring)
+            frameTimes.push_back(elapsed);
+        else
+            setupTime = elapsed;
+        start = Clock::now();
+    };
+
+    while (ok)
+    {
+        if (trace.done())
+        {
+            if (firstFrame == 0)
+                break;
+
+            endFrame();
+            if (++loop == options.loops)
+                break;
+            trace.position = firstFrame;
+            continue;
+        }
+
+        size_t position = trace.position;
+        uint16_t call = trace.read<uint16_t>();
+        if (call != GLCallFrame)
+        {
+            ok = replay.execute(call);
+            if (!ok)
+                printf("Impossible to replay %s (call %u) at byte %zu\n", GLCapture::name(call), call, position);
+            continue;
+        }
+
+        endFrame();
+        if (!replay.measuring)
+        {
+            firstFrame = trace.position;
+            replay.measuring = true;
+        }
+    }
+
+    if (ok)
+        printResults(replay, frameTimes, setupTime);
+
+    glfwTerminate();
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+
+#include <common/scene.hpp>
+
+// Shortest text that reads back as the same float
+static std::string number(float value)
+{
+    char text[32];
+    for (int digits = 6; digits <= 9; digits++)
+    {
+        snprintf(text, sizeof(text), "%.*g", digits, value);
+        if (strtof(text, nullptr) == value)
+            break;
+    }
+    return text;
+}
+
+static std::string vector(const glm::vec3& v)
+{
+    return "{ " + number(v.x) + ", " + number(v.y) + ", " + number(v.z) + " }";
+}
+
+// Write the scene as constexpr tables for bakeScene, the namespace is the
+// name of the output file
+static bool saveHeader(const Scene& scene, const char* input, const char* path)
+{
+    std::string name = path;
+    size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos)
+        name = name.substr(slash + 1);
+    name = name.substr(0, name.find('.'));
+    for (char& c : name)
+        if (!isalnum(static_cast<unsigned char>(c)))
+            c = '_';
+
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("Impossible to open the file %s.\n", path);
+        return false;
+    }
+
+    fprintf(file, "#pragma once\n\n");
+    fprintf(file, "// Generated from %s by Computer_Graphics_Coursework_sceneconverter\n\n", input);
+    fprintf(file, "#include <common/staticscene.hpp>\n\n");
+    fprintf(file, "namespace %s\n{\n", name.c_str());
+
+    fprintf(file, "    constexpr StaticMesh meshes[] = {\n");
+    for (const SceneMesh& mesh : scene.meshes)
+        fprintf(file, "        { \"%s\", \"%s\", %s, %s },\n", mesh.name.c_str(), mesh.path.c_str(),
+                vector(mesh.bounds.min).c_str(), vector(mesh.bounds.max).c_str());
+    fprintf(file, "    };\n\n");
+
+    fprintf(file, "    constexpr StaticMaterial materials[] = {\n");
+    for (const SceneMaterial& material : scene.materials)
+        fprintf(file, "        { \"%s\", \"%s\", %s, %s, %s, %s },\n", material.name.c_str(),
+                material.texture.c_str(), number(material.ka).c_str(), number(material.kd).c_str(),
+                number(material.ks).c_str(), number(material.Ns).c_str());
+    fprintf(file, "    };\n\n");
+
+    // Angles go back to degrees
+    fprintf(file, "    constexpr StaticObject objects[] = {\n");
+    for (unsigned int i = 0; i < scene.objectCount; i++)
+        fprintf(file, "        { %u, %u, %s, %s, %s, %s },\n", scene.meshIDs[i], scene.materialIDs[i],
+                vector(scene.positions[i]).c_str(), vector(scene.scales[i]).c_str(), vector(scene.axes[i]).c_str(),
+                number(static_cast<float>(scene.angles[i] * 180.0 / Maths::piDouble)).c_str());
+    fprintf(file, "    };\n\n");
+
+    fprintf(file, "    constexpr StaticScene<sizeof(objects) / sizeof(objects[0])> scene = bakeScene(meshes, materials, objects);\n");
+    fprintf(file, "}\n");
+    fclose(file);
+
+    printf("%s: %u objects, %u meshes, %u materials\n", path, scene.objectCount,
+           static_cast<unsigned int>(scene.meshes.size()), static_cast<unsigned int>(scene.materials.size()));
+    return true;
+}
+
+// Compile a text scene into a binary snapshot that loads with mmap, or into
+// a header of constexpr tables when the output ends in .hpp
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <input.scene> <output.bin | output.hpp>\n", argv[0]);
+        return 1;
+    }
+
+    Scene scene;
+    if (!scene.load(argv[1]))
+        return 1;
+
+    size_t length = strlen(argv[2]);
+    if (length > 4 && strcmp(argv[2] + length - 4, ".hpp") == 0)
+        return saveHeader(scene, argv[1], argv[2]) ? 0 : 1;
+
+    if (!scene.saveBinary(argv[2]))
+        return 1;
+
+    // Load the snapshot back to check it and report the load time
+    Scene snapshot;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!snapshot.loadBinary(argv[2]) || snapshot.objectCount != scene.objectCount)
+    {
+        fprintf(stderr, "Snapshot %s failed to load back.\n", argv[2]);
+        return 1;
+    }
+    float time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    printf("%s: %u objects, %u meshes, %u materials, loaded in %.3f ms\n", argv[2], snapshot.objectCount,
+           static_cast<unsigned int>(snapshot.meshes.size()), static_cast<unsigned int>(snapshot.materials.size()), time);
+    return 0;
+}
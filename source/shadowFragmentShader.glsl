@@ -0,0 +1,6 @@
+#version 330 core
+
+void main()
+{
+    // Only the depth is written
+}
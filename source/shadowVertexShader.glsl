@@ -0,0 +1,14 @@
+#version 330 core
+
+// Inputs
+layout(location = 0) in vec3 position;
+
+// Uniforms
+uniform mat4 viewProjection;
+uniform mat4 model;
+
+void main()
+{
+    // Output vertex position in the clip space of the light
+    gl_Position = viewProjection * model * vec4(position, 1.0);
+}
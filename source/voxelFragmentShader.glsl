@@ -0,0 +1,25 @@
+#version 330 core
+
+// Inputs
+in vec3 UV;
+in vec2 LightmapUV;
+
+// Outputs
+out vec3 colour;
+
+// Uniforms
+uniform sampler2DArray diffuseMap;
+uniform sampler2D lightmap;
+uniform int lightmapped;
+
+// Lightmap value of an irradiance of one, LightmapBaker::scale
+const float lightmapScale = 0.5;
+
+void main()
+{
+    colour = vec3(texture(diffuseMap, UV));
+
+    // Baked irradiance, the lightmap co-ordinates are in texels
+    if (lightmapped == 1)
+        colour *= texture(lightmap, LightmapUV / vec2(textureSize(lightmap, 0))).rgb / lightmapScale;
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+// Inputs
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+layout(location = 3) in float layer;
+layout(location = 4) in vec2 lightmapUV;
+
+// Outputs
+out vec3 UV;
+out vec2 LightmapUV;
+
+// Uniforms
+uniform mat4 MVP;
+
+void main()
+{
+    // Output vertex position
+    gl_Position = MVP * vec4(position, 1.0);
+    
+    // Output texture co-ordinates and array layer
+    UV = vec3(uv, layer);
+    LightmapUV = lightmapUV;
+}